@@ -35,6 +35,7 @@ system("stty -F /dev/ttyUSB0 115200");
 ///////////////////////////////////////////////
 
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <avr/io.h>         //macros
 #include <stdio.h>
 #include <string.h>
@@ -174,11 +175,25 @@ void Timer0_init(void)
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0 overflow
+//wakes it, the lcd is written after.
 void Delay(unsigned long val)
 {
 	volatile unsigned long t = val;
     gTimeTick = 0x00;           //upcounter
-    while (t > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0 and spi keep running
+    while (t > gTimeTick)
+    {
+        cli();
+        if (t > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
@@ -1,16 +1,25 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <avr/interrupt.h>
 
 #include "command.h"
 #include "usart.h"
 #include "nrf24l01.h"
+#include "duty.h"
+#include "payload.h"
+#include "telemetry.h"
 
 
 ///////////////////////////////////////////////
 //static function prototype defs
 //see below for function definitions
 static void cmdHelp(int argc, char** argv);
+static void cmdDuty(int argc, char** argv);
+static void cmdMode(int argc, char** argv);
+static void cmdPayload(int argc, char** argv);
+static void cmdRadio(int argc, char** argv);
+static void cmdScan(int argc, char** argv);
 static void cmdFunction1(int argc, char** argv);
 static void cmdFunction2(int argc, char** argv);
 static void cmdFunction3(int argc, char** argv);
@@ -19,21 +28,45 @@ static void cmdFunction3(int argc, char** argv);
 
 ////////////////////////////////////////////
 //CommandStruct commandTable
+//Flash only.  Keep it sorted by the command
+//string (strcmp order, '?' before letters),
+//the lookup is a binary search.
+//{command, menu, min args, max args, function}
+//usart/command/host/tablecheck.c checks the order.
 
-static const CommandStruct commandTable[5] = 
+static const CommandStruct commandTable[] PROGMEM = 
 {
-    {"?",       "Print Help",   cmdHelp},
-    {"string1", "menu string1", cmdFunction1},
-    {"string2", "menu string1", cmdFunction2},
-    {"string3", "menu string2", cmdFunction3},
-    {NULL, NULL, NULL},
+    {"?",       "Print Help, ? <cmd> for one", 0, 1, cmdHelp},
+    {"duty",    "stats, off, rx, tx, send", 0, 1, cmdDuty},
+    {"mode",    "output mode, text or bin", 0, 1, cmdMode},
+    {"payload", "<n> test samples, batched", 1, 1, cmdPayload},
+    {"radio",   "stats, clear, burst, rate, ch", 0, 3, cmdRadio},
+    {"scan",    "[samples] RPD hits, ch 0-125", 0, 1, cmdScan},
+    {"string1", "menu string1", 0, 0, cmdFunction1},
+    {"string2", "menu string1", 0, 0, cmdFunction2},
+    {"string3", "menu string2", 0, 0, cmdFunction3},
 };
 
+#define COMMAND_TABLE_SIZE      (int)(sizeof(commandTable) / sizeof(CommandStruct))
+
+//radio burst, payload - longest wait for a tx
+//queue slot.
+//ESB retries of one packet are well under this
+#define RADIO_BURST_WAIT_MS     100
+
 
 
 void cmdHelp(int argc, char** argv)
 {
-    Usart_sendString("Help Function\r\n");
+    if (argc > 1)
+    {
+        if (Command_PrintCommandHelp(argv[1]) < 0)
+            Usart_sendString_P(PSTR("No Such Command\r\n"));
+
+        return;
+    }
+
+    Usart_sendString_P(PSTR("Help Function\r\n"));
     Command_PrintHelp();
 }
 
@@ -45,7 +78,7 @@ void cmdFunction1(int argc, char** argv)
 {
     uint8_t tx[8] = {0xFE, 0xFE, 0xFE, 0xFE,0xFE, 0xFE, 0xFE,0x01}; 
     nrf24_transmitData(0, tx, 8);
-    Usart_sendString("FE in beginning  Hello From Handler Function 1!!\r\n");
+    Usart_sendString_P(PSTR("FE in beginning  Hello From Handler Function 1!!\r\n"));
 
 }
 
@@ -53,40 +86,421 @@ void cmdFunction2(int argc, char** argv)
 {
     uint8_t tx[8] = {0x01, 0xFE, 0xFE, 0xFE,0xFE, 0xFE, 0xFE,0xFE}; 
     nrf24_transmitData(0, tx, 8);
-    Usart_sendString("FE  in end  Hello From Handler Function 2!!\r\n");
+    Usart_sendString_P(PSTR("FE  in end  Hello From Handler Function 2!!\r\n"));
 }
 
 
 void cmdFunction3(int argc, char** argv)
 {
-    Usart_sendString("Hello From Handler Function 3!!\r\n");
+    Usart_sendString_P(PSTR("Hello From Handler Function 3!!\r\n"));
+}
+
+
+//////////////////////////////////////////////
+//Duty cycled radio, battery nodes (duty.h)
+//duty                  - role, sync and counts
+//duty off              - radio always on
+//duty rx               - receive windows and beacons
+//duty tx               - sender, waits for the windows
+//duty send             - test sensor packet, through
+//                        Duty_send
+void cmdDuty(int argc, char** argv)
+{
+    char buffer[64];
+    uint8_t packet[NRF24_PIPE_WIDTH] = {0xFE, STATION_1, 0xFF, 0, 0, 0, 0, 0xFE};
+    DutyStats stats;
+    int n;
+
+    if (argc > 1)
+    {
+        if (!strcmp_P(argv[1], PSTR("off")))
+            Duty_enable(DUTY_ROLE_OFF);
+        else if (!strcmp_P(argv[1], PSTR("rx")))
+            Duty_enable(DUTY_ROLE_RX);
+        else if (!strcmp_P(argv[1], PSTR("tx")))
+            Duty_enable(DUTY_ROLE_TX);
+        else if (!strcmp_P(argv[1], PSTR("send")))
+        {
+            if (Duty_send(0, packet, NRF24_PIPE_WIDTH) < 0)
+                Usart_sendString_P(PSTR("Duty Busy\r\n"));
+        }
+        else
+            Usart_sendString_P(PSTR("Duty: off, rx, tx, send\r\n"));
+
+        return;
+    }
+
+    Duty_getStats(&stats);
+
+    n = snprintf_P(buffer, 64, PSTR("Role: %u  Synced: %u  Period: %u  Busy: %u\r\n"),
+            Duty_getRole(), Duty_isSynced(), Duty_getPeriod(), Duty_busy());
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("Windows: %lu  Radio ms: %lu\r\n"),
+            (unsigned long)stats.windows, (unsigned long)stats.radioOn);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("RX: %u  Copies: %u  Beacons: %u\r\n"),
+            stats.received, stats.duplicates, stats.beacons);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("Sent: %u  Synced: %u  Preamble: %u\r\n"),
+            stats.sent, stats.synced, stats.preamble);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("Acked: %u  Lost Sync: %u\r\n"),
+            stats.acked, stats.lostSync);
+    Usart_sendArray((unsigned char*)buffer, n);
+}
+
+
+//////////////////////////////////////////////
+//Output mode - text (default) or bin, binary
+//frames for the rx packets and samples, see
+//telemetry.h.  No arg prints the mode.
+void cmdMode(int argc, char** argv)
+{
+    if (argc > 1)
+    {
+        if (!strcmp_P(argv[1], PSTR("bin")))
+            Telemetry_setMode(TELEMETRY_MODE_BINARY);
+        else if (!strcmp_P(argv[1], PSTR("text")))
+            Telemetry_setMode(TELEMETRY_MODE_TEXT);
+        else
+        {
+            Usart_sendString_P(PSTR("Mode: text or bin\r\n"));
+            return;
+        }
+    }
+
+    if (Telemetry_getMode() == TELEMETRY_MODE_BINARY)
+        Usart_sendString_P(PSTR("Mode: bin\r\n"));
+    else
+        Usart_sendString_P(PSTR("Mode: text\r\n"));
+}
+
+
+//////////////////////////////////////////////
+//Batched samples (payload.h)
+//payload <n>           - n test samples of a slow sensor,
+//                        1s apart, in as few frames as fit.
+//                        Duty cycled sender - one frame,
+//                        the rest when it's not busy
+void cmdPayload(int argc, char** argv)
+{
+    static uint8_t seq = 0x00;
+    PayloadBatch batch;
+    uint8_t frame[PAYLOAD_FRAME_SIZE];
+    char buffer[64];
+    int16_t value = 750;
+    uint8_t frames = 0x00, length;
+    long count, i;
+    int n, result = 0;
+
+    if ((Command_GetInt(argv[1], &count) < 0) || (count < 1) || (count > PAYLOAD_MAX_SAMPLES))
+    {
+        Usart_sendString_P(PSTR("Payload: 1 - 32 samples\r\n"));
+        return;
+    }
+
+    Payload_batchInit(&batch, MID_TEMP_MCP9700A, 10);
+
+    for (i = 0 ; i < count ; i++)
+    {
+        value += ((i * 7) % 5) - 2;
+        Payload_batchAdd(&batch, value);
+    }
+
+    while ((length = Payload_encode(frame, STATION_1, seq, &batch)) > 0)
+    {
+        if (Duty_getRole() == DUTY_ROLE_TX)
+        {
+            if (Duty_send(PAYLOAD_PIPE, frame, length) < 0)
+                break;
+        }
+        else if ((result = nrf24_sendWait(PAYLOAD_PIPE, frame, length, RADIO_BURST_WAIT_MS)) < 0)
+            break;
+
+        seq++;
+        frames++;
+    }
+
+    n = snprintf_P(buffer, 64, PSTR("Samples: %ld  Frames: %u  Left: %u\r\n"),
+            count, frames, batch.count);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    if (result < 0)
+        Usart_sendString_P(PSTR("Payload: tx queue full, frame dropped\r\n"));
+}
+
+
+//////////////////////////////////////////////
+//Radio
+//radio                 - link counters
+//radio clear           - zero them
+//radio channel <n>     - RF channel, 0 - 125
+//radio burst <n>       - send n test packets streaming,
+//                        print packets per second
+//radio burst <n> wait  - same, send and wait each one
+//radio rate <kbps>     - 250, 1000 or 2000
+//radio esb <0|1>       - Enhanced ShockBurst link off / on
+//radio ack <pipe> <hex> - payload for the next ack on pipe
+void cmdRadio(int argc, char** argv)
+{
+    char buffer[64];
+    uint8_t packet[NRF24_PIPE_WIDTH] = {0xFE, STATION_1, 0xFF, 0, 0, 0, 0, 0xFE};
+    long count, i;
+    uint32_t start, elapsed, sent;
+    NRF24_LinkStats stats;
+    int n;
+
+    if ((argc > 2) && !strcmp_P(argv[1], PSTR("rate")) && (Command_GetInt(argv[2], &count) == 0))
+    {
+        if (count == 250)
+            nrf24_setDataRate(NRF24_RATE_250KBPS);
+        else if (count == 1000)
+            nrf24_setDataRate(NRF24_RATE_1MBPS);
+        else if (count == 2000)
+            nrf24_setDataRate(NRF24_RATE_2MBPS);
+        else
+            Usart_sendString_P(PSTR("Rate: 250, 1000, 2000\r\n"));
+
+        return;
+    }
+
+    if ((argc > 1) && !strcmp_P(argv[1], PSTR("clear")))
+    {
+        nrf24_clearLinkStats();
+        return;
+    }
+
+    if ((argc > 2) && !strcmp_P(argv[1], PSTR("channel")) && (Command_GetInt(argv[2], &count) == 0))
+    {
+        if ((count < 0) || (count > NRF24_CHANNEL_MAX))
+            Usart_sendString_P(PSTR("Channel: 0 - 125\r\n"));
+        else
+            nrf24_setChannel((uint8_t)count);
+
+        return;
+    }
+
+    if ((argc > 2) && !strcmp_P(argv[1], PSTR("esb")) && (Command_GetInt(argv[2], &count) == 0))
+    {
+        nrf24_setEsb(count ? 1 : 0);
+        return;
+    }
+
+    if ((argc > 3) && !strcmp_P(argv[1], PSTR("ack")) && (Command_GetInt(argv[2], &count) == 0))
+    {
+        uint8_t *data;
+
+        n = Command_GetBytes(argv[3], &data);
+
+        if ((n <= 0) || (nrf24_setAckPayload((uint8_t)count, data, n) < 0))
+            Usart_sendString_P(PSTR("Ack Payload Failed\r\n"));
+
+        return;
+    }
+
+    if ((argc > 2) && !strcmp_P(argv[1], PSTR("burst")) && (Command_GetInt(argv[2], &count) == 0))
+    {
+        sent = nrf24_getTxCount();
+
+        cli();
+        start = nrf24_getTimeStamp();
+        sei();
+
+        for (i = 0 ; i < count ; i++)
+        {
+            packet[3] = (uint8_t)i;
+
+            if (argc > 3)
+                nrf24_transmitData(0, packet, NRF24_PIPE_WIDTH);
+            else if (nrf24_sendWait(0, packet, NRF24_PIPE_WIDTH, RADIO_BURST_WAIT_MS) < 0)
+            {
+                n = snprintf_P(buffer, 64, PSTR("Burst stopped at packet %ld, tx queue full\r\n"), i);
+                Usart_sendArray((unsigned char*)buffer, n);
+                break;
+            }
+        }
+
+        nrf24_txWait();
+
+        cli();
+        elapsed = nrf24_getTimeStamp() - start;
+        sei();
+
+        sent = nrf24_getTxCount() - sent;
+
+        if (!elapsed)
+            elapsed = 1;
+
+        n = snprintf_P(buffer, 64, PSTR("Sent: %lu  ms: %lu  pps: %lu\r\n"),
+                (unsigned long)sent, (unsigned long)elapsed,
+                (unsigned long)((sent * 1000) / elapsed));
+
+        Usart_sendArray((unsigned char*)buffer, n);
+        return;
+    }
+
+    nrf24_getLinkStats(&stats);
+
+    n = snprintf_P(buffer, 64, PSTR("TX OK: %lu  Lost: %lu  Retries: %lu\r\n"),
+            (unsigned long)stats.txOk, (unsigned long)stats.txLost,
+            (unsigned long)stats.txRetransmits);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("MAX_RT: %u  Timeout: %u  Queue Full: %u\r\n"),
+            stats.txMaxRt, stats.txTimeout, stats.txQueueFull);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("RX Pipe:"));
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    for (i = 0 ; i < 6 ; i++)
+    {
+        n = snprintf_P(buffer, 64, PSTR(" %lu"), (unsigned long)stats.rxPipe[i]);
+        Usart_sendArray((unsigned char*)buffer, n);
+    }
+
+    Usart_sendString_P(PSTR("\r\n"));
+
+    n = snprintf_P(buffer, 64, PSTR("Dropped: %u  FIFO Full: %u  Width: %u  Invalid: %u\r\n"),
+            stats.rxDropped, stats.rxFifoFull, stats.rxBadWidth, stats.rxInvalid);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    n = snprintf_P(buffer, 64, PSTR("Channel: %u  ESB: %u\r\n"), nrf24_getChannel(), nrf24_getEsb());
+    Usart_sendArray((unsigned char*)buffer, n);
+}
+
+
+
+//////////////////////////////////////////////
+//Scan
+//scan [samples]  - listen on each channel, 0 - 125,
+//samples times (NRF24_SCAN_SAMPLES, max 99) and
+//print how often RPD (above -64dBm) was set, 16 to
+//a row.  Then the quietest channel.  Back on the
+//link channel after, packets sent to this one
+//while it runs are missed.
+void cmdScan(int argc, char** argv)
+{
+    char buffer[16];
+    long samples = NRF24_SCAN_SAMPLES;
+    uint8_t channel, best = 0, bestHits = 0xFF;
+    int hits, n;
+
+    if (Duty_getRole() != DUTY_ROLE_OFF)
+    {
+        Usart_sendString_P(PSTR("Duty Cycled - duty off first\r\n"));
+        return;
+    }
+
+    if ((argc > 1) && ((Command_GetInt(argv[1], &samples) < 0) || (samples < 1) || (samples > 99)))
+    {
+        Usart_sendString_P(PSTR("Samples: 1 - 99\r\n"));
+        return;
+    }
+
+    nrf24_txWait();
+
+    for (channel = 0 ; channel <= NRF24_CHANNEL_MAX ; channel++)
+    {
+        if (!(channel & 0x0F))
+        {
+            n = snprintf_P(buffer, 16, PSTR("%s%03u:"), channel ? "\r\n" : "", channel);
+            Usart_sendArray((unsigned char*)buffer, n);
+        }
+
+        hits = nrf24_scanChannel(channel, (uint8_t)samples);
+
+        if (hits < 0)
+        {
+            Usart_sendString_P(PSTR("\r\nRadio Busy\r\n"));
+            return;
+        }
+
+        if (hits < bestHits)
+        {
+            bestHits = (uint8_t)hits;
+            best = channel;
+        }
+
+        n = snprintf_P(buffer, 16, PSTR(" %2d"), hits);
+        Usart_sendArray((unsigned char*)buffer, n);
+    }
+
+    n = snprintf_P(buffer, 16, PSTR("\r\nBest: %u\r\n"), best);
+    Usart_sendArray((unsigned char*)buffer, n);
+}
+
+
+
+/////////////////////////////////////////////
+//Command_Find
+//Binary search of the sorted table.
+//returns the index, -1 if no match
+static int Command_Find(char *name)
+{
+    int low = 0x00;
+    int high = COMMAND_TABLE_SIZE - 1;
+    int mid, cmp;
+
+    if (name == NULL)
+        return -1;
+
+    while (low <= high)
+    {
+        mid = (low + high) / 2;
+        cmp = strcmp_P(name, commandTable[mid].cmdString);
+
+        if (!cmp)
+            return mid;
+        else if (cmp < 0)
+            high = mid - 1;
+        else
+            low = mid + 1;
+    }
+
+    return -1;
 }
 
 
 /////////////////////////////////////////////
 //Command_ExeCommand
 //Takes parsed arguments, searches for the
-//matching command string, runs the cooresponding
-//function.
+//matching command string, checks the number
+//of args, runs the cooresponding function.
 //returns index of the table element, -1 if
-//no match
+//no match, -2 if wrong number of args
 int Command_ExeCommand(int argc, char** argv)
 {
-    int i = 0x00;
-    
-    while (commandTable[i].cmdString != NULL)
-    {
-        if (!strcmp(argv[0], commandTable[i].cmdString))
-        {
-            //run the function
-            commandTable[i].cmdPtr(argc, argv);
-            return i;
-        }
+    void (*cmdPtr) (int argc, char** argv);
+    unsigned char args;
+    int i;
+
+    if (argc < 1)
+        return -1;
 
-        i++;
+    i = Command_Find(argv[0]);
+
+    if (i < 0)
+        return -1;
+
+    args = argc - 1;
+
+    if ((args < pgm_read_byte(&commandTable[i].minArgs)) ||
+        (args > pgm_read_byte(&commandTable[i].maxArgs)))
+    {
+        Command_PrintCommandHelp(argv[0]);
+        return -2;
     }
 
-    return -1;
+    //run the function
+    cmdPtr = (void (*) (int, char**))pgm_read_word(&commandTable[i].cmdPtr);
+    cmdPtr(argc, argv);
+
+    return i;
 }
 
 
@@ -99,14 +513,231 @@ void Command_PrintHelp(void)
     int n = 0x00;
     char buffer[64];
 
-    while (commandTable[i].cmdString != NULL)
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
     {
-        n = snprintf(buffer, 64, "%-16s  %-32s\r\n", commandTable[i].cmdString, commandTable[i].menuString);
+        n = snprintf_P(buffer, 64, PSTR("%-16S  %-32S\r\n"), commandTable[i].cmdString, commandTable[i].menuString);
         Usart_sendArray((unsigned char*)buffer, n);
-        i++;
     }
+}
+
+
+//////////////////////////////////////
+//Prints one command, its description
+//and the number of args it takes.
+//returns the index, -1 if no match
+int Command_PrintCommandHelp(char *name)
+{
+    int i = Command_Find(name);
+    int n = 0x00;
+    char buffer[64];
+
+    if (i < 0)
+        return -1;
+
+    n = snprintf_P(buffer, 64, PSTR("%S - %S, args %u-%u\r\n"),
+            commandTable[i].cmdString,
+            commandTable[i].menuString,
+            pgm_read_byte(&commandTable[i].minArgs),
+            pgm_read_byte(&commandTable[i].maxArgs));
+
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    return i;
+}
+
+
+///////////////////////////////////////
+//hex char to 0-15, -1 if not hex
+static int Command_HexNibble(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+
+//////////////////////////////////////////////
+//Typed arg accessors.  Parse an argv[] string
+//without sscanf / strtol, no static state.
+//All return 0 and load value, or -1 if the
+//arg is missing, malformed or out of range.
+//
+//Command_GetInt - decimal with optional sign,
+//or hex with a 0x prefix
+int Command_GetInt(const char *arg, long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char negative = 0;
+
+    if ((arg == NULL) || (*arg == 0x00))
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+    {
+        if ((Command_GetHex(arg, &result) < 0) || (result > 0x7FFFFFFFul))
+            return -1;
+
+        *value = (long)result;
+        return 0;
+    }
+
+    if ((*arg == '-') || (*arg == '+'))
+        negative = (*arg++ == '-');
+
+    if (*arg == 0x00)
+        return -1;
+
+    while (*arg != 0x00)
+    {
+        if ((*arg < '0') || (*arg > '9'))
+            return -1;
+
+        if (result > ((0x80000000ul - (*arg - '0')) / 10))
+            return -1;
+
+        result = (result * 10) + (*arg++ - '0');
+    }
+
+    if (!negative && (result > 0x7FFFFFFFul))
+        return -1;
+
+    *value = negative ? (long)(0ul - result) : (long)result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetHex - hex, 0x prefix optional,
+//up to 8 digits
+int Command_GetHex(const char *arg, unsigned long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char digits = 0x00;
+    int nibble;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+        arg += 2;
+
+    while (*arg != 0x00)
+    {
+        nibble = Command_HexNibble(*arg++);
+
+        if ((nibble < 0) || (++digits > 8))
+            return -1;
+
+        result = (result << 4) | nibble;
+    }
+
+    if (!digits)
+        return -1;
 
+    *value = result;
+    return 0;
 }
 
 
+//////////////////////////////////////////////
+//Command_GetFixed - decimal number with up to
+//places digits after the point, returned
+//scaled by 10^places.  "-1.25", 2 -> -125.
+//Extra fraction digits are truncated.
+int Command_GetFixed(const char *arg, unsigned char places, long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char negative = 0;
+    unsigned char digits = 0x00;
+    unsigned char point = 0;
+    unsigned char i;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((*arg == '-') || (*arg == '+'))
+        negative = (*arg++ == '-');
+
+    while (*arg != 0x00)
+    {
+        if ((*arg == '.') && !point)
+        {
+            point = 1;
+            arg++;
+            continue;
+        }
+
+        if ((*arg < '0') || (*arg > '9'))
+            return -1;
+
+        //drop fraction digits past places
+        if (!point || (point++ <= places))
+        {
+            if (result > ((0x7FFFFFFFul - (*arg - '0')) / 10))
+                return -1;
+
+            result = (result * 10) + (*arg - '0');
+        }
+
+        digits++;
+        arg++;
+    }
+
+    if (!digits)
+        return -1;
+
+    //pad the missing fraction digits
+    for (i = (point ? point - 1 : 0) ; i < places ; i++)
+    {
+        if (result > (0x7FFFFFFFul / 10))
+            return -1;
+
+        result *= 10;
+    }
+
+    *value = negative ? -(long)result : (long)result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetBytes - hex string to bytes, in
+//place.  "0a1B2c" -> 0x0A 0x1B 0x2C written
+//over the start of arg.  Returns the number
+//of bytes, -1 if malformed or odd length.
+int Command_GetBytes(char *arg, unsigned char **data)
+{
+    unsigned char *out = (unsigned char*)arg;
+    int count = 0x00;
+    int high, low;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+        arg += 2;
+
+    while (*arg != 0x00)
+    {
+        high = Command_HexNibble(arg[0]);
+        low = Command_HexNibble(arg[1]);
+
+        if ((high < 0) || (low < 0))
+            return -1;
+
+        out[count++] = (high << 4) | low;
+        arg += 2;
+    }
+
+    *data = (unsigned char*)out;
+    return count;
+}
+
+
+
 
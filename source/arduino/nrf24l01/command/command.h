@@ -1,16 +1,37 @@
 #ifndef COMMAND__H
 #define COMMAND__H
 
+#include <avr/pgmspace.h>
+
+//////////////////////////////////////////
+//Command table lives in flash (PROGMEM),
+//strings are stored in the entry so nothing
+//is copied to sram.  The table is sorted by
+//cmdString (strcmp order), the lookup is a
+//binary search.
+#define COMMAND_NAME_SIZE       8       //with the null
+#define COMMAND_MENU_SIZE       32      //with the null
+
 typedef struct
 {
-    char const *cmdString;           //match string
-    char const *menuString;          //menu string
+    char cmdString[COMMAND_NAME_SIZE];          //match string
+    char menuString[COMMAND_MENU_SIZE];         //menu string
+    unsigned char minArgs;                      //args after the command
+    unsigned char maxArgs;
     void (*cmdPtr) (int argc, char** argv);     //function to run
 }CommandStruct;
 
 
 int Command_ExeCommand(int argc, char** argv);
 void Command_PrintHelp(void);
+int Command_PrintCommandHelp(char *name);
+
+
+//typed arg accessors, 0 ok, -1 bad arg
+int Command_GetInt(const char *arg, long *value);
+int Command_GetHex(const char *arg, unsigned long *value);
+int Command_GetFixed(const char *arg, unsigned char places, long *value);
+int Command_GetBytes(char *arg, unsigned char **data);
 
 
 
@@ -0,0 +1,630 @@
+/*
+Duty - duty cycled radio for battery nodes
+Dana Olcott
+
+See duty.h.  Main loop only, Duty_packet is called
+from nrf24_processRxPackets before a packet is
+printed, Duty_service from the same place for the
+timers.  Like the repeater's mesh.c, no avr headers,
+the time comes in with the packets and the service
+call.
+
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "duty.h"
+#include "nrf24l01.h"
+
+#define DUTY_NO_LIMIT               0xFFFFFFFFUL    //Duty_getSleep, nothing due
+#define DUTY_ALL_PIPES              0x3F            //EN_RXADDR, as nrf24_init
+
+//transmitter states
+typedef enum
+{
+    DUTY_TX_IDLE,                               //radio off, nothing to send
+    DUTY_TX_WAIT,                               //radio off until the guard time
+    DUTY_TX_SEEK,                               //listening for the beacon
+    DUTY_TX_TRAIN,                              //preamble, copies across a period
+    DUTY_TX_SEND                                //beacon heard, copies now
+}DutyTxState_t;
+
+
+static DutyRole_t mDutyRole = DUTY_ROLE_OFF;
+static uint32_t mDutyNow = 0x00;
+static DutyStats mDutyStats;
+static uint8_t mRadioOn = 0;
+static uint8_t mPipes = DUTY_ALL_PIPES;         //EN_RXADDR
+static uint32_t mRadioOnSince = 0x00;
+
+//receiver
+static uint8_t mRxAwake = 0;                    //window open
+static uint8_t mRxBeaconPending = 0;            //beacon in the tx queue
+static uint32_t mRxNextWake = 0x00;
+static uint32_t mRxWindowStart = 0x00;
+static uint32_t mRxLastPacket = 0x00;
+static uint8_t mRxBeaconSeq = 0x00;
+static uint8_t mRxLast[NRF24_PIPE_WIDTH_MAX];   //last packet passed on, copies
+static uint8_t mRxLastLength = 0x00;
+static uint32_t mRxLastTime = 0x00;
+
+//transmitter
+static DutyTxState_t mTxState = DUTY_TX_IDLE;
+static uint8_t mTxPending = 0;
+static uint8_t mTxPipe = 0x00;
+static uint8_t mTxLength = 0x00;
+static uint8_t mTxData[NRF24_PIPE_WIDTH_MAX];
+static uint32_t mTxWake = 0x00;
+static uint32_t mTxEnd = 0x00;
+static uint32_t mTxNext = 0x00;
+static uint8_t mTxCopies = 0x00;
+static uint32_t mTxCount = 0x00;                //nrf24_getTxCount at the start, ESB acks
+static uint8_t mBeaconHeard = 0;
+static uint8_t mTxMissed = 0;                   //beacons missed in a row
+static uint16_t mRandom = 0xACE1;               //copy slots
+
+//sync - last beacon, and the receiver's period in
+//this node's ms, 1/16 ms
+static uint8_t mSynced = 0;
+static uint32_t mSyncTime = 0x00;
+static uint8_t mSyncSeq = 0x00;
+static uint32_t mPeriod16 = (uint32_t)DUTY_PERIOD_MS << 4;
+static uint16_t mAdvertised = DUTY_PERIOD_MS;
+
+static void Duty_listen(void);
+static void Duty_radioOff(void);
+static void Duty_pipes(uint8_t mask);
+static void Duty_rxService(uint32_t now);
+static void Duty_txService(uint32_t now);
+static void Duty_txStart(uint32_t now);
+static void Duty_txDone(void);
+static void Duty_sendCopy(void);
+static void Duty_beacon(const NRF24_RxPacket *packet);
+static int Duty_nextWindow(uint32_t now, uint32_t *window, uint32_t *guard);
+static uint8_t Duty_checksum(const uint8_t *data);
+static uint8_t Duty_slot(void);
+
+
+void Duty_init(void)
+{
+    mDutyRole = DUTY_ROLE_OFF;
+    mRxAwake = 0;
+    mTxState = DUTY_TX_IDLE;
+    mTxPending = 0;
+    mSynced = 0;
+    mRadioOn = 0;
+
+    memset(&mDutyStats, 0x00, sizeof(mDutyStats));
+}
+
+
+///////////////////////////////////////////////
+//Receiver / transmitter / off.  Off leaves the
+//radio on, listening for rx, standby for tx.
+void Duty_enable(DutyRole_t role)
+{
+    if (role == mDutyRole)
+        return;
+
+    mRxAwake = 0;
+    mRxBeaconPending = 0;
+    mTxState = DUTY_TX_IDLE;
+    mSynced = 0;
+    mTxMissed = 0;
+
+    Duty_pipes(DUTY_ALL_PIPES);
+
+    if (role == DUTY_ROLE_OFF)
+    {
+        nrf24_power_up();
+
+        if (mDutyRole == DUTY_ROLE_RX)
+            Duty_listen();
+
+        mRadioOn = 0;
+    }
+
+    else if (role == DUTY_ROLE_RX)
+        mRxNextWake = mDutyNow;             //first window now
+
+    else
+        Duty_radioOff();
+
+    mDutyRole = role;
+}
+
+
+DutyRole_t Duty_getRole(void)
+{
+    return mDutyRole;
+}
+
+
+/////////////////////////////////////////////////
+//Packet from the rx ring, before it's printed.
+//Returns 1 if it was used here (beacon) or is
+//a copy to drop, 0 to pass it on.
+uint8_t Duty_packet(const NRF24_RxPacket *packet)
+{
+    mDutyNow = packet->timestamp;
+
+    if (mDutyRole == DUTY_ROLE_OFF)
+        return 0;
+
+    if (packet->pipe == DUTY_PIPE)
+    {
+        if (mDutyRole == DUTY_ROLE_TX)
+            Duty_beacon(packet);
+
+        return 1;
+    }
+
+    if ((mDutyRole != DUTY_ROLE_RX) || packet->ack)
+        return 0;
+
+    mRxLastPacket = packet->timestamp;
+
+    //copies of one packet land in the same window
+    if ((packet->length == mRxLastLength) &&
+        ((packet->timestamp - mRxLastTime) < DUTY_WINDOW_MAX_MS) &&
+        !memcmp(packet->data, mRxLast, packet->length))
+    {
+        mDutyStats.duplicates++;
+        return 1;
+    }
+
+    memcpy(mRxLast, packet->data, packet->length);
+    mRxLastLength = packet->length;
+    mRxLastTime = packet->timestamp;
+    mDutyStats.received++;
+
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////
+//Timers, call from the main loop and the Delay loop.
+void Duty_service(uint32_t now)
+{
+    mDutyNow = now;
+
+    if (mDutyRole == DUTY_ROLE_RX)
+        Duty_rxService(now);
+
+    else if (mDutyRole == DUTY_ROLE_TX)
+        Duty_txService(now);
+}
+
+
+/////////////////////////////////////////////////////
+//ms the radio stays off with nothing due, main.c
+//can sleep the cpu that long.  0 - stay awake,
+//0xFFFFFFFF - nothing due at all.
+uint32_t Duty_getSleep(uint32_t now)
+{
+    if ((mDutyRole == DUTY_ROLE_RX) && !mRxAwake)
+        return ((int32_t)(mRxNextWake - now) > 0) ? (mRxNextWake - now) : 0;
+
+    if (mDutyRole == DUTY_ROLE_TX)
+    {
+        if ((mTxState == DUTY_TX_IDLE) && !mTxPending)
+            return DUTY_NO_LIMIT;
+
+        if (mTxState == DUTY_TX_WAIT)
+            return ((int32_t)(mTxWake - now) > 0) ? (mTxWake - now) : 0;
+    }
+
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////
+//Send a packet to a duty cycled receiver.  Returns
+//0 if it was taken, -1 if one is still waiting.
+//Not a transmitter - straight to the radio.
+int Duty_send(uint8_t pipe, const uint8_t *data, uint8_t length)
+{
+    uint8_t i;
+
+    if (mDutyRole != DUTY_ROLE_TX)
+        return nrf24_send(pipe, data, length);
+
+    if (mTxPending || (length == 0) || (length > NRF24_PIPE_WIDTH_MAX))
+        return -1;
+
+    memcpy(mTxData, data, length);
+
+    //senders differ in their packets and clocks
+    for (i = 0 ; i < length ; i++)
+        mRandom = (mRandom << 3) + data[i] + (mRandom >> 13);
+
+    mRandom ^= (uint16_t)mDutyNow;
+    mTxPipe = pipe;
+    mTxLength = length;
+    mTxPending = 1;
+
+    return 0;
+}
+
+
+uint8_t Duty_busy(void)
+{
+    return mTxPending;
+}
+
+
+uint8_t Duty_isSynced(void)
+{
+    return mSynced;
+}
+
+
+///////////////////////////////////////////////
+//Receiver period in this node's ms
+uint16_t Duty_getPeriod(void)
+{
+    return (uint16_t)(mPeriod16 >> 4);
+}
+
+
+void Duty_getStats(DutyStats *stats)
+{
+    memcpy(stats, &mDutyStats, sizeof(DutyStats));
+
+    if (mRadioOn)
+        stats->radioOn += mDutyNow - mRadioOnSince;
+}
+
+
+//////////////////////////////////////////////////
+//Radio on and listening.  Power up is 1.5ms from
+//power down, nothing if it's already up.  A
+//transmitter only opens the beacon pipe, it doesn't
+//pick up (or with ESB, ack) the other senders.
+static void Duty_listen(void)
+{
+    if (!mRadioOn)
+    {
+        mRadioOn = 1;
+        mRadioOnSince = mDutyNow;
+    }
+
+    if (mDutyRole == DUTY_ROLE_TX)
+        Duty_pipes(1 << DUTY_PIPE);
+
+    nrf24_power_up();
+    nrf24_prime_rx_bit(1);
+    nrf24_ce_high();
+}
+
+
+static void Duty_radioOff(void)
+{
+    nrf24_ce_low();
+    nrf24_power_down();
+
+    if (mRadioOn)
+    {
+        mDutyStats.radioOn += mDutyNow - mRadioOnSince;
+        mRadioOn = 0;
+    }
+}
+
+
+static void Duty_pipes(uint8_t mask)
+{
+    if (mask == mPipes)
+        return;
+
+    nrf24_writeReg(NRF24_REG_EN_RXADDR, mask);
+    mPipes = mask;
+}
+
+
+//////////////////////////////////////////////////
+//Receiver.  Windows are on a fixed grid of this
+//node's ms, a late wake up doesn't move the rest.
+static void Duty_rxService(uint32_t now)
+{
+    uint8_t beacon[NRF24_PIPE_WIDTH];
+
+    if (!mRxAwake)
+    {
+        if ((int32_t)(now - mRxNextWake) < 0)
+            return;
+
+        while ((int32_t)(now - mRxNextWake) >= 0)
+            mRxNextWake += DUTY_PERIOD_MS;
+
+        mRxAwake = 1;
+        mRxWindowStart = now;
+        mRxLastPacket = now;
+        mDutyStats.windows++;
+
+        Duty_listen();
+
+        memset(beacon, 0x00, sizeof(beacon));
+        beacon[0] = DUTY_BEACON;
+        beacon[1] = mRxBeaconSeq++;
+        beacon[2] = DUTY_PERIOD_MS & 0xFF;
+        beacon[3] = DUTY_PERIOD_MS >> 8;
+        beacon[4] = DUTY_WINDOW_MS;
+        beacon[NRF24_PIPE_WIDTH - 1] = Duty_checksum(beacon);
+
+        if (nrf24_send(DUTY_PIPE, beacon, NRF24_PIPE_WIDTH) == 0)
+            mRxBeaconPending = 1;
+
+        return;
+    }
+
+    if (nrf24_txBusy())
+        return;
+
+    //tx mode radio stays in standby after a send
+    if (mRxBeaconPending)
+    {
+        mRxBeaconPending = 0;
+        Duty_listen();
+    }
+
+    if ((((now - mRxWindowStart) >= DUTY_WINDOW_MS) && ((now - mRxLastPacket) >= DUTY_HOLD_MS)) ||
+        ((now - mRxWindowStart) >= DUTY_WINDOW_MAX_MS))
+    {
+        mRxAwake = 0;
+        Duty_radioOff();
+    }
+}
+
+
+//////////////////////////////////////////////////
+//Transmitter
+static void Duty_txService(uint32_t now)
+{
+    if (mTxState == DUTY_TX_IDLE)
+    {
+        if (!mTxPending)
+            return;
+
+        Duty_txStart(now);
+    }
+
+    if (mTxState == DUTY_TX_WAIT)
+    {
+        if ((int32_t)(now - mTxWake) < 0)
+            return;
+
+        mBeaconHeard = 0;
+        mTxState = DUTY_TX_SEEK;
+        Duty_listen();
+        return;
+    }
+
+    if (nrf24_txBusy())
+        return;
+
+    //ESB - any copy acked, it's there
+    if (nrf24_getEsb() && (nrf24_getTxCount() != mTxCount))
+    {
+        mDutyStats.acked++;
+        Duty_txDone();
+        return;
+    }
+
+    if (mBeaconHeard && ((mTxState == DUTY_TX_SEEK) || (mTxState == DUTY_TX_TRAIN)))
+    {
+        mTxState = DUTY_TX_SEND;
+        mTxCopies = 0;
+        mTxNext = now + Duty_slot();
+    }
+
+    if (mTxState == DUTY_TX_SEEK)
+    {
+        //no beacon in the guard time - lost, or the
+        //clocks drifted, or the receiver moved.  Try
+        //the next window, twice - start over.
+        if ((int32_t)(now - mTxEnd) >= 0)
+        {
+            if (++mTxMissed >= 2)
+            {
+                mSynced = 0;
+                mTxMissed = 0;
+                mDutyStats.lostSync++;
+            }
+
+            Duty_txStart(now);
+        }
+    }
+
+    else if (mTxState == DUTY_TX_TRAIN)
+    {
+        if ((int32_t)(now - mTxEnd) >= 0)
+        {
+            mDutyStats.preamble++;
+            Duty_txDone();
+            return;
+        }
+
+        if ((int32_t)(now - mTxNext) >= 0)
+        {
+            Duty_sendCopy();
+            mTxNext = now + DUTY_RETRY_MS;
+            return;
+        }
+    }
+
+    else if (mTxState == DUTY_TX_SEND)
+    {
+        if (mTxCopies >= DUTY_COPIES)
+        {
+            mDutyStats.synced++;
+            Duty_txDone();
+            return;
+        }
+
+        if ((int32_t)(now - mTxNext) >= 0)
+        {
+            Duty_sendCopy();
+            mTxCopies++;
+            mTxNext = now + DUTY_COPY_MS + Duty_slot();
+            return;
+        }
+    }
+
+    //between copies, listen for the beacon
+    Duty_listen();
+}
+
+
+//////////////////////////////////////////////////
+//Synced - sleep until the guard time before the
+//next window.  Not synced - preamble train.
+static void Duty_txStart(uint32_t now)
+{
+    uint32_t window, guard;
+
+    mBeaconHeard = 0;
+    mTxCount = nrf24_getTxCount();
+
+    if (mSynced && (Duty_nextWindow(now, &window, &guard) == 0))
+    {
+        mTxWake = window - guard;
+        mTxEnd = window + guard + DUTY_WINDOW_MS;
+        mTxState = DUTY_TX_WAIT;
+        Duty_radioOff();
+        return;
+    }
+
+    mTxNext = now;
+    mTxEnd = now + mAdvertised + DUTY_WINDOW_MS;
+    mTxState = DUTY_TX_TRAIN;
+    Duty_listen();
+}
+
+
+static void Duty_txDone(void)
+{
+    mDutyStats.sent++;
+    mTxPending = 0;
+    mTxState = DUTY_TX_IDLE;
+    Duty_radioOff();
+}
+
+
+//ESB acks come back on pipe 0
+static void Duty_sendCopy(void)
+{
+    Duty_pipes(DUTY_ALL_PIPES);
+    nrf24_send(mTxPipe, mTxData, mTxLength);
+}
+
+
+//////////////////////////////////////////////////
+//Beacon from the receiver.  The period is measured
+//over the beacons since the last one heard, in
+//this node's ms - both clocks drift, only the
+//ratio matters.  Over 256 periods apart the count
+//wraps, the range check throws that out.
+static void Duty_beacon(const NRF24_RxPacket *packet)
+{
+    const uint8_t *data = packet->data;
+    uint32_t elapsed, count, period16;
+
+    if ((packet->length < NRF24_PIPE_WIDTH) || (data[0] != DUTY_BEACON) ||
+        (data[NRF24_PIPE_WIDTH - 1] != Duty_checksum(data)))
+        return;
+
+    mDutyStats.beacons++;
+    mAdvertised = data[2] | ((uint16_t)data[3] << 8);
+
+    //beacons since the last one heard, from the
+    //sequence numbers.  The period has to be within
+    //a quarter of the advertised one, else a beacon
+    //was mistaken - keep the old period
+    if (mSynced)
+    {
+        elapsed = packet->timestamp - mSyncTime;
+        count = (uint8_t)(data[1] - mSyncSeq);
+        period16 = count ? ((elapsed << 4) / count) : 0;
+
+        if (count && (elapsed < (0xFFFFFFFFUL >> 4)) &&
+            (period16 > ((uint32_t)mAdvertised * 12)) && (period16 < ((uint32_t)mAdvertised * 20)))
+            mPeriod16 = period16;
+    }
+    //first beacon - the period measured before
+    //losing sync is still good, if it's in range
+    else if ((mPeriod16 <= ((uint32_t)mAdvertised * 12)) || (mPeriod16 >= ((uint32_t)mAdvertised * 20)))
+        mPeriod16 = (uint32_t)mAdvertised << 4;
+
+    mSynced = 1;
+    mSyncTime = packet->timestamp;
+    mSyncSeq = data[1];
+    mBeaconHeard = 1;
+    mTxMissed = 0;
+}
+
+
+//////////////////////////////////////////////////
+//Next window after now, this node's ms, and the
+//guard time to wake up before it.  -1 if the guard
+//is over half a period, the train costs the same.
+static int Duty_nextWindow(uint32_t now, uint32_t *window, uint32_t *guard)
+{
+    uint32_t elapsed = now - mSyncTime;
+    uint32_t half = mPeriod16 >> 5;
+    uint32_t count, start, wait;
+
+    //guard grows with the time since the beacon
+    if (elapsed > ((half * 1000UL) / DUTY_DRIFT_PERMILLE))
+        return -1;
+
+    count = ((elapsed << 4) / mPeriod16) + 1;
+
+    while (1)
+    {
+        start = (count * mPeriod16) >> 4;
+        wait = DUTY_GUARD_MS + ((start * DUTY_DRIFT_PERMILLE) / 1000UL);
+
+        if (wait > half)
+            return -1;
+
+        if ((int32_t)(mSyncTime + start - wait - now) >= 0)
+            break;
+
+        count++;
+    }
+
+    *window = mSyncTime + start;
+    *guard = wait;
+
+    return 0;
+}
+
+
+static uint8_t Duty_checksum(const uint8_t *data)
+{
+    uint8_t i, sum = 0x00;
+
+    for (i = 0 ; i < NRF24_PIPE_WIDTH - 1 ; i++)
+        sum += data[i];
+
+    return sum;
+}
+
+
+//////////////////////////////////////////////////
+//0 - DUTY_SLOTS-1, xorshift.  Seeded from the
+//packets and the time in Duty_send.
+static uint8_t Duty_slot(void)
+{
+    mRandom ^= mRandom << 7;
+    mRandom ^= mRandom >> 9;
+    mRandom ^= mRandom << 8;
+
+    if (!mRandom)
+        mRandom = 0xACE1;
+
+    return mRandom % DUTY_SLOTS;
+}
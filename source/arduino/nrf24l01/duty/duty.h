@@ -0,0 +1,119 @@
+/*
+Duty - duty cycled radio for battery nodes
+Dana Olcott
+
+The radio and the cpu sleep most of the time, the
+link still works because both ends agree on when to
+be awake.
+
+Receiver (DUTY_ROLE_RX, the radio in rx mode)
+Wakes every DUTY_PERIOD_MS on its own timer, sends
+a beacon on pipe 3 (DUTY_PIPE) and listens for
+DUTY_WINDOW_MS.  The window is held open while
+packets keep coming (DUTY_HOLD_MS after the last,
+DUTY_WINDOW_MAX_MS at most), then the radio is
+powered down until the next window.  Copies of the
+same packet heard in one period are dropped.
+
+Transmitter (DUTY_ROLE_TX, the radio in tx mode)
+Duty_send holds one packet until the receiver is
+awake.
+- not synced: preamble.  The packet is sent every
+  DUTY_RETRY_MS, listening for the beacon between
+  copies, for one whole period and window - one copy
+  lands in the receiver's window whenever it is.  A
+  beacon heard stops the train, the packet goes
+  right after it.
+- synced: the last beacon heard and the period
+  measured between beacons say when the next window
+  opens.  The radio wakes a guard time before it
+  (DUTY_GUARD_MS plus the clock drift since the last
+  beacon, DUTY_DRIFT_PERMILLE), waits for the beacon
+  and sends DUTY_COPIES copies, each a random slot
+  later (DUTY_SLOTS) so senders woken by the same
+  beacon don't all collide.  No beacon - the next
+  window, no beacon there either - back to the
+  preamble.
+While listening for the beacon, only the beacon pipe
+is open.
+Enhanced ShockBurst - the first copy acked ends it.
+
+Beacon, 8 bytes on DUTY_PIPE:
+DUTY_BEACON, seq, period lsb / msb, window, 0, 0,
+checksum (sum of bytes 0 - 6)
+
+Sleeping - Duty_getSleep is the time the radio is
+off and nothing is due, main.c sleeps the cpu for it
+(power down, watchdog).  The watchdog runs +-10%, so
+the receiver's period is measured, not trusted.
+
+Time comes in with the packets and Duty_service, no
+avr headers.  See host/dutysim.c for the pc timing
+simulation.
+
+*/
+
+#ifndef __DUTY__H
+#define __DUTY__H
+
+#include <stdint.h>
+
+#include "nrf24l01.h"
+
+#define DUTY_PIPE                   3
+#define DUTY_BEACON                 0xBC
+
+//ms
+#define DUTY_PERIOD_MS              1000        //receiver wake up to wake up
+#define DUTY_WINDOW_MS              12          //listen after the beacon
+#define DUTY_HOLD_MS                6           //keep listening after a packet
+#define DUTY_WINDOW_MAX_MS          100
+#define DUTY_RETRY_MS               4           //preamble, copy to copy
+#define DUTY_COPY_MS                2           //synced, copy to copy
+#define DUTY_COPIES                 3
+#define DUTY_SLOTS                  4           //synced, random 0 - 3ms more per copy
+#define DUTY_GUARD_MS               4
+#define DUTY_DRIFT_PERMILLE         30          //guard per ms since the last beacon
+#define DUTY_SLEEP_MIN_MS           16          //shortest power down, watchdog
+
+
+typedef enum
+{
+    DUTY_ROLE_OFF,
+    DUTY_ROLE_RX,
+    DUTY_ROLE_TX
+}DutyRole_t;
+
+
+typedef struct
+{
+    uint32_t windows;                           //rx - windows opened
+    uint32_t radioOn;                           //ms the radio was powered
+    uint16_t received;                          //rx - packets passed on
+    uint16_t duplicates;                        //rx - copies dropped
+    uint16_t beacons;                           //tx - beacons heard
+    uint16_t sent;                              //tx - packets
+    uint16_t synced;                            //tx - sent after a beacon
+    uint16_t preamble;                          //tx - sent with the train
+    uint16_t acked;                             //tx - ESB only
+    uint16_t lostSync;                          //tx - no beacon in the guard
+}DutyStats;
+
+
+void Duty_init(void);
+void Duty_enable(DutyRole_t role);
+DutyRole_t Duty_getRole(void);
+
+uint8_t Duty_packet(const NRF24_RxPacket *packet);         //1 - used / dropped
+void Duty_service(uint32_t now);
+uint32_t Duty_getSleep(uint32_t now);
+
+int Duty_send(uint8_t pipe, const uint8_t *data, uint8_t length);
+uint8_t Duty_busy(void);
+uint8_t Duty_isSynced(void);
+uint16_t Duty_getPeriod(void);
+
+void Duty_getStats(DutyStats *stats);
+
+
+#endif
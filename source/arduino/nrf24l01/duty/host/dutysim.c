@@ -0,0 +1,443 @@
+/*
+Duty cycle simulator - runs on the pc
+Dana Olcott
+
+Runs duty.c on one receiver and a number of sensor
+nodes sending to it, prints the delivery ratio, the
+latency and the average current of each end, next
+to the same radio listening all the time.
+
+Each node is its own copy of duty.c, loaded as a
+shared library, so each has its own state.  The
+simulator supplies the radio driver calls duty.c
+uses and models:
+
+- 1ms steps.  A frame goes out in the ms it was
+  queued, the sender doesn't hear in that ms, two
+  frames in the same ms are both lost.  LOSS of the
+  rest are lost at random.
+- the radio is only heard powered up, PRIM_RX and
+  CE high (nrf24_power_up, nrf24_prime_rx_bit,
+  nrf24_ce_high), on the pipes open (EN_RXADDR).
+  Like the driver, tx mode goes to standby after a
+  send, rx mode back to listening
+- the cpu sleeps whenever Duty_getSleep says so, in
+  watchdog steps (16ms - 8s) like main.c.  Each node's
+  watchdog is off by up to +-WDT_ERROR, steady, plus
+  WDT_JITTER on every step.  The node's own ms count
+  goes up by the nominal step, awake it's exact.
+- current (datasheets): radio rx 13.5mA, tx 11.3mA for
+  the 0.3ms of a frame, standby 26uA, power down 0.9uA.
+  cpu awake 3.5mA (idle between ticks), power down with
+  the watchdog 6uA.
+
+Build:  gcc -std=gnu99 -O2 -shared -fPIC -I.. -I../../nrf24l01 \
+            -o dutynode.so ../duty.c
+        gcc -std=gnu99 -O2 -Wall -rdynamic -I.. -I../../nrf24l01 \
+            -o dutysim dutysim.c -ldl
+Run:    ./dutysim [senders] [seconds] [seed] [esb]
+
+senders 3, seconds 600, seed 0, no ESB by default.
+Packets are lost to collisions and LOSS, not every
+run delivers all of them:
+
+./dutysim                   3 senders   164/165  99.4%  797ms avg  rx 0.283mA
+./dutysim 3 600 1           3 senders   164/164 100.0%  820ms avg  rx 0.281mA
+./dutysim 3 600 0 1         3, ESB      165/165 100.0%  750ms avg  rx 0.267mA
+./dutysim 8                 8 senders   425/440  96.6%  815ms avg  rx 0.300mA
+
+Seeds 0 - 9 with 3 senders: 1646 of 1651, 99.7%,
+worst seed 6 at 98.2%.  Always listening is 17.0mA.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "duty.h"
+
+#define MAX_NODES           16
+#define SEND_MS             10000           //sensor packet, each sender
+#define WARMUP_MS           2000
+#define LOSS                0.05
+#define WDT_ERROR           0.10
+#define WDT_JITTER          0.005
+#define MAX_PACKETS         65536
+
+//mA
+#define I_RX                13.5
+#define I_TX                11.3
+#define I_STANDBY           0.026
+#define I_POWER_DOWN        0.0009
+#define I_CPU               3.5
+#define I_CPU_SLEEP         0.006
+
+
+typedef struct
+{
+    void *lib;
+    void (*init)(void);
+    void (*enable)(DutyRole_t);
+    uint8_t (*packet)(const NRF24_RxPacket*);
+    void (*service)(uint32_t);
+    uint32_t (*sleep)(uint32_t);
+    int (*send)(uint8_t, const uint8_t*, uint8_t);
+    uint8_t (*busy)(void);
+    uint8_t (*synced)(void);
+    void (*stats)(DutyStats*);
+
+    uint8_t txMode;                         //nrf24 tx mode, standby after a send
+    uint8_t powered, primRx, ce;
+    uint8_t pipes;                          //EN_RXADDR
+    uint8_t txFrame[NRF24_PIPE_WIDTH_MAX];
+    uint8_t txPipe;
+    uint8_t txQueued;
+    uint32_t txCount;
+
+    uint32_t clock;                         //this node's ms
+    double wdt;                             //watchdog, real ms per nominal ms
+    double wakeAt;                          //real ms, asleep until
+    uint32_t nextSensor;                    //real ms
+
+    NRF24_RxPacket rx[4];
+    int rxCount;
+
+    double charge;                          //mA ms
+}SimNode;
+
+
+static SimNode mNodes[MAX_NODES];
+static int mNumNodes = 4;
+static int mCurrent = 0;
+static uint32_t mNow = 0;                   //real ms
+static uint32_t mRandom = 1;
+static uint8_t mEsb = 0;
+
+static uint32_t mSentTime[MAX_PACKETS];
+static uint8_t mDelivered[MAX_PACKETS];
+static uint16_t mNextId = 0;
+static uint32_t mSent = 0, mArrived = 0, mBusy = 0;
+static uint64_t mLatencySum = 0;
+static uint32_t mLatencyMax = 0;
+
+
+static uint32_t sim_random(void)
+{
+    mRandom ^= mRandom << 13;
+    mRandom ^= mRandom >> 17;
+    mRandom ^= mRandom << 5;
+    return mRandom;
+}
+
+static double sim_uniform(void)
+{
+    return (sim_random() & 0xFFFFFF) / (double)0x1000000;
+}
+
+
+//////////////////////////////////////////
+//Radio driver calls, from the node that
+//is running (mCurrent)
+void nrf24_power_up(void)               { mNodes[mCurrent].powered = 1; }
+void nrf24_power_down(void)             { mNodes[mCurrent].powered = 0; }
+void nrf24_prime_rx_bit(uint8_t value)  { mNodes[mCurrent].primRx = value; }
+void nrf24_ce_high(void)                { mNodes[mCurrent].ce = 1; }
+void nrf24_ce_low(void)                 { mNodes[mCurrent].ce = 0; }
+uint8_t nrf24_txBusy(void)              { return mNodes[mCurrent].txQueued; }
+uint8_t nrf24_getEsb(void)              { return mEsb; }
+uint32_t nrf24_getTxCount(void)         { return mNodes[mCurrent].txCount; }
+
+uint8_t nrf24_writeReg(uint8_t reg, uint8_t data)
+{
+    if (reg == NRF24_REG_EN_RXADDR)
+        mNodes[mCurrent].pipes = data;
+
+    return 0x0E;
+}
+
+int nrf24_send(uint8_t pipe, const uint8_t* buffer, uint8_t length)
+{
+    SimNode *node = &mNodes[mCurrent];
+
+    if (node->txQueued || !node->powered)
+        return -1;
+
+    memset(node->txFrame, 0x00, sizeof(node->txFrame));
+    memcpy(node->txFrame, buffer, length);
+    node->txPipe = pipe;
+    node->txQueued = 1;
+
+    return 0;
+}
+
+
+static void sim_load(int index, const char *path)
+{
+    SimNode *node = &mNodes[index];
+    char copy[64];
+    char command[192];
+
+    //dlopen returns the same library for the same
+    //file, each node gets its own copy
+    snprintf(copy, sizeof(copy), "/tmp/dutysim_%d_%d.so", (int)getpid(), index);
+    snprintf(command, sizeof(command), "cp %s %s", path, copy);
+
+    if (system(command) != 0)
+        exit(1);
+
+    node->lib = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+    remove(copy);
+
+    if (!node->lib)
+    {
+        printf("%s\n", dlerror());
+        exit(1);
+    }
+
+    node->init = (void (*)(void))dlsym(node->lib, "Duty_init");
+    node->enable = (void (*)(DutyRole_t))dlsym(node->lib, "Duty_enable");
+    node->packet = (uint8_t (*)(const NRF24_RxPacket*))dlsym(node->lib, "Duty_packet");
+    node->service = (void (*)(uint32_t))dlsym(node->lib, "Duty_service");
+    node->sleep = (uint32_t (*)(uint32_t))dlsym(node->lib, "Duty_getSleep");
+    node->send = (int (*)(uint8_t, const uint8_t*, uint8_t))dlsym(node->lib, "Duty_send");
+    node->busy = (uint8_t (*)(void))dlsym(node->lib, "Duty_busy");
+    node->synced = (uint8_t (*)(void))dlsym(node->lib, "Duty_isSynced");
+    node->stats = (void (*)(DutyStats*))dlsym(node->lib, "Duty_getStats");
+}
+
+
+static uint8_t sim_listening(SimNode *node)
+{
+    return node->powered && node->primRx && node->ce && (mNow >= node->wakeAt);
+}
+
+
+//////////////////////////////////////////
+//One ms on the air, and the current
+static void sim_air(void)
+{
+    int i, j, sending = 0, from = -1;
+    SimNode *node;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        if (mNodes[i].txQueued)
+        {
+            sending++;
+            from = i;
+        }
+    }
+
+    for (j = 0 ; j < mNumNodes ; j++)
+    {
+        node = &mNodes[j];
+
+        if (node->txQueued)
+            node->charge += (I_TX * 0.3) + (I_STANDBY * 0.7);
+        else if (sim_listening(node))
+            node->charge += I_RX;
+        else if (node->powered)
+            node->charge += I_STANDBY;
+        else
+            node->charge += I_POWER_DOWN;
+
+        node->charge += (mNow >= node->wakeAt) ? I_CPU : I_CPU_SLEEP;
+
+        if ((sending != 1) || node->txQueued || !sim_listening(node) ||
+            !(node->pipes & (1 << mNodes[from].txPipe)) ||
+            (node->rxCount >= 4) || (sim_uniform() < LOSS))
+            continue;
+
+        //ESB - the ack comes back in the same ms
+        if (mEsb && (mNodes[from].txPipe != DUTY_PIPE))
+            mNodes[from].txCount++;
+
+        NRF24_RxPacket *rx = &node->rx[node->rxCount++];
+        memset(rx, 0x00, sizeof(NRF24_RxPacket));
+        rx->pipe = mNodes[from].txPipe;
+        rx->length = NRF24_PIPE_WIDTH;
+        rx->timestamp = node->clock;
+        memcpy(rx->data, mNodes[from].txFrame, NRF24_PIPE_WIDTH);
+    }
+
+    //sent - standby for tx mode, listening for rx mode
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        node = &mNodes[i];
+
+        if (!node->txQueued)
+            continue;
+
+        node->txQueued = 0;
+
+        if (!mEsb || (node->txPipe == DUTY_PIPE))
+            node->txCount++;
+
+        node->primRx = !node->txMode;
+        node->ce = !node->txMode;
+    }
+}
+
+
+//////////////////////////////////////////
+//Main loop of each node awake, the receiver
+//passes packets on, the senders make them.
+//Then the watchdog sleep, like main.c Delay.
+static void sim_nodes(uint32_t stop)
+{
+    uint8_t packet[NRF24_PIPE_WIDTH];
+    uint32_t sleep, step;
+    uint16_t id;
+    int i, k;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        SimNode *node = &mNodes[i];
+
+        if (mNow < node->wakeAt)
+            continue;
+
+        mCurrent = i;
+
+        for (k = 0 ; k < node->rxCount ; k++)
+        {
+            if (node->packet(&node->rx[k]) || (i != 0) || (node->rx[k].pipe == DUTY_PIPE))
+                continue;
+
+            id = node->rx[k].data[3] | (node->rx[k].data[4] << 8);
+
+            if (mDelivered[id])
+                continue;
+
+            mDelivered[id] = 1;
+            mArrived++;
+            mLatencySum += mNow - mSentTime[id];
+
+            if ((mNow - mSentTime[id]) > mLatencyMax)
+                mLatencyMax = mNow - mSentTime[id];
+        }
+
+        node->rxCount = 0;
+
+        if ((i > 0) && (mNow >= WARMUP_MS) && (mNow < stop) && (mNow >= node->nextSensor))
+        {
+            node->nextSensor = mNow + SEND_MS + (sim_random() % 1000);
+
+            packet[0] = 0xFE;
+            packet[1] = i;
+            packet[2] = 0;
+            packet[3] = mNextId & 0xFF;
+            packet[4] = mNextId >> 8;
+            packet[5] = 0;
+            packet[6] = 0;
+            packet[7] = 0xFE;
+
+            if (node->send(0, packet, NRF24_PIPE_WIDTH) == 0)
+            {
+                mSentTime[mNextId] = mNow;
+                mDelivered[mNextId] = 0;
+                mNextId++;
+                mSent++;
+            }
+            else
+                mBusy++;
+        }
+
+        node->service(node->clock);
+        sleep = node->sleep(node->clock);
+
+        //next sensor reading wakes it up too
+        if ((i > 0) && (sleep > (node->nextSensor - mNow)) && (node->nextSensor > mNow))
+            sleep = node->nextSensor - mNow;
+
+        if (sleep >= DUTY_SLEEP_MIN_MS)
+        {
+            for (step = 8192 ; step > sleep ; step >>= 1)
+                ;
+
+            if (step < 16)
+                step = 16;
+
+            node->wakeAt = mNow + 1 + step * node->wdt * (1.0 + (sim_uniform() - 0.5) * 2.0 * WDT_JITTER);
+            node->clock += 1 + step;
+        }
+        else
+            node->clock++;
+    }
+
+    //asleep nodes catch up in real time, the
+    //clock already moved when they went to sleep
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = 600;
+    int i;
+    double ms, always;
+    DutyStats stats;
+
+    if (argc > 1)   mNumNodes = atoi(argv[1]) + 1;
+    if (argc > 2)   seconds = atoi(argv[2]);
+    if (argc > 3)   mRandom = (atoi(argv[3]) << 1) | 1;
+    if (argc > 4)   mEsb = atoi(argv[4]) ? 1 : 0;
+
+    if ((mNumNodes < 2) || (mNumNodes > MAX_NODES))
+        mNumNodes = 4;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        SimNode *node = &mNodes[i];
+
+        sim_load(i, "./dutynode.so");
+
+        node->wdt = 1.0 + (sim_uniform() - 0.5) * 2.0 * WDT_ERROR;
+        node->clock = sim_random() % 100000;
+        node->nextSensor = WARMUP_MS + (sim_random() % SEND_MS);
+        node->txMode = (i > 0);
+        node->powered = 1;
+        node->pipes = 0x3F;
+        node->primRx = !node->txMode;
+        node->ce = !node->txMode;
+
+        mCurrent = i;
+        node->init();
+        node->service(node->clock);
+        node->enable(i ? DUTY_ROLE_TX : DUTY_ROLE_RX);
+    }
+
+    for (mNow = 1 ; mNow < (seconds * 1000) ; mNow++)
+    {
+        sim_air();
+        sim_nodes((seconds * 1000) - (2 * SEND_MS));        //last packets have time to arrive
+    }
+
+    ms = seconds * 1000.0;
+    always = I_RX + I_CPU;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        mCurrent = i;
+        mNodes[i].stats(&stats);
+
+        printf("%s %2d  wdt %.3f  %7.3fmA  radio on %5.2f%%  windows %6lu  beacons %5u  synced %4u  preamble %3u  acked %4u  lost sync %3u  copies %4u\n",
+            i ? "tx" : "rx", i, mNodes[i].wdt, mNodes[i].charge / ms,
+            100.0 * stats.radioOn / ms, (unsigned long)stats.windows, stats.beacons,
+            stats.synced, stats.preamble, stats.acked, stats.lostSync, stats.duplicates);
+    }
+
+    printf("senders %d  sent %lu  delivered %lu  ratio %.1f%%  latency avg %.0fms max %lums  busy %lu\n",
+        mNumNodes - 1, (unsigned long)mSent, (unsigned long)mArrived,
+        mSent ? (100.0 * mArrived / mSent) : 0.0,
+        mArrived ? ((double)mLatencySum / mArrived) : 0.0,
+        (unsigned long)mLatencyMax, (unsigned long)mBusy);
+
+    printf("receiver %.3fmA  always listening %.1fmA  %.1f%%\n",
+        mNodes[0].charge / ms, always, 100.0 * (mNodes[0].charge / ms) / always);
+
+    return 0;
+}
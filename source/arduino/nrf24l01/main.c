@@ -25,11 +25,23 @@ UART - PD0 and PD1 - Pins 0 and 1
 
 INT1 - PD3 - Also config as interrupt, falling, pullup
 
+Battery nodes - "duty rx" / "duty tx" (duty.h) turns
+the radio off between receive windows, and Delay
+powers the cpu down for that time with the watchdog
+as the wake up (16ms - 8s steps).  Timer0 stops, the
+nominal watchdog time is added to the ms counts.
+The usart can't run powered down - a pin change on
+RX (PD0) wakes the cpu and it stays awake for
+CONSOLE_AWAKE_MS after each character, the first
+character is lost.
+
 
 */
 ///////////////////////////////////////////////
 
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
 #include <avr/io.h>         //macros
 #include <stdio.h>
 #include <string.h>
@@ -38,6 +50,8 @@ INT1 - PD3 - Also config as interrupt, falling, pullup
 #include "spi.h"
 #include "nrf24l01.h"
 #include "usart.h"
+#include "duty.h"
+#include "payload.h"
 
 //////////////////////////////////////
 //prototypes
@@ -47,12 +61,20 @@ void LED_off(void);
 void LED_toggle(void);
 void Timer0_init(void);
 void Interrupt_init(void);
+void Sleep_powerDown(unsigned long ms);
 
 
 /////////////////////////////
 //Delay items
 void Delay(unsigned long val);
 volatile unsigned long gTimeTick = 0x00;
+volatile unsigned long gMillis = 0x00;      //free running, rx packet time stamps
+
+/////////////////////////////
+//Power down sleep
+#define CONSOLE_AWAKE_MS        10000       //after a usart character
+volatile unsigned long gConsoleTime = 0x00;
+volatile uint8_t gWatchdog = 0;             //watchdog woke the cpu
 
 
 ///////////////////////////////
@@ -63,6 +85,7 @@ volatile unsigned long gTimeTick = 0x00;
 ISR(TIMER0_OVF_vect)
 {
     gTimeTick++;        //used by Delay
+    gMillis++;
 
     //clear interrupt - datasheet shows
     //this bit has to be set to run timer
@@ -99,10 +122,49 @@ ISR(USART_RX_vect)
 {
     unsigned char data = UDR0_R;
 
+    gConsoleTime = gMillis;
     Usart_isr(data);
 }
 
 
+//////////////////////////////////////
+//Watchdog - power down wake up
+ISR(WDT_vect)
+{
+    gWatchdog = 1;
+}
+
+
+//////////////////////////////////////
+//Pin change on PD0 (usart RX) - wakes
+//the cpu from power down, the console
+//stays awake after
+ISR(PCINT2_vect)
+{
+    gConsoleTime = gMillis;
+}
+
+
+//////////////////////////////////////
+//usart data register empty interrupt
+//sends the next byte from the tx ring
+//
+ISR(USART_UDRE_vect)
+{
+    Usart_txIsr();
+}
+
+
+//////////////////////////////////////
+//time stamp for the nrf24 rx ring.
+//Called from the INT0 isr, interrupts
+//are already off.
+uint32_t nrf24_getTimeStamp(void)
+{
+    return gMillis;
+}
+
+
 ///////////////////////////////////////
 int main()
 {
@@ -112,6 +174,8 @@ int main()
     SPI_setSpeed(SPI_SPEED_1_MHZ);
     Usart_init(9600);    
     nrf24_init(NRF24_MODE_RX);
+    nrf24_setRxPayLoadSize(PAYLOAD_PIPE, PAYLOAD_FRAME_SIZE);     //batched samples, payload.h
+    Duty_init();
 
 //    uint8_t txBuffer[8] = "ARDUINO1";
 //    uint8_t pipe = 0x00;
@@ -238,12 +302,100 @@ void Timer0_init(void)
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0, a usart byte
+//or the radio INT0 wakes it.
+//Usart command lines run here, the rx isr
+//only queues them.
+//Duty cycling - powered down while the radio
+//is off and nothing is due, see Sleep_powerDown
 void Delay(unsigned long val)
 {
 	volatile unsigned long t = val;
+    unsigned long now, sleep;
     gTimeTick = 0x00;           //upcounter
-    while (t > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0, usart and radio INT0 keep running
+    while (t > gTimeTick)
+    {
+        Usart_processLines();           //command lines, outside the rx isr
+        nrf24_processRxPackets();       //radio packets, outside the INT0 isr
+
+        cli();
+        now = gMillis;
+        sleep = t - gTimeTick;
+        sei();
+
+        if (Duty_getSleep(now) < sleep)
+            sleep = Duty_getSleep(now);
+
+        if ((sleep >= DUTY_SLEEP_MIN_MS) && ((now - gConsoleTime) > CONSOLE_AWAKE_MS))
+        {
+            Sleep_powerDown(sleep);
+            continue;
+        }
+
+        cli();
+        if (t > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
 
+//////////////////////////////////////////
+//Power down for up to ms, the largest
+//watchdog time that fits (16ms * 2^k, 8s
+//max).  Only the watchdog and a pin change on
+//usart RX wake the cpu up, INT0 edges don't -
+//the radio is off.  Timer0 stops, the watchdog
+//time is added to the counts.  Woken early by
+//the pin change, the time asleep isn't known,
+//nothing is added.
+void Sleep_powerDown(unsigned long ms)
+{
+    unsigned long step = 16;
+    uint8_t prescale = 0;
+
+    while ((prescale < 9) && ((step << 1) <= ms))
+    {
+        step <<= 1;
+        prescale++;
+    }
+
+    Usart_flush();                      //usart stops too
+
+    cli();
+    gWatchdog = 0;
+    wdt_reset();
+    WDTCSR = (1u << WDCE) | (1u << WDE);
+    WDTCSR = (1u << WDIE) | (prescale & 0x07) | ((prescale & 0x08) ? (1u << WDP3) : 0);
+
+    PCMSK2 |= 1u << PCINT16;            //PD0 - usart RX
+    PCIFR = 1u << PCIF2;
+    PCICR |= 1u << PCIE2;
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+
+    cli();
+    wdt_disable();
+    PCICR &=~ (1u << PCIE2);
+
+    if (gWatchdog)
+    {
+        gMillis += step;
+        gTimeTick += step;
+    }
+
+    sei();
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+}
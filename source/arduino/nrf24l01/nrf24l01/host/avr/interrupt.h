@@ -0,0 +1,16 @@
+/*
+avr/interrupt.h for the pc build - nrf24l01/host
+Dana Olcott
+
+txcheck runs the radio isr itself, between calls
+into the driver, so interrupts are never on.
+
+*/
+
+#ifndef HOST_INTERRUPT_H
+#define HOST_INTERRUPT_H
+
+#define cli()
+#define sei()
+
+#endif
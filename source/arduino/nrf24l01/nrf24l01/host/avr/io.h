@@ -0,0 +1,8 @@
+/*
+avr/io.h for the pc build - nrf24l01/host
+Dana Olcott
+
+nrf24l01.c uses its own register defines, the
+pc ones are in register.h in this folder.
+
+*/
@@ -0,0 +1,23 @@
+/*
+avr/pgmspace.h for the pc build - nrf24l01/host
+Dana Olcott
+
+Flash is plain memory here, the _P calls are the
+plain ones.  No %S in the driver's formats.
+
+*/
+
+#ifndef HOST_PGMSPACE_H
+#define HOST_PGMSPACE_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(p)        (*(const unsigned char*)(p))
+#define sprintf_P               sprintf
+#define snprintf_P              snprintf
+#define strcmp_P                strcmp
+
+#endif
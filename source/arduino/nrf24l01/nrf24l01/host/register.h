@@ -0,0 +1,38 @@
+/*
+register.h for the pc build - nrf24l01/host
+Dana Olcott
+
+The registers nrf24l01.c touches, as variables in
+txcheck.c.  Timer0 counts on every read so the us
+delays run out.
+
+*/
+
+#ifndef __REGISTER_H
+#define __REGISTER_H
+
+/////////////////////////////////////////
+#define BIT0			(1u << 0)
+#define BIT1			(1u << 1)
+#define BIT2			(1u << 2)
+#define BIT3			(1u << 3)
+#define BIT4			(1u << 4)
+#define BIT5			(1u << 5)
+#define BIT6			(1u << 6)
+#define BIT7			(1u << 7)
+
+extern volatile unsigned char mHostPortB;
+extern volatile unsigned char mHostReg[8];
+volatile unsigned char *Host_Timer0(void);
+
+#define PORTB_DATA_R    mHostPortB
+#define PORTB_DIR_R     mHostReg[0]
+#define PORTD_DATA_R    mHostReg[1]
+#define PORTD_DIR_R     mHostReg[2]
+#define EICRA_R         mHostReg[3]
+#define EIMSK_R         mHostReg[4]
+#define EIFR_R          mHostReg[5]
+#define SREG_R          mHostReg[6]
+#define TCNT0_R         (*Host_Timer0())
+
+#endif
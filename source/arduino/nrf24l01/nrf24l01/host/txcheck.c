@@ -0,0 +1,685 @@
+/*
+Tx queue check - runs on the pc
+Dana Olcott
+
+nrf24l01.c as it is on the target, on a model of the
+radio behind the spi calls: the commands and registers
+the driver uses, the 3 deep tx fifo, CE, TX_DS and
+MAX_RT, and the irq pin.  Packets go on air one at a
+time when CE is high in tx, with ESB each try is lost
+at random and MAX_RT stops the fifo until it's cleared.
+
+The isr runs right after a packet goes on air, or
+some of the time a packet or two late (interrupts off
+in the main loop), between calls into the driver.
+nrf24_send is called the way radio burst calls it,
+again when the queue is full, the radio running in
+between.  Checked:
+
+- no payload written to a full fifo, no payload of
+  the wrong width
+- TX_ADDR not changed with packets in the fifo
+- the irq pin high when the isr returns (INT0 is edge
+  triggered, a flag left set is never seen again)
+- every packet queued is counted once, sent or lost:
+  txOk is the packets that went on air (acked with
+  ESB), txOk + txLost the packets queued
+- packets go on air in order, to their pipe, none twice
+- rx packets that come in while listening, between
+  bursts, are read: only the isr clears RX_DR with
+  the rx fifo not empty (the flag doesn't come back)
+- the queue never stays full with the radio idle
+- after the burst the radio is idle, CE low in tx,
+  back in rx with CE high in rx
+- txQueueFull at most once per packet queued, the
+  retries of one packet aren't counted
+- a dead radio: nrf24_transmitData gives up on the
+  full queue and nrf24_txWait times out, both after
+  NRF24_TX_TIMEOUT_MS, everything not sent counted
+  lost, the fifo flushed.  nrf24_sendWait gives up
+  after its ms, the full queue counted once for all
+  of them
+
+The rx printing in nrf24l01.c hands uint8_t buffers
+to sprintf, -Wno-pointer-sign keeps -Wall quiet.  Exit
+code is the failure count.
+
+repeater/nrf24l01/host/txcheck.c runs the same checks
+on the repeater's copy.
+
+Build:  gcc -std=c99 -O2 -Wall -Wextra -Wno-pointer-sign -I. -I.. -I../../spi -I../../usart \
+            -I../../utility -I../../duty -I../../payload -I../../telemetry -o txcheck txcheck.c
+Run:    ./txcheck [packets] [seed]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+//the driver copy under test, repeater/nrf24l01/host
+//builds this file on its own copy
+#ifndef NRF24_SOURCE
+#define NRF24_SOURCE            "../nrf24l01.c"
+#endif
+
+#include NRF24_SOURCE
+
+#define RADIO_FIFO_SIZE         3
+#define ESB_LOSS_PERCENT        30          //each try
+#define ISR_LATE_PERCENT        20          //isr a packet or two late
+#define DRAIN_STEPS             100000
+
+//registers nrf24l01.c touches
+volatile unsigned char mHostPortB = 0x00;
+volatile unsigned char mHostReg[8];
+static volatile unsigned char mHostTimer0 = 0x00;
+static uint32_t mHostMillis = 0;
+
+
+//////////////////////////////////////////
+//Radio model
+typedef struct
+{
+    uint8_t reg[32];
+    uint8_t txAddr[5];
+    uint8_t fifo[RADIO_FIFO_SIZE][NRF24_PIPE_WIDTH_MAX];
+    uint8_t fifoLength[RADIO_FIFO_SIZE];
+    uint8_t fifoCount;
+    uint8_t rxCount;                //rx fifo, pipe 0, width 8
+    uint8_t dead;                   //never sends
+
+    //spi transaction
+    uint8_t selected;
+    uint8_t command;
+    uint8_t index;
+    uint8_t payload[NRF24_PIPE_WIDTH_MAX];
+    uint8_t payloadLength;
+}Radio;
+
+static Radio mRadio;
+
+//what went on air, in order
+#define AIR_LOG_SIZE            4096
+static uint16_t mAirSeq[AIR_LOG_SIZE];
+static unsigned int mAirCount;
+static unsigned int mAirDup;
+static unsigned int mRxArrived;
+static unsigned int mRxRead;
+static uint8_t mInIsr = 0;
+
+static int mFailures = 0;
+static const char *mScenario = "";
+
+
+static void Check(int ok, const char *what)
+{
+    if (!ok)
+    {
+        if (mFailures < 20)
+            printf("FAIL %s: %s\n", mScenario, what);
+        mFailures++;
+    }
+}
+
+
+volatile unsigned char *Host_Timer0(void)
+{
+    mHostTimer0++;
+    return &mHostTimer0;
+}
+
+
+//////////////////////////////////////////
+//ms count, a ms goes by on every read so
+//the tx timeouts run out
+uint32_t nrf24_getTimeStamp(void)
+{
+    return mHostMillis++;
+}
+
+
+//////////////////////////////////////////
+//the rest of the firmware, not used here
+
+void Usart_sendString(char *data)
+{
+    (void)data;
+}
+
+void Usart_sendString_P(const char *data)
+{
+    (void)data;
+}
+
+void Usart_sendArray(unsigned char *data, unsigned int length)
+{
+    (void)data;
+    (void)length;
+}
+
+uint8_t Duty_packet(const NRF24_RxPacket *packet)
+{
+    (void)packet;
+    return 0;
+}
+
+void Duty_service(uint32_t now)
+{
+    (void)now;
+}
+
+int Payload_open(PayloadReader *reader, const uint8_t *data, uint8_t length)
+{
+    (void)reader;
+    (void)data;
+    (void)length;
+    return -1;
+}
+
+int Payload_read(PayloadReader *reader, PayloadBatch *batch)
+{
+    (void)reader;
+    (void)batch;
+    return 0;
+}
+
+TelemetryMode_t Telemetry_getMode(void)
+{
+    return TELEMETRY_MODE_TEXT;
+}
+
+int Telemetry_sendRadioPacket(uint8_t pipe, const uint8_t *packet, uint8_t length)
+{
+    (void)pipe;
+    (void)packet;
+    (void)length;
+    return 0;
+}
+
+int Telemetry_sendAdc(uint8_t source, uint16_t value)
+{
+    (void)source;
+    (void)value;
+    return 0;
+}
+
+int Telemetry_sendTemp(uint8_t source, uint8_t tempInt, uint8_t tempFrac)
+{
+    (void)source;
+    (void)tempInt;
+    (void)tempFrac;
+    return 0;
+}
+
+uint8_t utility_decimal2Buffer(uint16_t value, uint8_t* output)
+{
+    (void)value;
+    (void)output;
+    return 0;
+}
+
+uint8_t utility_data2HexBuffer(uint8_t* input, uint8_t len, uint8_t* output)
+{
+    (void)input;
+    (void)len;
+    (void)output;
+    return 0;
+}
+
+
+static uint8_t Radio_Status(void)
+{
+    uint8_t status = mRadio.reg[NRF24_REG_STATUS] & (NRF24_BIT_RX_DR | NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
+
+    if (!mRadio.rxCount)
+        status |= 0x0E;                         //RX_P_NO - rx fifo empty
+
+    if (mRadio.fifoCount == RADIO_FIFO_SIZE)
+        status |= NRF24_BIT_TX_FULL;
+
+    return status;
+}
+
+
+static uint8_t Radio_ReadReg(uint8_t reg)
+{
+    uint8_t value;
+
+    switch (reg)
+    {
+        case NRF24_REG_STATUS:
+            return Radio_Status();
+
+        case NRF24_REG_FIFO_STATUS:
+            value = mRadio.rxCount ? 0x00 : NRF24_BIT_RX_EMPTY;
+            if (!mRadio.fifoCount)
+                value |= NRF24_BIT_TX_EMPTY;
+            if (mRadio.fifoCount == RADIO_FIFO_SIZE)
+                value |= NRF24_BIT_FIFO_TX_FULL;
+            return value;
+
+        default:
+            return mRadio.reg[reg];
+    }
+}
+
+
+static uint8_t Radio_Ce(void)
+{
+    return (mHostPortB & BIT1) ? 1 : 0;
+}
+
+
+static uint8_t Radio_Sending(void)
+{
+    return Radio_Ce() && !(mRadio.reg[NRF24_REG_CONFIG] & NRF24_BIT_PRIM_RX);
+}
+
+
+static void Radio_WriteReg(uint8_t reg, uint8_t index, uint8_t data)
+{
+    if (reg == NRF24_REG_TX_ADDR)
+    {
+        Check(!mRadio.fifoCount || !Radio_Sending(), "TX_ADDR changed with packets in the fifo");
+
+        if (index < 5)
+            mRadio.txAddr[index] = data;
+    }
+    else if (reg == NRF24_REG_STATUS)
+    {
+        //the flag doesn't come back for packets left in
+        //the fifo, only the isr reads them after clearing
+        Check(mInIsr || !mRadio.rxCount || !(data & mRadio.reg[reg] & NRF24_BIT_RX_DR),
+                "RX_DR cleared outside the isr, rx fifo not read");
+        mRadio.reg[reg] &= ~(data & (NRF24_BIT_RX_DR | NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT));
+    }
+
+    else if (!index)
+        mRadio.reg[reg] = data;
+}
+
+
+//////////////////////////////////////////
+//spi, one byte each way
+void SPI_select(void)
+{
+    mRadio.selected = 1;
+    mRadio.index = 0;
+    mRadio.payloadLength = 0;
+}
+
+
+void SPI_deselect(void)
+{
+    uint8_t width;
+
+    if (mRadio.selected && (mRadio.command == NRF24_CMD_W_TX_PAYLOAD))
+    {
+        width = (mRadio.reg[NRF24_REG_FEATURE] & NRF24_BIT_EN_DPL) ?
+                mRadio.payloadLength : mRadio.reg[NRF24_REG_RX_PW_P0];
+
+        Check(mRadio.fifoCount < RADIO_FIFO_SIZE, "payload written to a full fifo");
+        Check((mRadio.payloadLength > 0) && (mRadio.payloadLength == width), "payload width");
+
+        if (mRadio.fifoCount < RADIO_FIFO_SIZE)
+        {
+            memcpy(mRadio.fifo[mRadio.fifoCount], mRadio.payload, mRadio.payloadLength);
+            mRadio.fifoLength[mRadio.fifoCount++] = mRadio.payloadLength;
+        }
+    }
+
+    if (mRadio.selected && (mRadio.command == NRF24_CMD_R_RX_PAYLOAD) && mRadio.rxCount)
+    {
+        mRadio.rxCount--;
+        mRxRead++;
+    }
+
+    mRadio.selected = 0;
+    mRadio.command = NRF24_CMD_NOP;
+}
+
+
+uint8_t SPI_tx(uint8_t data)
+{
+    uint8_t command = mRadio.command;
+    uint8_t index = mRadio.index++;
+
+    if (!index)
+    {
+        mRadio.command = data;
+
+        if (data == NRF24_CMD_FLUSH_TX)
+            mRadio.fifoCount = 0;
+
+        if (data == NRF24_CMD_FLUSH_RX)
+        {
+            mRxRead += mRadio.rxCount;
+            mRadio.rxCount = 0;
+        }
+
+        return Radio_Status();
+    }
+
+    if ((command & 0xE0) == NRF24_CMD_W_REGISTER)
+        Radio_WriteReg(command & 0x1F, index - 1, data);
+
+    else if ((command & 0xE0) == NRF24_CMD_R_REGISTER)
+        return Radio_ReadReg(command & 0x1F);
+
+    else if (command == NRF24_CMD_R_RX_PL_WID)
+        return NRF24_PIPE_WIDTH;
+
+    else if ((command == NRF24_CMD_W_TX_PAYLOAD) && (mRadio.payloadLength < NRF24_PIPE_WIDTH_MAX))
+        mRadio.payload[mRadio.payloadLength++] = data;
+
+    return 0x00;
+}
+
+
+uint8_t SPI_rx(void)
+{
+    return SPI_tx(0xFF);
+}
+
+
+//////////////////////////////////////////
+//pin low while a flag is set, none masked
+static uint8_t Radio_Irq(void)
+{
+    return mRadio.reg[NRF24_REG_STATUS] & ~mRadio.reg[NRF24_REG_CONFIG] &
+            (NRF24_BIT_RX_DR | NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
+}
+
+
+static void Radio_Retire(void)
+{
+    uint16_t seq = mRadio.fifo[0][0] | (mRadio.fifo[0][1] << 8);
+    uint8_t pipe = mRadio.fifo[0][2];
+    uint8_t addr = mRadio.txAddr[0];
+    unsigned int i;
+
+    //TX_ADDR of the packet's pipe, mTxAddress_Pipe0 - 5
+    Check((pipe == 0) ? (addr == 0xE7) : (addr == (0xC1 + pipe)), "packet sent to the wrong pipe");
+
+    for (i = 0 ; i < mAirCount ; i++)
+    {
+        if (mAirSeq[i] == seq)
+            mAirDup++;
+    }
+
+    Check(!mAirCount || (seq > mAirSeq[mAirCount - 1]), "packets out of order");
+
+    if (mAirCount < AIR_LOG_SIZE)
+        mAirSeq[mAirCount++] = seq;
+
+    mRadio.fifoCount--;
+    memmove(mRadio.fifo[0], mRadio.fifo[1], mRadio.fifoCount * NRF24_PIPE_WIDTH_MAX);
+    memmove(&mRadio.fifoLength[0], &mRadio.fifoLength[1], mRadio.fifoCount);
+}
+
+
+//////////////////////////////////////////
+//Top of the fifo on air.  Returns 1 if a
+//packet went, 0 if the radio is idle
+static int Radio_Air(void)
+{
+    uint8_t retries = mRadio.reg[NRF24_REG_SETUP_RETR] & 0x0F;
+    uint8_t tries = 0;
+
+    if (mRadio.dead || !Radio_Sending() || !mRadio.fifoCount ||
+        (mRadio.reg[NRF24_REG_STATUS] & NRF24_BIT_MAX_RT))
+        return 0;
+
+    if (mRadio.reg[NRF24_REG_EN_AA] & BIT0)
+    {
+        while ((rand() % 100) < ESB_LOSS_PERCENT)
+        {
+            if (tries++ == retries)
+            {
+                mRadio.reg[NRF24_REG_STATUS] |= NRF24_BIT_MAX_RT;
+                mRadio.reg[NRF24_REG_OBSERVE_TX] = retries;
+                return 1;
+            }
+        }
+
+        mRadio.reg[NRF24_REG_OBSERVE_TX] = tries;
+    }
+
+    Radio_Retire();
+    mRadio.reg[NRF24_REG_STATUS] |= NRF24_BIT_TX_DS;
+
+    return 1;
+}
+
+
+//////////////////////////////////////////
+//A packet comes in while listening, the isr
+//not run yet
+static void Radio_Arrive(void)
+{
+    if (!Radio_Ce() || !(mRadio.reg[NRF24_REG_CONFIG] & NRF24_BIT_PRIM_RX) ||
+        (mRadio.rxCount == NRF24_RX_FIFO_SIZE))
+        return;
+
+    mRadio.rxCount++;
+    mRadio.reg[NRF24_REG_STATUS] |= NRF24_BIT_RX_DR;
+    mRxArrived++;
+}
+
+
+static void Sim_Isr(void)
+{
+    if (!Radio_Irq())
+        return;
+
+    mInIsr = 1;
+    nrf24_ISR();
+    mInIsr = 0;
+    Check(!Radio_Irq(), "irq pin still low after the isr");
+}
+
+
+//////////////////////////////////////////
+//The radio runs for a packet, the isr is
+//on time or a packet or two late.  Returns
+//0 if nothing happened
+static int Sim_Run(void)
+{
+    int ran = Radio_Air();
+
+    if (ran && ((rand() % 100) < ISR_LATE_PERCENT))
+        ran += Radio_Air();
+
+    Sim_Isr();
+
+    return ran || Radio_Irq();
+}
+
+
+static void Sim_Start(const char *scenario, NRF24_Mode_t mode, uint8_t esb)
+{
+    memset(&mRadio, 0x00, sizeof(mRadio));
+    mRadio.command = NRF24_CMD_NOP;
+    mAirCount = 0;
+    mAirDup = 0;
+    mRxArrived = mRxRead = 0;
+    mScenario = scenario;
+
+    //nrf24_init doesn't touch the queue, it's only
+    //called at boot
+    mTxHead = mTxTail = mTxInFlight = 0x00;
+    mTxPipe = 0xFF;
+    mTxActive = 0;
+    mConfig = 0x00;
+
+    nrf24_init(mode);
+    nrf24_setEsb(esb);
+    nrf24_clearLinkStats();
+}
+
+
+//////////////////////////////////////////
+//radio burst - nrf24_send, again while the
+//queue is full.  A packet: seq, pipe, fill.
+//Returns the packets queued
+static unsigned int Sim_Burst(unsigned int packets, uint8_t pipes)
+{
+    uint8_t packet[NRF24_PIPE_WIDTH_MAX];
+    uint8_t length, pipe = 0;
+    unsigned int i;
+
+    for (i = 1 ; i <= packets ; i++)
+    {
+        if (pipes > 1)
+            pipe = (rand() % 4) ? pipe : (uint8_t)(rand() % pipes);
+
+        length = mEsb ? (uint8_t)(3 + (rand() % (NRF24_PIPE_WIDTH_MAX - 2))) : 3;
+
+        packet[0] = i & 0xFF;
+        packet[1] = i >> 8;
+        packet[2] = pipe;
+        memset(&packet[3], 0xA5, length - 3);
+
+        //a gap in the burst, the radio goes back to
+        //listening and a packet comes in
+        if (!(rand() % 8))
+        {
+            while (nrf24_txBusy() && Sim_Run())
+                ;
+            Radio_Arrive();
+        }
+
+        while (nrf24_send(pipe, packet, length) < 0)
+        {
+            if (!Sim_Run())
+            {
+                Check(0, "tx queue full with the radio idle");
+                return i - 1;
+            }
+        }
+
+        if (rand() % 2)
+            Sim_Run();
+    }
+
+    return packets;
+}
+
+
+static void Sim_Drain(void)
+{
+    unsigned int steps = 0;
+
+    while (nrf24_txBusy() && (steps++ < DRAIN_STEPS) && Sim_Run())
+        ;
+
+    Check(!nrf24_txBusy(), "still sending after the burst");
+    Check(nrf24_txWait() == 0, "txWait on an idle radio");
+}
+
+
+static void Sim_CheckCounts(unsigned int queued, uint8_t mode)
+{
+    NRF24_LinkStats stats;
+
+    nrf24_getLinkStats(&stats);
+
+    printf("%-6s queued %5u  on air %5u  txOk %5lu  txLost %4lu  maxRt %4u  queue full %5u  rx %4u\n",
+            mScenario, queued, mAirCount, (unsigned long)stats.txOk, (unsigned long)stats.txLost,
+            stats.txMaxRt, stats.txQueueFull, mRxRead);
+
+    Check(stats.txOk == mAirCount, "txOk isn't the packets on air");
+    Check((stats.txOk + stats.txLost) == queued, "txOk + txLost isn't the packets queued");
+    Check(!mAirDup, "packet on air twice");
+    Check(stats.txQueueFull <= queued, "queue full counted for retries");
+    Check(!mRadio.fifoCount, "radio fifo not empty");
+    Check(mRxRead == mRxArrived, "rx packet left in the radio fifo");
+
+    if (mode == NRF24_MODE_TX)
+        Check(!Radio_Ce(), "CE high, tx idle");
+    else
+        Check(Radio_Ce() && (mRadio.reg[NRF24_REG_CONFIG] & NRF24_BIT_PRIM_RX), "not back in rx");
+}
+
+
+static void Sim_Scenario(const char *scenario, NRF24_Mode_t mode, uint8_t esb,
+        uint8_t pipes, unsigned int packets)
+{
+    unsigned int queued;
+
+    Sim_Start(scenario, mode, esb);
+    queued = Sim_Burst(packets, pipes);
+    Sim_Drain();
+    Sim_CheckCounts(queued, mode);
+
+    if (!esb)
+        Check(nrf24_getTxFailed() == 0, "fixed width packet lost");
+}
+
+
+//////////////////////////////////////////
+//Radio never sends, nrf24_txWait times out
+static void Sim_Dead(void)
+{
+    uint8_t packet[NRF24_PIPE_WIDTH] = {0};
+    unsigned int queued = 0;
+    uint32_t start;
+    NRF24_LinkStats stats;
+
+    Sim_Start("dead", NRF24_MODE_TX, 0);
+    mRadio.dead = 1;
+
+    while (nrf24_send(0, packet, NRF24_PIPE_WIDTH) == 0)
+        queued++;
+
+    Check(queued == (NRF24_TX_QUEUE_SIZE + RADIO_FIFO_SIZE), "queue and fifo size");
+    Check(mRadio.fifoCount == RADIO_FIFO_SIZE, "fifo not loaded");
+    start = mHostMillis;
+    Check(nrf24_transmitData(0, packet, NRF24_PIPE_WIDTH) == -1, "transmitData sent to a full queue");
+    Check((mHostMillis - start) >= NRF24_TX_TIMEOUT_MS, "transmitData gave up early");
+
+    start = mHostMillis;
+    Check(nrf24_sendWait(0, packet, NRF24_PIPE_WIDTH, 50) == -1, "sendWait queued to a full queue");
+    Check(((mHostMillis - start) >= 50) && ((mHostMillis - start) < 100), "sendWait timeout");
+
+    start = mHostMillis;
+    Check(nrf24_txWait() == -1, "txWait didn't time out");
+    Check((mHostMillis - start) >= NRF24_TX_TIMEOUT_MS, "txWait gave up early");
+
+    nrf24_getLinkStats(&stats);
+
+    printf("%-6s queued %5u  txLost %4lu  timeouts %u  queue full %u\n", mScenario, queued,
+            (unsigned long)stats.txLost, stats.txTimeout, stats.txQueueFull);
+
+    Check(stats.txLost == queued, "not everything counted lost");
+    Check(stats.txTimeout == 1, "timeout not counted");
+    Check(stats.txQueueFull == 1, "full queue counted more than once");
+    Check(!nrf24_txBusy() && !mRadio.fifoCount && !Radio_Ce(), "not idle after the timeout");
+    Check(nrf24_send(0, packet, NRF24_PIPE_WIDTH) == 0, "queue still full after the timeout");
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned int packets = (argc > 1) ? (unsigned int)atoi(argv[1]) : 2000;
+    unsigned int seed = (argc > 2) ? (unsigned int)atoi(argv[2]) : 1;
+
+    if (packets >= AIR_LOG_SIZE)
+        packets = AIR_LOG_SIZE - 1;
+
+    srand(seed);
+
+    Sim_Scenario("fixed", NRF24_MODE_TX, 0, 1, packets);
+    Sim_Scenario("pipes", NRF24_MODE_TX, 0, 6, packets);
+    Sim_Scenario("rx", NRF24_MODE_RX, 0, 1, packets);
+    Sim_Scenario("esb", NRF24_MODE_TX, 1, 1, packets);
+    Sim_Scenario("esbp", NRF24_MODE_TX, 1, 6, packets);
+    Sim_Scenario("esbrx", NRF24_MODE_RX, 1, 1, packets);
+    Sim_Dead();
+
+    printf("seed %u, %d failures\n", seed, mFailures);
+
+    return (mFailures > 255) ? 255 : mFailures;
+}
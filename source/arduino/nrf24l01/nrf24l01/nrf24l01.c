@@ -19,16 +19,21 @@ CE Pin - PB1 - Pin 9 - Normal output
 NOTES:
 Rx Mode:
     RX_DR interrupt is set such that new data pulls the IRQ pin low
-    Packets are read until no data is left to read
-    Packets are echoed out the uart.
+    Packets are read until no data is left to read, into
+    the rx packet ring.  nrf24_processRxPackets, from the
+    main loop, echoes them out the uart.
     Packet widths are fixed for each data pipe
 
 Tx Mode:
-    TX_DS interrupt is set when data is sent.
+    nrf24_send queues a packet and returns.  The radio tx fifo
+    is kept loaded from the queue with CE held high, so packets
+    go back to back.  TX_DS / MAX_RT retire them and load more.
+    nrf24_transmitData is send and wait (nrf24_txWait).
     Packet widths are fixed for each data pipe
 
 All pipes are configured to be on
-All pipes are configured with ack off
+NRF24_ESB 0 - ack off, no crc, fixed widths (NRF24_PIPE_WIDTH)
+NRF24_ESB 1 - Enhanced ShockBurst, see nrf24_setEsb
 
 
 
@@ -40,6 +45,7 @@ All pipes are configured with ack off
 #include <string.h>
 #include <avr/interrupt.h>
 #include <avr/io.h>         //macros
+#include <avr/pgmspace.h>   //strings in flash
 
 
 #include "nrf24l01.h"
@@ -47,12 +53,59 @@ All pipes are configured with ack off
 #include "spi.h"
 #include "usart.h"           //retransmitting out serial port
 #include "utility.h"        //print functions
+#include "duty.h"           //duty cycled rx / tx
+#include "payload.h"        //batched samples
+#include "telemetry.h"      //binary output mode
 
 
 ///////////////////////////////////////////////
 //NRF24 Global Variables
 static NRF24_Mode_t mNRF24_Mode = NRF24_MODE_RX;
-static volatile uint8_t mTransmitCompleteFlag = 0;
+//tx queue - written with interrupts off, by
+//nrf24_send and the TX_DS / MAX_RT interrupt
+static NRF24_TxPacket mTxQueue[NRF24_TX_QUEUE_SIZE];
+static volatile uint8_t mTxHead = 0x00;         //free running
+static volatile uint8_t mTxTail = 0x00;         //free running, next to load into the radio
+static volatile uint8_t mTxInFlight = 0x00;     //in the radio fifo
+static volatile uint8_t mTxPipe = 0xFF;         //pipe in TX_ADDR
+static volatile uint8_t mTxActive = 0;          //CE high, sending
+static uint8_t mTxRefused = 0;                  //queue full counted, retries aren't
+
+static uint8_t mEsb = 0;                        //Enhanced ShockBurst link
+
+//CONFIG register, only written through nrf24_writeConfig
+//so the bits are read and changed without the spi
+static uint8_t mConfig = 0x00;
+
+//fixed payload width of each pipe, RX_PW_Px.  The
+//other end has to use the same width on that pipe
+static uint8_t mPipeWidth[6] = {NRF24_PIPE_WIDTH, NRF24_PIPE_WIDTH, NRF24_PIPE_WIDTH,
+                                NRF24_PIPE_WIDTH, NRF24_PIPE_WIDTH, NRF24_PIPE_WIDTH};
+
+//rx packet ring - single producer (INT0 isr),
+//single consumer (main loop), no locks
+static NRF24_RxPacket mRxRing[NRF24_RX_RING_SIZE];
+static volatile uint8_t mRxHead = 0x00;         //free running, written by the isr
+static volatile uint8_t mRxTail = 0x00;         //free running, written by the main loop
+
+//link counters, nrf24_getLinkStats.  Written
+//by the isr, read with interrupts off
+static volatile NRF24_LinkStats mLink;
+static uint8_t mChannel = NRF24_CHANNEL;        //RF_CH
+
+//compiler barrier - slot data in memory before
+//the index that hands it over
+#define NRF24_BARRIER()     __asm__ __volatile__ ("" ::: "memory")
+
+//tx queue helpers, interrupts off
+static void nrf24_txLoad(void);
+static void nrf24_txComplete(uint8_t status);
+static void nrf24_txDone(void);
+static uint32_t nrf24_now(void);
+
+static void nrf24_writeConfig(uint8_t config);
+static void nrf24_countRxInvalid(void);
+static void nrf24_printPayload(const NRF24_RxPacket *packet);
 
 //transmit addresses for pipes 0 - 5
 //LSB First - load the array into reg
@@ -77,19 +130,42 @@ void nrf24_dummyDelay(uint32_t delay)
 }
 
 
+//////////////////////////////////////////////
+//Wait at least us microseconds, counted off the
+//Timer0 count (main.c, Timer0_init).  Polls the
+//count, so it works with interrupts off, in the isr.
+void nrf24_delayUs(uint32_t us)
+{
+    uint32_t elapsed = 0x00;
+    uint8_t last = TCNT0_R;
+    uint8_t count;
+
+    while (elapsed < us)
+    {
+        count = TCNT0_R;
+        elapsed += (uint8_t)(count - last) * NRF24_TIMER_US;
+        last = count;
+    }
+}
+
+
 ////////////////////////////////////////////////
 //Write data to register.
 //Combine write reg command with 5 bit reg value.
 //Send as write followed by 1 data byte
-//
-void nrf24_writeReg(uint8_t reg, uint8_t data)
+//Returns STATUS, clocked out with the command byte
+//(before the write)
+uint8_t nrf24_writeReg(uint8_t reg, uint8_t data)
 {
+    uint8_t status = 0x00;
     uint8_t regValue = NRF24_CMD_W_REGISTER | (reg & (0x1F));
 
     SPI_select();                   //CS low
-    SPI_tx(regValue);               //Set write reg
+    status = SPI_tx(regValue);      //Set write reg
     SPI_tx(data);                   //send the data
     SPI_deselect();                 //CS high
+
+    return status;
 }
 
 
@@ -116,12 +192,14 @@ void nrf24_writeRegArray(uint8_t reg, uint8_t* data, uint8_t length)
 
 //////////////////////////////////////////////////
 //Write command byte followed by length data bytes
-void nrf24_writeCmd(uint8_t command, uint8_t* data, uint8_t length)
+//Returns STATUS, clocked out with the command byte
+uint8_t nrf24_writeCmd(uint8_t command, uint8_t* data, uint8_t length)
 {
     uint8_t i = 0x00;
+    uint8_t status = 0x00;
 
     SPI_select();           //CS low
-    SPI_tx(command);
+    status = SPI_tx(command);
 
     if (length > 0)
     {
@@ -130,6 +208,8 @@ void nrf24_writeCmd(uint8_t command, uint8_t* data, uint8_t length)
     }
 
     SPI_deselect();
+
+    return status;
 }
 
 
@@ -170,18 +250,24 @@ void nrf24_ce_low(void)
 
 /////////////////////////////////////////////////
 //Pulse the CE pin - for use with transmit mode
-//pulse for at least 10us
-//NRF24_CE_PULSE_LENGTH = 10000
+//pulse for at least 10us (NRF24_CE_PULSE_US)
 void nrf24_ce_pulse(void)
 {
-    volatile uint32_t time = NRF24_CE_PULSE_LENGTH;
-
     PORTB_DATA_R |= BIT1;
+    nrf24_delayUs(NRF24_CE_PULSE_US);
+    PORTB_DATA_R &=~ BIT1;
+}
 
-    while (time > 0)
-        time--;
 
-    PORTB_DATA_R &=~ BIT1;
+///////////////////////////////////////
+//Write CONFIG if it changed, keep the copy
+static void nrf24_writeConfig(uint8_t config)
+{
+    if (config != mConfig)
+    {
+        nrf24_writeReg(NRF24_REG_CONFIG, config);
+        mConfig = config;
+    }
 }
 
 
@@ -190,31 +276,31 @@ void nrf24_ce_pulse(void)
 //CONFIG REG
 void nrf24_prime_rx_bit(uint8_t value)
 {
-    uint8_t result = nrf24_readReg(NRF24_REG_CONFIG);
-
     if (value == 1)
-        result |= NRF24_BIT_PRIM_RX;
+        nrf24_writeConfig(mConfig | NRF24_BIT_PRIM_RX);
     else
-        result &=~ NRF24_BIT_PRIM_RX;
-
-    nrf24_writeReg(NRF24_REG_CONFIG, result);
+        nrf24_writeConfig(mConfig & ~NRF24_BIT_PRIM_RX);
 }
 
 
+//////////////////////////////////////////
+//Power down -> standby, NRF24_POWER_UP_US.
+//Already up - no start up wait, rx / tx
+//switches happen in the isr
 void nrf24_power_up(void)
 {
-    uint8_t config = nrf24_readReg(NRF24_REG_CONFIG);
-    config |= NRF24_BIT_PWR_UP;
-    nrf24_writeReg(NRF24_REG_CONFIG, config);    
-    nrf24_dummyDelay(100000);
+    if (mConfig & NRF24_BIT_PWR_UP)
+        return;
+
+    nrf24_writeConfig(mConfig | NRF24_BIT_PWR_UP);
+    nrf24_delayUs(NRF24_POWER_UP_US);
 }
 
+//////////////////////////////////////////
+//Power down takes effect right away
 void nrf24_power_down(void)
 {
-    uint8_t config = nrf24_readReg(NRF24_REG_CONFIG);
-    config &=~ NRF24_BIT_PWR_UP;
-    nrf24_writeReg(NRF24_REG_CONFIG, config);    
-    nrf24_dummyDelay(100000);
+    nrf24_writeConfig(mConfig & ~NRF24_BIT_PWR_UP);
 }
 
 
@@ -232,6 +318,8 @@ void nrf24_power_down(void)
 //Pass the final mode
 void nrf24_init(NRF24_Mode_t initialMode)
 {
+    uint8_t i;
+
     //Pin 9 - PB1 - CE Pin
     PORTB_DIR_R |= BIT1; 	//pin 9 as output
     PORTB_DATA_R &=~ BIT1;	//clear pin 9
@@ -263,23 +351,20 @@ void nrf24_init(NRF24_Mode_t initialMode)
     nrf24_writeReg(NRF24_REG_CONFIG, 0x00);         //No CRC, Enable All Interrupts    
     nrf24_writeReg(NRF24_REG_EN_AA, 0x00);          //Disable auto ack - if enable, CRC forced high
     nrf24_writeReg(NRF24_REG_CONFIG, 0x00);         //send again
+    mConfig = 0x00;
         
-    nrf24_dummyDelay(100000);                       //wait a while
+    nrf24_delayUs(NRF24_POR_US);                    //power on reset
     
     nrf24_writeReg(NRF24_REG_EN_RXADDR, 0x3F);      //enable all data pipes    
     nrf24_writeReg(NRF24_REG_SETUP_RETR, 0x00);     //disable retry / resend data
     
     nrf24_writeReg(NRF24_REG_RF_SETUP, 0x06);           //set power = 0dm, data rate = 1mbs
     
-    nrf24_writeReg(NRF24_REG_RF_CH, NRF24_CHANNEL);     //see .h for channel def.
+    nrf24_writeReg(NRF24_REG_RF_CH, mChannel);          //see .h for channel def.
         
     //Set the payload widths on all data pipes
-    nrf24_writeReg(NRF24_REG_RX_PW_P0, NRF24_PIPE_WIDTH & 0x3F);
-    nrf24_writeReg(NRF24_REG_RX_PW_P1, NRF24_PIPE_WIDTH & 0x3F);
-    nrf24_writeReg(NRF24_REG_RX_PW_P2, NRF24_PIPE_WIDTH & 0x3F);
-    nrf24_writeReg(NRF24_REG_RX_PW_P3, NRF24_PIPE_WIDTH & 0x3F);
-    nrf24_writeReg(NRF24_REG_RX_PW_P4, NRF24_PIPE_WIDTH & 0x3F);
-    nrf24_writeReg(NRF24_REG_RX_PW_P5, NRF24_PIPE_WIDTH & 0x3F);
+    for (i = 0 ; i < 6 ; i++)
+        nrf24_setRxPayLoadSize(i, NRF24_PIPE_WIDTH);
     
     //STATUS - Clear all pending interrupts
     nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_RX_DR | NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
@@ -287,8 +372,13 @@ void nrf24_init(NRF24_Mode_t initialMode)
     //flush rx and tx
     nrf24_flushTx();
     nrf24_flushRx();
+
+    //link type, see NRF24_ESB
+    nrf24_setEsb(NRF24_ESB);
     
     //Initial Mode - TX / RX
+    mNRF24_Mode = initialMode;
+
     if (initialMode == NRF24_MODE_RX)
     {
         nrf24_power_up();           //set the power up bit
@@ -302,7 +392,7 @@ void nrf24_init(NRF24_Mode_t initialMode)
         nrf24_ce_low();             //set the ce pin low
     }
     
-    nrf24_dummyDelay(50000);        //wait a while
+    nrf24_delayUs(NRF24_SETTLE_US);     //rx / tx settling
 }
 
 
@@ -407,6 +497,11 @@ void nrf24_setTxPipe(uint8_t pipe)
 
         //write pipeAddress into the TX_ADDR register
         nrf24_writeRegArray(NRF24_REG_TX_ADDR, (uint8_t*)pipeAddress, 5);
+
+        //auto ack - the ack comes back on pipe 0 with the
+        //tx address, put back in nrf24_txDone
+        if (mEsb)
+            nrf24_writeRegArray(NRF24_REG_RX_ADDR_P0, (uint8_t*)pipeAddress, 5);
     }
 }
 
@@ -422,66 +517,422 @@ void nrf24_writeTXPayLoad(uint8_t* buffer, uint8_t length)
 
 //////////////////////////////////////////////////////
 //Transmit Data
-//Uses TX_DS interrupt to set the transmit complete flag
-//Clear the interrupt bits
-//flush the tx register
-//write data to the tx payload register
-//pulse the ce pin and wait...
-//
-void nrf24_transmitData(uint8_t pipe, uint8_t* buffer, uint8_t length)
+//Send and wait.  Queues the packet and waits for
+//the tx queue to drain, with a timeout in case the
+//interrupt never comes.  Use nrf24_send to stream
+//packets without waiting.  Returns 0 if sent (acked
+//on an Enhanced ShockBurst link), -1 if not.
+int nrf24_transmitData(uint8_t pipe, uint8_t* buffer, uint8_t length)
 {
-    uint16_t timeout = NRF24_TX_TIMEOUT;    //reset the counter    
-    mTransmitCompleteFlag = 0;              //clear the tx complete flag
+    if (nrf24_sendWait(pipe, buffer, length, NRF24_TX_TIMEOUT_MS) < 0)
+    {
+        Usart_sendString_P(PSTR("Timeout - Tx Queue Full - Transmit Aborted\r\n"));
+        return -1;
+    }
 
-    //set the transmit pipe
-    nrf24_setTxPipe(pipe);
+    if (nrf24_txWait() < 0)
+    {
+        Usart_sendString_P(PSTR("Timeout - Counter Expired - Transmit Aborted\r\n"));
+        return -1;
+    }
+
+    return 0;
+}
 
-    //clear the tx_ds and max_rt bits
-    nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_TX_DS | NRF24_BIT_TX_DS);
 
-    nrf24_flushTx();                                    //flush the tx fifo
-    nrf24_writeTXPayLoad(buffer, NRF24_PIPE_WIDTH);   //write the data to the payload reg
-    nrf24_ce_pulse();                                   //pulse the ce pin
-    
-    while ((!mTransmitCompleteFlag) && (timeout > 0))
+
+//////////////////////////////////////////////////////
+//Queue a packet for transmit.  Returns 0 if queued,
+//-1 if the queue is full or the packet is too long.
+//Doesn't wait, the radio sends back to back while
+//the queue has packets, TX_DS retires them.
+//txQueueFull counts a full queue once, not again
+//for the retries until a packet gets in.
+//Fixed width link - short packets are padded to the
+//pipe width.  Enhanced ShockBurst - 1 to 32 bytes,
+//sent as is.
+int nrf24_send(uint8_t pipe, const uint8_t* buffer, uint8_t length)
+{
+    NRF24_TxPacket *slot;
+    uint8_t sreg;
+    uint8_t width = (pipe <= 5) ? mPipeWidth[pipe] : NRF24_PIPE_WIDTH;
+
+    if ((length == 0) || (length > (mEsb ? NRF24_PIPE_WIDTH_MAX : width)))
     {
-        timeout--;
+        mTxRefused = 0;             //not full, nothing to wait for
+        return -1;
     }
-    
 
-//void Usart_sendString(char *data);
-//void Usart_sendArray(unsigned char *data, unsigned int length);
+    sreg = SREG_R;
+    cli();
 
+    if ((uint8_t)(mTxHead - mTxTail) >= NRF24_TX_QUEUE_SIZE)
+    {
+        if (!mTxRefused)
+            mLink.txQueueFull++;
 
-    //if timeout == 0 or transmit complete flag
-    if ((!timeout) || (!mTransmitCompleteFlag))
+        mTxRefused = 1;
+        SREG_R = sreg;
+        return -1;
+    }
+
+    mTxRefused = 0;
+
+    slot = &mTxQueue[mTxHead & NRF24_TX_QUEUE_MASK];
+    slot->pipe = pipe;
+    slot->length = length;
+    memcpy(slot->data, buffer, length);
+
+    if (!mEsb)
     {
-        Usart_sendString("Timeout - Counter Expired - Transmit Aborted\r\n");
-        mTransmitCompleteFlag = 0x00;
+        memset(slot->data + length, 0x00, width - length);
+        slot->length = width;
+    }
+
+    mTxHead++;
+
+    nrf24_txLoad();                 //start it if the fifo has room
+
+    SREG_R = sreg;
+
+    return 0;
+}
+
+
+
+//////////////////////////////////////////////////////
+//Queue a packet, waiting up to ms for a slot.  The
+//tx interrupt frees slots, if it stops coming the
+//queue stays full.  Interrupts have to be on.
+//Returns 0 if queued, -1 on timeout or if the
+//packet is too long.
+int nrf24_sendWait(uint8_t pipe, const uint8_t* buffer, uint8_t length, uint16_t ms)
+{
+    uint32_t start = nrf24_now();
+
+    while (nrf24_send(pipe, buffer, length) < 0)
+    {
+        if (!mTxRefused || ((nrf24_now() - start) >= ms))
+            return -1;
+    }
+
+    return 0;
+}
+
+
+
+//////////////////////////////////////////////////////
+//Wait for the tx queue and the radio fifo to drain.
+//Returns 0 when sent, -1 on timeout or if anything
+//failed (MAX_RT) while waiting.  A timeout drops
+//everything not sent yet.  NRF24_TX_TIMEOUT_MS on
+//the main.c ms count, interrupts have to be on.
+int nrf24_txWait(void)
+{
+    uint32_t start = nrf24_now();
+    uint32_t failed = nrf24_getTxFailed();
+    uint8_t sreg;
+
+    while (mTxActive && ((nrf24_now() - start) < NRF24_TX_TIMEOUT_MS))
+        ;
+
+    if (!mTxActive)
+        return (nrf24_getTxFailed() == failed) ? 0 : -1;
+
+    sreg = SREG_R;
+    cli();
+
+    mLink.txLost += mTxInFlight + (uint8_t)(mTxHead - mTxTail);
+    mLink.txTimeout++;
+    mTxTail = mTxHead;
+    mTxInFlight = 0;
+    nrf24_flushTx();
+    nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
+    nrf24_txDone();
+
+    SREG_R = sreg;
+
+    return -1;
+}
+
+
+
+uint8_t nrf24_txBusy(void)
+{
+    return mTxActive;
+}
+
+
+/////////////////////////////////////////////
+//Packets sent / failed since boot.  Failed
+//is MAX_RT, flushed, or timed out.
+uint32_t nrf24_getTxCount(void)
+{
+    uint32_t count;
+    uint8_t sreg = SREG_R;
+
+    cli();
+    count = mLink.txOk;
+    SREG_R = sreg;
+
+    return count;
+}
+
+
+uint32_t nrf24_getTxFailed(void)
+{
+    uint32_t count;
+    uint8_t sreg = SREG_R;
+
+    cli();
+    count = mLink.txLost;
+    SREG_R = sreg;
+
+    return count;
+}
+
+
+/////////////////////////////////////////////
+//nrf24_getTimeStamp, the 32 bit count is
+//written by the timer isr
+static uint32_t nrf24_now(void)
+{
+    uint32_t now;
+    uint8_t sreg = SREG_R;
+
+    cli();
+    now = nrf24_getTimeStamp();
+    SREG_R = sreg;
+
+    return now;
+}
+
+
+
+//////////////////////////////////////////////////////
+//Load queued packets into the radio tx fifo until
+//it's full.  CE stays high while there is anything
+//to send, so the packets go back to back.  The tx
+//address is shared by the whole fifo, so a packet
+//for another pipe waits until the fifo is empty.
+//Interrupts off, or called from the isr.
+static void nrf24_txLoad(void)
+{
+    NRF24_TxPacket *slot;
+
+    while (mTxTail != mTxHead)
+    {
+        slot = &mTxQueue[mTxTail & NRF24_TX_QUEUE_MASK];
+
+        if (slot->pipe != mTxPipe)
+        {
+            if (mTxInFlight > 0)
+                break;
+
+            nrf24_setTxPipe(slot->pipe);
+            mTxPipe = slot->pipe;
+        }
+
+        //fixed width - only data payloads in the fifo,
+        //counted.  ESB - 2 at most (nrf24_txComplete),
+        //ack payloads share it, ask
+        if ((mTxInFlight >= (mEsb ? NRF24_ESB_TX_IN_FLIGHT : NRF24_TX_FIFO_SIZE)) ||
+            (mEsb && !nrf24_TxFifoHasSpace()))
+            break;
+
+        if (!mTxActive)
+        {
+            nrf24_ce_low();
+            nrf24_prime_rx_bit(0);
+            mTxActive = 1;
+        }
+
+        nrf24_writeTXPayLoad(slot->data, slot->length);
+        mTxInFlight++;
+        mTxTail++;
+        nrf24_ce_high();            //hold high, back to back
+    }
+}
+
+
+
+//////////////////////////////////////////////////////
+//TX_DS / MAX_RT from the isr.  TX_DS is one flag for
+//any number of packets sent, the fifo status says
+//what is left: nothing if empty, else one less than
+//in flight, or all of them on MAX_RT without TX_DS.
+//MAX_RT leaves the failed packet at the top of the
+//fifo, blocking the rest - drop them all.  ESB keeps
+//2 in flight, so the count is exact also when the
+//isr is late for two acks, or an ack and MAX_RT.
+//Fixed width has no MAX_RT, a packet not counted
+//yet is counted on the next TX_DS.
+//ESB - OBSERVE_TX ARC_CNT is the retransmits of the
+//last packet, earlier ones retired by the same TX_DS
+//aren't seen, the count is a floor.
+static void nrf24_txComplete(uint8_t status)
+{
+    uint8_t left = 0x00;
+
+    nrf24_writeReg(NRF24_REG_STATUS, status & (NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT));
+
+    if (mEsb)
+        mLink.txRetransmits += nrf24_readReg(NRF24_REG_OBSERVE_TX) & 0x0F;
+
+    //one in flight and sent - no need to ask the fifo
+    if (mTxInFlight && ((mTxInFlight > 1) || (status & NRF24_BIT_MAX_RT)) &&
+        !(nrf24_getFifoStatus() & NRF24_BIT_TX_EMPTY))
+    {
+        left = mTxInFlight;
+
+        if (status & NRF24_BIT_TX_DS)
+            left--;
+    }
+
+    mLink.txOk += mTxInFlight - left;
+
+    if (status & NRF24_BIT_MAX_RT)
+    {
+        mLink.txMaxRt++;
+        mLink.txLost += left;
+        left = 0;
         nrf24_flushTx();
-        nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
     }
-    
-    else if(mTransmitCompleteFlag == 1)
+
+    mTxInFlight = left;
+
+    nrf24_txLoad();
+
+    //not sending - TX_DS for an ack payload (receiver)
+    if (mTxActive && !mTxInFlight && (mTxTail == mTxHead))
+        nrf24_txDone();
+}
+
+
+
+//////////////////////////////////////////////////////
+//Nothing left to send - CE low, and back to
+//listening if it's not a transmit only radio
+static void nrf24_txDone(void)
+{
+    nrf24_ce_low();
+    mTxActive = 0;
+
+    //acks came back on pipe 0 - put its rx address back
+    if (mEsb)
     {
-        Usart_sendString("Polling - Transmit Complete: ");
-        Usart_sendArray(buffer, length);
-        Usart_sendString("\r\n");        
+        nrf24_writeRegArray(NRF24_REG_RX_ADDR_P0, (uint8_t*)mTxAddress_Pipe0, 5);
+        mTxPipe = 0xFF;
+    }
+
+    if (mNRF24_Mode != NRF24_MODE_TX)
+    {
+        nrf24_prime_rx_bit(1);
+        nrf24_ce_high();
+    }
+}
+
+
+
+//////////////////////////////////////////////////////
+//Air data rate, power stays at 0dbm.
+//Both ends have to match.
+void nrf24_setDataRate(NRF24_DataRate_t rate)
+{
+    uint8_t setup = NRF24_RF_PWR_0DBM;
+
+    if (rate == NRF24_RATE_250KBPS)
+        setup |= NRF24_BIT_RF_DR_LOW;
+    else if (rate == NRF24_RATE_2MBPS)
+        setup |= NRF24_BIT_RF_DR_HIGH;
+
+    nrf24_writeReg(NRF24_REG_RF_SETUP, setup);
+}
+
+
+
+//////////////////////////////////////////////////////
+//Enhanced ShockBurst link on / off.  On:
+//crc16, auto ack on all pipes, NRF24_ESB_RETRIES
+//retransmits, dynamic payload widths, ack payloads
+//and no-ack payloads.  Off: the fixed width link.
+//The radio has to be idle.
+void nrf24_setEsb(uint8_t enable)
+{
+    uint8_t config = mConfig & ~(NRF24_BIT_EN_CRC | NRF24_BIT_CRCO);
+    uint8_t feature = NRF24_BIT_EN_DPL | NRF24_BIT_EN_ACK_PAY | NRF24_BIT_EN_DYN_ACK;
+    uint8_t key = 0x73;
+
+    if (enable)
+    {
+        nrf24_writeConfig(config | NRF24_BIT_EN_CRC | NRF24_BIT_CRCO);
+        nrf24_writeReg(NRF24_REG_EN_AA, 0x3F);
+        nrf24_setRetries(NRF24_ESB_RETRIES, NRF24_ESB_RETRY_DELAY);
+
+        //nrf24l01 (not +) ignores FEATURE until ACTIVATE
+        nrf24_writeReg(NRF24_REG_FEATURE, feature);
+
+        if (nrf24_readReg(NRF24_REG_FEATURE) != feature)
+        {
+            nrf24_writeCmd(NRF24_CMD_ACTIVATE, &key, 1);
+            nrf24_writeReg(NRF24_REG_FEATURE, feature);
+        }
+
+        nrf24_writeReg(NRF24_REG_DYNPD, 0x3F);
     }
-    
     else
     {
-        Usart_sendString("Polling - Transmit Flag Never Set - Timeout\r\n");    
+        nrf24_writeReg(NRF24_REG_DYNPD, 0x00);
+        nrf24_writeReg(NRF24_REG_FEATURE, 0x00);
+        nrf24_writeReg(NRF24_REG_SETUP_RETR, 0x00);
+        nrf24_writeReg(NRF24_REG_EN_AA, 0x00);
+        nrf24_writeConfig(config);
     }
-    
-    /////////////////////////////////////////
-    //Test the tx_ds and max_rt bits
-    if (nrf24_getStatus() & (NRF24_BIT_TX_DS | NRF24_BIT_TX_DS ))
+
+    mEsb = enable ? 1 : 0;
+}
+
+
+uint8_t nrf24_getEsb(void)
+{
+    return mEsb;
+}
+
+
+//////////////////////////////////////////////////////
+//Auto retransmit, SETUP_RETR.  count 0 - 15,
+//delay 0 - 15, (delay + 1) * 250us between tries.
+//Ack payloads over 15 bytes at 1mbps need 500us.
+void nrf24_setRetries(uint8_t count, uint8_t delay)
+{
+    nrf24_writeReg(NRF24_REG_SETUP_RETR, ((delay & 0x0F) << 4) | (count & 0x0F));
+}
+
+
+//////////////////////////////////////////////////////
+//Load a payload for the next ack sent on pipe.
+//Enhanced ShockBurst only.  Shares the tx fifo,
+//3 deep.  Returns 0 if loaded, -1 if not.
+int nrf24_setAckPayload(uint8_t pipe, const uint8_t* buffer, uint8_t length)
+{
+    int result = -1;
+    uint8_t sreg;
+
+    if (!mEsb || (pipe > 5) || (length == 0) || (length > NRF24_PIPE_WIDTH_MAX))
+        return -1;
+
+    sreg = SREG_R;
+    cli();
+
+    if (nrf24_TxFifoHasSpace())
     {
-        //tx ds bit high - clearing it
-        Usart_sendString("TX_DS and or MAX_RT Bit(s) High - Clearing It...\r\n");
-        nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
-    }   
+        nrf24_writeCmd(NRF24_CMD_W_ACK_PAYLOAD | pipe, (uint8_t*)buffer, length);
+        result = 0;
+    }
+
+    SREG_R = sreg;
+
+    return result;
 }
 
 
@@ -504,6 +955,7 @@ void nrf24_setRxPayLoadSize(uint8_t pipe, uint8_t numBytes)
     { 
         reg = NRF24_REG_RX_PW_P0 + pipe;                    //pipe address continuous
         nrf24_writeReg(reg, (numBytes & 0x3F));             //write num bytes to bits 0:5
+        mPipeWidth[pipe] = numBytes;                        //nrf24_getRxPayLoadSize, the isr
     }
 }
 
@@ -512,18 +964,11 @@ void nrf24_setRxPayLoadSize(uint8_t pipe, uint8_t numBytes)
 //////////////////////////////////////////////////
 //Get the pipe width for a particular pipe.  
 //Pipe Range: 0-5
+//The copy kept by nrf24_setRxPayLoadSize, no spi
 uint8_t nrf24_getRxPayLoadSize(uint8_t pipe)
 {
-    uint8_t reg = 0x00;
-    uint8_t width = 0x00;
-
     if (pipe <= 5)
-    {
-        reg = NRF24_REG_RX_PW_P0 + pipe;                    //pipe address continuous
-        width = (nrf24_readReg(reg) & 0x3F);
-
-        return width;
-    }
+        return mPipeWidth[pipe];
     
     return 0;
 }
@@ -533,6 +978,23 @@ uint8_t nrf24_getRxPayLoadSize(uint8_t pipe)
 
 
 
+////////////////////////////////////////////////////////
+//Width of the payload at the top of the rx fifo,
+//R_RX_PL_WID.  Dynamic payload widths only.
+uint8_t nrf24_readRxPayLoadWidth(void)
+{
+    uint8_t width = 0x00;
+
+    SPI_select();
+    SPI_tx(NRF24_CMD_R_RX_PL_WID);
+    width = SPI_rx();
+    SPI_deselect();
+
+    return width;
+}
+
+
+
 //////////////////////////////////////////////////////////
 //Read which pipe has data available to read from
 //the RX Fifo.  STATUS register - bits 3:1, 111 = RX FIFO
@@ -584,16 +1046,43 @@ void nrf24_readRxPayLoad(uint8_t* data, uint8_t length)
 //pipe - pipe from which data is read
 //size - pipe width
 //returns the length of bytes in the pipe.
+//The isr doesn't use it, see nrf24_readRxStatus
 //
 uint8_t nrf24_readRxData(uint8_t* data, uint8_t* pipe)
 {
-    uint8_t length = 0x00;    
-    uint8_t pipeNum = nrf24_getRxPipeToRead();    //returns pipeNum
+    return nrf24_readRxStatus(nrf24_getStatus(), data, pipe);
+}
+
+
+
+///////////////////////////////////////////////////
+//Read the top of the rx fifo, the pipe number is
+//taken from a STATUS byte that's already been read
+//(RX_P_NO, bits 3:1).  Fixed width - the width is
+//the cached pipe width, so a payload is just the
+//R_RX_PAYLOAD transaction.  Same returns as
+//nrf24_readRxData.
+uint8_t nrf24_readRxStatus(uint8_t status, uint8_t* data, uint8_t* pipe)
+{
+    uint8_t length = 0x00;
+    uint8_t pipeNum = (status >> 1) & 0x07;     //111 empty, 110 not used
 
     if (pipeNum <= 0x05)                         //pipe 5 max
     {
         *pipe = pipeNum;                            //set the pipe read
-        length = nrf24_getRxPayLoadSize(pipeNum);   //pipe width
+
+        if (mEsb)
+            length = nrf24_readRxPayLoadWidth();    //dynamic width
+        else
+            length = mPipeWidth[pipeNum];           //pipe width
+
+        //bad width - datasheet says flush it
+        if (length > NRF24_PIPE_WIDTH_MAX)
+        {
+            nrf24_flushRx();
+            return 0xFF;
+        }
+
         nrf24_readRxPayLoad(data, length);          //read the data
 
         return length;
@@ -613,93 +1102,386 @@ uint8_t nrf24_readRxData(uint8_t* data, uint8_t* pipe)
 //
 //For now, only enable the RX_DR interrupt and TX_DS interrupt
 //
+//RX_DR only copies the payloads into the rx ring,
+//the packets are checked and decoded in the main
+//loop (nrf24_processRxPackets).  If the ring is full
+//the payload is still read, to free the radio fifo,
+//and counted as dropped.  A whole fifo's worth in one
+//interrupt - it was full, anything that came then was
+//lost in the radio, counted as rxFifoFull.
+//
 void nrf24_ISR(void)
 {
-    int n = 0x00;
-    uint8_t len = 0x00;
     uint8_t pipe = 0x00;
-    uint8_t rxBuffer[32] = {0x00};
+    uint8_t len = 0x00;
+    uint8_t count = 0x00;
+    uint8_t discard[NRF24_PIPE_WIDTH_MAX];
     uint8_t status = nrf24_getStatus();
-    uint16_t adcValue, adcLSB, adcMSB = 0x00;
-    uint8_t tempInt, tempFrac = 0x00;
-    uint8_t output[64] = {0x00};
-
+    NRF24_RxPacket *slot;
 
     //RX_DR Interrupt - Data Received
     if (status & NRF24_BIT_RX_DR)
     {
-        //read the rx fifo while packets are available
-        while (nrf24_RxFifoHasData())
+        //read the rx fifo while packets are available,
+        //RX_P_NO 111 - empty.  Clearing RX_DR returns
+        //the STATUS for the next payload, so a packet is
+        //two spi transactions (three with ESB, the width)
+        while (((status >> 1) & 0x07) <= 5)
         {
-            len = nrf24_readRxData(rxBuffer, &pipe);            //read the packet and pipe
+            if (++count == NRF24_RX_FIFO_SIZE)
+                mLink.rxFifoFull++;
 
-            //output result
-            n = sprintf(output, "RX(%d): ", pipe);
-            Usart_sendArray(output, n);                   //forward it to the uart
+            if ((uint8_t)(mRxHead - mRxTail) < NRF24_RX_RING_SIZE)
+            {
+                slot = &mRxRing[mRxHead & NRF24_RX_RING_MASK];
+                len = nrf24_readRxStatus(status, slot->data, &pipe);    //read the packet and pipe
+
+                if (len <= NRF24_PIPE_WIDTH_MAX)
+                {
+                    slot->pipe = pipe;
+                    slot->length = len;
+                    slot->ack = (mEsb && mTxActive) ? 1 : 0;     //fixed width - rx before tx started
+                    slot->timestamp = nrf24_getTimeStamp();
+
+                    NRF24_BARRIER();
+                    mRxHead++;
+                    mLink.rxPipe[pipe]++;
+                }
+                else
+                    mLink.rxBadWidth++;
+            }
+            else
+            {
+                nrf24_readRxStatus(status, discard, &pipe);
+                mLink.rxDropped++;
+            }
 
-            n = utility_data2HexBuffer(rxBuffer, 8, output);
-            Usart_sendArray(output, n);                   //forward it to the uart
+            //clear the interrupt, STATUS of the next one
+            status = nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_RX_DR);
+        }
+    }
 
-            Usart_sendString("\r\n");
-            
-            //Testing - 0xFE, MID_ADC_TEMP1, LSB, MSB in millivolts
-            if (rxBuffer[0] == 0xFE)
-            {
+    //TX_DS Interrupt - Data Sent, MAX_RT Interrupt -
+    //Max Retransmissions - For Ack Only.  Not an else,
+    //the irq pin stays low until every flag is cleared
+    //and INT0 is edge triggered.
+    if (status & (NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT))
+    {
+        nrf24_txComplete(status);
+    }
+}
 
-                //process buffer...
 
-                adcLSB = (uint16_t)rxBuffer[3];
-                adcMSB = (uint16_t)rxBuffer[4];
-                adcValue = (adcMSB << 8) | (adcLSB & 0xFF);
 
-                tempInt = rxBuffer[5];
-                tempFrac = rxBuffer[6];
+///////////////////////////////////////////////////
+//Take the oldest packet out of the rx ring.
+//Main loop only.  Returns 1 if a packet was
+//loaded, 0 if the ring is empty.
+uint8_t nrf24_getRxPacket(NRF24_RxPacket *packet)
+{
+    uint8_t tail = mRxTail;
 
-                //output the result....
-                Usart_sendString("ADC: ");
-                n = utility_decimal2Buffer(adcValue, output);
-                Usart_sendArray(output, n);
-                Usart_sendString("\r\n");
+    if (tail == mRxHead)
+        return 0;
 
-                Usart_sendString("TEMP: ");
-                n = utility_decimal2Buffer(tempInt, output);
-                Usart_sendArray(output, n);
+    memcpy(packet, &mRxRing[tail & NRF24_RX_RING_MASK], sizeof(NRF24_RxPacket));
 
-                Usart_sendString(".");
-                n = utility_decimal2Buffer(tempFrac, output);
-                Usart_sendArray(output, n);
+    NRF24_BARRIER();
+    mRxTail = tail + 1;
 
-                Usart_sendString("\r\n");
+    return 1;
+}
 
-            }
 
-            else
+
+///////////////////////////////////////////////////
+//Batched samples, payload.h.  Binary mode - the
+//frame as is, the host decoder reads the batch.
+//Text mode - one line per sample, oldest first,
+//with how long before the frame it was taken.
+//MCP9700A - millivolts, 500mV at 0C, 10mV per
+//degree.
+static void nrf24_printPayload(const NRF24_RxPacket *packet)
+{
+    PayloadReader reader;
+    PayloadBatch batch;
+    char output[64];
+    uint32_t age;
+    int16_t temp;
+    uint8_t i;
+    int n;
+
+    if (Payload_open(&reader, packet->data, packet->length) < 0)
+    {
+        nrf24_countRxInvalid();
+        Usart_sendString_P(PSTR("Bad Payload\r\n"));
+        return;
+    }
+
+    if (Telemetry_getMode() == TELEMETRY_MODE_BINARY)
+    {
+        Telemetry_sendRadioPacket(packet->pipe, packet->data, packet->length);
+        return;
+    }
+
+    while (Payload_read(&reader, &batch) > 0)
+    {
+        for (i = 0 ; i < batch.count ; i++)
+        {
+            age = batch.age + (uint32_t)(batch.count - 1 - i) * batch.interval;
+
+            n = sprintf_P(output, PSTR("S%u M%u -%lu.%lus: %d"), reader.station, batch.mid,
+                    (unsigned long)(age / 10), (unsigned long)(age % 10), batch.samples[i]);
+            Usart_sendArray((unsigned char*)output, n);
+
+            if (batch.mid == MID_TEMP_MCP9700A)
             {
-                //bad / missing data
-                Usart_sendString("Bad Data / Corrupt Packet\r\n");
+                temp = batch.samples[i] - 500;
+                n = sprintf_P(output, PSTR("  TEMP: %s%d.%d"), (temp < 0) ? "-" : "",
+                        ((temp < 0) ? -temp : temp) / 10, ((temp < 0) ? -temp : temp) % 10);
+                Usart_sendArray((unsigned char*)output, n);
             }
 
-            //clear the interrupt
-            nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_RX_DR);
+            Usart_sendString_P(PSTR("\r\n"));
         }
     }
+}
+
+
+
+///////////////////////////////////////////////////
+//Print all the packets waiting in the rx ring.
+//Call from the main loop and the Delay loop.
+//Testing - 0xFE, MID_ADC_TEMP1, LSB, MSB in millivolts
+//Duty cycling (duty.h) sees each packet first -
+//beacons and copies aren't printed - and runs its
+//timers after.
+//Pipe 2 - batched samples (payload.h)
+//Binary mode (telemetry.h) - a radio frame, and adc
+//and temp frames for a sensor packet
+void nrf24_processRxPackets(void)
+{
+    int n = 0x00;
+    NRF24_RxPacket packet;
+    uint16_t adcValue, adcLSB, adcMSB = 0x00;
+    uint8_t tempInt, tempFrac = 0x00;
+    uint8_t output[16] = {0x00};                //a line piece, hex a byte at a time
+    uint8_t i, sensor;
+    uint32_t now;
 
-    //TX_DS Interrupt - Data Sent
-    else if (status & NRF24_BIT_TX_DS)
+    while (nrf24_getRxPacket(&packet))
     {
-        mTransmitCompleteFlag = 1;      //set the transmit complete flag
-        //write 1 to clear the transmit complete flag        
-        nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
+        if (Duty_packet(&packet))
+            continue;
+
+        if ((packet.pipe == PAYLOAD_PIPE) && !packet.ack)
+        {
+            nrf24_printPayload(&packet);
+            continue;
+        }
+
+        //0xFE from the sensor, 0xF0 + ttl relayed (repeater relay.h),
+        //the adc and temp in bytes 3 - 6
+        sensor = (packet.length >= 7) && ((packet.data[0] == 0xFE) ||
+            (((packet.data[0] & 0xF0) == 0xF0) && (packet.data[0] != 0xFF)));
+
+        if (Telemetry_getMode() == TELEMETRY_MODE_BINARY)
+        {
+            Telemetry_sendRadioPacket(packet.pipe, packet.data, packet.length);
+
+            if (sensor)
+            {
+                adcValue = ((uint16_t)packet.data[4] << 8) | packet.data[3];
+                Telemetry_sendAdc(packet.data[1], adcValue);
+                Telemetry_sendTemp(packet.data[1], packet.data[5], packet.data[6]);
+            }
+            else
+                nrf24_countRxInvalid();
+
+            continue;
+        }
+
+        //output result, ACK - ack payload
+        n = sprintf_P(output, packet.ack ? PSTR("ACK(%d): ") : PSTR("RX(%d): "), packet.pipe);
+        Usart_sendArray(output, n);                   //forward it to the uart
+
+        for (i = 0 ; i < packet.length ; i++)
+        {
+            n = utility_data2HexBuffer(&packet.data[i], 1, output);
+            Usart_sendArray(output, n);               //forward it to the uart
+        }
+
+        Usart_sendString_P(PSTR("\r\n"));
+
+        if (sensor)
+        {
+            adcLSB = (uint16_t)packet.data[3];
+            adcMSB = (uint16_t)packet.data[4];
+            adcValue = (adcMSB << 8) | (adcLSB & 0xFF);
+
+            tempInt = packet.data[5];
+            tempFrac = packet.data[6];
+
+            //output the result....
+            Usart_sendString_P(PSTR("ADC: "));
+            n = utility_decimal2Buffer(adcValue, output);
+            Usart_sendArray(output, n);
+            Usart_sendString_P(PSTR("\r\n"));
+
+            Usart_sendString_P(PSTR("TEMP: "));
+            n = utility_decimal2Buffer(tempInt, output);
+            Usart_sendArray(output, n);
+
+            Usart_sendString_P(PSTR("."));
+            n = utility_decimal2Buffer(tempFrac, output);
+            Usart_sendArray(output, n);
+
+            Usart_sendString_P(PSTR("\r\n"));
+        }
+
+        else
+        {
+            //bad / missing data
+            nrf24_countRxInvalid();
+            Usart_sendString_P(PSTR("Bad Data / Corrupt Packet\r\n"));
+        }
     }
-    
-    //MX_RT Interrupt - Max Retransmissions - For Ack Only
-    else if (status & NRF24_BIT_MAX_RT)
-    {
-//        UART_sendString("Max Retries Failed...\n");        
-        nrf24_writeReg(NRF24_REG_STATUS, NRF24_BIT_TX_DS | NRF24_BIT_MAX_RT);
-    }    
+
+    now = nrf24_now();
+
+    Duty_service(now);
+}
+
+
+/////////////////////////////////////////////
+//Packets put into the rx ring since boot
+uint32_t nrf24_getRxCount(void)
+{
+    uint32_t count = 0x00;
+    uint8_t i, sreg = SREG_R;
+
+    cli();
+
+    for (i = 0 ; i < 6 ; i++)
+        count += mLink.rxPipe[i];
+
+    SREG_R = sreg;
+
+    return count;
+}
+
+
+/////////////////////////////////////////////
+//Packets lost to a full rx ring
+uint16_t nrf24_getRxDropped(void)
+{
+    uint16_t dropped;
+    uint8_t sreg = SREG_R;
+
+    cli();
+    dropped = mLink.rxDropped;
+    SREG_R = sreg;
+
+    return dropped;
+}
+
+
+/////////////////////////////////////////////
+//Link counters, a copy taken with interrupts
+//off.  See NRF24_LinkStats.
+void nrf24_getLinkStats(NRF24_LinkStats *stats)
+{
+    uint8_t sreg = SREG_R;
+
+    cli();
+    memcpy(stats, (const void*)&mLink, sizeof(NRF24_LinkStats));
+    SREG_R = sreg;
 }
 
 
+void nrf24_clearLinkStats(void)
+{
+    uint8_t sreg = SREG_R;
+
+    cli();
+    memset((void*)&mLink, 0x00, sizeof(NRF24_LinkStats));
+    SREG_R = sreg;
+}
+
+
+/////////////////////////////////////////////
+//Main loop - a packet that failed the checks
+//in nrf24_processRxPackets
+static void nrf24_countRxInvalid(void)
+{
+    uint8_t sreg = SREG_R;
+
+    cli();
+    mLink.rxInvalid++;
+    SREG_R = sreg;
+}
+
+
+
+//////////////////////////////////////////////////
+//RF channel, 2400 + channel MHz, 0 - 125.  Both
+//ends have to match.
+void nrf24_setChannel(uint8_t channel)
+{
+    if (channel > NRF24_CHANNEL_MAX)
+        return;
+
+    nrf24_writeReg(NRF24_REG_RF_CH, channel);
+    mChannel = channel;
+}
+
+
+uint8_t nrf24_getChannel(void)
+{
+    return mChannel;
+}
+
+
+//////////////////////////////////////////////////
+//Channel survey.  Listens on channel samples
+//times, NRF24_SCAN_LISTEN_US each, and counts how
+//often RPD was set - something over -64dBm on it.
+//Main loop.  Returns the count, -1 if sending or a
+//bad channel.  Back on the link channel after, in
+//the same power / rx state.
+int nrf24_scanChannel(uint8_t channel, uint8_t samples)
+{
+    uint8_t config = mConfig;
+    uint8_t ce = PORTB_DATA_R & BIT1;
+    uint8_t i;
+    int hits = 0;
+
+    if (mTxActive || (channel > NRF24_CHANNEL_MAX))
+        return -1;
+
+    nrf24_ce_low();
+    nrf24_power_up();
+    nrf24_prime_rx_bit(1);
+    nrf24_writeReg(NRF24_REG_RF_CH, channel);
+
+    for (i = 0 ; i < samples ; i++)
+    {
+        nrf24_ce_high();
+        nrf24_delayUs(NRF24_SCAN_LISTEN_US);
+        nrf24_ce_low();                             //RPD latched
+
+        if (nrf24_readReg(NRF24_REG_RPD) & 0x01)
+            hits++;
+    }
+
+    nrf24_writeReg(NRF24_REG_RF_CH, mChannel);
+    nrf24_writeConfig(config);
+
+    if (ce)
+        nrf24_ce_high();
+
+    return hits;
+}
+
 
 
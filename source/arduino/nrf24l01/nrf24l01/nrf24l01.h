@@ -13,16 +13,61 @@ Dana Olcott
 #include <stddef.h>
 #include <stdint.h>
 
-//pulse length of the CE pin, for use with transmitting
-//data out of tx payload.  at cpu = 16mhz, this is about 10ms
-#define NRF24_CE_PULSE_LENGTH           ((uint16_t)5000)
-#define NRF24_TX_TIMEOUT                ((uint16_t)50000)
+//nrf24_txWait / nrf24_transmitData give up after
+//this, ms.  The slowest ESB link - 15 retries 4ms
+//apart at 250kbps, 32 bytes - takes ~95ms a packet,
+//7 of them with the queue and fifo full.
+#define NRF24_TX_TIMEOUT_MS             ((uint16_t)1000)
+
+//waits, from the datasheet.  nrf24_delayUs counts
+//them off Timer0, clk/64 at 16mhz (main.c)
+#define NRF24_TIMER_US                  4           //us per Timer0 count
+#define NRF24_CE_PULSE_US               10          //CE high, start a transmit
+#define NRF24_SETTLE_US                 130         //Tstby2a, standby to rx / tx
+#define NRF24_POWER_UP_US               1500        //Tpd2stby, power down to standby
+#define NRF24_POR_US                    100000      //power on reset
+
+#define NRF24_TX_FIFO_SIZE              3
+#define NRF24_RX_FIFO_SIZE              3
 
 #define NRF24_PIPE_WIDTH                ((uint8_t)8)
 #define NRF24_PIPE_WIDTH_MAX            ((uint8_t)32)
 
+#define NRF24_CHANNEL_MAX               ((uint8_t)125)
+
+//channel scan, nrf24_scanChannel - RPD wants 40us
+//in rx, after the 130us settle
+#define NRF24_SCAN_LISTEN_US            200
+#define NRF24_SCAN_SAMPLES              20
+
 #define NRF24_CHANNEL                   ((uint8_t)2)
 
+//Enhanced ShockBurst link - crc16, auto ack with
+//retransmit, dynamic payload widths and ack payloads.
+//Both ends have to match.  0 - the fixed width link,
+//no crc, no ack.
+#ifndef NRF24_ESB
+#define NRF24_ESB                       0
+#endif
+#define NRF24_ESB_RETRIES               ((uint8_t)5)        //0 - 15
+#define NRF24_ESB_RETRY_DELAY           ((uint8_t)1)        //(n + 1) * 250us, 0 - 15
+#define NRF24_ESB_TX_IN_FLIGHT          2                   //payloads in the radio fifo, see nrf24_txComplete
+
+//rx packet ring - the isr reads payloads into
+//the slots, the main loop decodes them.  Power of 2
+#ifndef NRF24_RX_RING_SIZE
+#define NRF24_RX_RING_SIZE              4
+#endif
+#define NRF24_RX_RING_MASK              (NRF24_RX_RING_SIZE - 1)
+
+//tx queue - nrf24_send puts packets here, the
+//radio tx fifo (3 deep) is kept loaded from it.
+//Power of 2
+#ifndef NRF24_TX_QUEUE_SIZE
+#define NRF24_TX_QUEUE_SIZE             4
+#endif
+#define NRF24_TX_QUEUE_MASK             (NRF24_TX_QUEUE_SIZE - 1)
+
 
 ///////////////////////////////////////////////
 //Register Definitions - Commands
@@ -43,6 +88,7 @@ Dana Olcott
 
 #define NRF24_CMD_W_TX_PAYLOAD_NOACK    0xB0
 #define NRF24_CMD_NOP                   0xFF
+#define NRF24_CMD_ACTIVATE              0x50        //nrf24l01 (not +), before FEATURE
 
 
 ////////////////////////////////////////////////
@@ -65,6 +111,18 @@ Dana Olcott
 
 //reg: FIFO_STATUS
 #define NRF24_BIT_RX_EMPTY              (1u << 0)       //1 = empty
+#define NRF24_BIT_TX_EMPTY              (1u << 4)       //1 = empty
+#define NRF24_BIT_FIFO_TX_FULL          (1u << 5)       //1 = full
+
+//reg: FEATURE
+#define NRF24_BIT_EN_DPL                (1u << 2)       //dynamic payload length
+#define NRF24_BIT_EN_ACK_PAY            (1u << 1)       //payload with ack
+#define NRF24_BIT_EN_DYN_ACK            (1u << 0)       //W_TX_PAYLOAD_NOACK
+
+//reg: RF_SETUP
+#define NRF24_BIT_RF_DR_LOW             (1u << 5)       //250kbps
+#define NRF24_BIT_RF_DR_HIGH            (1u << 3)       //2mbps
+#define NRF24_RF_PWR_0DBM               (3u << 1)
 
 
 
@@ -146,13 +204,66 @@ typedef enum
 //Bytes 3 - 7   Data Bytes
 //
 
+/////////////////////////////////////////////////
+//Air data rate, RF_SETUP
+typedef enum
+{
+    NRF24_RATE_250KBPS,
+    NRF24_RATE_1MBPS,
+    NRF24_RATE_2MBPS
+}NRF24_DataRate_t;
+
+////////////////////////////////////////////////
+//Tx queue slot
+typedef struct
+{
+    uint8_t pipe;
+    uint8_t length;
+    uint8_t data[NRF24_PIPE_WIDTH_MAX];
+}NRF24_TxPacket;
+
+////////////////////////////////////////////////
+//Rx ring slot, one payload and where / when
+//it arrived
+typedef struct
+{
+    uint8_t pipe;
+    uint8_t length;
+    uint8_t ack;                            //1 - ack payload, came back while sending
+    uint32_t timestamp;                     //ms, nrf24_getTimeStamp
+    uint8_t data[NRF24_PIPE_WIDTH_MAX];
+}NRF24_RxPacket;
+
+////////////////////////////////////////////////
+//Link counters, nrf24_getLinkStats.  The fixed
+//width link has no radio crc, a bad packet shows
+//up as rxInvalid (failed the checks in
+//nrf24_processRxPackets).  With ESB the radio drops
+//crc errors without telling, lost / MAX_RT on the
+//sender is where they show.
+typedef struct
+{
+    uint32_t txOk;                          //sent, acked with ESB
+    uint32_t txLost;                        //MAX_RT, timed out, dropped with them
+    uint32_t txRetransmits;                 //ESB, OBSERVE_TX ARC_CNT, a floor
+    uint16_t txMaxRt;                       //MAX_RT interrupts
+    uint16_t txTimeout;                     //nrf24_txWait gave up
+    uint16_t txQueueFull;                   //nrf24_send turned away, once until one gets in
+    uint32_t rxPipe[6];                     //into the ring, per pipe
+    uint16_t rxDropped;                     //ring full
+    uint16_t rxFifoFull;                    //radio fifo full, may have lost some
+    uint16_t rxBadWidth;                    //bad dynamic width, fifo flushed
+    uint16_t rxInvalid;                     //failed validation
+}NRF24_LinkStats;
+
 ////////////////////////////////////////////////
 //Prototypes
 void nrf24_dummyDelay(uint32_t delay);
+void nrf24_delayUs(uint32_t us);
 
-void nrf24_writeReg(uint8_t reg, uint8_t data);
+uint8_t nrf24_writeReg(uint8_t reg, uint8_t data);                      //returns STATUS
 void nrf24_writeRegArray(uint8_t reg, uint8_t* data, uint8_t length);
-void nrf24_writeCmd(uint8_t command, uint8_t* data, uint8_t length);
+uint8_t nrf24_writeCmd(uint8_t command, uint8_t* data, uint8_t length); //returns STATUS
 uint8_t nrf24_readReg(uint8_t reg);
 
 void nrf24_ce_high(void);
@@ -182,15 +293,47 @@ void nrf24_flushTx(void);
 //transmit
 void nrf24_setTxPipe(uint8_t pipe);
 void nrf24_writeTXPayLoad(uint8_t* buffer, uint8_t length);
-void nrf24_transmitData(uint8_t pipe, uint8_t* buffer, uint8_t length);
+int nrf24_transmitData(uint8_t pipe, uint8_t* buffer, uint8_t length);   //send and wait, 0 delivered
+int nrf24_send(uint8_t pipe, const uint8_t* buffer, uint8_t length);    //queue it, 0 ok, -1 full
+int nrf24_sendWait(uint8_t pipe, const uint8_t* buffer, uint8_t length, uint16_t ms); //wait up to ms for a slot
+int nrf24_txWait(void);                                                 //wait until sent, -1 timeout / failed
+uint8_t nrf24_txBusy(void);
+uint32_t nrf24_getTxCount(void);
+uint32_t nrf24_getTxFailed(void);
+void nrf24_setDataRate(NRF24_DataRate_t rate);
+
+//Enhanced ShockBurst
+void nrf24_setEsb(uint8_t enable);
+uint8_t nrf24_getEsb(void);
+void nrf24_setRetries(uint8_t count, uint8_t delay);
+int nrf24_setAckPayload(uint8_t pipe, const uint8_t* buffer, uint8_t length);
+uint8_t nrf24_readRxPayLoadWidth(void);                         //dynamic width, top of the rx fifo
 
 //receive
-uint8_t nrf24_getRxPayLoadSize(uint8_t pipe);                           //width of the pipe
+uint8_t nrf24_getRxPayLoadSize(uint8_t pipe);                           //width of the pipe, cached
 void nrf24_setRxPayLoadSize(uint8_t pipe, uint8_t numBytes);            //set width of pipe
 uint8_t nrf24_getRxPipeToRead(void);                                    //which pipe to read next
 
 void nrf24_readRxPayLoad(uint8_t* data, uint8_t length);        //read the top payload in the rx fifo
 uint8_t nrf24_readRxData(uint8_t* data, uint8_t* pipe);         //read data in rx pipe, returns len bytes
+uint8_t nrf24_readRxStatus(uint8_t status, uint8_t* data, uint8_t* pipe);  //same, pipe from a STATUS already read
+
+//rx packet ring
+uint8_t nrf24_getRxPacket(NRF24_RxPacket *packet);              //1 if a packet was loaded
+void nrf24_processRxPackets(void);                              //print them, main loop only
+uint32_t nrf24_getRxCount(void);
+uint16_t nrf24_getRxDropped(void);
+
+//link counters and the channel
+void nrf24_getLinkStats(NRF24_LinkStats *stats);
+void nrf24_clearLinkStats(void);
+void nrf24_setChannel(uint8_t channel);                         //0 - NRF24_CHANNEL_MAX
+uint8_t nrf24_getChannel(void);
+int nrf24_scanChannel(uint8_t channel, uint8_t samples);        //RPD hits, -1 busy / bad channel
+
+//ms time stamp for the rx ring, supplied by
+//main.c.  Called from the INT0 isr.
+uint32_t nrf24_getTimeStamp(void);
 
 
 
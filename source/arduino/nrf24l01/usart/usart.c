@@ -1,6 +1,7 @@
 
 #include <avr/interrupt.h>
 #include <avr/io.h>         //macros
+#include <avr/pgmspace.h>
 
 #include <string.h>
 #include <stdio.h>
@@ -14,10 +15,26 @@
 
 
 
+//rx line queue - the isr fills line rxLineHead,
+//the main loop takes complete lines from rxLineTail
 static volatile unsigned char rxIndex = 0x00;
-static volatile unsigned char rxActiveBuffer = 0;
-static volatile unsigned char rxBuffer0[RX_BUFFER_SIZE];
-static volatile unsigned char rxBuffer1[RX_BUFFER_SIZE];
+static volatile unsigned char rxLineHead = 0x00;    //free running, written by the isr
+static volatile unsigned char rxLineTail = 0x00;    //free running, written by the main loop
+static volatile unsigned int rxLinesDropped = 0x00;
+static volatile unsigned char rxDiscard = 0;        //drop up to the next '\n'
+static unsigned char rxLines[RX_LINE_COUNT][RX_BUFFER_SIZE];
+static unsigned char rxLineLength[RX_LINE_COUNT];
+
+//compiler barrier - line data in memory before
+//the index that hands it over
+#define USART_BARRIER()     __asm__ __volatile__ ("" ::: "memory")
+
+//tx ring, UDRE interrupt sends
+static volatile unsigned char txHead = 0x00;        //written by senders
+static volatile unsigned char txTail = 0x00;        //written by Usart_txIsr
+static volatile unsigned char txStarted = 0;        //sent since the last flush
+static volatile unsigned int txDropped = 0x00;
+static unsigned char txBuffer[TX_BUFFER_SIZE];
 
 
 
@@ -33,9 +50,14 @@ void Usart_init(unsigned long baud)
 {
 
     rxIndex = 0x00;
-    rxActiveBuffer = 0;
-    memset((char*)rxBuffer0, 0x00, RX_BUFFER_SIZE);
-    memset((char*)rxBuffer1, 0x00, RX_BUFFER_SIZE);
+    rxLineHead = 0x00;
+    rxLineTail = 0x00;
+    rxLinesDropped = 0x00;
+    rxDiscard = 0;
+    txHead = 0x00;
+    txTail = 0x00;
+    txStarted = 0;
+    txDropped = 0x00;
 
 
     //configure the baud rate
@@ -79,7 +101,7 @@ void Usart_init(unsigned long baud)
     //UCSR0B_R - 0xC1 - config interrupts and tx/rx enable
     //bit 7 - RX complete interrupt enable - set high
     //bit 6 - tx complete interrupt - 0
-    //bit 5 - 0
+    //bit 5 - data reg empty interrupt - 0, set while the tx ring has data
     //bit 4 - rx enable - 1
     //bit 3 - tx enable - 1
     //bit 2 - 1 - dont care
@@ -110,54 +132,217 @@ void Usart_init(unsigned long baud)
 //Usart_isr
 //Call this function from ISR(), passing
 //the read data byte as function arg.
-//Uses two buffers and flips between them
-//process command splits into argc, argv
+//Only stores the byte.  A '\n' completes the
+//line and hands it to the main loop, see
+//Usart_processLines.  A line that arrives with
+//the queue full, or doesn't fit the buffer, is
+//discarded up to its '\n' and counted, so the
+//tail of it doesn't run as a command.
+//returns 1 when a line was completed
 //
-void Usart_isr(unsigned char c)
+unsigned char Usart_isr(unsigned char c)
 {
+    unsigned char *line;
+
+    if (rxDiscard || ((unsigned char)(rxLineHead - rxLineTail) >= RX_LINE_COUNT))
+    {
+        rxIndex = 0x00;
+        rxDiscard = (c != '\n');
+
+        if (c == '\n')
+            rxLinesDropped++;
+
+        return 0;
+    }
+
+    line = rxLines[rxLineHead & RX_LINE_MASK];
+
+    if ((c != 0x00) && (c != '\n') && (rxIndex >= (RX_BUFFER_SIZE - 1)))
+    {
+        rxIndex = 0x00;                 //too long
+        rxDiscard = 1;
+        return 0;
+    }
+
     if ((c != 0x00) && (rxIndex < (RX_BUFFER_SIZE - 1)))
+        line[rxIndex++] = c;
+
+    //test char c for \n - ends the line, a '\n'
+    //with no room left isn't stored
+    if (c == '\n')
     {
-        if (!rxActiveBuffer)
-            rxBuffer0[rxIndex] = c;
-        else
-            rxBuffer1[rxIndex] = c;
+        line[rxIndex] = 0x00;
+        rxLineLength[rxLineHead & RX_LINE_MASK] = rxIndex;
+        rxIndex = 0x00;
 
-        rxIndex++;
+        USART_BARRIER();
+        rxLineHead++;
+        return 1;
+    }
 
-        //test char c for \n
-        if (c == '\n')
-        {
-            if (!rxActiveBuffer)
-            {
-                rxBuffer0[rxIndex] = 0x00;    
-                Usart_processCommand((unsigned char*)rxBuffer0, rxIndex);                
-                rxActiveBuffer = 1;
-                rxIndex = 0x00;
-                memset((char*)rxBuffer1, 0x00, RX_BUFFER_SIZE);
-            }
+    return 0;
+}
 
-            else
-            {
-                rxBuffer1[rxIndex] = 0x00;
-                Usart_processCommand((unsigned char*)rxBuffer1, rxIndex);                
-                rxActiveBuffer = 0;
-                rxIndex = 0x00;
-                memset((char*)rxBuffer0, 0x00, RX_BUFFER_SIZE);
-            }
+
+///////////////////////////////////////////
+//Usart_processLines
+//Call from the main loop.  Runs
+//Usart_processCommand on each complete line,
+//oldest first, outside the rx interrupt.
+//returns the number of lines processed.
+//A command that calls it again (from Delay)
+//returns 0, the line is still being run.
+int Usart_processLines(void)
+{
+    static unsigned char running = 0;
+    int count = 0x00;
+    unsigned char slot;
+
+    if (running)
+        return 0;
+
+    running = 1;
+
+    while (rxLineTail != rxLineHead)
+    {
+        USART_BARRIER();
+        slot = rxLineTail & RX_LINE_MASK;
+        Usart_processCommand(rxLines[slot], rxLineLength[slot]);
+
+        USART_BARRIER();
+        rxLineTail++;                   //frees the line for the isr
+        count++;
+    }
+
+    running = 0;
+
+    return count;
+}
+
+
+///////////////////////////////////////
+//Lines dropped, queue full or too long
+unsigned int Usart_getRxDropped(void)
+{
+    return rxLinesDropped;
+}
+
+
+/////////////////////////////////////////////
+//Transmit - bytes go into the tx ring and the
+//data register empty interrupt (UDRE) sends
+//them, see Usart_txIsr.  Senders only wait when
+//the ring is full and USART_TX_POLICY is block.
+//
+//Usart_txPut - one byte into the ring.  Senders
+//in isrs and the main loop share the head, so it
+//is claimed with interrupts off.  Full ring with
+//interrupts off (called from an isr) - the udre
+//interrupt can't run, send a byte by hand.
+//returns 1 if the byte went in, 0 if dropped
+static unsigned char Usart_txPut(unsigned char data, unsigned char block)
+{
+    unsigned char sreg;
+    unsigned char next;
+
+    while (1)
+    {
+        sreg = SREG_R;
+        cli();
+
+        next = (txHead + 1) & TX_BUFFER_MASK;
+        if (next != txTail)
+            break;
+
+        SREG_R = sreg;
+
+        if (!block)
+        {
+            txDropped++;
+            return 0;
         }
+
+        if (!(sreg & 0x80) && (UCSR0A_R & (1u << 5)))
+            Usart_txIsr();
+    }
+
+    txBuffer[txHead] = data;
+    txHead = next;
+    UCSR0B_R |= 1u << 5;                //UDRIE - start sending
+
+    SREG_R = sreg;
+
+    return 1;
+}
+
+
+///////////////////////////////////////
+//Usart_txIsr
+//Call this function from ISR(USART_UDRE_vect)
+//Sends the next byte, turns the interrupt
+//off when the ring is empty.
+void Usart_txIsr(void)
+{
+    if (txTail != txHead)
+    {
+        UCSR0A_R = (UCSR0A_R & 0x03) | (1u << 6);  //clear TXC, keep U2X
+        UDR0_R = txBuffer[txTail];
+        txTail = (txTail + 1) & TX_BUFFER_MASK;
+        txStarted = 1;
+    }
+    else
+        UCSR0B_R &=~ (1u << 5);         //UDRIE off
+}
+
+
+/////////////////////////////////////////
+//Usart_write
+//Non blocking - copies what fits in the
+//tx ring, returns the number of bytes
+//accepted.
+unsigned int Usart_write(const unsigned char *data, unsigned int length)
+{
+    unsigned int i = 0x00;
+
+    while ((i < length) && Usart_txPut(data[i], 0))
+        i++;
+
+    return i;
+}
+
+
+/////////////////////////////////////////
+//Usart_flush
+//Wait until everything in the ring is
+//out of the shift register.
+void Usart_flush(void)
+{
+    while (txHead != txTail)
+    {
+        if (!(SREG_R & 0x80) && (UCSR0A_R & (1u << 5)))
+            Usart_txIsr();
+    }
+
+    if (txStarted)
+    {
+        while(!(UCSR0A_R & (1u << 6))){};   //wait for complete
+        txStarted = 0;
     }
 }
 
 
-/////////////////////////////////////
-//poll the tx ready bit to get an empty
-//tx buffer.
+/////////////////////////////////////////
+//Bytes dropped - ring full, USART_TX_DROP
+//or Usart_write
+unsigned int Usart_getTxDropped(void)
+{
+    return txDropped;
+}
+
 
 void Usart_sendByte(unsigned char data)
 {
-    while(!(UCSR0A_R & (1u << 5))){};   //wait for empty
-    UDR0_R = data;                      //write data
-    while(!(UCSR0A_R & (1u << 6))){};   //wait for complete
+    Usart_txPut(data, USART_TX_POLICY);
 }
 
 
@@ -171,6 +356,14 @@ void Usart_sendString(char *data)
     }
 }
 
+void Usart_sendString_P(const char *data)
+{
+    char c;
+
+    while ((c = pgm_read_byte(data++)) != 0x00)
+        Usart_sendByte((unsigned char)c);
+}
+
 void Usart_sendArray(unsigned char *data, unsigned int length)
 {
     unsigned int i = 0x00;
@@ -194,7 +387,7 @@ void Usart_processCommand(unsigned char *data, unsigned int length)
     int result = 0x00;
     char outBuffer[64];
 
-	memset(argv, 0x00, ARG_BUFFER_SIZE);
+	memset(argv, 0x00, sizeof(argv));
 
     //clean up array by removing \r\n
     for (i = 0 ; i < length ; i++)
@@ -203,11 +396,6 @@ void Usart_processCommand(unsigned char *data, unsigned int length)
             data[i] = 0x00;
     }
 
-    Usart_sendString("Orig Rx String: ");
-    Usart_sendArray(data, length);
-    Usart_sendString("\r\n");
-
-
     //parse data* into argv argc
     Usart_parseArgs((char*)data, &argc, argv);
 
@@ -216,12 +404,12 @@ void Usart_processCommand(unsigned char *data, unsigned int length)
 
     if (result >= 0)
     {
-        i = sprintf(outBuffer, "Success: Elem: %d\r\n", result);
+        i = sprintf_P(outBuffer, PSTR("Success: Elem: %d\r\n"), result);
         Usart_sendArray((unsigned char*)outBuffer, i);    
     }
     else
     {
-        Usart_sendString("Error No Match\r\n");
+        Usart_sendString_P(PSTR("Error No Match\r\n"));
     }
 
 
@@ -231,29 +419,54 @@ void Usart_processCommand(unsigned char *data, unsigned int length)
 
 
 /////////////////////////////////////////
-//parse input buffer into args by replacing
-//all white space with null chars, and 
-//populating array of pointers pointing
-//to each arg.
+//parse input buffer into args in place.
+//Args are split on spaces, tabs and commas,
+//the separators are replaced with null chars
+//and argv points into the buffer, nothing
+//is copied.  "quoted args" keep their spaces,
+//the quotes are removed.  No static state,
+//so it can be called from any context.
 //
 void Usart_parseArgs(char *in, int *pargc, char** argv)
 {
-	int argc = 0;
-	char* ptr;
-
-	//get the first arg - pass input buffer
-	ptr = strtok(in, " ,.-");
-	argv[argc++] = ptr;
-
-	//subsequent args, pass NULL
-	while ((ptr != NULL) && (argc < ARG_BUFFER_SIZE))
-	{
-		ptr = strtok(NULL, " ,.-");
-		if(ptr != NULL)
-			argv[argc++] = ptr;
-	}
-
-	*pargc = argc;
+    int argc = 0;
+    char *src = in;
+    char *dst;
+    char quote;
+
+    while ((*src != 0x00) && (argc < ARG_BUFFER_SIZE))
+    {
+        //skip separators
+        if ((*src == ' ') || (*src == '\t') || (*src == ','))
+        {
+            src++;
+            continue;
+        }
+
+        //arg starts here, copy down over any quotes
+        argv[argc++] = src;
+        dst = src;
+        quote = 0;
+
+        while (*src != 0x00)
+        {
+            if (*src == '"')
+                quote = !quote;
+            else if (!quote && ((*src == ' ') || (*src == '\t') || (*src == ',')))
+                break;
+            else
+                *dst++ = *src;
+
+            src++;
+        }
+
+        if (*src != 0x00)
+            src++;
+
+        *dst = 0x00;
+    }
+
+    *pargc = argc;
 }
 
 
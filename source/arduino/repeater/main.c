@@ -11,6 +11,19 @@ Use existing nrf24l01 tx/rx project and add repeater mode.
 Repeater mode uses two states: RX and TX.  The radio normally
 listens in RX state.  When a new message arrives, it switches
 to TX state, forwards the messages, and returns back to RX state.
+The INT0 isr only queues the packets, they are forwarded from
+the main loop and the Delay loop.
+
+Store and forward (relay.c): duplicates heard from other
+repeaters are dropped, each hop takes one off the packet ttl.
+The Delay loop sleeps until the next interrupt, so a packet
+is forwarded as soon as INT0 wakes the cpu, not on the next
+pass of the main loop.
+
+Mesh routing (mesh.c): "mesh 1" on every repeater, each
+with its own address ("mesh addr <n>"), the gateway is
+address 1.  Sensor packets find their way to the gateway
+over any number of repeaters, no fixed relay.
 
 
 
@@ -33,6 +46,7 @@ INT1 - PD3 - Also config as interrupt, falling, pullup
 ///////////////////////////////////////////////
 
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <avr/io.h>         //macros
 #include <stdio.h>
 #include <string.h>
@@ -42,6 +56,11 @@ INT1 - PD3 - Also config as interrupt, falling, pullup
 #include "nrf24l01.h"
 #include "usart.h"
 #include "eeprom.h"
+#include "relay.h"
+#include "mesh.h"
+#include "transport.h"
+#include "payload.h"
+#include "command.h"
 
 //////////////////////////////////////
 //prototypes
@@ -62,8 +81,8 @@ void Interrupt_init(void);
 //Delay items
 void Delay(unsigned long val);
 volatile unsigned long gTimeTick = 0x00;
+volatile unsigned long gMillis = 0x00;      //free running, rx packet time stamps
 
-uint8_t forwardBuffer[32] = {0x00};
 uint32_t loopCounter = 0x00;
 
 ///////////////////////////////
@@ -74,6 +93,7 @@ uint32_t loopCounter = 0x00;
 ISR(TIMER0_OVF_vect)
 {
     gTimeTick++;        //used by Delay
+    gMillis++;
 
     //clear interrupt - datasheet shows
     //this bit has to be set to run timer
@@ -114,6 +134,26 @@ ISR(USART_RX_vect)
 }
 
 
+//////////////////////////////////////
+//usart data register empty interrupt
+//sends the next byte from the tx ring
+//
+ISR(USART_UDRE_vect)
+{
+    Usart_txIsr();
+}
+
+
+//////////////////////////////////////
+//time stamp for the nrf24 rx ring.
+//Called from the INT0 isr, interrupts
+//are already off.
+uint32_t nrf24_getTimeStamp(void)
+{
+    return gMillis;
+}
+
+
 ///////////////////////////////////////
 int main()
 {
@@ -122,26 +162,19 @@ int main()
     SPI_init();			            //init spi
     SPI_setSpeed(SPI_SPEED_1_MHZ);
     Usart_init(9600);
+    Relay_init();
     nrf24_init(NRF24_MODE_REPEATER);
+    Mesh_init(MESH_ADDRESS);            //MESH_ENABLE - mesh at boot
+    Transport_init(Command_TransferReceived);
+    nrf24_setRxPayLoadSize(PAYLOAD_PIPE, PAYLOAD_FRAME_SIZE);     //batched samples, payload.h
 
     while(1)
     {
         if (!(loopCounter % 10))
             LED_RedToggle();
 
-        //Mode: NRF24_MODE_REPEATER
-        if (nrf24_getMode() == NRF24_MODE_REPEATER)
-        {
-            if (nrf24_getRepeaterFlag() == 1)
-            {
-                LED_BlueOn();                                               //enable led (turned off in the tx function)
-                uint8_t size = nrf24_getRepeaterBuffer(forwardBuffer);      //load the contents
-                nrf24_setState(NRF24_STATE_TX);                             //set to tx state
-                nrf24_transmitData(8, forwardBuffer, size);                 //send the data
-                nrf24_setState(NRF24_STATE_RX);                             //return to rx state
-                nrf24_setRepeaterFlag(0);                                   //clear the flag
-            }
-        }
+        //forward / process anything in the rx ring
+        nrf24_processRxPackets();
       
         loopCounter++;
         Delay(50);
@@ -269,11 +302,29 @@ void Timer0_init(void)
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0, a usart byte
+//or the radio INT0 wakes it.
+//Usart command lines run here, the rx isr
+//only queues them.
 void Delay(unsigned long val)
 {
 	volatile unsigned long t = val;
     gTimeTick = 0x00;           //upcounter
-    while (t > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0, usart and radio INT0 keep running
+    while (t > gTimeTick)
+    {
+        Usart_processLines();           //command lines, outside the rx isr
+        nrf24_processRxPackets();       //radio packets, outside the INT0 isr
+        cli();
+        if (t > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
@@ -0,0 +1,388 @@
+/*
+Mesh simulator - runs on the pc
+Dana Olcott
+
+Runs mesh.c on a number of simulated nodes and
+prints the delivery ratio and latency of sensor
+packets to the gateway.
+
+Each node is its own copy of mesh.c + relay.c,
+loaded as a shared library, so each has its own
+tables.  The simulator supplies the radio driver
+calls they use (nrf24_send, nrf24_setRxPayLoadSize,
+nrf24_processPacket) and models the air:
+
+- 1ms steps, one frame per node per step from a 4
+  deep tx queue (NRF24_TX_QUEUE_SIZE)
+- half duplex, a node sending doesn't hear
+- no carrier sense, two frames heard at once are
+  both lost
+- frames get weaker and are lost more often with
+  distance, RPD set inside half the range
+- 4 deep rx ring per node (NRF24_RX_RING_SIZE)
+
+Nodes sit two per column along a line, the gateway
+(address 1) at one end.  Every other node sends a
+sensor packet every PERIOD_MS after the warm up.  With
+a node number to kill, that node goes quiet half way
+through, the routes around it have to age out.
+
+Build:  gcc -std=gnu99 -O2 -Wall -Wextra -shared -fPIC -I.. -I../../nrf24l01 -I../../relay \
+            -o meshnode.so ../mesh.c ../../relay/relay.c
+        gcc -std=gnu99 -O2 -Wall -Wextra -rdynamic -I.. -I../../nrf24l01 -I../../relay \
+            -o meshsim meshsim.c -ldl -lm
+Run:    ./meshsim [nodes] [seconds] [seed] [kill]
+
+nodes 12, seconds 600, seed 1, no kill by default.
+The seed is made odd, 2 and 3 are the same run.
+The node layout comes from the seed too, results
+move a few % between seeds:
+
+./meshsim                   12 nodes            93.6%  26.3ms avg
+./meshsim 20 600 1          20 nodes            81.8%  43.6ms avg
+./meshsim 20 600 3          20 nodes            89.4%  37.0ms avg
+./meshsim 20 600 3 8        20 nodes, 8 killed  88.0%  39.9ms avg
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "mesh.h"
+
+#define MAX_NODES           32
+#define RANGE               10.0            //decode range
+#define SPACING             7.0             //between columns
+#define WARMUP_MS           10000           //hellos, before any data
+#define PERIOD_MS           5000            //sensor packet, each node
+#define TX_QUEUE            4
+#define RX_RING             4
+#define MAX_PACKETS         65536
+
+
+typedef struct
+{
+    void *lib;
+    void (*init)(uint8_t);
+    void (*enable)(uint8_t);
+    void (*packet)(const NRF24_RxPacket*);
+    int (*send)(uint8_t, const uint8_t*);
+    void (*service)(uint32_t);
+    uint8_t (*metric)(void);
+    void (*stats)(MeshStats*);
+
+    double x, y;
+    uint8_t alive;
+    uint32_t nextSensor;
+
+    uint8_t txFrames[TX_QUEUE][NRF24_PIPE_WIDTH_MAX];
+    uint8_t txLength[TX_QUEUE];
+    uint8_t txPipe[TX_QUEUE];
+    int txCount;
+
+    NRF24_RxPacket rx[RX_RING];
+    int rxCount;
+}SimNode;
+
+
+static SimNode mNodes[MAX_NODES];
+static int mNumNodes = 12;
+static int mCurrent = 0;                    //node running now
+static uint32_t mNow = 0;
+static uint32_t mRandom = 1;
+static uint8_t mPipeWidth[MAX_NODES][6];
+
+static uint32_t mSentTime[MAX_PACKETS];
+static uint8_t mDelivered[MAX_PACKETS];
+static uint16_t mNextId = 0;
+static uint32_t mSent = 0, mArrived = 0, mLost = 0;
+static uint64_t mLatencySum = 0;
+static uint32_t mLatencyMax = 0;
+
+
+static uint32_t sim_random(void)
+{
+    mRandom ^= mRandom << 13;
+    mRandom ^= mRandom >> 17;
+    mRandom ^= mRandom << 5;
+    return mRandom;
+}
+
+static double sim_uniform(void)
+{
+    return (sim_random() & 0xFFFFFF) / (double)0x1000000;
+}
+
+
+//////////////////////////////////////////
+//Radio driver calls, from the node that
+//is running (mCurrent)
+int nrf24_send(uint8_t pipe, const uint8_t* buffer, uint8_t length)
+{
+    SimNode *node = &mNodes[mCurrent];
+    uint8_t width = (pipe <= 5) ? mPipeWidth[mCurrent][pipe] : NRF24_PIPE_WIDTH;
+
+    if ((length > width) || (node->txCount >= TX_QUEUE))
+        return -1;
+
+    memset(node->txFrames[node->txCount], 0x00, NRF24_PIPE_WIDTH_MAX);
+    memcpy(node->txFrames[node->txCount], buffer, length);
+    node->txLength[node->txCount] = width;
+    node->txPipe[node->txCount] = pipe;
+    node->txCount++;
+
+    return 0;
+}
+
+void nrf24_setRxPayLoadSize(uint8_t pipe, uint8_t numBytes)
+{
+    if (pipe <= 5)
+        mPipeWidth[mCurrent][pipe] = numBytes;
+}
+
+//gateway - a sensor packet made it
+void nrf24_processPacket(uint8_t pipe, uint8_t* buffer, uint8_t size)
+{
+    uint16_t id = buffer[3] | (buffer[4] << 8);
+    uint32_t latency;
+
+    (void)pipe;
+    (void)size;
+
+    if (mDelivered[id])
+        return;
+
+    mDelivered[id] = 1;
+    mArrived++;
+
+    latency = mNow - mSentTime[id];
+    mLatencySum += latency;
+
+    if (latency > mLatencyMax)
+        mLatencyMax = latency;
+}
+
+
+static void sim_load(int index, const char *path)
+{
+    SimNode *node = &mNodes[index];
+    char copy[64];
+    char command[192];
+
+    //dlopen returns the same library for the same
+    //file, each node gets its own copy
+    snprintf(copy, sizeof(copy), "/tmp/meshsim_%d_%d.so", (int)getpid(), index);
+    snprintf(command, sizeof(command), "cp %s %s", path, copy);
+
+    if (system(command) != 0)
+        exit(1);
+
+    node->lib = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+    remove(copy);
+
+    if (!node->lib)
+    {
+        printf("%s\n", dlerror());
+        exit(1);
+    }
+
+    node->init = (void (*)(uint8_t))dlsym(node->lib, "Mesh_init");
+    node->enable = (void (*)(uint8_t))dlsym(node->lib, "Mesh_enable");
+    node->packet = (void (*)(const NRF24_RxPacket*))dlsym(node->lib, "Mesh_packet");
+    node->send = (int (*)(uint8_t, const uint8_t*))dlsym(node->lib, "Mesh_send");
+    node->service = (void (*)(uint32_t))dlsym(node->lib, "Mesh_service");
+    node->metric = (uint8_t (*)(void))dlsym(node->lib, "Mesh_getMetric");
+    node->stats = (void (*)(MeshStats*))dlsym(node->lib, "Mesh_getStats");
+}
+
+
+//////////////////////////////////////////
+//One ms on the air
+static void sim_air(void)
+{
+    int sending[MAX_NODES];
+    int i, j, k, heard, from;
+    double d;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+        sending[i] = mNodes[i].alive && (mNodes[i].txCount > 0);
+
+    for (j = 0 ; j < mNumNodes ; j++)
+    {
+        if (!mNodes[j].alive || sending[j])
+            continue;
+
+        heard = 0;
+        from = -1;
+
+        //anything in 1.5 x range is loud enough to collide
+        for (i = 0 ; i < mNumNodes ; i++)
+        {
+            if (sending[i] && (hypot(mNodes[i].x - mNodes[j].x, mNodes[i].y - mNodes[j].y) < (RANGE * 1.5)))
+            {
+                heard++;
+                from = i;
+            }
+        }
+
+        if (heard != 1)
+            continue;
+
+        d = hypot(mNodes[from].x - mNodes[j].x, mNodes[from].y - mNodes[j].y) / RANGE;
+
+        //lost more often toward the edge of the range
+        if ((d >= 1.0) || (sim_uniform() < (d * d * d * d * 0.5)))
+            continue;
+
+        //pipe width mismatch, the radio drops it
+        k = mNodes[from].txPipe[0];
+
+        if ((mNodes[j].rxCount >= RX_RING) || (mNodes[from].txLength[0] != mPipeWidth[j][k]))
+            continue;
+
+        NRF24_RxPacket *rx = &mNodes[j].rx[mNodes[j].rxCount++];
+        memset(rx, 0x00, sizeof(NRF24_RxPacket));
+        rx->pipe = k;
+        rx->length = mNodes[from].txLength[0];
+        rx->rpd = (d < 0.5) ? 1 : 0;
+        rx->timestamp = mNow;
+        memcpy(rx->data, mNodes[from].txFrames[0], rx->length);
+    }
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        if (!sending[i])
+            continue;
+
+        SimNode *node = &mNodes[i];
+        memmove(node->txFrames[0], node->txFrames[1], sizeof(node->txFrames[0]) * (TX_QUEUE - 1));
+        memmove(node->txLength, node->txLength + 1, TX_QUEUE - 1);
+        memmove(node->txPipe, node->txPipe + 1, TX_QUEUE - 1);
+        node->txCount--;
+    }
+}
+
+
+//////////////////////////////////////////
+//Main loop of each node, then its sensor
+static void sim_nodes(uint32_t stop)
+{
+    uint8_t packet[NRF24_PIPE_WIDTH];
+    int i, k;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        SimNode *node = &mNodes[i];
+
+        if (!node->alive)
+            continue;
+
+        mCurrent = i;
+
+        for (k = 0 ; k < node->rxCount ; k++)
+            node->packet(&node->rx[k]);
+
+        node->rxCount = 0;
+        node->service(mNow);
+
+        if ((i > 0) && (mNow >= WARMUP_MS) && (mNow < stop) && (mNow >= node->nextSensor))
+        {
+            node->nextSensor = mNow + PERIOD_MS;
+
+            packet[0] = 0xFE;
+            packet[1] = i + 1;                  //station
+            packet[2] = MID_TEMP_MCP9700A;
+            packet[3] = mNextId & 0xFF;
+            packet[4] = mNextId >> 8;
+            packet[5] = sim_random() & 0xFF;
+            packet[6] = sim_random() & 0xFF;
+            packet[7] = 0xFE;
+
+            mSentTime[mNextId] = mNow;
+            mDelivered[mNextId] = 0;
+            mNextId++;
+            mSent++;
+
+            if (node->send(MESH_ADDR_GATEWAY, packet) < 0)
+                mLost++;
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = 600;
+    int kill = -1;
+    int i;
+    MeshStats stats, total;
+
+    if (argc > 1)   mNumNodes = atoi(argv[1]);
+    if (argc > 2)   seconds = atoi(argv[2]);
+    if (argc > 3)   mRandom = atoi(argv[3]) | 1;
+    if (argc > 4)   kill = atoi(argv[4]);
+
+    if ((mNumNodes < 2) || (mNumNodes > MAX_NODES))
+        mNumNodes = 12;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        sim_load(i, "./meshnode.so");
+
+        mNodes[i].x = (i / 2) * SPACING + (sim_uniform() - 0.5) * 2.0;
+        mNodes[i].y = (i % 2) * (RANGE * 0.4) + (sim_uniform() - 0.5) * 2.0;
+        mNodes[i].alive = 1;
+        mNodes[i].nextSensor = WARMUP_MS + (sim_random() % PERIOD_MS);
+
+        memset(mPipeWidth[i], NRF24_PIPE_WIDTH, 6);
+        mCurrent = i;
+        mNodes[i].init(MESH_ADDR_GATEWAY + i);
+        mNodes[i].enable(1);
+    }
+
+    for (mNow = 1 ; mNow < (seconds * 1000) ; mNow++)
+    {
+        if ((kill > 0) && (kill < mNumNodes) && (mNow == (seconds * 1000) / 2))
+        {
+            mNodes[kill].alive = 0;
+            printf("node %d off at %lus\n", kill + 1, (unsigned long)(mNow / 1000));
+        }
+
+        sim_air();
+        sim_nodes((seconds * 1000) - PERIOD_MS);        //last packets have time to arrive
+    }
+
+    memset(&total, 0x00, sizeof(total));
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        mCurrent = i;
+        mNodes[i].stats(&stats);
+
+        printf("node %2d  x %5.1f  metric %3u  tx %6lu  fwd %5u  retry %4u  linkfail %3u  noroute %3u  rreq %3u\n",
+            i + 1, mNodes[i].x, mNodes[i].metric(), (unsigned long)stats.tx,
+            stats.forwarded, stats.retries, stats.linkFail, stats.noRoute, stats.discoveries);
+
+        total.forwarded += stats.forwarded;
+        total.retries += stats.retries;
+        total.linkFail += stats.linkFail;
+        total.noRoute += stats.noRoute;
+        total.expired += stats.expired;
+    }
+
+    printf("nodes %d  sent %lu  delivered %lu  ratio %.1f%%  latency avg %.1fms max %lums\n",
+        mNumNodes, (unsigned long)mSent, (unsigned long)mArrived,
+        mSent ? (100.0 * mArrived / mSent) : 0.0,
+        mArrived ? ((double)mLatencySum / mArrived) : 0.0,
+        (unsigned long)mLatencyMax);
+
+    printf("forwarded %u  retries %u  link fail %u  no route %u  ttl %u  queue full %lu\n",
+        total.forwarded, total.retries, total.linkFail, total.noRoute, total.expired, (unsigned long)mLost);
+
+    return 0;
+}
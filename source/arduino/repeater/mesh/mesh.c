@@ -0,0 +1,844 @@
+/*
+Mesh - multi hop routing between repeaters
+Dana Olcott
+
+See mesh.h.  Main loop only.  Mesh_packet is called
+from nrf24_processRxPackets for each mesh frame,
+Mesh_service for the timers and to move frames to
+the radio tx queue.  Nothing here waits on the radio.
+
+No avr headers, the time comes in with the packets
+and Mesh_service, so the same file runs in the pc
+simulator.
+
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mesh.h"
+#include "nrf24l01.h"
+#include "relay.h"          //crc8
+
+
+//frames heard, key type / address / seq.  Type 0
+//is a delivered sensor packet, address = station
+typedef struct
+{
+    uint8_t type;
+    uint8_t address;
+    uint8_t seq;
+    uint32_t timestamp;
+}MeshCacheEntry;
+
+//packet waiting for a route
+typedef struct
+{
+    uint8_t used;
+    MeshFrame frame;
+    uint32_t start;
+    uint32_t rreq;                              //last rreq sent
+}MeshPending;
+
+//frame waiting for the radio, or for its
+//hop ack
+typedef struct
+{
+    uint8_t used;
+    uint8_t tries;                              //sends left
+    MeshFrame frame;
+    uint32_t due;
+}MeshOut;
+
+
+static uint8_t mMeshEnabled = 0;
+static uint8_t mMeshAddress = MESH_ADDRESS;
+static uint8_t mMeshSeq = 0x00;
+static uint32_t mMeshNow = 0x00;                //ms, last packet / service
+static uint32_t mMeshHelloDue = 0x00;
+
+static MeshNeighbour mMeshNeighbours[MESH_NEIGHBOUR_SIZE];
+static MeshRoute mMeshRoutes[MESH_ROUTE_SIZE];
+static MeshCacheEntry mMeshCache[MESH_CACHE_SIZE];
+static uint8_t mMeshCacheNext = 0x00;
+static MeshPending mMeshPending[MESH_PENDING_SIZE];
+static MeshOut mMeshOut[MESH_OUT_SIZE];
+
+static MeshStats mMeshStats;
+
+
+static uint8_t Mesh_updateNeighbour(uint8_t address, uint8_t rpd);
+static void Mesh_removeNeighbour(MeshNeighbour *neighbour);
+static void Mesh_removeRoutes(uint8_t next);
+static void Mesh_ack(const MeshFrame *frame);
+static uint8_t Mesh_needsAck(const MeshFrame *frame);
+static MeshRoute* Mesh_findRoute(uint8_t dst);
+static void Mesh_updateRoute(uint8_t dst, uint8_t next, uint8_t metric);
+static uint8_t Mesh_seen(uint8_t type, uint8_t address, uint8_t seq);
+static uint8_t Mesh_addCost(uint8_t metric, uint8_t cost);
+static int Mesh_queue(MeshFrame *frame, uint8_t delay);
+static int Mesh_route(MeshFrame *frame);
+static void Mesh_discover(uint8_t dst);
+static void Mesh_deliver(const MeshFrame *frame);
+static void Mesh_hello(void);
+static void Mesh_flushPending(void);
+static uint8_t Mesh_jitter(void);
+
+
+/////////////////////////////////////////////
+//Clear the tables.  Call after nrf24_init,
+//Mesh_enable sets the pipe 5 width.
+void Mesh_init(uint8_t address)
+{
+    mMeshEnabled = 0;
+    mMeshAddress = address;
+    mMeshSeq = 0x00;
+    mMeshCacheNext = 0x00;
+
+    memset(mMeshNeighbours, 0x00, sizeof(mMeshNeighbours));
+    memset(mMeshRoutes, 0x00, sizeof(mMeshRoutes));
+    memset(mMeshCache, 0x00, sizeof(mMeshCache));
+    memset(mMeshPending, 0x00, sizeof(mMeshPending));
+    memset(mMeshOut, 0x00, sizeof(mMeshOut));
+    memset(&mMeshStats, 0x00, sizeof(mMeshStats));
+
+    Mesh_enable(MESH_ENABLE);
+}
+
+
+/////////////////////////////////////////////
+//Mesh on / off.  Pipe 5 is 16 bytes wide for
+//mesh frames, 8 for sensor packets when off.
+//The first hello goes out on the next service.
+void Mesh_enable(uint8_t enable)
+{
+    mMeshEnabled = enable ? 1 : 0;
+    mMeshHelloDue = mMeshNow;
+
+    nrf24_setRxPayLoadSize(MESH_PIPE, mMeshEnabled ? MESH_FRAME_SIZE : NRF24_PIPE_WIDTH);
+}
+
+
+uint8_t Mesh_isEnabled(void)
+{
+    return mMeshEnabled;
+}
+
+
+uint8_t Mesh_getAddress(void)
+{
+    return mMeshAddress;
+}
+
+
+///////////////////////////////////////////////////
+//One frame from the rx ring, pipe 5.  Every frame
+//updates the neighbour table, the rest depends on
+//the type and if this node is the next hop.
+void Mesh_packet(const NRF24_RxPacket *packet)
+{
+    MeshFrame frame;
+    uint8_t cost;
+    uint8_t i;
+
+    if (!mMeshEnabled)
+        return;
+
+    mMeshNow = packet->timestamp;
+
+    if (packet->length != MESH_FRAME_SIZE)
+    {
+        mMeshStats.bad++;
+        return;
+    }
+
+    memcpy(&frame, packet->data, MESH_FRAME_SIZE);
+
+    if ((Relay_crc8((uint8_t*)&frame, MESH_FRAME_SIZE - 1) != frame.crc) ||
+        (frame.type < MESH_TYPE_HELLO) || (frame.type > MESH_TYPE_ACK) ||
+        (frame.prev == MESH_ADDR_NONE) || (frame.prev == MESH_ADDR_BROADCAST) ||
+        (frame.prev == mMeshAddress))
+    {
+        mMeshStats.bad++;
+        return;
+    }
+
+    mMeshStats.rx++;
+
+    cost = Mesh_updateNeighbour(frame.prev, packet->rpd);
+    Mesh_updateRoute(frame.prev, frame.prev, cost);
+
+    switch(frame.type)
+    {
+        //neighbour's metric to the gateway.  Ignore it
+        //if the neighbour goes through this node, or
+        //two nodes would point at each other.
+        case MESH_TYPE_HELLO:
+        {
+            if ((frame.metric > MESH_METRIC_MAX) || (frame.next == mMeshAddress))
+                Mesh_updateRoute(MESH_ADDR_GATEWAY, frame.prev, MESH_METRIC_NONE);
+            else
+                Mesh_updateRoute(MESH_ADDR_GATEWAY, frame.prev, Mesh_addCost(frame.metric, cost));
+
+            break;
+        }
+
+        //flooded - learn the way back to src, answer
+        //if it's for this node, pass it on once
+        case MESH_TYPE_RREQ:
+        {
+            frame.metric = Mesh_addCost(frame.metric, cost);
+            Mesh_updateRoute(frame.src, frame.prev, frame.metric);
+
+            if ((frame.src == mMeshAddress) || Mesh_seen(MESH_TYPE_RREQ, frame.src, frame.seq))
+            {
+                mMeshStats.duplicates++;
+                break;
+            }
+
+            if (frame.dst == mMeshAddress)
+            {
+                frame.type = MESH_TYPE_RREP;
+                frame.ttl = MESH_TTL;
+                frame.dst = frame.src;
+                frame.src = mMeshAddress;
+                frame.seq = mMeshSeq++;
+                frame.metric = 0x00;
+                frame.hops = 0x00;
+                Mesh_route(&frame);
+            }
+            else if (frame.ttl <= 1)
+                mMeshStats.expired++;
+            else
+            {
+                frame.ttl--;
+                frame.hops++;
+                frame.prev = mMeshAddress;
+                frame.next = MESH_ADDR_BROADCAST;
+                Mesh_queue(&frame, Mesh_jitter());
+            }
+
+            break;
+        }
+
+        //unicast, back along the reverse path.  Each
+        //hop learns the way to the node that answered.
+        case MESH_TYPE_RREP:
+        case MESH_TYPE_DATA:
+        {
+            if (frame.next != mMeshAddress)
+                break;
+
+            //ack copies too, the last ack may be lost
+            Mesh_ack(&frame);
+
+            frame.metric = Mesh_addCost(frame.metric, cost);
+            Mesh_updateRoute(frame.src, frame.prev, frame.metric);
+
+            if (frame.type == MESH_TYPE_RREP)
+            {
+                if (frame.dst == mMeshAddress)
+                {
+                    Mesh_flushPending();
+                    break;
+                }
+            }
+            else
+            {
+                if (Mesh_seen(MESH_TYPE_DATA, frame.src, frame.seq))
+                {
+                    mMeshStats.duplicates++;
+                    break;
+                }
+
+                if (frame.dst == mMeshAddress)
+                {
+                    Mesh_deliver(&frame);
+                    break;
+                }
+            }
+
+            if (frame.ttl <= 1)
+            {
+                mMeshStats.expired++;
+                break;
+            }
+
+            frame.ttl--;
+            frame.hops++;
+
+            if (Mesh_route(&frame) < 0)
+                mMeshStats.noRoute++;
+            else
+                mMeshStats.forwarded++;
+
+            break;
+        }
+
+        //next hop has it, stop repeating
+        case MESH_TYPE_ACK:
+        {
+            if (frame.next != mMeshAddress)
+                break;
+
+            for (i = 0 ; i < MESH_OUT_SIZE ; i++)
+            {
+                if (mMeshOut[i].used && Mesh_needsAck(&mMeshOut[i].frame) &&
+                    (mMeshOut[i].tries <= MESH_RETRIES) &&
+                    (mMeshOut[i].frame.next == frame.prev) &&
+                    (mMeshOut[i].frame.src == frame.data[0]) &&
+                    (mMeshOut[i].frame.type == frame.data[1]) &&
+                    (mMeshOut[i].frame.seq == frame.seq))
+                {
+                    mMeshOut[i].used = 0;
+                }
+            }
+
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+/////////////////////////////////////////////////////
+//Route an 8 byte sensor packet to dst.  Returns 0
+//if it's on the way or waiting for a route, -1 if
+//there is no room.  The sequence number is crc8 of
+//bytes 1 - 6, same as the relay.
+int Mesh_send(uint8_t dst, const uint8_t *packet)
+{
+    MeshFrame frame;
+    uint8_t i;
+
+    if (!mMeshEnabled)
+        return -1;
+
+    frame.type = MESH_TYPE_DATA;
+    frame.ttl = MESH_TTL;
+    frame.src = mMeshAddress;
+    frame.dst = dst;
+    frame.seq = Relay_crc8(&packet[1], MESH_DATA_SIZE);
+    frame.metric = 0x00;
+    frame.hops = 0x00;
+    memcpy(frame.data, &packet[1], MESH_DATA_SIZE);
+
+    //heard from a sensor next to the gateway
+    if (dst == mMeshAddress)
+    {
+        Mesh_deliver(&frame);
+        return 0;
+    }
+
+    //copies coming back to this node
+    Mesh_seen(MESH_TYPE_DATA, frame.src, frame.seq);
+
+    if (Mesh_route(&frame) == 0)
+        return 0;
+
+    for (i = 0 ; i < MESH_PENDING_SIZE ; i++)
+    {
+        if (!mMeshPending[i].used)
+        {
+            mMeshPending[i].used = 1;
+            mMeshPending[i].frame = frame;
+            mMeshPending[i].start = mMeshNow;
+            mMeshPending[i].rreq = mMeshNow;
+
+            Mesh_discover(dst);
+            return 0;
+        }
+    }
+
+    mMeshStats.noRoute++;
+    return -1;
+}
+
+
+/////////////////////////////////////////////////////
+//Timers and the radio.  Call from the main loop and
+//the Delay loop, now in ms.  Ages the tables, sends
+//the hello, retries discovery and moves frames that
+//are due into the radio tx queue.  Frames waiting
+//for a hop ack are sent again when it doesn't come.
+void Mesh_service(uint32_t now)
+{
+    uint8_t i;
+
+    if (!mMeshEnabled)
+        return;
+
+    mMeshNow = now;
+
+    for (i = 0 ; i < MESH_NEIGHBOUR_SIZE ; i++)
+    {
+        if ((mMeshNeighbours[i].address != MESH_ADDR_NONE) &&
+            ((now - mMeshNeighbours[i].heard) > MESH_NEIGHBOUR_MS))
+        {
+            Mesh_removeNeighbour(&mMeshNeighbours[i]);
+        }
+    }
+
+    for (i = 0 ; i < MESH_ROUTE_SIZE ; i++)
+    {
+        if ((mMeshRoutes[i].dst != MESH_ADDR_NONE) &&
+            ((now - mMeshRoutes[i].updated) > MESH_ROUTE_MS))
+        {
+            mMeshRoutes[i].dst = MESH_ADDR_NONE;
+        }
+    }
+
+    if ((int32_t)(now - mMeshHelloDue) >= 0)
+    {
+        Mesh_hello();
+        mMeshHelloDue = now + MESH_HELLO_MS - (MESH_HELLO_MS / 8) + (Mesh_jitter() * (MESH_HELLO_MS / 4) / MESH_JITTER_MS);
+    }
+
+    Mesh_flushPending();
+
+    for (i = 0 ; i < MESH_OUT_SIZE ; i++)
+    {
+        MeshOut *out = &mMeshOut[i];
+
+        if (!out->used || ((int32_t)(now - out->due) < 0))
+            continue;
+
+        //no ack after the last repeat, link is down
+        if (out->tries == 0)
+        {
+            out->used = 0;
+            mMeshStats.linkFail++;
+            Mesh_removeRoutes(out->frame.next);
+            continue;
+        }
+
+        if (nrf24_send(MESH_PIPE, (uint8_t*)&out->frame, MESH_FRAME_SIZE) < 0)
+            break;
+
+        mMeshStats.tx++;
+
+        if (!Mesh_needsAck(&out->frame))
+            out->used = 0;
+        else
+        {
+            if (out->tries <= MESH_RETRIES)
+                mMeshStats.retries++;
+
+            out->tries--;
+            out->due = now + MESH_ACK_MS + Mesh_jitter();
+        }
+    }
+}
+
+
+/////////////////////////////////////////
+//Metric to the gateway, MESH_METRIC_NONE
+//if there is no route
+uint8_t Mesh_getMetric(void)
+{
+    MeshRoute *route;
+
+    if (mMeshAddress == MESH_ADDR_GATEWAY)
+        return 0x00;
+
+    route = Mesh_findRoute(MESH_ADDR_GATEWAY);
+
+    return route ? route->metric : MESH_METRIC_NONE;
+}
+
+
+/////////////////////////////////////////
+//Table entries for the cli.  0 if the
+//slot is in use, -1 if not.
+int Mesh_getNeighbour(uint8_t index, MeshNeighbour *neighbour)
+{
+    if ((index >= MESH_NEIGHBOUR_SIZE) || (mMeshNeighbours[index].address == MESH_ADDR_NONE))
+        return -1;
+
+    memcpy(neighbour, &mMeshNeighbours[index], sizeof(MeshNeighbour));
+    return 0;
+}
+
+
+int Mesh_getRoute(uint8_t index, MeshRoute *route)
+{
+    if ((index >= MESH_ROUTE_SIZE) || (mMeshRoutes[index].dst == MESH_ADDR_NONE))
+        return -1;
+
+    memcpy(route, &mMeshRoutes[index], sizeof(MeshRoute));
+    return 0;
+}
+
+
+void Mesh_getStats(MeshStats *stats)
+{
+    memcpy(stats, &mMeshStats, sizeof(MeshStats));
+}
+
+
+///////////////////////////////////////////////////
+//Heard a frame from address.  Quality is a running
+//average of the rpd bit, 1/4 new sample.  A new
+//neighbour takes a free slot or the one heard least
+//recently.  Returns the link cost, 1 - 4.
+static uint8_t Mesh_updateNeighbour(uint8_t address, uint8_t rpd)
+{
+    MeshNeighbour *neighbour = NULL;
+    MeshNeighbour *oldest = &mMeshNeighbours[0];
+    uint8_t sample = rpd ? 255 : 0;
+    uint8_t i;
+
+    for (i = 0 ; i < MESH_NEIGHBOUR_SIZE ; i++)
+    {
+        if (mMeshNeighbours[i].address == address)
+        {
+            neighbour = &mMeshNeighbours[i];
+            break;
+        }
+
+        if ((mMeshNeighbours[i].address == MESH_ADDR_NONE) ||
+            ((oldest->address != MESH_ADDR_NONE) && ((int32_t)(mMeshNeighbours[i].heard - oldest->heard) < 0)))
+        {
+            oldest = &mMeshNeighbours[i];
+        }
+    }
+
+    if (neighbour)
+        neighbour->quality = (uint8_t)(((uint16_t)neighbour->quality * 3 + sample) / 4);
+    else
+    {
+        if (oldest->address != MESH_ADDR_NONE)
+            Mesh_removeNeighbour(oldest);
+
+        neighbour = oldest;
+        neighbour->address = address;
+        neighbour->quality = rpd ? 255 : 128;
+    }
+
+    neighbour->heard = mMeshNow;
+
+    return 1 + ((255 - neighbour->quality) >> 6);
+}
+
+
+//////////////////////////////////////////
+//Neighbour gone, and every route through it
+static void Mesh_removeNeighbour(MeshNeighbour *neighbour)
+{
+    Mesh_removeRoutes(neighbour->address);
+    neighbour->address = MESH_ADDR_NONE;
+}
+
+
+static void Mesh_removeRoutes(uint8_t next)
+{
+    uint8_t i;
+
+    for (i = 0 ; i < MESH_ROUTE_SIZE ; i++)
+    {
+        if (mMeshRoutes[i].next == next)
+            mMeshRoutes[i].dst = MESH_ADDR_NONE;
+    }
+}
+
+
+/////////////////////////////////////////////////
+//Hop ack for a rrep / data frame, to the node
+//that sent it
+static void Mesh_ack(const MeshFrame *frame)
+{
+    MeshFrame ack;
+
+    memset(&ack, 0x00, sizeof(ack));
+    ack.type = MESH_TYPE_ACK;
+    ack.ttl = 1;
+    ack.src = mMeshAddress;
+    ack.dst = frame->prev;
+    ack.prev = mMeshAddress;
+    ack.next = frame->prev;
+    ack.seq = frame->seq;
+    ack.data[0] = frame->src;
+    ack.data[1] = frame->type;
+
+    Mesh_queue(&ack, 0);
+}
+
+
+//unicast rrep / data.  Hello has a next hop
+//too, but it's a broadcast
+static uint8_t Mesh_needsAck(const MeshFrame *frame)
+{
+    return ((frame->type == MESH_TYPE_RREP) || (frame->type == MESH_TYPE_DATA)) ? 1 : 0;
+}
+
+
+static MeshRoute* Mesh_findRoute(uint8_t dst)
+{
+    uint8_t i;
+
+    for (i = 0 ; i < MESH_ROUTE_SIZE ; i++)
+    {
+        if (mMeshRoutes[i].dst == dst)
+            return &mMeshRoutes[i];
+    }
+
+    return NULL;
+}
+
+
+///////////////////////////////////////////////////
+//Route to dst through next, metric.  Same next
+//hop - take the new metric, it's the current
+//one, and drop the route if it's gone.  Other
+//next hop - only if it's better.  New routes take
+//a free slot or the oldest, never the one to the
+//gateway.
+static void Mesh_updateRoute(uint8_t dst, uint8_t next, uint8_t metric)
+{
+    MeshRoute *route;
+    uint8_t i;
+
+    if ((dst == mMeshAddress) || (dst == MESH_ADDR_NONE) || (dst == MESH_ADDR_BROADCAST))
+        return;
+
+    route = Mesh_findRoute(dst);
+
+    if (route)
+    {
+        if (route->next == next)
+        {
+            if (metric > MESH_METRIC_MAX)
+            {
+                route->dst = MESH_ADDR_NONE;
+                return;
+            }
+        }
+        else if (metric >= route->metric)
+            return;
+    }
+    else
+    {
+        if (metric > MESH_METRIC_MAX)
+            return;
+
+        route = NULL;
+
+        for (i = 0 ; i < MESH_ROUTE_SIZE ; i++)
+        {
+            if (mMeshRoutes[i].dst == MESH_ADDR_NONE)
+            {
+                route = &mMeshRoutes[i];
+                break;
+            }
+
+            if ((mMeshRoutes[i].dst != MESH_ADDR_GATEWAY) &&
+                (!route || ((int32_t)(mMeshRoutes[i].updated - route->updated) < 0)))
+            {
+                route = &mMeshRoutes[i];
+            }
+        }
+
+        route->dst = dst;
+    }
+
+    route->next = next;
+    route->metric = metric;
+    route->updated = mMeshNow;
+}
+
+
+/////////////////////////////////////////////////
+//Seen this type / address / seq inside the
+//window?  If not, remember it in place of the
+//oldest.
+static uint8_t Mesh_seen(uint8_t type, uint8_t address, uint8_t seq)
+{
+    MeshCacheEntry *entry;
+    uint8_t i;
+
+    for (i = 0 ; i < MESH_CACHE_SIZE ; i++)
+    {
+        entry = &mMeshCache[i];
+
+        if ((entry->timestamp != 0) && (entry->type == type) &&
+            (entry->address == address) && (entry->seq == seq) &&
+            ((mMeshNow - entry->timestamp) < MESH_CACHE_MS))
+        {
+            return 1;
+        }
+    }
+
+    entry = &mMeshCache[mMeshCacheNext];
+    entry->type = type;
+    entry->address = address;
+    entry->seq = seq;
+    entry->timestamp = mMeshNow ? mMeshNow : 1;
+    mMeshCacheNext = (mMeshCacheNext + 1) % MESH_CACHE_SIZE;
+
+    return 0;
+}
+
+
+static uint8_t Mesh_addCost(uint8_t metric, uint8_t cost)
+{
+    if (metric >= (MESH_METRIC_NONE - cost))
+        return MESH_METRIC_NONE;
+
+    return metric + cost;
+}
+
+
+/////////////////////////////////////////////////
+//Frame to the radio in delay ms, crc added here.
+//Returns -1 if the out queue is full.
+static int Mesh_queue(MeshFrame *frame, uint8_t delay)
+{
+    uint8_t i;
+
+    frame->crc = Relay_crc8((uint8_t*)frame, MESH_FRAME_SIZE - 1);
+
+    for (i = 0 ; i < MESH_OUT_SIZE ; i++)
+    {
+        if (!mMeshOut[i].used)
+        {
+            mMeshOut[i].used = 1;
+            mMeshOut[i].tries = Mesh_needsAck(frame) ? (MESH_RETRIES + 1) : 1;
+            mMeshOut[i].frame = *frame;
+            mMeshOut[i].due = mMeshNow + delay;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+
+/////////////////////////////////////////////////
+//Unicast frame to the next hop toward its dst.
+//-1 if there is no route (or no room).
+static int Mesh_route(MeshFrame *frame)
+{
+    MeshRoute *route = Mesh_findRoute(frame->dst);
+
+    if (!route)
+        return -1;
+
+    frame->prev = mMeshAddress;
+    frame->next = route->next;
+
+    return Mesh_queue(frame, 0);
+}
+
+
+static void Mesh_discover(uint8_t dst)
+{
+    MeshFrame frame;
+
+    memset(&frame, 0x00, sizeof(frame));
+    frame.type = MESH_TYPE_RREQ;
+    frame.ttl = MESH_TTL;
+    frame.src = mMeshAddress;
+    frame.dst = dst;
+    frame.prev = mMeshAddress;
+    frame.next = MESH_ADDR_BROADCAST;
+    frame.seq = mMeshSeq++;
+
+    Mesh_seen(MESH_TYPE_RREQ, frame.src, frame.seq);
+
+    if (Mesh_queue(&frame, 0) == 0)
+        mMeshStats.discoveries++;
+}
+
+
+/////////////////////////////////////////////////
+//Sensor packet at the gateway.  Put the 0xFE
+//bytes back on and run the packet table.  One
+//sensor packet picked up by a few routers shows
+//up once.
+static void Mesh_deliver(const MeshFrame *frame)
+{
+    uint8_t packet[NRF24_PIPE_WIDTH];
+
+    if (Mesh_seen(0, frame->data[0], frame->seq))
+    {
+        mMeshStats.duplicates++;
+        return;
+    }
+
+    packet[0] = 0xFE;
+    memcpy(&packet[1], frame->data, MESH_DATA_SIZE);
+    packet[NRF24_PIPE_WIDTH - 1] = 0xFE;
+
+    mMeshStats.delivered++;
+    nrf24_processPacket(MESH_PIPE, packet, NRF24_PIPE_WIDTH);
+}
+
+
+/////////////////////////////////////////////////
+//Metric to the gateway and the next hop it goes
+//through, so that neighbour doesn't route back
+//through this node.
+static void Mesh_hello(void)
+{
+    MeshFrame frame;
+    MeshRoute *route = Mesh_findRoute(MESH_ADDR_GATEWAY);
+
+    memset(&frame, 0x00, sizeof(frame));
+    frame.type = MESH_TYPE_HELLO;
+    frame.ttl = 1;
+    frame.src = mMeshAddress;
+    frame.dst = MESH_ADDR_GATEWAY;
+    frame.prev = mMeshAddress;
+    frame.next = route ? route->next : MESH_ADDR_NONE;
+    frame.seq = mMeshSeq++;
+    frame.metric = Mesh_getMetric();
+
+    Mesh_queue(&frame, 0);
+}
+
+
+/////////////////////////////////////////////////
+//Send packets whose route showed up, drop the
+//ones that waited too long, repeat the rreq for
+//the rest
+static void Mesh_flushPending(void)
+{
+    MeshPending *pending;
+    uint8_t i;
+
+    for (i = 0 ; i < MESH_PENDING_SIZE ; i++)
+    {
+        pending = &mMeshPending[i];
+
+        if (!pending->used)
+            continue;
+
+        if (Mesh_route(&pending->frame) == 0)
+            pending->used = 0;
+
+        else if ((mMeshNow - pending->start) > MESH_DISCOVERY_MS)
+        {
+            pending->used = 0;
+            mMeshStats.noRoute++;
+        }
+
+        else if ((mMeshNow - pending->rreq) >= MESH_RREQ_MS)
+        {
+            pending->rreq = mMeshNow;
+            Mesh_discover(pending->frame.dst);
+        }
+    }
+}
+
+
+/////////////////////////////////////////////////
+//0 - MESH_JITTER_MS - 1, different on each node
+//and each frame, so rebroadcasts don't collide
+static uint8_t Mesh_jitter(void)
+{
+    return (uint8_t)((mMeshAddress * 7) + (mMeshSeq * 13) + (uint8_t)mMeshNow) % MESH_JITTER_MS;
+}
@@ -0,0 +1,179 @@
+/*
+Mesh - multi hop routing between repeaters
+Dana Olcott
+
+Every repeater is a router, one of them (the one on
+the pc) is the gateway.  Sensor nodes don't change,
+their 8 byte packets are picked up by whichever
+routers hear them and routed to the gateway.
+
+Mesh frames go on pipe 5 (MESH_PIPE), 16 bytes
+fixed width.  Every node uses the same pipe
+addresses, so every frame is heard by every node in
+range - the next hop is picked in the frame, not by
+the radio.  Fixed width link only (NRF24_ESB 0),
+auto ack can't work with a shared address.
+
+Frame:
+type, ttl, src, dst, prev, next, seq, metric,
+hops, data[6], crc8
+
+src / dst       origin / final node address
+prev / next     this hop, next = MESH_ADDR_BROADCAST for all
+metric          link cost so far (rreq, rrep) or to
+                the gateway (hello)
+data            sensor packet bytes 1 - 6, the 0xFE
+                start / stop bytes are put back on
+                at the gateway
+
+Neighbour table - learned from every frame heard.
+Link quality is an average of the RPD bit (received
+power above -64dBm), link cost 1 (strong) - 4 (weak).
+
+Routing table - destination, next hop and metric,
+the lowest metric wins.  Routes come from:
+hello       every node broadcasts its metric to the
+            gateway every MESH_HELLO_MS.  The route
+            up to the gateway is kept without any
+            discovery, that's where the data goes.
+rreq / rrep discovery for any other destination,
+            flooded rreq, unicast rrep back along the
+            reverse path.  Packets wait for the route.
+
+Hop acks - the link has no ack (fixed width), so the
+next hop answers every rrep / data frame with an ack
+frame.  No ack after MESH_RETRIES repeats - the link is
+down, its routes are removed.
+
+Aging - neighbours not heard for MESH_NEIGHBOUR_MS
+are removed with every route through them, routes not
+refreshed for MESH_ROUTE_MS are removed.
+
+Duplicates - sequence number is crc8 of the sensor
+data, so copies of one sensor packet injected by
+different routers are dropped at the gateway.
+
+See host/meshsim.c for the pc simulator.
+
+*/
+
+#ifndef __MESH__H
+#define __MESH__H
+
+#include <stdint.h>
+
+#include "nrf24l01.h"
+
+#ifndef MESH_ENABLE
+#define MESH_ENABLE                 0           //1 - mesh at boot, 0 - relay
+#endif
+
+#ifndef MESH_ADDRESS
+#define MESH_ADDRESS                0x02        //this node, 1 - 254
+#endif
+
+#define MESH_ADDR_NONE              0x00
+#define MESH_ADDR_GATEWAY           0x01
+#define MESH_ADDR_BROADCAST         0xFF
+
+#define MESH_PIPE                   5
+#define MESH_FRAME_SIZE             16
+#define MESH_DATA_SIZE              6           //sensor packet bytes 1 - 6
+
+#define MESH_TTL                    10          //hops
+#define MESH_METRIC_NONE            0xFF        //no route
+#define MESH_METRIC_MAX             48          //higher counts as no route
+
+#define MESH_NEIGHBOUR_SIZE         8
+#define MESH_ROUTE_SIZE             8
+#define MESH_CACHE_SIZE             8           //recent src / seq
+#define MESH_PENDING_SIZE           2           //packets waiting for a route
+#define MESH_OUT_SIZE               8           //frames waiting to go to the radio
+
+//ms
+#define MESH_HELLO_MS               2000
+#define MESH_NEIGHBOUR_MS           7000        //3 hellos missed
+#define MESH_ROUTE_MS               15000
+#define MESH_RREQ_MS                500         //rreq repeat while waiting
+#define MESH_DISCOVERY_MS           2000        //give up, drop the packet
+#define MESH_CACHE_MS               2000
+#define MESH_JITTER_MS              16          //broadcasts, spread the rebroadcasts
+#define MESH_ACK_MS                 20          //hop ack wait, then repeat
+#define MESH_RETRIES                3           //repeats without an ack
+
+
+typedef enum
+{
+    MESH_TYPE_HELLO = 1,
+    MESH_TYPE_RREQ,
+    MESH_TYPE_RREP,
+    MESH_TYPE_DATA,
+    MESH_TYPE_ACK                               //hop ack, seq / data[0] src / data[1] type
+}MeshType_t;
+
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t ttl;
+    uint8_t src;
+    uint8_t dst;
+    uint8_t prev;
+    uint8_t next;
+    uint8_t seq;
+    uint8_t metric;
+    uint8_t hops;
+    uint8_t data[MESH_DATA_SIZE];
+    uint8_t crc;
+}MeshFrame;
+
+
+typedef struct
+{
+    uint8_t address;                            //MESH_ADDR_NONE - free
+    uint8_t quality;                            //0 - 255, average of the rpd bit
+    uint32_t heard;                             //ms, last frame
+}MeshNeighbour;
+
+
+typedef struct
+{
+    uint8_t dst;                                //MESH_ADDR_NONE - free
+    uint8_t next;
+    uint8_t metric;
+    uint32_t updated;                           //ms
+}MeshRoute;
+
+
+typedef struct
+{
+    uint32_t rx;
+    uint32_t tx;
+    uint16_t forwarded;
+    uint16_t delivered;
+    uint16_t duplicates;
+    uint16_t noRoute;                           //no route, discovery timed out
+    uint16_t expired;                           //ttl used up
+    uint16_t bad;                               //crc / unknown type
+    uint16_t discoveries;                       //rreq sent
+    uint16_t retries;                           //repeated, no hop ack
+    uint16_t linkFail;                          //no hop ack after the retries
+}MeshStats;
+
+
+void Mesh_init(uint8_t address);
+void Mesh_enable(uint8_t enable);
+uint8_t Mesh_isEnabled(void);
+uint8_t Mesh_getAddress(void);
+
+void Mesh_packet(const NRF24_RxPacket *packet);
+int Mesh_send(uint8_t dst, const uint8_t *packet);
+void Mesh_service(uint32_t now);
+
+uint8_t Mesh_getMetric(void);
+int Mesh_getNeighbour(uint8_t index, MeshNeighbour *neighbour);
+int Mesh_getRoute(uint8_t index, MeshRoute *route);
+void Mesh_getStats(MeshStats *stats);
+
+
+#endif
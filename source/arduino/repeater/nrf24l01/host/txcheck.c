@@ -0,0 +1,78 @@
+/*
+Tx queue check, repeater copy - runs on the pc
+Dana Olcott
+
+nrf24l01/nrf24l01/host/txcheck.c on the repeater's
+nrf24l01.c - same radio model, scenarios and checks,
+the host register.h and avr stubs from there.  The
+repeater modules the driver calls into are stubbed
+here, none of them run in the tx scenarios.
+
+Exit code is the failure count.
+
+Build:  gcc -std=c99 -O2 -Wall -Wextra -Wno-pointer-sign -I../../../nrf24l01/nrf24l01/host \
+            -I.. -I../../spi -I../../usart -I../../utility -I../../payload -I../../relay \
+            -I../../mesh -I../../telemetry -I../../transport -o txcheck txcheck.c
+Run:    ./txcheck [packets] [seed]
+
+*/
+
+#define NRF24_SOURCE            "../../../repeater/nrf24l01/nrf24l01.c"
+
+#include "../../../nrf24l01/nrf24l01/host/txcheck.c"
+
+
+//////////////////////////////////////////
+//repeater modules, not used here
+int Relay_packet(const NRF24_RxPacket *packet)
+{
+    (void)packet;
+    return 0;
+}
+
+void Relay_service(void)
+{
+}
+
+uint8_t Mesh_isEnabled(void)
+{
+    return 0;
+}
+
+void Mesh_packet(const NRF24_RxPacket *packet)
+{
+    (void)packet;
+}
+
+int Mesh_send(uint8_t dst, const uint8_t *packet)
+{
+    (void)dst;
+    (void)packet;
+    return -1;
+}
+
+void Mesh_service(uint32_t now)
+{
+    (void)now;
+}
+
+void Transport_packet(const NRF24_RxPacket *packet)
+{
+    (void)packet;
+}
+
+void Transport_service(uint32_t now)
+{
+    (void)now;
+}
+
+
+//////////////////////////////////////////
+//forwarding led, main.c
+void LED_BlueOn(void)
+{
+}
+
+void LED_BlueOff(void)
+{
+}
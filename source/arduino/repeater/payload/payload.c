@@ -0,0 +1,287 @@
+/*
+Payload - batched sensor samples in one radio frame
+Dana Olcott
+
+See payload.h.  Encoder and decoder, no state of
+its own - the batch and the reader hold it.
+
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "payload.h"
+
+static uint8_t Payload_bits(uint32_t value);
+static uint32_t Payload_zigzag(int16_t value, int16_t previous);
+static void Payload_putBits(uint8_t *out, uint16_t *bit, uint32_t value, uint8_t width);
+static uint32_t Payload_getBits(const uint8_t *in, uint16_t *bit, uint8_t width);
+
+
+////////////////////////////////////////////////
+//CCITT, poly 0x1021, init 0xFFFF, msb first
+uint16_t Payload_crc16(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i, bit;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+
+        for (bit = 0 ; bit < 8 ; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+
+void Payload_batchInit(PayloadBatch *batch, uint8_t mid, uint16_t interval)
+{
+    memset(batch, 0x00, sizeof(PayloadBatch));
+    batch->mid = mid;
+    batch->interval = interval;
+}
+
+
+////////////////////////////////////////////////
+//Newest sample, now.  Returns the count, full at
+//PAYLOAD_MAX_SAMPLES - the oldest is dropped to
+//make room.
+uint8_t Payload_batchAdd(PayloadBatch *batch, int16_t value)
+{
+    if (batch->count >= PAYLOAD_MAX_SAMPLES)
+    {
+        memmove(&batch->samples[0], &batch->samples[1], (PAYLOAD_MAX_SAMPLES - 1) * sizeof(int16_t));
+        batch->count--;
+    }
+
+    batch->samples[batch->count++] = value;
+    batch->age = 0;
+
+    return batch->count;
+}
+
+
+/////////////////////////////////////////////////////
+//As many of the oldest samples as fit into one
+//frame.  They're taken out of the batch, the rest
+//wait for the next frame.  Set batch->age first.
+//Returns the frame length, 0 if the batch is empty.
+uint8_t Payload_encode(uint8_t *frame, uint8_t station, uint8_t seq, PayloadBatch *batch)
+{
+    uint8_t room = PAYLOAD_FRAME_SIZE - PAYLOAD_HEADER_SIZE - PAYLOAD_CRC_SIZE - PAYLOAD_BATCH_SIZE;
+    uint8_t used, width, w, i, length, deltas;
+    uint32_t age;
+    uint16_t bit, crc;
+    uint8_t *record;
+
+    if (!batch->count)
+        return 0;
+
+    //widest delta so far sets the width, stop
+    //before the deltas don't fit
+    width = 0;
+
+    for (used = 1 ; used < batch->count ; used++)
+    {
+        w = Payload_bits(Payload_zigzag(batch->samples[used], batch->samples[used - 1]));
+
+        if (w < width)
+            w = width;
+
+        if ((((uint16_t)used * w) + 7) / 8 > room)
+            break;
+
+        width = w;
+    }
+
+    deltas = (uint8_t)((((uint16_t)(used - 1) * width) + 7) / 8);
+    length = PAYLOAD_BATCH_SIZE + deltas;
+
+    //newest one sent waited for the ones kept
+    age = batch->age + (uint32_t)(batch->count - used) * batch->interval;
+
+    if (age > 0xFFFF)
+        age = 0xFFFF;
+
+    memset(frame, 0x00, PAYLOAD_FRAME_SIZE);
+    frame[0] = PAYLOAD_MARK | PAYLOAD_VERSION;
+    frame[1] = station;
+    frame[2] = seq;
+    frame[3] = length;
+
+    record = &frame[PAYLOAD_HEADER_SIZE];
+    record[0] = PAYLOAD_TYPE_BATCH;
+    record[1] = length - 2;
+    record[2] = batch->mid;
+    record[3] = used;
+    record[4] = width;
+    record[5] = age & 0xFF;
+    record[6] = age >> 8;
+    record[7] = batch->interval & 0xFF;
+    record[8] = batch->interval >> 8;
+    record[9] = (uint16_t)batch->samples[0] & 0xFF;
+    record[10] = (uint16_t)batch->samples[0] >> 8;
+
+    bit = 0;
+
+    for (i = 1 ; i < used ; i++)
+        Payload_putBits(&record[PAYLOAD_BATCH_SIZE], &bit, Payload_zigzag(batch->samples[i], batch->samples[i - 1]), width);
+
+    crc = Payload_crc16(frame, PAYLOAD_HEADER_SIZE + length);
+    frame[PAYLOAD_HEADER_SIZE + length] = crc & 0xFF;
+    frame[PAYLOAD_HEADER_SIZE + length + 1] = crc >> 8;
+
+    batch->count -= used;
+    memmove(&batch->samples[0], &batch->samples[used], batch->count * sizeof(int16_t));
+
+    return PAYLOAD_HEADER_SIZE + length + PAYLOAD_CRC_SIZE;
+}
+
+
+/////////////////////////////////////////////////////
+//Check a received frame, mark, version, lengths and
+//crc.  0 - good, the reader is set to the first
+//record.  -1 - drop it.
+int Payload_open(PayloadReader *reader, const uint8_t *frame, uint8_t length)
+{
+    uint8_t records;
+    uint16_t crc;
+
+    if ((length < (PAYLOAD_HEADER_SIZE + PAYLOAD_CRC_SIZE)) ||
+        (frame[0] != (PAYLOAD_MARK | PAYLOAD_VERSION)))
+        return -1;
+
+    records = frame[3];
+
+    if ((PAYLOAD_HEADER_SIZE + records + PAYLOAD_CRC_SIZE) > length)
+        return -1;
+
+    crc = frame[PAYLOAD_HEADER_SIZE + records] | ((uint16_t)frame[PAYLOAD_HEADER_SIZE + records + 1] << 8);
+
+    if (Payload_crc16(frame, PAYLOAD_HEADER_SIZE + records) != crc)
+        return -1;
+
+    reader->frame = frame;
+    reader->offset = PAYLOAD_HEADER_SIZE;
+    reader->end = PAYLOAD_HEADER_SIZE + records;
+    reader->station = frame[1];
+    reader->seq = frame[2];
+
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////
+//Next batch record in the frame, unknown types are
+//skipped.  1 - batch filled in, 0 - no more,
+//-1 - bad record, stop reading.
+int Payload_read(PayloadReader *reader, PayloadBatch *batch)
+{
+    const uint8_t *record;
+    uint8_t i, width;
+    uint16_t bit;
+    uint32_t z;
+    int16_t value;
+
+    while ((reader->offset + 2) <= reader->end)
+    {
+        record = &reader->frame[reader->offset];
+
+        if ((reader->offset + 2 + record[1]) > reader->end)
+            return -1;
+
+        reader->offset += 2 + record[1];
+
+        if (record[0] != PAYLOAD_TYPE_BATCH)
+            continue;
+
+        width = record[4];
+
+        if ((record[1] < (PAYLOAD_BATCH_SIZE - 2)) || (record[3] == 0) ||
+            (record[3] > PAYLOAD_MAX_SAMPLES) || (width > PAYLOAD_MAX_WIDTH) ||
+            ((((uint16_t)(record[3] - 1) * width) + 7) / 8 > (record[1] - (PAYLOAD_BATCH_SIZE - 2))))
+            return -1;
+
+        batch->mid = record[2];
+        batch->count = record[3];
+        batch->age = record[5] | ((uint16_t)record[6] << 8);
+        batch->interval = record[7] | ((uint16_t)record[8] << 8);
+
+        value = (int16_t)(record[9] | ((uint16_t)record[10] << 8));
+        batch->samples[0] = value;
+        bit = 0;
+
+        for (i = 1 ; i < batch->count ; i++)
+        {
+            z = Payload_getBits(&record[PAYLOAD_BATCH_SIZE], &bit, width);
+            value = (int16_t)(value + ((z & 1) ? -(int32_t)((z + 1) >> 1) : (int32_t)(z >> 1)));
+            batch->samples[i] = value;
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static uint8_t Payload_bits(uint32_t value)
+{
+    uint8_t n = 0;
+
+    while (value)
+    {
+        n++;
+        value >>= 1;
+    }
+
+    return n;
+}
+
+
+//////////////////////////////////////////
+//value - previous, 0, -1, 1, -2 .. to 0, 1, 2, 3 ..
+static uint32_t Payload_zigzag(int16_t value, int16_t previous)
+{
+    int32_t delta = (int32_t)value - previous;
+
+    return (delta < 0) ? (((uint32_t)(-delta) << 1) - 1) : ((uint32_t)delta << 1);
+}
+
+
+//////////////////////////////////////////
+//width bits of value at bit, lsb first.
+//out starts zeroed.
+static void Payload_putBits(uint8_t *out, uint16_t *bit, uint32_t value, uint8_t width)
+{
+    while (width--)
+    {
+        if (value & 1)
+            out[*bit >> 3] |= 1u << (*bit & 0x07);
+
+        value >>= 1;
+        (*bit)++;
+    }
+}
+
+
+static uint32_t Payload_getBits(const uint8_t *in, uint16_t *bit, uint8_t width)
+{
+    uint32_t value = 0;
+    uint8_t i;
+
+    for (i = 0 ; i < width ; i++)
+    {
+        if (in[*bit >> 3] & (1u << (*bit & 0x07)))
+            value |= 1UL << i;
+
+        (*bit)++;
+    }
+
+    return value;
+}
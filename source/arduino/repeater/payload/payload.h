@@ -0,0 +1,111 @@
+/*
+Payload - batched sensor samples in one radio frame
+Dana Olcott
+
+The 8 byte sensor packet (0xFE, station, MID, 4 data
+bytes, 0xFE) carries one reading.  A payload frame
+carries a batch of them, timestamped and delta
+encoded, up to PAYLOAD_FRAME_SIZE bytes on pipe 2
+(PAYLOAD_PIPE).  Same file in the nrf24l01 and
+repeater projects, and the pc decoder includes it.
+
+Frame:
+mark | version, station, seq, records length,
+records..., crc16 lsb, crc16 msb
+
+mark        PAYLOAD_MARK, high nibble.  Low nibble the
+            version, a frame from a newer one is
+            dropped whole
+crc16       CCITT, poly 0x1021, init 0xFFFF, over the
+            header and records.  The fixed width link
+            has no radio crc, this is it
+
+Records are type, length, value.  A reader skips
+types it doesn't know by the length, new ones can be
+added in the same version.
+
+PAYLOAD_TYPE_BATCH, 9 bytes + the deltas:
+mid, count, width, age lsb / msb, interval lsb / msb,
+first lsb / msb, deltas...
+
+mid         NRF24_MID_t, what the samples are
+count       samples, 1 - PAYLOAD_MAX_SAMPLES
+width       bits per delta, 0 - 17
+age         1/10 s from the newest sample to the send
+interval    1/10 s between samples
+first       oldest sample, int16
+deltas      count - 1 of them, sample minus the one
+            before, zigzag (0, -1, 1, -2.. to 0, 1, 2,
+            3..), width bits each, packed lsb first
+
+Sample i (0 oldest) was taken age + (count - 1 - i) *
+interval before the frame went out.
+
+A slow sensor moves a few counts per sample, 6 bit
+deltas put 21 samples in a 32 byte frame against one
+per packet, 8 at the worst (17 bit).
+
+No avr headers, builds on the pc.
+
+*/
+
+#ifndef __PAYLOAD__H
+#define __PAYLOAD__H
+
+#include <stdint.h>
+
+#define PAYLOAD_PIPE                2
+#define PAYLOAD_FRAME_SIZE          32
+#define PAYLOAD_MARK                0xA0
+#define PAYLOAD_VERSION             1
+#define PAYLOAD_HEADER_SIZE         4           //mark, station, seq, records length
+#define PAYLOAD_CRC_SIZE            2
+#define PAYLOAD_BATCH_SIZE          11          //type, length, 9 bytes before the deltas
+#define PAYLOAD_MAX_SAMPLES         32
+#define PAYLOAD_MAX_WIDTH           17          //int16 - int16, zigzag
+
+
+typedef enum
+{
+    PAYLOAD_TYPE_BATCH = 0x01
+}PayloadType_t;
+
+
+////////////////////////////////////////////////
+//Samples of one kind at a fixed interval, oldest
+//first.  Sender - Payload_batchAdd fills it,
+//Payload_encode takes what fits in a frame.
+//Receiver - Payload_read fills it.
+typedef struct
+{
+    uint8_t mid;                            //NRF24_MID_t
+    uint8_t count;
+    uint16_t interval;                      //1/10 s
+    uint16_t age;                           //1/10 s, newest sample to now / the send
+    int16_t samples[PAYLOAD_MAX_SAMPLES];
+}PayloadBatch;
+
+
+////////////////////////////////////////////////
+//Received frame being read, Payload_open
+typedef struct
+{
+    const uint8_t *frame;
+    uint8_t offset;                         //next record
+    uint8_t end;
+    uint8_t station;
+    uint8_t seq;
+}PayloadReader;
+
+
+uint16_t Payload_crc16(const uint8_t *data, uint8_t length);
+
+void Payload_batchInit(PayloadBatch *batch, uint8_t mid, uint16_t interval);
+uint8_t Payload_batchAdd(PayloadBatch *batch, int16_t value);
+uint8_t Payload_encode(uint8_t *frame, uint8_t station, uint8_t seq, PayloadBatch *batch);
+
+int Payload_open(PayloadReader *reader, const uint8_t *frame, uint8_t length);
+int Payload_read(PayloadReader *reader, PayloadBatch *batch);
+
+
+#endif
@@ -0,0 +1,169 @@
+/*
+Relay - store and forward repeater engine
+Dana Olcott
+
+See relay.h.  Main loop only, Relay_packet is called
+from nrf24_processRxPackets for each packet in repeater
+mode, Relay_service moves the forward queue into the
+radio tx queue.  Both run as soon as the INT0 isr
+wakes the cpu, not on the 50ms main loop.
+
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "relay.h"
+#include "nrf24l01.h"
+
+
+typedef struct
+{
+    uint8_t station;
+    uint8_t seq;
+    uint32_t timestamp;
+}RelayCacheEntry;
+
+
+static uint8_t mRelayQueue[RELAY_QUEUE_SIZE][NRF24_PIPE_WIDTH];
+static uint8_t mRelayHead = 0x00;               //free running
+static uint8_t mRelayTail = 0x00;               //free running
+
+static RelayCacheEntry mRelayCache[RELAY_CACHE_SIZE];
+static uint8_t mRelayCacheNext = 0x00;          //oldest entry, replaced next
+
+static RelayStats mRelayStats;
+
+
+static uint8_t Relay_isDuplicate(uint8_t station, uint8_t seq, uint32_t timestamp);
+
+
+void Relay_init(void)
+{
+    mRelayHead = 0x00;
+    mRelayTail = 0x00;
+    mRelayCacheNext = 0x00;
+
+    memset(mRelayCache, 0x00, sizeof(mRelayCache));
+    memset(&mRelayStats, 0x00, sizeof(mRelayStats));
+}
+
+
+/////////////////////////////////////////////////
+//One packet from the rx ring, already checked
+//for start / stop bytes.  Returns 1 if queued
+//to forward, 0 if dropped (duplicate or out of
+//hops), -1 if the forward queue is full.
+int Relay_packet(const NRF24_RxPacket *packet)
+{
+    uint8_t mark = packet->data[0];
+    uint8_t ttl;
+    uint8_t seq = Relay_crc8(&packet->data[1], 6);
+    uint8_t *slot;
+
+    if (Relay_isDuplicate(packet->data[1], seq, packet->timestamp))
+    {
+        mRelayStats.duplicates++;
+        return 0;
+    }
+
+    //hops left after this one
+    if (mark == RELAY_MARK_SENSOR)
+        ttl = RELAY_TTL;
+    else
+        ttl = mark - RELAY_MARK_BASE;
+
+    if (ttl == 0)
+    {
+        mRelayStats.expired++;
+        return 0;
+    }
+
+    if ((uint8_t)(mRelayHead - mRelayTail) >= RELAY_QUEUE_SIZE)
+    {
+        mRelayStats.dropped++;
+        return -1;
+    }
+
+    slot = mRelayQueue[mRelayHead & RELAY_QUEUE_MASK];
+    memcpy(slot, packet->data, NRF24_PIPE_WIDTH);
+    slot[0] = RELAY_MARK_BASE + (ttl - 1);
+    mRelayHead++;
+
+    return 1;
+}
+
+
+/////////////////////////////////////////////////
+//Forward queued packets while the radio tx
+//queue takes them.  Doesn't wait.
+void Relay_service(void)
+{
+    while (mRelayTail != mRelayHead)
+    {
+        if (nrf24_send(RELAY_PIPE, mRelayQueue[mRelayTail & RELAY_QUEUE_MASK], NRF24_PIPE_WIDTH) < 0)
+            break;
+
+        mRelayTail++;
+        mRelayStats.forwarded++;
+    }
+}
+
+
+void Relay_getStats(RelayStats *stats)
+{
+    memcpy(stats, &mRelayStats, sizeof(RelayStats));
+}
+
+
+///////////////////////////////////////////
+//CRC8 - poly 0x07, init 0x00
+uint8_t Relay_crc8(const uint8_t *data, uint8_t length)
+{
+    uint8_t crc = 0x00;
+    uint8_t i, bit;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        crc ^= data[i];
+
+        for (bit = 0 ; bit < 8 ; bit++)
+        {
+            if (crc & 0x80)
+                crc = (crc << 1) ^ 0x07;
+            else
+                crc <<= 1;
+        }
+    }
+
+    return crc;
+}
+
+
+/////////////////////////////////////////////////
+//Seen this station / seq inside the window?
+//If not, remember it in place of the oldest.
+static uint8_t Relay_isDuplicate(uint8_t station, uint8_t seq, uint32_t timestamp)
+{
+    uint8_t i;
+
+    for (i = 0 ; i < RELAY_CACHE_SIZE ; i++)
+    {
+        if ((mRelayCache[i].timestamp != 0) &&
+            (mRelayCache[i].station == station) &&
+            (mRelayCache[i].seq == seq) &&
+            ((timestamp - mRelayCache[i].timestamp) < RELAY_CACHE_MS))
+        {
+            return 1;
+        }
+    }
+
+    mRelayCache[mRelayCacheNext].station = station;
+    mRelayCache[mRelayCacheNext].seq = seq;
+    mRelayCache[mRelayCacheNext].timestamp = timestamp ? timestamp : 1;
+    mRelayCacheNext = (mRelayCacheNext + 1) % RELAY_CACHE_SIZE;
+
+    return 0;
+}
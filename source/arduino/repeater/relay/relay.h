@@ -0,0 +1,65 @@
+/*
+Relay - store and forward repeater engine
+Dana Olcott
+
+Runs the repeater mode of the radio.  Sensor packets
+come out of the nrf24 rx ring, duplicates and packets
+out of hops are dropped, the rest wait in the forward
+queue until the radio tx queue has room.
+
+Packets stay 8 bytes, so the fixed width link still
+works.  Byte 0 says who sent it:
+
+0xFE            from the sensor, not relayed yet
+0xF0 + ttl      relayed, ttl hops left (0 - 13)
+
+Byte 1 (station) is no longer overwritten, it's the
+origin of the packet.  Bytes 1 - 6 are never changed
+by a relay, so every relay that hears the same packet
+computes the same sequence number, crc8 of bytes 1 - 6.
+A per source cache of recent sequence numbers drops
+copies heard from peer relays, or a relay's own packet
+coming back.  Two readings with the same data inside
+RELAY_CACHE_MS count as one.
+
+*/
+
+#ifndef __RELAY__H
+#define __RELAY__H
+
+#include <stdint.h>
+
+#include "nrf24l01.h"
+
+#define RELAY_MARK_SENSOR           0xFE
+#define RELAY_MARK_BASE             0xF0
+#define RELAY_TTL                   3           //hops, 13 max
+#define RELAY_PIPE                  0           //tx pipe for forwarding
+
+#define RELAY_QUEUE_SIZE            8           //power of 2
+#define RELAY_QUEUE_MASK            (RELAY_QUEUE_SIZE - 1)
+#define RELAY_CACHE_SIZE            8           //sources * recent packets
+#define RELAY_CACHE_MS              2000        //duplicate window
+
+//sensor packet or relayed packet
+#define RELAY_IS_MARK(b)            (((b) & 0xF0) == RELAY_MARK_BASE && ((b) != 0xFF))
+
+
+typedef struct
+{
+    uint32_t forwarded;
+    uint16_t duplicates;
+    uint16_t expired;                           //ttl used up
+    uint16_t dropped;                           //forward queue full
+}RelayStats;
+
+
+void Relay_init(void);
+int Relay_packet(const NRF24_RxPacket *packet);
+void Relay_service(void);
+void Relay_getStats(RelayStats *stats);
+
+uint8_t Relay_crc8(const uint8_t *data, uint8_t length);
+
+
+#endif
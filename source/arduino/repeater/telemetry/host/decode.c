@@ -0,0 +1,181 @@
+/*
+Telemetry decoder - runs on the pc
+Dana Olcott
+
+Reads the repeater or nrf24l01 usart from stdin,
+prints one line per frame.  Anything that isn't a good frame
+(cli text) is printed as it came in.
+
+Radio frames from pipe 2 are batched samples, they
+are read with ../../payload/payload.c, one line per
+sample.
+
+Build:  gcc -std=c99 -Wall -I../../payload -o decode decode.c ../../payload/payload.c
+Run:    stty -F /dev/ttyUSB0 9600 raw
+        ./decode < /dev/ttyUSB0
+
+See ../telemetry.h for the format.
+
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "payload.h"
+
+#define MAX_BLOCK       256
+
+#define TYPE_RADIO      0x01
+#define TYPE_ADC        0x02
+#define TYPE_TEMP       0x03
+#define TYPE_EEPROM     0x04
+
+
+static uint16_t crc16(const uint8_t *data, int length)
+{
+    uint16_t crc = 0xFFFF;
+    int i, bit;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+
+        for (bit = 0 ; bit < 8 ; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+
+/////////////////////////////////////////
+//COBS decode in to out.  returns the
+//decoded length, -1 if malformed
+static int cobsDecode(const uint8_t *in, int length, uint8_t *out)
+{
+    int i = 0, n = 0;
+
+    while (i < length)
+    {
+        int code = in[i++];
+
+        if ((code == 0) || ((i + code - 1) > length))
+            return -1;
+
+        memcpy(&out[n], &in[i], code - 1);
+        n += code - 1;
+        i += code - 1;
+
+        if ((code < 0xFF) && (i < length))
+            out[n++] = 0x00;
+    }
+
+    return n;
+}
+
+
+/////////////////////////////////////////
+//Batched samples, payload.h
+static void printPayload(const uint8_t *data, int length)
+{
+    PayloadReader reader;
+    PayloadBatch batch;
+    unsigned long age;
+    int i;
+
+    if (Payload_open(&reader, data, length) < 0)
+    {
+        printf("\n      bad payload");
+        return;
+    }
+
+    while (Payload_read(&reader, &batch) > 0)
+    {
+        printf("\n      BATCH station:%u seq:%u mid:%u samples:%u",
+                reader.station, reader.seq, batch.mid, batch.count);
+
+        for (i = 0 ; i < batch.count ; i++)
+        {
+            age = batch.age + (unsigned long)(batch.count - 1 - i) * batch.interval;
+            printf("\n      -%lu.%lus %d", age / 10, age % 10, batch.samples[i]);
+        }
+    }
+}
+
+
+static void printFrame(const uint8_t *frame, int length)
+{
+    const uint8_t *p = &frame[2];
+    int size = length - 4;
+    int i;
+
+    printf("[%3u] ", frame[1]);
+
+    switch(frame[0])
+    {
+        case TYPE_RADIO:
+            printf("RADIO pipe:%u len:%u ", p[0], p[1]);
+            for (i = 2 ; i < size ; i++)
+                printf("%02x ", p[i]);
+
+            if (p[0] == PAYLOAD_PIPE)
+                printPayload(&p[2], size - 2);
+            break;
+
+        case TYPE_ADC:
+            printf("ADC src:0x%02x value:%u", p[0], p[1] | (p[2] << 8));
+            break;
+
+        case TYPE_TEMP:
+            printf("TEMP src:0x%02x %u.%u", p[0], p[1], p[2]);
+            break;
+
+        case TYPE_EEPROM:
+            printf("EEPROM page:%2u ", p[0]);
+            for (i = 1 ; i < size ; i++)
+                printf("%02x ", p[i]);
+            break;
+
+        default:
+            printf("type 0x%02x, %d bytes", frame[0], size);
+            break;
+    }
+
+    printf("\n");
+}
+
+
+int main(void)
+{
+    uint8_t block[MAX_BLOCK];
+    uint8_t frame[MAX_BLOCK];
+    int length = 0;
+    int c;
+
+    while ((c = getchar()) != EOF)
+    {
+        if (c != 0x00)
+        {
+            if (length < MAX_BLOCK)
+                block[length++] = (uint8_t)c;
+            continue;
+        }
+
+        if (!length)
+            continue;
+
+        //delimiter - good frame, or text
+        int n = cobsDecode(block, length, frame);
+
+        if ((n >= 4) && (crc16(frame, n - 2) == (frame[n - 2] | (frame[n - 1] << 8))))
+            printFrame(frame, n);
+        else
+            fwrite(block, 1, length, stdout);
+
+        fflush(stdout);
+        length = 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+Telemetry - binary framed output on the usart
+Dana Olcott
+
+See telemetry.h for the frame format.
+
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "telemetry.h"
+#include "usart.h"
+
+
+static volatile TelemetryMode_t mTelemetryMode = TELEMETRY_MODE_TEXT;
+static uint8_t mTelemetrySeq = 0x00;
+
+
+void Telemetry_setMode(TelemetryMode_t mode)
+{
+    mTelemetryMode = mode;
+}
+
+TelemetryMode_t Telemetry_getMode(void)
+{
+    return mTelemetryMode;
+}
+
+
+///////////////////////////////////////////
+//CRC16 CCITT - poly 0x1021, init 0xFFFF,
+//msb first, no final xor
+uint16_t Telemetry_crc16(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i, bit;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+
+        for (bit = 0 ; bit < 8 ; bit++)
+        {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc = crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+
+/////////////////////////////////////////////
+//Build the frame, COBS encode it straight
+//out the usart, between two delimiters.
+//Each COBS block is a code byte (distance to
+//the next zero) and the bytes up to it.
+//Frames are short, a block never reaches 254.
+//returns the number of bytes sent, -1 if
+//the payload is too big
+int Telemetry_send(TelemetryType_t type, const uint8_t *payload, uint8_t length)
+{
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    uint8_t size = 0x00;
+    uint8_t start = 0x00;
+    uint8_t i;
+    uint16_t crc;
+    int sent = 0x00;
+
+    if (length > TELEMETRY_MAX_PAYLOAD)
+        return -1;
+
+    frame[size++] = (uint8_t)type;
+    frame[size++] = mTelemetrySeq++;
+    memcpy(&frame[size], payload, length);
+    size += length;
+
+    crc = Telemetry_crc16(frame, size);
+    frame[size++] = crc & 0xFF;
+    frame[size++] = (crc >> 8) & 0xFF;
+
+    Usart_sendByte(0x00);               //ends any cli text before the frame
+
+    //one block per zero in the frame, plus the last
+    for (i = 0 ; i <= size ; i++)
+    {
+        if ((i == size) || (frame[i] == 0x00))
+        {
+            Usart_sendByte(i - start + 1);                  //code
+            Usart_sendArray(&frame[start], i - start);      //data, no zeros
+            sent += i - start + 1;
+            start = i + 1;
+        }
+    }
+
+    Usart_sendByte(0x00);                                   //delimiter
+
+    return sent + 2;
+}
+
+
+//////////////////////////////////////////
+//Radio packet - pipe, length, packet
+int Telemetry_sendRadioPacket(uint8_t pipe, const uint8_t *packet, uint8_t length)
+{
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+
+    if (length > (TELEMETRY_MAX_PAYLOAD - 2))
+        return -1;
+
+    payload[0] = pipe;
+    payload[1] = length;
+    memcpy(&payload[2], packet, length);
+
+    return Telemetry_send(TELEMETRY_TYPE_RADIO, payload, length + 2);
+}
+
+
+int Telemetry_sendAdc(uint8_t source, uint16_t value)
+{
+    uint8_t payload[3] = {source, value & 0xFF, (value >> 8) & 0xFF};
+
+    return Telemetry_send(TELEMETRY_TYPE_ADC, payload, 3);
+}
+
+
+int Telemetry_sendTemp(uint8_t source, uint8_t tempInt, uint8_t tempFrac)
+{
+    uint8_t payload[3] = {source, tempInt, tempFrac};
+
+    return Telemetry_send(TELEMETRY_TYPE_TEMP, payload, 3);
+}
+
+
+//////////////////////////////////////////
+//Eeprom page - page number, page data
+int Telemetry_sendEepromPage(uint8_t page, const uint8_t *data, uint8_t length)
+{
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+
+    if (length > (TELEMETRY_MAX_PAYLOAD - 1))
+        return -1;
+
+    payload[0] = page;
+    memcpy(&payload[1], data, length);
+
+    return Telemetry_send(TELEMETRY_TYPE_EEPROM, payload, length + 1);
+}
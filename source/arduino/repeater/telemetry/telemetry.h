@@ -0,0 +1,66 @@
+/*
+Telemetry - binary framed output on the usart
+Dana Olcott
+
+Text output is about 3x the bytes of the data
+("0x3f " per byte).  In binary mode the radio
+packets, samples and eeprom pages go out as
+frames instead:
+
+frame:  type, seq, payload..., crc16 lsb, crc16 msb
+crc16:  CCITT, poly 0x1021, init 0xFFFF, over type..payload
+wire:   0x00, COBS encoded frame, 0x00
+
+COBS removes every 0x00 from the frame, so 0x00
+only ever marks the end of a frame.  Text from the
+cli between frames has no 0x00 either, the host
+decoder shows anything that isn't a good frame as
+text.  See repeater/telemetry/host/decode.c.
+Same file in the nrf24l01 and repeater projects.
+
+Payloads:
+TELEMETRY_TYPE_RADIO    pipe, length, packet...
+TELEMETRY_TYPE_ADC      source, value lsb, value msb
+TELEMETRY_TYPE_TEMP     source, int, frac
+TELEMETRY_TYPE_EEPROM   page, PAGE_SIZE bytes (repeater)
+
+The cli switches modes, "mode bin" / "mode text".
+
+*/
+
+#ifndef __TELEMETRY__H
+#define __TELEMETRY__H
+
+#include <stdint.h>
+
+#define TELEMETRY_MAX_PAYLOAD       40
+#define TELEMETRY_MAX_FRAME         (TELEMETRY_MAX_PAYLOAD + 4)     //type, seq, crc
+
+typedef enum
+{
+    TELEMETRY_MODE_TEXT,
+    TELEMETRY_MODE_BINARY,
+}TelemetryMode_t;
+
+typedef enum
+{
+    TELEMETRY_TYPE_RADIO = 0x01,
+    TELEMETRY_TYPE_ADC = 0x02,
+    TELEMETRY_TYPE_TEMP = 0x03,
+    TELEMETRY_TYPE_EEPROM = 0x04,
+}TelemetryType_t;
+
+
+void Telemetry_setMode(TelemetryMode_t mode);
+TelemetryMode_t Telemetry_getMode(void);
+
+uint16_t Telemetry_crc16(const uint8_t *data, uint8_t length);
+int Telemetry_send(TelemetryType_t type, const uint8_t *payload, uint8_t length);
+
+int Telemetry_sendRadioPacket(uint8_t pipe, const uint8_t *packet, uint8_t length);
+int Telemetry_sendAdc(uint8_t source, uint16_t value);
+int Telemetry_sendTemp(uint8_t source, uint8_t tempInt, uint8_t tempFrac);
+int Telemetry_sendEepromPage(uint8_t page, const uint8_t *data, uint8_t length);
+
+
+#endif
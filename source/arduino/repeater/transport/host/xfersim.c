@@ -0,0 +1,610 @@
+/*
+Transport simulator - runs on the pc
+Dana Olcott
+
+Runs transport.c on simulated nodes, checks every
+message arrives whole, in order and only at its dst,
+and measures the throughput against the air.
+
+Each node is its own copy of transport.c + relay.c,
+loaded as a shared library like mesh/host/meshsim.c.
+The simulator supplies the calls they make
+(nrf24_send, nrf24_setRxPayLoadSize, Mesh_getAddress)
+and models the air:
+
+- one frame time per step, SLOT_US: 1mbps, no ESB
+  (the repeater default), 1 + 5 + 32 + 2 bytes on air
+  plus the 130us tx settling
+- each node sends one frame per step from a 4 deep tx
+  queue (NRF24_TX_QUEUE_SIZE)
+- half duplex, a node sending doesn't hear
+- two frames at once are both lost, every node hears
+  every other one, each frame lost at random loss %
+- 4 deep rx ring per node, emptied every step (the
+  repeater wakes on every interrupt, Delay in main.c)
+
+The model is the air only.  SPI loads, the usart and
+the main loop aren't in it, so the B/s here is an
+upper bound.  On the repeater the figure is the one
+"xfer eeprom" prints.
+
+Scenarios, each a number of 256 byte messages of
+random data from node 1 to node 2:
+
+sweep       loss 0 - 30%, throughput and retransmits
+reboot      node 1 reloaded between messages, its ids
+            start over - the next message with the same
+            id must not get the full SACK of the last
+two         nodes 1 and 3 to node 2 at the same time
+overhear    node 3 listens to 1 and 2, must not answer
+            or hand anything over
+
+Fails on a message that fails, arrives wrong, out of
+order, twice, or at the wrong node.  Exit code is the
+failure count.
+
+Build:  gcc -std=gnu99 -O2 -Wall -Wextra -shared -fPIC -I.. -I../../nrf24l01 -I../../relay \
+            -I../../mesh -o xfernode.so ../transport.c ../../relay/relay.c
+        gcc -std=gnu99 -O2 -Wall -Wextra -rdynamic -I.. -I../../nrf24l01 -I../../relay \
+            -I../../mesh -o xfersim xfersim.c -ldl
+Run:    ./xfersim [messages] [seed]
+
+messages 50 per case, seed 1 by default.  ./xfersim
+gives 0 failures, seeds 1 - 13 with 200 messages too.
+The air carries 22 data bytes a frame, 48889 B/s:
+
+loss  0%    29942 B/s   61.2%
+loss  5%    18037 B/s   36.9%
+loss 10%     8486 B/s   17.4%
+loss 20%     4173 B/s    8.5%
+loss 30%     2596 B/s    5.3%
+
+With no loss the sender waits TRANSPORT_ACK_MS for
+each SACK after a window, with loss most of the time
+is lost SACKs waiting out TRANSPORT_RTO_MS.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "transport.h"
+
+#define MAX_NODES           3
+#define SLOT_US             450             //130 + 40 bytes at 1mbps
+#define TX_QUEUE            4
+#define RX_RING             4
+#define MESSAGE_MS          5000            //longer than TRANSPORT_TX_TIMEOUT_MS
+
+
+typedef struct
+{
+    void *lib;
+    void (*init)(void (*)(uint8_t, uint16_t, const uint8_t*, uint8_t));
+    void (*packet)(const NRF24_RxPacket*);
+    void (*service)(uint32_t);
+    int (*send)(uint8_t, uint16_t, void (*)(uint16_t, uint8_t*, uint8_t));
+    TransportState_t (*state)(void);
+    void (*stats)(TransportStats*);
+
+    uint8_t address;
+    uint8_t pipeWidth[6];
+
+    uint8_t txFrames[TX_QUEUE][NRF24_PIPE_WIDTH_MAX];
+    int txCount;
+    uint32_t txFrameCount;                  //frames put on the air
+
+    NRF24_RxPacket rx[RX_RING];
+    int rxCount;
+
+    //sender - the message it is sending
+    uint8_t message[TRANSPORT_MAX_MESSAGE];
+    uint16_t length;
+    uint32_t delivered;                     //whole and right at the receiver
+
+    //receiver - the message coming in
+    uint8_t rxSrc;
+    uint16_t rxNext;
+    uint8_t rxGood;
+}SimNode;
+
+
+static SimNode mNodes[MAX_NODES];
+static int mNumNodes = 0;
+static int mCurrent = 0;                    //node running now
+static uint64_t mNowUs = 0;
+static uint32_t mRandom = 1;
+static uint32_t mLoss = 0;                  //per mille
+static const char *mLibPath = "./xfernode.so";
+
+static uint32_t mWrong = 0;                 //out of order, bad data, wrong node
+
+
+static uint32_t sim_random(void)
+{
+    mRandom ^= mRandom << 13;
+    mRandom ^= mRandom >> 17;
+    mRandom ^= mRandom << 5;
+    return mRandom;
+}
+
+static uint32_t sim_now(void)
+{
+    return (uint32_t)(mNowUs / 1000);
+}
+
+
+//////////////////////////////////////////
+//Radio driver and mesh calls, from the node
+//that is running (mCurrent)
+int nrf24_send(uint8_t pipe, const uint8_t* buffer, uint8_t length)
+{
+    SimNode *node = &mNodes[mCurrent];
+
+    if ((pipe > 5) || (length > node->pipeWidth[pipe]) || (node->txCount >= TX_QUEUE))
+        return -1;
+
+    memset(node->txFrames[node->txCount], 0x00, NRF24_PIPE_WIDTH_MAX);
+    memcpy(node->txFrames[node->txCount], buffer, length);
+    node->txCount++;
+
+    return 0;
+}
+
+void nrf24_setRxPayLoadSize(uint8_t pipe, uint8_t numBytes)
+{
+    if (pipe <= 5)
+        mNodes[mCurrent].pipeWidth[pipe] = numBytes;
+}
+
+uint8_t Mesh_getAddress(void)
+{
+    return mNodes[mCurrent].address;
+}
+
+
+//////////////////////////////////////////
+//Transport callbacks
+static void sim_read(uint16_t offset, uint8_t *data, uint8_t length)
+{
+    memcpy(data, &mNodes[mCurrent].message[offset], length);
+}
+
+static SimNode* sim_node(uint8_t address)
+{
+    int i;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        if (mNodes[i].address == address)
+            return &mNodes[i];
+    }
+
+    return NULL;
+}
+
+static void sim_received(uint8_t src, uint16_t offset, const uint8_t *data, uint8_t length)
+{
+    SimNode *node = &mNodes[mCurrent];
+    SimNode *from = sim_node(src);
+
+    //only node 2 gets messages here
+    if ((node->address != 2) || (from == NULL))
+    {
+        mWrong++;
+        return;
+    }
+
+    if (data == NULL)
+    {
+        if (node->rxGood && (src == node->rxSrc) && (offset == node->rxNext) && (offset == from->length))
+            from->delivered++;
+        else
+            mWrong++;
+
+        node->rxGood = 0;
+        return;
+    }
+
+    //a message starts over at 0, a dropped one
+    //never gets its end
+    if (offset == 0)
+    {
+        node->rxSrc = src;
+        node->rxNext = 0;
+        node->rxGood = 1;
+    }
+
+    if ((src != node->rxSrc) || (offset != node->rxNext) || ((offset + length) > from->length) ||
+        memcmp(data, &from->message[offset], length))
+    {
+        if (node->rxGood)
+            mWrong++;
+
+        node->rxGood = 0;
+    }
+
+    node->rxNext = offset + length;
+}
+
+
+static void sim_load(int index, uint8_t address)
+{
+    SimNode *node = &mNodes[index];
+    char copy[64];
+    char command[192];
+
+    if (node->lib)
+        dlclose(node->lib);
+
+    memset(node, 0x00, sizeof(SimNode));
+
+    //dlopen returns the same library for the same
+    //file, each node gets its own copy
+    snprintf(copy, sizeof(copy), "/tmp/xfersim_%d_%d.so", (int)getpid(), index);
+    snprintf(command, sizeof(command), "cp %s %s", mLibPath, copy);
+
+    if (system(command) != 0)
+        exit(1);
+
+    node->lib = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+    remove(copy);
+
+    if (!node->lib)
+    {
+        printf("%s\n", dlerror());
+        exit(1);
+    }
+
+    node->init = (void (*)(void (*)(uint8_t, uint16_t, const uint8_t*, uint8_t)))dlsym(node->lib, "Transport_init");
+    node->packet = (void (*)(const NRF24_RxPacket*))dlsym(node->lib, "Transport_packet");
+    node->service = (void (*)(uint32_t))dlsym(node->lib, "Transport_service");
+    node->send = (int (*)(uint8_t, uint16_t, void (*)(uint16_t, uint8_t*, uint8_t)))dlsym(node->lib, "Transport_send");
+    node->state = (TransportState_t (*)(void))dlsym(node->lib, "Transport_getState");
+    node->stats = (void (*)(TransportStats*))dlsym(node->lib, "Transport_getStats");
+
+    node->address = address;
+    memset(node->pipeWidth, NRF24_PIPE_WIDTH, 6);
+
+    mCurrent = index;
+    node->init(sim_received);
+    node->service(sim_now());
+}
+
+
+static void sim_setup(int nodes)
+{
+    int i;
+
+    for (i = 0 ; i < MAX_NODES ; i++)
+    {
+        if (mNodes[i].lib)
+            dlclose(mNodes[i].lib);
+        mNodes[i].lib = NULL;
+    }
+
+    mNumNodes = nodes;
+
+    for (i = 0 ; i < nodes ; i++)
+        sim_load(i, i + 1);
+}
+
+
+//////////////////////////////////////////
+//One frame time on the air, then the main
+//loop of each node
+static void sim_step(void)
+{
+    int sending[MAX_NODES];
+    int i, j, from, heard;
+    NRF24_RxPacket *rx;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        sending[i] = (mNodes[i].txCount > 0);
+        mNodes[i].txFrameCount += sending[i];
+    }
+
+    for (j = 0 ; j < mNumNodes ; j++)
+    {
+        if (sending[j])
+            continue;
+
+        heard = 0;
+        from = -1;
+
+        for (i = 0 ; i < mNumNodes ; i++)
+        {
+            if (sending[i])
+            {
+                heard++;
+                from = i;
+            }
+        }
+
+        if ((heard != 1) || ((sim_random() % 1000) < mLoss) || (mNodes[j].rxCount >= RX_RING) ||
+            (mNodes[j].pipeWidth[TRANSPORT_PIPE] != TRANSPORT_FRAME_SIZE))
+            continue;
+
+        rx = &mNodes[j].rx[mNodes[j].rxCount++];
+        memset(rx, 0x00, sizeof(NRF24_RxPacket));
+        rx->pipe = TRANSPORT_PIPE;
+        rx->length = TRANSPORT_FRAME_SIZE;
+        rx->timestamp = sim_now();
+        memcpy(rx->data, mNodes[from].txFrames[0], TRANSPORT_FRAME_SIZE);
+    }
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        if (!sending[i])
+            continue;
+
+        memmove(mNodes[i].txFrames[0], mNodes[i].txFrames[1], sizeof(mNodes[i].txFrames[0]) * (TX_QUEUE - 1));
+        mNodes[i].txCount--;
+    }
+
+    mNowUs += SLOT_US;
+
+    for (i = 0 ; i < mNumNodes ; i++)
+    {
+        mCurrent = i;
+
+        for (j = 0 ; j < mNodes[i].rxCount ; j++)
+            mNodes[i].packet(&mNodes[i].rx[j]);
+
+        mNodes[i].rxCount = 0;
+        mNodes[i].service(sim_now());
+    }
+}
+
+
+static void sim_message(SimNode *node)
+{
+    uint16_t i;
+
+    node->length = TRANSPORT_MAX_MESSAGE;
+
+    for (i = 0 ; i < node->length ; i++)
+        node->message[i] = sim_random() & 0xFF;
+}
+
+
+//////////////////////////////////////////
+//Start a message from node index to node 2,
+//-1 if the transport says no
+static int sim_start(int index)
+{
+    sim_message(&mNodes[index]);
+    mCurrent = index;
+
+    return mNodes[index].send(2, mNodes[index].length, sim_read);
+}
+
+
+//////////////////////////////////////////
+//Steps until the senders given are done,
+//returns the ones that didn't end DONE.
+static int sim_wait(const int *senders, int count)
+{
+    uint64_t end = mNowUs + (MESSAGE_MS * 1000ULL);
+    int i, busy, failed = 0;
+
+    do
+    {
+        sim_step();
+        busy = 0;
+
+        for (i = 0 ; i < count ; i++)
+        {
+            if (mNodes[senders[i]].state() == TRANSPORT_STATE_BUSY)
+                busy++;
+        }
+    }
+    while (busy && (mNowUs < end));
+
+    for (i = 0 ; i < count ; i++)
+    {
+        if (mNodes[senders[i]].state() != TRANSPORT_STATE_DONE)
+            failed++;
+    }
+
+    //let the last SACKs and copies die out
+    for (i = 0 ; i < 100 ; i++)
+        sim_step();
+
+    return failed;
+}
+
+
+//////////////////////////////////////////
+//Node 1 to node 2, loss per mille.  Prints
+//the line for the case, returns failures
+static int sim_sweep(int messages, uint32_t loss)
+{
+    int sender = 0;
+    int i, failed = 0;
+    uint64_t airUs = 0, start;
+    uint32_t wrong = mWrong;
+    TransportStats stats, rxStats;
+    double rate, capacity;
+
+    sim_setup(2);
+    mLoss = loss;
+
+    for (i = 0 ; i < messages ; i++)
+    {
+        if (sim_start(sender) < 0)
+        {
+            failed++;
+            continue;
+        }
+
+        start = mNowUs;
+
+        //time to DONE, not the quiet steps after
+        while ((mNodes[sender].state() == TRANSPORT_STATE_BUSY) && ((mNowUs - start) < (MESSAGE_MS * 1000ULL)))
+            sim_step();
+
+        airUs += mNowUs - start;
+        failed += sim_wait(&sender, 1);
+    }
+
+    mCurrent = sender;
+    mNodes[sender].stats(&stats);
+    mCurrent = 1;
+    mNodes[1].stats(&rxStats);
+
+    rate = airUs ? ((double)mNodes[sender].delivered * TRANSPORT_MAX_MESSAGE * 1000000.0 / airUs) : 0.0;
+    capacity = TRANSPORT_FRAG_DATA * 1000000.0 / SLOT_US;
+
+    printf("sweep    loss %2u%%  delivered %3lu/%d  %6.0f B/s  %4.1f%% of %0.f  resent %5lu  sack %4u\n",
+        (unsigned)(loss / 10), (unsigned long)mNodes[sender].delivered, messages, rate,
+        100.0 * rate / capacity, capacity, (unsigned long)stats.retransmits, rxStats.sacks);
+
+    failed += (int)(messages - mNodes[sender].delivered);
+    return failed + (int)(mWrong - wrong);
+}
+
+
+//////////////////////////////////////////
+//Node 1 reboots after each message, its
+//first id after a reboot is the one before
+static int sim_reboot(int messages, uint32_t loss)
+{
+    int sender = 0;
+    int i, failed = 0;
+    uint32_t delivered = 0;
+    uint32_t wrong = mWrong;
+
+    sim_setup(2);
+    mLoss = loss;
+
+    for (i = 0 ; i < messages ; i++)
+    {
+        sim_load(sender, 1);
+
+        if (sim_start(sender) < 0)
+        {
+            failed++;
+            continue;
+        }
+
+        failed += sim_wait(&sender, 1);
+        delivered += mNodes[sender].delivered;
+    }
+
+    printf("reboot   loss %2u%%  delivered %3lu/%d\n", (unsigned)(loss / 10),
+        (unsigned long)delivered, messages);
+
+    return failed + (int)(messages - delivered) + (int)(mWrong - wrong);
+}
+
+
+//////////////////////////////////////////
+//Nodes 1 and 3 to node 2 at once
+static int sim_two(int messages, uint32_t loss)
+{
+    int senders[2] = {0, 2};
+    int i, j, failed = 0;
+    uint32_t wrong = mWrong;
+    TransportStats stats;
+
+    sim_setup(3);
+    mLoss = loss;
+
+    for (i = 0 ; i < messages ; i++)
+    {
+        if (sim_start(senders[0]) < 0)
+        {
+            failed++;
+            continue;
+        }
+
+        //no carrier sense, two senders in step collide
+        //every frame - the second one starts 0 - 20ms in
+        for (j = sim_random() % 45 ; j > 0 ; j--)
+            sim_step();
+
+        if (sim_start(senders[1]) < 0)
+        {
+            failed++;
+            continue;
+        }
+
+        failed += sim_wait(senders, 2);
+    }
+
+    mCurrent = 1;
+    mNodes[1].stats(&stats);
+
+    printf("two      loss %2u%%  delivered %3lu/%d + %3lu/%d  second sender frames %u\n",
+        (unsigned)(loss / 10), (unsigned long)mNodes[0].delivered, messages,
+        (unsigned long)mNodes[2].delivered, messages, stats.busy);
+
+    failed += (int)(messages - mNodes[0].delivered) + (int)(messages - mNodes[2].delivered);
+    return failed + (int)(mWrong - wrong);
+}
+
+
+//////////////////////////////////////////
+//Node 1 to node 2, node 3 hears it all
+static int sim_overhear(int messages, uint32_t loss)
+{
+    int sender = 0;
+    int i, failed = 0;
+    uint32_t wrong = mWrong;
+
+    sim_setup(3);
+    mLoss = loss;
+
+    for (i = 0 ; i < messages ; i++)
+    {
+        if (sim_start(sender) < 0)
+        {
+            failed++;
+            continue;
+        }
+
+        failed += sim_wait(&sender, 1);
+    }
+
+    printf("overhear loss %2u%%  delivered %3lu/%d  node 3 frames sent %lu\n",
+        (unsigned)(loss / 10), (unsigned long)mNodes[0].delivered, messages,
+        (unsigned long)mNodes[2].txFrameCount);
+
+    failed += (int)(messages - mNodes[0].delivered) + (int)mNodes[2].txFrameCount;
+    return failed + (int)(mWrong - wrong);
+}
+
+
+int main(int argc, char **argv)
+{
+    static const uint32_t loss[] = {0, 50, 100, 200, 300};
+    int messages = 50;
+    int failures = 0;
+    unsigned int i;
+
+    if (argc > 1)   messages = atoi(argv[1]);
+    if (argc > 2)   mRandom = atoi(argv[2]) | 1;
+
+    if (messages < 1)
+        messages = 50;
+
+    for (i = 0 ; i < sizeof(loss) / sizeof(loss[0]) ; i++)
+        failures += sim_sweep(messages, loss[i]);
+
+    failures += sim_reboot(messages, 0);
+    failures += sim_reboot(messages, 100);
+    failures += sim_two(messages, 0);
+    failures += sim_two(messages, 100);
+    failures += sim_overhear(messages, 0);
+    failures += sim_overhear(messages, 100);
+
+    printf("failures %d\n", failures);
+
+    return (failures > 255) ? 255 : failures;
+}
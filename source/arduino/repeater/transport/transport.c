@@ -0,0 +1,544 @@
+/*
+Transport - messages larger than one radio payload
+Dana Olcott
+
+See transport.h.  Main loop only, Transport_packet
+is called from nrf24_processRxPackets for pipe 4,
+Transport_service for the timers and to keep the
+window full.  Like mesh.c, no avr headers, the time
+comes in with the packets and the service call.
+
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "transport.h"
+#include "nrf24l01.h"
+#include "relay.h"          //crc8
+#include "mesh.h"           //node address
+
+
+static void (*mTransportCallback)(uint8_t src, uint16_t offset, const uint8_t *data, uint8_t length) = NULL;
+static uint32_t mTransportNow = 0x00;
+static TransportStats mTransportStats;
+
+//sender
+static TransportState_t mTxState = TRANSPORT_STATE_IDLE;
+static void (*mTxRead)(uint16_t offset, uint8_t *data, uint8_t length) = NULL;
+static uint16_t mTxLength = 0x00;
+static uint8_t mTxDst = 0x00;
+static uint8_t mTxId = 0x00;
+static uint16_t mTxSum = 0x00;                  //crc16 of the message
+static uint8_t mTxCount = 0x00;
+static uint16_t mTxAcked = 0x00;                //bitmap
+static uint16_t mTxSentMask = 0x00;             //bitmap, sent and not known lost
+static uint16_t mTxEverSent = 0x00;             //bitmap, sent at least once
+static uint32_t mTxSentTime[TRANSPORT_MAX_FRAGS];
+static uint32_t mTxProgress = 0x00;             //last new ack
+
+//receiver - fragments past the first hole wait
+//in mRxWindow, slot index % TRANSPORT_WINDOW
+static uint8_t mRxWindow[TRANSPORT_WINDOW][TRANSPORT_FRAG_DATA];
+static uint8_t mRxActive = 0;
+static uint8_t mRxSrc = 0x00;
+static uint8_t mRxId = 0x00;
+static uint16_t mRxSum = 0x00;                  //from the frames
+static uint16_t mRxCheck = 0x00;                //crc16 of what was handed over
+static uint8_t mRxCount = 0x00;
+static uint8_t mRxNext = 0x00;                  //first fragment not handed over
+static uint8_t mRxLastLength = 0x00;            //data in the last fragment
+static uint16_t mRxBitmap = 0x00;
+static uint32_t mRxLast = 0x00;                 //last new fragment
+static uint8_t mRxAckPending = 0;
+static uint32_t mRxAckDue = 0x00;
+
+//last messages completed
+static TransportDone mRxDone[TRANSPORT_DONE_SIZE];
+
+static void Transport_data(const TransportFrame *frame);
+static void Transport_sack(const TransportFrame *frame);
+static void Transport_sendSack(uint8_t dst, uint8_t id, uint16_t sum, uint8_t count, uint16_t bitmap);
+static int Transport_sendFragment(uint8_t index);
+static uint16_t Transport_fullMask(uint8_t count);
+static uint16_t Transport_crc16(uint16_t crc, const uint8_t *data, uint8_t length);
+
+
+/////////////////////////////////////////////
+//Clear the state.  Call after nrf24_init,
+//pipe 4 is set to 32 bytes wide.  callback
+//gets the messages received, see transport.h
+void Transport_init(void (*callback)(uint8_t src, uint16_t offset, const uint8_t *data, uint8_t length))
+{
+    mTransportCallback = callback;
+    mTxState = TRANSPORT_STATE_IDLE;
+    mRxActive = 0;
+    mRxAckPending = 0;
+    memset(mRxDone, 0x00, sizeof(mRxDone));
+    memset(&mTransportStats, 0x00, sizeof(mTransportStats));
+
+    nrf24_setRxPayLoadSize(TRANSPORT_PIPE, TRANSPORT_FRAME_SIZE);
+}
+
+
+/////////////////////////////////////////////////
+//One frame from the rx ring, pipe 4.  Frames
+//for other nodes are left alone.
+void Transport_packet(const NRF24_RxPacket *packet)
+{
+    TransportFrame frame;
+
+    mTransportNow = packet->timestamp;
+
+    if (packet->length != TRANSPORT_FRAME_SIZE)
+    {
+        mTransportStats.bad++;
+        return;
+    }
+
+    memcpy(&frame, packet->data, TRANSPORT_FRAME_SIZE);
+
+    if ((Relay_crc8((uint8_t*)&frame, TRANSPORT_FRAME_SIZE - 1) != frame.crc) ||
+        (frame.count == 0) || (frame.count > TRANSPORT_MAX_FRAGS))
+    {
+        mTransportStats.bad++;
+        return;
+    }
+
+    if (frame.dst != Mesh_getAddress())
+        return;
+
+    if (frame.type == TRANSPORT_TYPE_DATA)
+        Transport_data(&frame);
+
+    else if (frame.type == TRANSPORT_TYPE_SACK)
+        Transport_sack(&frame);
+
+    else
+        mTransportStats.bad++;
+}
+
+
+/////////////////////////////////////////////////////
+//Timers, call from the main loop and the Delay loop.
+//Receiver - SACK when the burst is over, drop a
+//stalled message.  Sender - give up on no progress,
+//fill the window with new and lost fragments.
+void Transport_service(uint32_t now)
+{
+    TransportDone *done;
+    uint8_t i, base, end;
+    uint16_t bit;
+
+    mTransportNow = now;
+
+    if (mRxAckPending && ((int32_t)(now - mRxAckDue) >= 0))
+    {
+        mRxAckPending = 0;
+        Transport_sendSack(mRxSrc, mRxId, mRxSum, mRxCount, mRxBitmap);
+    }
+
+    if (mRxActive && ((now - mRxLast) > TRANSPORT_RX_TIMEOUT_MS))
+    {
+        mRxActive = 0;
+        mRxAckPending = 0;
+        mTransportStats.rxTimeout++;
+    }
+
+    for (i = 0 ; i < TRANSPORT_DONE_SIZE ; i++)
+    {
+        done = &mRxDone[i];
+
+        if (done->ackPending && ((int32_t)(now - done->ackDue) >= 0))
+        {
+            done->ackPending = 0;
+            Transport_sendSack(done->src, done->id, done->sum, done->count, Transport_fullMask(done->count));
+        }
+
+        if (done->valid && ((now - done->time) > TRANSPORT_DONE_MS))
+        {
+            done->valid = 0;
+            done->ackPending = 0;
+        }
+    }
+
+    if (mTxState != TRANSPORT_STATE_BUSY)
+        return;
+
+    if ((now - mTxProgress) > TRANSPORT_TX_TIMEOUT_MS)
+    {
+        mTxState = TRANSPORT_STATE_FAILED;
+        mTransportStats.failed++;
+        return;
+    }
+
+    //window starts at the first fragment not acked
+    for (base = 0 ; base < mTxCount ; base++)
+    {
+        if (!(mTxAcked & (1u << base)))
+            break;
+    }
+
+    end = base + TRANSPORT_WINDOW;
+
+    if (end > mTxCount)
+        end = mTxCount;
+
+    for (i = base ; i < end ; i++)
+    {
+        bit = 1u << i;
+
+        if (mTxAcked & bit)
+            continue;
+
+        if ((mTxSentMask & bit) && ((now - mTxSentTime[i]) < (TRANSPORT_RTO_MS + TRANSPORT_RTO_SPREAD(Mesh_getAddress()))))
+            continue;
+
+        if (Transport_sendFragment(i) < 0)
+            break;                                  //radio queue full, next time
+    }
+}
+
+
+/////////////////////////////////////////////////////
+//Start sending a message of length bytes to node
+//dst.  read fills in each fragment as it goes out.
+//Returns 0 if started, -1 if a transfer is running,
+//the length or dst is bad.  Transport_getState goes
+//to DONE when every fragment is acked, FAILED if
+//the receiver stops answering.
+int Transport_send(uint8_t dst, uint16_t length, void (*read)(uint16_t offset, uint8_t *data, uint8_t length))
+{
+    uint8_t data[TRANSPORT_FRAG_DATA];
+    uint16_t offset;
+    uint8_t n;
+
+    if ((mTxState == TRANSPORT_STATE_BUSY) || (length == 0) || (length > TRANSPORT_MAX_MESSAGE) ||
+        (read == NULL) || (dst == MESH_ADDR_NONE) || (dst == MESH_ADDR_BROADCAST) ||
+        (dst == Mesh_getAddress()))
+        return -1;
+
+    //crc16 of the whole message, every frame carries
+    //it, so the receiver can't mix two messages up
+    mTxSum = 0xFFFF;
+
+    for (offset = 0 ; offset < length ; offset += n)
+    {
+        n = ((length - offset) > TRANSPORT_FRAG_DATA) ? TRANSPORT_FRAG_DATA : (uint8_t)(length - offset);
+        read(offset, data, n);
+        mTxSum = Transport_crc16(mTxSum, data, n);
+    }
+
+    mTxRead = read;
+    mTxLength = length;
+    mTxDst = dst;
+    mTxCount = (length + TRANSPORT_FRAG_DATA - 1) / TRANSPORT_FRAG_DATA;
+    mTxId++;
+    mTxAcked = 0x00;
+    mTxSentMask = 0x00;
+    mTxEverSent = 0x00;
+    mTxProgress = mTransportNow;
+    mTxState = TRANSPORT_STATE_BUSY;
+
+    Transport_service(mTransportNow);
+
+    return 0;
+}
+
+
+TransportState_t Transport_getState(void)
+{
+    return mTxState;
+}
+
+
+void Transport_getStats(TransportStats *stats)
+{
+    memcpy(stats, &mTransportStats, sizeof(TransportStats));
+}
+
+
+/////////////////////////////////////////////////
+//Fragment of the message being received.  A new
+//id or sum starts over.  Copies of the last
+//message done get a full SACK again, that one
+//was lost.  SACKs wait for the burst to stop,
+//the sender can't hear while it sends.
+static void Transport_data(const TransportFrame *frame)
+{
+    TransportDone *done;
+    uint16_t bit;
+    uint8_t i, slot, length;
+
+    if ((frame->index >= frame->count) || (frame->length > TRANSPORT_FRAG_DATA) ||
+        ((frame->index < (frame->count - 1)) && (frame->length != TRANSPORT_FRAG_DATA)) ||
+        (((uint16_t)frame->index * TRANSPORT_FRAG_DATA + frame->length) > TRANSPORT_MAX_MESSAGE))
+    {
+        mTransportStats.bad++;
+        return;
+    }
+
+    bit = 1u << frame->index;
+
+    for (i = 0 ; i < TRANSPORT_DONE_SIZE ; i++)
+    {
+        done = &mRxDone[i];
+
+        if (done->valid && (frame->src == done->src) && (frame->id == done->id) &&
+            (frame->sum == done->sum) && (frame->count == done->count))
+        {
+            done->ackPending = 1;
+            done->ackDue = mTransportNow + TRANSPORT_ACK_MS;
+            return;
+        }
+    }
+
+    //one sender at a time, the other one's frames go
+    //unanswered, it sends again after its RTO
+    if (mRxActive && (frame->src != mRxSrc))
+    {
+        mTransportStats.busy++;
+        return;
+    }
+
+    if (!mRxActive || (frame->id != mRxId) || (frame->sum != mRxSum) || (frame->count != mRxCount))
+    {
+        mRxActive = 1;
+        mRxSrc = frame->src;
+        mRxId = frame->id;
+        mRxSum = frame->sum;
+        mRxCheck = 0xFFFF;
+        mRxCount = frame->count;
+        mRxNext = 0x00;
+        mRxBitmap = 0x00;
+        mRxLast = mTransportNow;
+    }
+
+    //the sender's window starts at or below mRxNext,
+    //anything further out is a stray
+    if (frame->index >= (mRxNext + TRANSPORT_WINDOW))
+        return;
+
+    if (!(mRxBitmap & bit))
+    {
+        slot = frame->index % TRANSPORT_WINDOW;
+        memcpy(mRxWindow[slot], frame->data, frame->length);
+        mRxBitmap |= bit;
+
+        if (frame->index == (mRxCount - 1))
+            mRxLastLength = frame->length;
+
+        mRxLast = mTransportNow;
+
+        //hand over what is in order now
+        while ((mRxNext < mRxCount) && (mRxBitmap & (1u << mRxNext)))
+        {
+            slot = mRxNext % TRANSPORT_WINDOW;
+            length = (mRxNext == (mRxCount - 1)) ? mRxLastLength : TRANSPORT_FRAG_DATA;
+            mRxCheck = Transport_crc16(mRxCheck, mRxWindow[slot], length);
+
+            if (mTransportCallback)
+                mTransportCallback(mRxSrc, (uint16_t)mRxNext * TRANSPORT_FRAG_DATA, mRxWindow[slot], length);
+
+            mRxNext++;
+        }
+    }
+
+    if (mRxNext < mRxCount)
+    {
+        mRxAckPending = 1;
+        mRxAckDue = mTransportNow + TRANSPORT_ACK_MS;
+        return;
+    }
+
+    //all here - not the message the sender summed,
+    //it gets no end and no SACK
+    mRxActive = 0;
+    mRxAckPending = 0;
+
+    if (mRxCheck != mRxSum)
+    {
+        mTransportStats.bad++;
+        return;
+    }
+
+    //done, the full SACK once the burst stops.  It
+    //takes this sender's entry, or the oldest
+    done = &mRxDone[0];
+
+    for (i = 0 ; i < TRANSPORT_DONE_SIZE ; i++)
+    {
+        if (mRxDone[i].valid && (mRxDone[i].src == mRxSrc))
+        {
+            done = &mRxDone[i];
+            break;
+        }
+
+        if (!mRxDone[i].valid || (done->valid && ((int32_t)(mRxDone[i].time - done->time) < 0)))
+            done = &mRxDone[i];
+    }
+
+    done->valid = 1;
+    done->src = mRxSrc;
+    done->id = mRxId;
+    done->sum = mRxSum;
+    done->count = mRxCount;
+    done->time = mTransportNow;
+    done->ackPending = 1;
+    done->ackDue = mTransportNow + TRANSPORT_ACK_MS;
+    mTransportStats.received++;
+
+    if (mTransportCallback)
+        mTransportCallback(mRxSrc, ((uint16_t)(mRxCount - 1) * TRANSPORT_FRAG_DATA) + mRxLastLength, NULL, 0);
+}
+
+
+/////////////////////////////////////////////////
+//Receiver state for the message being sent.
+//Holes below the highest fragment received are
+//lost, they go again right away.
+static void Transport_sack(const TransportFrame *frame)
+{
+    uint16_t bitmap = frame->data[0] | ((uint16_t)frame->data[1] << 8);
+    uint16_t below;
+    uint8_t i;
+
+    if ((mTxState != TRANSPORT_STATE_BUSY) || (frame->src != mTxDst) || (frame->id != mTxId) ||
+        (frame->sum != mTxSum) || (frame->count != mTxCount))
+        return;
+
+    bitmap &= Transport_fullMask(mTxCount);
+
+    if (bitmap & ~mTxAcked)
+        mTxProgress = mTransportNow;
+
+    mTxAcked |= bitmap;
+
+    if (mTxAcked == Transport_fullMask(mTxCount))
+    {
+        mTxState = TRANSPORT_STATE_DONE;
+        mTransportStats.sent++;
+        return;
+    }
+
+    //highest received, everything missing below it
+    for (i = mTxCount ; i > 0 ; i--)
+    {
+        if (bitmap & (1u << (i - 1)))
+            break;
+    }
+
+    below = (i > 0) ? (uint16_t)((1u << (i - 1)) - 1) : 0x00;
+    mTxSentMask &= ~(below & ~mTxAcked);
+
+    //the SACK waited TRANSPORT_ACK_MS for quiet, a
+    //fragment sent that long ago that isn't in it was
+    //lost too - the end of a burst, nothing above it
+    for (i = 0 ; i < mTxCount ; i++)
+    {
+        if ((mTxSentMask & ~mTxAcked & (1u << i)) && ((mTransportNow - mTxSentTime[i]) >= TRANSPORT_ACK_MS))
+            mTxSentMask &= ~(1u << i);
+    }
+
+    Transport_service(mTransportNow);
+}
+
+
+static void Transport_sendSack(uint8_t dst, uint8_t id, uint16_t sum, uint8_t count, uint16_t bitmap)
+{
+    TransportFrame frame;
+    uint8_t first;
+
+    for (first = 0 ; first < count ; first++)
+    {
+        if (!(bitmap & (1u << first)))
+            break;
+    }
+
+    memset(&frame, 0x00, sizeof(frame));
+    frame.type = TRANSPORT_TYPE_SACK;
+    frame.src = Mesh_getAddress();
+    frame.dst = dst;
+    frame.id = id;
+    frame.sum = sum;
+    frame.index = first;
+    frame.count = count;
+    frame.data[0] = bitmap & 0xFF;
+    frame.data[1] = bitmap >> 8;
+    frame.crc = Relay_crc8((uint8_t*)&frame, TRANSPORT_FRAME_SIZE - 1);
+
+    if (nrf24_send(TRANSPORT_PIPE, (uint8_t*)&frame, TRANSPORT_FRAME_SIZE) == 0)
+        mTransportStats.sacks++;
+}
+
+
+///////////////////////////////////////////////
+//Fragment index of the message into the radio
+//tx queue.  -1 if the queue is full.
+static int Transport_sendFragment(uint8_t index)
+{
+    TransportFrame frame;
+    uint16_t offset = index * TRANSPORT_FRAG_DATA;
+    uint16_t length = mTxLength - offset;
+
+    if (length > TRANSPORT_FRAG_DATA)
+        length = TRANSPORT_FRAG_DATA;
+
+    memset(&frame, 0x00, sizeof(frame));
+    frame.type = TRANSPORT_TYPE_DATA;
+    frame.src = Mesh_getAddress();
+    frame.dst = mTxDst;
+    frame.id = mTxId;
+    frame.sum = mTxSum;
+    frame.index = index;
+    frame.count = mTxCount;
+    frame.length = (uint8_t)length;
+    mTxRead(offset, frame.data, (uint8_t)length);
+    frame.crc = Relay_crc8((uint8_t*)&frame, TRANSPORT_FRAME_SIZE - 1);
+
+    if (nrf24_send(TRANSPORT_PIPE, (uint8_t*)&frame, TRANSPORT_FRAME_SIZE) < 0)
+        return -1;
+
+    if (mTxEverSent & (1u << index))
+        mTransportStats.retransmits++;
+    else
+        mTransportStats.fragments++;
+
+    mTxEverSent |= (1u << index);
+    mTxSentMask |= (1u << index);
+    mTxSentTime[index] = mTransportNow;
+
+    return 0;
+}
+
+
+static uint16_t Transport_fullMask(uint8_t count)
+{
+    return (count >= 16) ? 0xFFFF : (uint16_t)((1u << count) - 1);
+}
+
+
+///////////////////////////////////////////
+//CRC16 CCITT as telemetry.c, carried on
+//from crc (0xFFFF to start)
+static uint16_t Transport_crc16(uint16_t crc, const uint8_t *data, uint8_t length)
+{
+    uint8_t i, bit;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+
+        for (bit = 0 ; bit < 8 ; bit++)
+        {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc = crc << 1;
+        }
+    }
+
+    return crc;
+}
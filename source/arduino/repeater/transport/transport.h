@@ -0,0 +1,163 @@
+/*
+Transport - messages larger than one radio payload
+Dana Olcott
+
+Splits a message up to TRANSPORT_MAX_MESSAGE bytes into
+numbered fragments, the receiver puts them back in
+order and hands them to a callback as they come.
+
+Frames are 32 bytes on pipe 4 (TRANSPORT_PIPE), both
+ways.  Fixed width link or Enhanced ShockBurst.
+
+Frame:
+type, src, dst, id, sum, index, count, length, data[22], crc8
+
+src / dst       node addresses, Mesh_getAddress.  Every
+                node hears every frame, only dst takes it
+sum             crc16 of the whole message (CCITT, as
+                telemetry), lsb first
+DATA    one fragment, index 0 - count-1, length bytes
+        of data (22, less in the last one)
+SACK    receiver state for message id.  index is the
+        first fragment missing (all received = count),
+        data[0] / data[1] the bitmap of fragments
+        received, lsb first
+
+Sender - sliding window.  Up to TRANSPORT_WINDOW
+fragments past the first one not acked are in the
+air at once, no stop and wait per fragment.  The
+radio doesn't reorder, so a hole in the SACK bitmap
+below the highest fragment received was lost and is
+sent again right away, so is anything sent
+TRANSPORT_ACK_MS before a SACK that isn't in it (the
+end of a burst).  Anything else not acked in
+TRANSPORT_RTO_MS is sent again.  There is no carrier
+sense, two senders retrying on the same RTO would
+collide every time - each node adds a few ms by its
+address, TRANSPORT_RTO_SPREAD.
+
+Receiver - one message at a time, src and id.  Frames
+from another sender get no SACK until it is done, that
+sender tries again after its RTO.  The callback gets
+the data in order, fragments past a hole wait in a
+TRANSPORT_WINDOW fragment buffer (the sender never
+runs further ahead), so there is no whole message
+buffer.  The callback gets data NULL when the message
+is complete, offset is its length.  Half duplex, the
+SACK goes out once the burst stops (TRANSPORT_ACK_MS
+with no frame, the sender is listening again), also
+for a complete message.  A message with no new
+fragment for TRANSPORT_RX_TIMEOUT_MS is dropped, the
+callback doesn't hear about it again.
+
+Copies of the last TRANSPORT_DONE_SIZE messages done
+get a full SACK for TRANSPORT_DONE_MS, the SACK was
+lost - the one for the first of two senders is often
+lost in the second one's burst.  A message is
+src, id and sum: a sender that rebooted starts its
+ids over, its next message has the same id but
+another sum.  The receiver sums what it hands over,
+a message that doesn't match gets no end and no SACK.
+
+The sender reads the message through a callback, once
+for the sum and then as each fragment goes out (again
+for a retransmit).  Keep the data the same until the
+transfer is done.
+
+*/
+
+#ifndef __TRANSPORT__H
+#define __TRANSPORT__H
+
+#include <stdint.h>
+
+#include "nrf24l01.h"
+
+#define TRANSPORT_PIPE              4
+#define TRANSPORT_FRAME_SIZE        32
+#define TRANSPORT_FRAG_DATA         22          //data bytes per fragment
+
+#define TRANSPORT_MAX_MESSAGE       256         //whole eeprom
+#define TRANSPORT_MAX_FRAGS         ((TRANSPORT_MAX_MESSAGE + TRANSPORT_FRAG_DATA - 1) / TRANSPORT_FRAG_DATA)    //16 max, bitmap
+#define TRANSPORT_WINDOW            6           //radio tx queue + fifo
+#define TRANSPORT_DONE_SIZE         2           //messages done, their copies get a full SACK
+
+//ms
+#define TRANSPORT_ACK_MS            2           //quiet time before the SACK
+#define TRANSPORT_RTO_MS            40          //no SACK, send again
+#define TRANSPORT_RTO_SPREAD(a)     ((a) & 0x07u)  //+ms by address, two senders out of step
+#define TRANSPORT_RX_TIMEOUT_MS     1000        //drop a partial message
+#define TRANSPORT_TX_TIMEOUT_MS     2000        //no progress, give up
+#define TRANSPORT_DONE_MS           TRANSPORT_TX_TIMEOUT_MS     //copies of the last message, the sender gives up by then
+
+typedef enum
+{
+    TRANSPORT_TYPE_DATA = 1,
+    TRANSPORT_TYPE_SACK
+}TransportType_t;
+
+typedef enum
+{
+    TRANSPORT_STATE_IDLE,
+    TRANSPORT_STATE_BUSY,
+    TRANSPORT_STATE_DONE,
+    TRANSPORT_STATE_FAILED
+}TransportState_t;
+
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t src;
+    uint8_t dst;
+    uint8_t id;
+    uint16_t sum;
+    uint8_t index;
+    uint8_t count;
+    uint8_t length;
+    uint8_t data[TRANSPORT_FRAG_DATA];
+    uint8_t crc;
+}TransportFrame;
+
+
+//message received, full SACK for its copies
+typedef struct
+{
+    uint8_t valid;
+    uint8_t src;
+    uint8_t id;
+    uint16_t sum;
+    uint8_t count;
+    uint8_t ackPending;
+    uint32_t time;                              //done
+    uint32_t ackDue;
+}TransportDone;
+
+
+typedef struct
+{
+    uint16_t sent;                              //messages acked
+    uint16_t failed;
+    uint16_t received;                          //messages put back together
+    uint16_t rxTimeout;
+    uint32_t fragments;                         //sent, first time
+    uint32_t retransmits;
+    uint16_t sacks;                             //sent
+    uint16_t bad;                               //crc / bad header
+    uint16_t busy;                              //frames from a second sender
+}TransportStats;
+
+
+//callback - data in order, NULL at the end
+void Transport_init(void (*callback)(uint8_t src, uint16_t offset, const uint8_t *data, uint8_t length));
+
+void Transport_packet(const NRF24_RxPacket *packet);
+void Transport_service(uint32_t now);
+
+//read - length bytes of the message from offset
+int Transport_send(uint8_t dst, uint16_t length, void (*read)(uint16_t offset, uint8_t *data, uint8_t length));
+TransportState_t Transport_getState(void);
+void Transport_getStats(TransportStats *stats);
+
+
+#endif
@@ -7,6 +7,7 @@ Utility Functions
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <avr/pgmspace.h>
 
 #include "utility.h"
 
@@ -58,7 +59,7 @@ uint8_t utility_data2HexBuffer(uint8_t* input, uint8_t len, uint8_t* output)
 
     for (i = 0 ; i < len ; i++)
     {
-        n = sprintf(output + offset, "0x%02x ", input[i]);
+        n = sprintf_P(output + offset, PSTR("0x%02x "), input[i]);
         offset += n;
     }
 
@@ -23,6 +23,7 @@ INT1 - PD3 - Also config as interrupt, falling, pullup
 ///////////////////////////////////////////////
 
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <avr/io.h>         //macros
 #include <stdio.h>
 #include <string.h>
@@ -30,6 +31,7 @@ INT1 - PD3 - Also config as interrupt, falling, pullup
 #include "register.h"
 #include "spi.h"
 #include "usart.h"
+#include "timerwheel.h"     //software timers on the Timer0 tick
 
 //includes for fat fs - call int SD_Init(void);
 
@@ -40,7 +42,7 @@ void LED_on(void);
 void LED_off(void);
 void LED_toggle(void);
 void Timer0_init(void);
-void Timer2_init(void);
+void LED_blink(void *arg);
 void Interrupt_init(void);
 
 
@@ -49,14 +51,23 @@ void Interrupt_init(void);
 void Delay(unsigned long val);
 volatile unsigned long gTimeTick = 0x00;
 
+static TimerWheelTimer mBlinkTimer;     //LED, 500ms
+
 ///////////////////////////////
 //Timer0 Overflow Interrupt ISR
 //Configured to run at 1khz, it's
 //pretty close, runs a little slow.
 //
+//Also the fatfs timer.  This used to be on
+//Timer2 at the same rate.  disk_timerproc stays
+//in the isr, the disk driver spins on its
+//counters.  Everything else goes on the wheel.
+//
 ISR(TIMER0_OVF_vect)
 {
     gTimeTick++;        //used by Delay
+    disk_timerproc();   //fatfs timer management
+    TimerWheel_Tick();  //software timers
 
     //clear interrupt - datasheet shows
     //this bit has to be set to run timer
@@ -64,21 +75,6 @@ ISR(TIMER0_OVF_vect)
 }
 
 
-////////////////////////////////////
-//Timer2 - Dedicated Timer for SDCard
-//Calls the timer management function
-//for the fatfs
-ISR(TIMER2_OVF_vect)
-{
-    //fatfs timer management
-    disk_timerproc();
-
-    //clear interrupt - datasheet shows
-    //this bit has to be set to run timer
-    TIFR2_R |= 0x01;
-}
-
-
 
 //////////////////////////////////
 //INT0 ISR
@@ -112,6 +108,16 @@ ISR(USART_RX_vect)
 }
 
 
+//////////////////////////////////////
+//usart data register empty interrupt
+//sends the next byte from the tx ring
+//
+ISR(USART_UDRE_vect)
+{
+    Usart_txIsr();
+}
+
+
 uint8_t buffer[100] = {0x00};
 int n = 0;
 unsigned char res = 0x00;
@@ -119,8 +125,8 @@ unsigned char res = 0x00;
 int main()
 {
     GPIO_init();                    //configure led and button
-    Timer0_init();                  //Timer0 Counter Overflow
-    Timer2_init();                  //Timer2 Counter Overflow
+    TimerWheel_Init();              //before the tick starts
+    Timer0_init();                  //Timer0 Counter Overflow - also fatfs timer
     SPI_init();			            //init spi
     Usart_init(115200);    
 //    SD_Init();
@@ -148,10 +154,10 @@ int main()
 //    n = sprintf(buffer, "Hello into file 1\r\n");
 //    SD_AppendData("FILE1.TXT", buffer, n);
 
+    TimerWheel_Start(&mBlinkTimer, 500, 500, LED_blink, NULL);
+
     while(1)
     {
-        LED_toggle();
-        
         //int SD_PrintFileToBuffer(char* name, uint8_t* dest, uint32_t maxbytes);
 
         n = SD_PrintFileToBuffer("HELLO.TXT", buffer, 100);
@@ -219,6 +225,12 @@ void LED_toggle(void)
   PORTB_DATA_R ^= BIT0;
 }
 
+//timer wheel callback
+void LED_blink(void *arg)
+{
+  LED_toggle();
+}
+
 //////////////////////////////////////////
 //Configure Timer0 with Overflow Interrupt
 //
@@ -257,48 +269,32 @@ void Timer0_init(void)
 
 
 
-//////////////////////////////////////////
-//Configure Timer2 with Overflow Interrupt
-//The configuration should be similar to Timer0
-//in that both are 8 bit and will also be 
-//configured to overflow at 1khz
-//
-void Timer2_init(void)
-{
-    //Timer Control - 2 registers:
-    TCCR2A_R = 0x00;      //disable all pin outputs on compare
-    TCCR2B_R = 0x04;      //set the prescaler - bits 0-2
-
-    //NOTE: Prescale values for Timer2 are not the same
-    //as Timer0.  ie, to get clk / 64, need to write 0x04
-
-    //    000 - no clock - timer disabled
-    //    001 - no prescale
-    //    010 - clk/8
-    //    011 - clk/32
-    //    100 - clk/64
-    //    101 - clk/128
-    //    110 - clk/256
-    //    111 - clk/1024
-
-    TIMSK2_R |= 0x01;       //bit 0 - overflow interrupt
-    TIFR2_R |= 0x01;        //clear the overflow flag
-
-    //enable global interrupts
-    __SEI;
-}
-
-
-
-
-
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0 or a usart
+//byte wakes it.
+//Usart command lines run here, the rx isr
+//only queues them.
+//Timer wheel callbacks run here.
 void Delay(unsigned long val)
 {
 	volatile unsigned long t = val;
     gTimeTick = 0x00;           //upcounter
-    while (t > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0, spi and usart keep running
+    while (t > gTimeTick)
+    {
+        Usart_processLines();           //command lines, outside the rx isr
+        TimerWheel_Process();
+        cli();
+        if (t > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
@@ -0,0 +1,173 @@
+/*
+Timer wheel check - runs on the pc
+Dana Olcott
+
+Runs timerwheel.c against a brute force reference:
+every timer's next due tick kept in a plain array.
+Random starts (one shot and periodic, out past both
+levels so they park and cascade), stops, restarts
+from inside callbacks, and main loop stalls where
+TimerWheel_Process doesn't run for a few ticks.
+
+Each callback must come on the first Process at or
+after its due tick, exactly once, and nothing due
+may be left after a Process.  Any miss is printed,
+the exit code is the error count (0 - pass).
+
+Build:  gcc -std=c99 -O2 -Wall -DTIMERWHEEL_HOST -I.. \
+            -o wheelcheck wheelcheck.c ../timerwheel.c
+Run:    ./wheelcheck [ticks] [seed]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "timerwheel.h"
+
+#define NUM_TIMERS          64
+#define MAX_START           3000        //ticks, past L0 * L1 (1024)
+#define MAX_PERIOD          3000
+#define STALL_MAX           20          //ticks without Process
+#define MAX_ERRORS          20          //printed
+
+
+typedef struct
+{
+    uint8_t active;
+    uint32_t due;                       //absolute tick
+    uint32_t period;
+}Reference;
+
+
+static TimerWheelTimer mTimers[NUM_TIMERS];
+static Reference mRef[NUM_TIMERS];
+static uint32_t mLastProcess = 0;       //tick of the last Process
+static unsigned long mErrors = 0;
+static unsigned long mFired = 0;
+static unsigned long mStarts = 0;
+static unsigned long mStops = 0;
+
+static void check_callback(void *arg);
+
+
+static uint32_t rnd(uint32_t n)
+{
+    return (uint32_t)(rand() % n);
+}
+
+
+static void error(const char *what, int i, uint32_t now)
+{
+    if (mErrors++ < MAX_ERRORS)
+        printf("tick %lu timer %d: %s (due %lu)\n", (unsigned long)now, i, what,
+                (unsigned long)mRef[i].due);
+}
+
+
+static void start(int i)
+{
+    uint32_t ticks = 1 + rnd(MAX_START);
+    uint32_t period = rnd(10) < 4 ? 0 : 1 + rnd(MAX_PERIOD);
+
+    TimerWheel_Start(&mTimers[i], ticks, period, check_callback, &mTimers[i]);
+
+    mRef[i].active = 1;
+    mRef[i].due = TimerWheel_GetTick() + ticks;
+    mRef[i].period = period;
+    mStarts++;
+}
+
+
+static void stop(int i)
+{
+    TimerWheel_Stop(&mTimers[i]);
+    mRef[i].active = 0;
+    mStops++;
+}
+
+
+//////////////////////////////////////////
+//Check the fire against the reference, move
+//the reference on like Process does, then
+//stir things up
+static void check_callback(void *arg)
+{
+    int i = (int)((TimerWheelTimer*)arg - mTimers);
+    uint32_t now = TimerWheel_GetTick();
+
+    mFired++;
+
+    if (!mRef[i].active)
+        error("fired while stopped", i, now);
+    else if ((int32_t)(mRef[i].due - now) > 0)
+        error("early", i, now);
+    else if ((int32_t)(mRef[i].due - mLastProcess) <= 0)
+        error("late, due at an earlier Process", i, now);
+
+    if (mRef[i].period)
+    {
+        mRef[i].due += mRef[i].period;
+
+        if ((int32_t)(mRef[i].due - now) <= 0)
+            mRef[i].due = now + 1;
+    }
+    else
+        mRef[i].active = 0;
+
+    if (rnd(10) == 0)
+        start(rnd(NUM_TIMERS));
+    else if (rnd(20) == 0)
+        stop(rnd(NUM_TIMERS));
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned long ticks = (argc > 1) ? strtoul(argv[1], NULL, 0) : 3000000;
+    unsigned int seed = (argc > 2) ? (unsigned int)atoi(argv[2]) : 1;
+    uint32_t stall = 0;
+    unsigned long t;
+    int i;
+
+    srand(seed);
+    TimerWheel_Init();
+
+    for (t = 0 ; t < ticks ; t++)
+    {
+        TimerWheel_Tick();
+
+        //main loop between ticks
+        if (rnd(50) == 0)
+            start(rnd(NUM_TIMERS));
+        if (rnd(200) == 0)
+            stop(rnd(NUM_TIMERS));
+
+        if (stall)
+        {
+            stall--;
+            continue;
+        }
+
+        if (rnd(1000) == 0)
+            stall = 1 + rnd(STALL_MAX);
+
+        TimerWheel_Process();
+        mLastProcess = TimerWheel_GetTick();
+
+        for (i = 0 ; i < NUM_TIMERS ; i++)
+        {
+            if (mRef[i].active && ((int32_t)(mRef[i].due - mLastProcess) <= 0))
+            {
+                error("missed", i, mLastProcess);
+                mRef[i].active = 0;
+            }
+        }
+    }
+
+    printf("%lu ticks seed %u: %lu starts, %lu stops, %lu callbacks, %lu errors\n",
+            ticks, seed, mStarts, mStops, mFired, mErrors);
+
+    return (mErrors > 255) ? 255 : (int)mErrors;
+}
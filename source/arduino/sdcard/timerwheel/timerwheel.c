@@ -0,0 +1,264 @@
+/*
+ * timerwheel.c
+ *
+ *  Author: danao
+
+ Two level timer wheel, see timerwheel.h
+
+ Slot lists are doubly linked through pprev (pointer
+ to whatever points at this timer), so a timer can be
+ removed without knowing which slot it is in.
+
+ Slot for a timer, delta = expire - now:
+ delta < L0 size            level 0, expire & L0 mask
+ delta < L0 * L1 size       level 1, (expire >> L0 bits) & L1 mask
+ anything longer            level 1, last slot before now
+
+ When level 0 wraps, the next level 1 slot is
+ emptied and its timers are inserted again, which
+ puts them in level 0 (or back in level 1 if they
+ were parked).
+
+ */
+
+#include "timerwheel.h"
+
+
+static TimerWheelTimer *mWheelL0[TIMERWHEEL_L0_SIZE];
+static TimerWheelTimer *mWheelL1[TIMERWHEEL_L1_SIZE];
+
+static TimerWheelTimer *mPendingHead = NULL;            //expired, oldest first
+static TimerWheelTimer **mPendingTail = &mPendingHead;
+static volatile uint32_t mWheelTick = 0x00;
+
+static void TimerWheel_Link(TimerWheelTimer **head, TimerWheelTimer *timer);
+static void TimerWheel_Unlink(TimerWheelTimer *timer);
+static void TimerWheel_Insert(TimerWheelTimer *timer);
+static void TimerWheel_Cascade(uint32_t slot);
+
+
+///////////////////////////////////////
+//Clear all slots.  Call before the tick
+//interrupt is enabled.
+void TimerWheel_Init(void)
+{
+    for (unsigned int i = 0 ; i < TIMERWHEEL_L0_SIZE ; i++)
+        mWheelL0[i] = NULL;
+
+    for (unsigned int i = 0 ; i < TIMERWHEEL_L1_SIZE ; i++)
+        mWheelL1[i] = NULL;
+
+    mPendingHead = NULL;
+    mPendingTail = &mPendingHead;
+    mWheelTick = 0x00;
+}
+
+
+///////////////////////////////////////////
+//Advance the wheel one tick.  Call from the
+//tick interrupt.  Expired timers move to the
+//pending list, callbacks run in Process.
+void TimerWheel_Tick(void)
+{
+    TimerWheelTimer *timer;
+    uint32_t now = mWheelTick + 1;
+
+    mWheelTick = now;
+
+    //level 0 wrapped - pull down the next level 1 slot
+    if (!(now & TIMERWHEEL_L0_MASK))
+        TimerWheel_Cascade((now >> TIMERWHEEL_L0_BITS) & TIMERWHEEL_L1_MASK);
+
+    while ((timer = mWheelL0[now & TIMERWHEEL_L0_MASK]) != NULL)
+    {
+        TimerWheel_Unlink(timer);
+
+        timer->next = NULL;
+        timer->pprev = mPendingTail;
+        *mPendingTail = timer;
+        mPendingTail = &timer->next;
+        timer->state = TIMERWHEEL_STATE_PENDING;
+    }
+}
+
+
+//////////////////////////////////////////////////
+//Run the callbacks of expired timers.  Call from
+//the main loop.  Periodic timers are put back on
+//the wheel before the callback runs, so the callback
+//can stop or restart its own timer.  Returns the
+//number of callbacks run.
+unsigned int TimerWheel_Process(void)
+{
+    unsigned int count = 0;
+
+    while (1)
+    {
+        TimerWheelCallback callback = NULL;
+        void *arg = NULL;
+
+        TIMERWHEEL_ENTER_CRITICAL();
+
+        TimerWheelTimer *timer = mPendingHead;
+
+        if (timer != NULL)
+        {
+            TimerWheel_Unlink(timer);
+            callback = timer->callback;
+            arg = timer->arg;
+
+            if (timer->period > 0)
+            {
+                timer->expire += timer->period;     //no drift
+
+                //late - more than a period behind, skip to the next tick
+                if ((int32_t)(timer->expire - mWheelTick) <= 0)
+                    timer->expire = mWheelTick + 1;
+
+                TimerWheel_Insert(timer);
+            }
+            else
+                timer->state = TIMERWHEEL_STATE_IDLE;
+        }
+
+        TIMERWHEEL_EXIT_CRITICAL();
+
+        if (timer == NULL)
+            break;
+
+        if (callback != NULL)
+            callback(arg);
+
+        count++;
+    }
+
+    return count;
+}
+
+
+//////////////////////////////////////////////////
+//Start a timer, ticks from now.  period = 0 for a
+//one shot, or the reload in ticks.  Restarts the
+//timer if it is already running.
+void TimerWheel_Start(TimerWheelTimer *timer, uint32_t ticks, uint32_t period, TimerWheelCallback callback, void *arg)
+{
+    if (ticks == 0)
+        ticks = 1;
+
+    TIMERWHEEL_ENTER_CRITICAL();
+
+    if (timer->state != TIMERWHEEL_STATE_IDLE)
+        TimerWheel_Unlink(timer);
+
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->period = period;
+    timer->expire = mWheelTick + ticks;
+    TimerWheel_Insert(timer);
+
+    TIMERWHEEL_EXIT_CRITICAL();
+}
+
+
+////////////////////////////////////////////
+//Stop a timer.  A pending callback that has
+//not run yet is cancelled too.
+void TimerWheel_Stop(TimerWheelTimer *timer)
+{
+    TIMERWHEEL_ENTER_CRITICAL();
+
+    if (timer->state != TIMERWHEEL_STATE_IDLE)
+    {
+        TimerWheel_Unlink(timer);
+        timer->state = TIMERWHEEL_STATE_IDLE;
+    }
+
+    TIMERWHEEL_EXIT_CRITICAL();
+}
+
+
+uint8_t TimerWheel_IsActive(TimerWheelTimer *timer)
+{
+    return (timer->state != TIMERWHEEL_STATE_IDLE) ? 1 : 0;
+}
+
+
+uint32_t TimerWheel_GetTick(void)
+{
+    return mWheelTick;
+}
+
+
+////////////////////////////////////////
+//Push timer on the front of a slot list
+static void TimerWheel_Link(TimerWheelTimer **head, TimerWheelTimer *timer)
+{
+    timer->next = *head;
+    timer->pprev = head;
+
+    if (*head != NULL)
+        (*head)->pprev = &timer->next;
+
+    *head = timer;
+}
+
+
+/////////////////////////////////////////////
+//Remove timer from whatever list it is in.
+//Fixes the pending tail if it was the last.
+static void TimerWheel_Unlink(TimerWheelTimer *timer)
+{
+    if (mPendingTail == &timer->next)
+        mPendingTail = timer->pprev;
+
+    *timer->pprev = timer->next;
+
+    if (timer->next != NULL)
+        timer->next->pprev = timer->pprev;
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+
+///////////////////////////////////////////////
+//Put timer in its slot from timer->expire.
+//Interrupts off, or called from the tick ISR.
+//delta = 0 only happens from the cascade, which
+//runs before the current level 0 slot is emptied.
+static void TimerWheel_Insert(TimerWheelTimer *timer)
+{
+    uint32_t now = mWheelTick;
+    uint32_t delta = timer->expire - now;
+
+    if (delta < TIMERWHEEL_L0_SIZE)
+        TimerWheel_Link(&mWheelL0[timer->expire & TIMERWHEEL_L0_MASK], timer);
+
+    else if (delta < (TIMERWHEEL_L0_SIZE * TIMERWHEEL_L1_SIZE))
+        TimerWheel_Link(&mWheelL1[(timer->expire >> TIMERWHEEL_L0_BITS) & TIMERWHEEL_L1_MASK], timer);
+
+    //out of range - park it in the last slot to cascade
+    else
+        TimerWheel_Link(&mWheelL1[((now >> TIMERWHEEL_L0_BITS) - 1) & TIMERWHEEL_L1_MASK], timer);
+
+    timer->state = TIMERWHEEL_STATE_WHEEL;
+}
+
+
+//////////////////////////////////////////////
+//Move every timer in a level 1 slot down to
+//level 0 (or re-park it).  Tick ISR only.
+static void TimerWheel_Cascade(uint32_t slot)
+{
+    TimerWheelTimer *list = mWheelL1[slot];
+
+    mWheelL1[slot] = NULL;
+
+    while (list != NULL)
+    {
+        TimerWheelTimer *timer = list;
+
+        list = timer->next;
+        TimerWheel_Insert(timer);
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * timerwheel.h
+ *
+ *  Author: danao
+
+ Software timers on one hardware tick.
+
+ Two level hierarchical timer wheel.  Level 0 has one
+ slot per tick, level 1 has one slot per level 0 turn.
+ Timers further out than both levels park in the last
+ level 1 slot and get re-sorted when it cascades.
+
+ Start / stop are O(1).  Each tick the ISR moves the
+ timers in the current level 0 slot to a pending list,
+ also O(1) per timer.  Callbacks are not run in the
+ ISR, TimerWheel_Process() runs them from the main loop.
+
+ Timers are owned by the caller (static), nothing is
+ allocated.  The sdcard project runs its led blink on
+ it.  host/wheelcheck.c checks it on the pc.
+
+ Usage:
+ tick ISR:      TimerWheel_Tick();
+ main loop:     TimerWheel_Process();
+
+ static TimerWheelTimer blink;
+ TimerWheel_Start(&blink, 500, 500, LED_toggle_cb, NULL);   //periodic
+ TimerWheel_Start(&once, 100, 0, Done_cb, NULL);            //one shot
+
+ */
+
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+////////////////////////////////////////////
+//Wheel size, bits per level.  Timers within
+//2^(L0 + L1) ticks are placed directly.
+#ifndef TIMERWHEEL_L0_BITS
+#define TIMERWHEEL_L0_BITS          5
+#endif
+
+#ifndef TIMERWHEEL_L1_BITS
+#define TIMERWHEEL_L1_BITS          5
+#endif
+
+#define TIMERWHEEL_L0_SIZE          (1u << TIMERWHEEL_L0_BITS)
+#define TIMERWHEEL_L0_MASK          (TIMERWHEEL_L0_SIZE - 1)
+#define TIMERWHEEL_L1_SIZE          (1u << TIMERWHEEL_L1_BITS)
+#define TIMERWHEEL_L1_MASK          (TIMERWHEEL_L1_SIZE - 1)
+
+
+////////////////////////////////////////////
+//Critical section - the tick ISR and the
+//main loop share the lists.
+#if defined(__AVR__)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define TIMERWHEEL_ENTER_CRITICAL()     uint8_t _twSreg = SREG; cli()
+#define TIMERWHEEL_EXIT_CRITICAL()      SREG = _twSreg
+
+#elif defined(TIMERWHEEL_HOST)
+
+//pc, host/wheelcheck.c - one thread
+#define TIMERWHEEL_ENTER_CRITICAL()
+#define TIMERWHEEL_EXIT_CRITICAL()
+
+#endif
+
+
+typedef void (*TimerWheelCallback)(void *arg);
+
+typedef enum
+{
+    TIMERWHEEL_STATE_IDLE,          //not running
+    TIMERWHEEL_STATE_WHEEL,         //waiting in a slot
+    TIMERWHEEL_STATE_PENDING,       //expired, callback not run yet
+}TimerWheelState_t;
+
+
+typedef struct TimerWheelTimer
+{
+    struct TimerWheelTimer *next;
+    struct TimerWheelTimer **pprev;     //previous next field, or the list head
+    uint32_t expire;                    //absolute tick
+    uint32_t period;                    //0 - one shot
+    TimerWheelCallback callback;
+    void *arg;
+    volatile uint8_t state;
+}TimerWheelTimer;
+
+
+void TimerWheel_Init(void);
+void TimerWheel_Tick(void);
+unsigned int TimerWheel_Process(void);
+
+void TimerWheel_Start(TimerWheelTimer *timer, uint32_t ticks, uint32_t period, TimerWheelCallback callback, void *arg);
+void TimerWheel_Stop(TimerWheelTimer *timer);
+uint8_t TimerWheel_IsActive(TimerWheelTimer *timer);
+uint32_t TimerWheel_GetTick(void);
+
+
+#endif /* TIMERWHEEL_H_ */
@@ -10,8 +10,26 @@
 #include "register.h"
 #include "usart.h"
 
+//rx line queue - the isr fills line rxLineHead,
+//the main loop takes complete lines from rxLineTail
 static volatile unsigned char rxIndex = 0x00;
-static volatile unsigned char rxBuffer[RX_BUFFER_SIZE];
+static volatile unsigned char rxLineHead = 0x00;    //free running, written by the isr
+static volatile unsigned char rxLineTail = 0x00;    //free running, written by the main loop
+static volatile unsigned int rxLinesDropped = 0x00;
+static volatile unsigned char rxDiscard = 0;        //drop up to the next '\n'
+static unsigned char rxLines[RX_LINE_COUNT][RX_BUFFER_SIZE];
+static unsigned char rxLineLength[RX_LINE_COUNT];
+
+//compiler barrier - line data in memory before
+//the index that hands it over
+#define USART_BARRIER()     __asm__ __volatile__ ("" ::: "memory")
+
+//tx ring, UDRE interrupt sends
+static volatile unsigned char txHead = 0x00;        //written by senders
+static volatile unsigned char txTail = 0x00;        //written by Usart_txIsr
+static volatile unsigned char txStarted = 0;        //sent since the last flush
+static volatile unsigned int txDropped = 0x00;
+static unsigned char txBuffer[TX_BUFFER_SIZE];
 
 
 ///////////////////////////////////////
@@ -26,7 +44,14 @@ void Usart_init(unsigned long baud)
 {
 
     rxIndex = 0x00;
-    memset((char*)rxBuffer, 0x00, RX_BUFFER_SIZE);
+    rxLineHead = 0x00;
+    rxLineTail = 0x00;
+    rxLinesDropped = 0x00;
+    rxDiscard = 0;
+    txHead = 0x00;
+    txTail = 0x00;
+    txStarted = 0;
+    txDropped = 0x00;
 
     //configure the baud rate
     UBRR0H_R = 0x00;
@@ -69,7 +94,7 @@ void Usart_init(unsigned long baud)
     //UCSR0B_R - 0xC1 - config interrupts and tx/rx enable
     //bit 7 - RX complete interrupt enable - set high
     //bit 6 - tx complete interrupt - 0
-    //bit 5 - 0
+    //bit 5 - data reg empty interrupt - 0, set while the tx ring has data
     //bit 4 - rx enable - 1
     //bit 3 - tx enable - 1
     //bit 2 - 1 - dont care
@@ -100,35 +125,217 @@ void Usart_init(unsigned long baud)
 //Usart_isr
 //Call this function from ISR(), passing
 //the read data byte as function arg.
-//Uses two buffers and flips between them
-//process command splits into argc, argv
+//Only stores the byte.  A '\n' completes the
+//line and hands it to the main loop, see
+//Usart_processLines.  A line that arrives with
+//the queue full, or doesn't fit the buffer, is
+//discarded up to its '\n' and counted, so the
+//tail of it doesn't run as a command.
+//returns 1 when a line was completed
 //
-void Usart_isr(unsigned char c)
+unsigned char Usart_isr(unsigned char c)
 {
-    if ((c != 0x00) && (rxIndex < (RX_BUFFER_SIZE - 1)))
+    unsigned char *line;
+
+    if (rxDiscard || ((unsigned char)(rxLineHead - rxLineTail) >= RX_LINE_COUNT))
     {
-        rxBuffer[rxIndex++] = c;
+        rxIndex = 0x00;
+        rxDiscard = (c != '\n');
 
-        //test char c for \n
         if (c == '\n')
+            rxLinesDropped++;
+
+        return 0;
+    }
+
+    line = rxLines[rxLineHead & RX_LINE_MASK];
+
+    if ((c != 0x00) && (c != '\n') && (rxIndex >= (RX_BUFFER_SIZE - 1)))
+    {
+        rxIndex = 0x00;                 //too long
+        rxDiscard = 1;
+        return 0;
+    }
+
+    if ((c != 0x00) && (rxIndex < (RX_BUFFER_SIZE - 1)))
+        line[rxIndex++] = c;
+
+    //test char c for \n - ends the line, a '\n'
+    //with no room left isn't stored
+    if (c == '\n')
+    {
+        line[rxIndex] = 0x00;
+        rxLineLength[rxLineHead & RX_LINE_MASK] = rxIndex;
+        rxIndex = 0x00;
+
+        USART_BARRIER();
+        rxLineHead++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+///////////////////////////////////////////
+//Usart_processLines
+//Call from the main loop.  Runs
+//Usart_processCommand on each complete line,
+//oldest first, outside the rx interrupt.
+//returns the number of lines processed.
+//A command that calls it again (from Delay)
+//returns 0, the line is still being run.
+int Usart_processLines(void)
+{
+    static unsigned char running = 0;
+    int count = 0x00;
+    unsigned char slot;
+
+    if (running)
+        return 0;
+
+    running = 1;
+
+    while (rxLineTail != rxLineHead)
+    {
+        USART_BARRIER();
+        slot = rxLineTail & RX_LINE_MASK;
+        Usart_processCommand(rxLines[slot], rxLineLength[slot]);
+
+        USART_BARRIER();
+        rxLineTail++;                   //frees the line for the isr
+        count++;
+    }
+
+    running = 0;
+
+    return count;
+}
+
+
+///////////////////////////////////////
+//Lines dropped, queue full or too long
+unsigned int Usart_getRxDropped(void)
+{
+    return rxLinesDropped;
+}
+
+
+/////////////////////////////////////////////
+//Transmit - bytes go into the tx ring and the
+//data register empty interrupt (UDRE) sends
+//them, see Usart_txIsr.  Senders only wait when
+//the ring is full and USART_TX_POLICY is block.
+//
+//Usart_txPut - one byte into the ring.  Senders
+//in isrs and the main loop share the head, so it
+//is claimed with interrupts off.  Full ring with
+//interrupts off (called from an isr) - the udre
+//interrupt can't run, send a byte by hand.
+//returns 1 if the byte went in, 0 if dropped
+static unsigned char Usart_txPut(unsigned char data, unsigned char block)
+{
+    unsigned char sreg;
+    unsigned char next;
+
+    while (1)
+    {
+        sreg = SREG_R;
+        cli();
+
+        next = (txHead + 1) & TX_BUFFER_MASK;
+        if (next != txTail)
+            break;
+
+        SREG_R = sreg;
+
+        if (!block)
         {
-                rxBuffer[rxIndex] = 0x00;    
-                Usart_processCommand((unsigned char*)rxBuffer, rxIndex);                
-                rxIndex = 0x00;
+            txDropped++;
+            return 0;
         }
+
+        if (!(sreg & 0x80) && (UCSR0A_R & (1u << 5)))
+            Usart_txIsr();
     }
+
+    txBuffer[txHead] = data;
+    txHead = next;
+    UCSR0B_R |= 1u << 5;                //UDRIE - start sending
+
+    SREG_R = sreg;
+
+    return 1;
 }
 
 
-/////////////////////////////////////
-//poll the tx ready bit to get an empty
-//tx buffer.
+///////////////////////////////////////
+//Usart_txIsr
+//Call this function from ISR(USART_UDRE_vect)
+//Sends the next byte, turns the interrupt
+//off when the ring is empty.
+void Usart_txIsr(void)
+{
+    if (txTail != txHead)
+    {
+        UCSR0A_R = (UCSR0A_R & 0x03) | (1u << 6);  //clear TXC, keep U2X
+        UDR0_R = txBuffer[txTail];
+        txTail = (txTail + 1) & TX_BUFFER_MASK;
+        txStarted = 1;
+    }
+    else
+        UCSR0B_R &=~ (1u << 5);         //UDRIE off
+}
+
+
+/////////////////////////////////////////
+//Usart_write
+//Non blocking - copies what fits in the
+//tx ring, returns the number of bytes
+//accepted.
+unsigned int Usart_write(const unsigned char *data, unsigned int length)
+{
+    unsigned int i = 0x00;
+
+    while ((i < length) && Usart_txPut(data[i], 0))
+        i++;
+
+    return i;
+}
+
+
+/////////////////////////////////////////
+//Usart_flush
+//Wait until everything in the ring is
+//out of the shift register.
+void Usart_flush(void)
+{
+    while (txHead != txTail)
+    {
+        if (!(SREG_R & 0x80) && (UCSR0A_R & (1u << 5)))
+            Usart_txIsr();
+    }
+
+    if (txStarted)
+    {
+        while(!(UCSR0A_R & (1u << 6))){};   //wait for complete
+        txStarted = 0;
+    }
+}
+
+
+/////////////////////////////////////////
+//Bytes dropped - ring full, USART_TX_DROP
+//or Usart_write
+unsigned int Usart_getTxDropped(void)
+{
+    return txDropped;
+}
+
 
 void Usart_sendByte(unsigned char data)
 {
-    while(!(UCSR0A_R & (1u << 5))){};   //wait for empty
-    UDR0_R = data;                      //write data
-    while(!(UCSR0A_R & (1u << 6))){};   //wait for complete
+    Usart_txPut(data, USART_TX_POLICY);
 }
 
 
@@ -7,10 +7,30 @@
 //usart buffer items
 #define RX_BUFFER_SIZE              64
 #define ARG_BUFFER_SIZE             16
+#define RX_LINE_COUNT               2       //lines waiting, power of 2
+#define RX_LINE_MASK                (RX_LINE_COUNT - 1)
+#define TX_BUFFER_SIZE              64      //power of 2
+#define TX_BUFFER_MASK              (TX_BUFFER_SIZE - 1)
+
+//////////////////////////////
+//tx ring full - sendByte/String/Array
+//wait for room, or drop what doesn't fit
+#define USART_TX_DROP               0
+#define USART_TX_BLOCK              1
+
+#ifndef USART_TX_POLICY
+#define USART_TX_POLICY             USART_TX_BLOCK
+#endif
 
 
 void Usart_init(unsigned long baud);
-void Usart_isr(unsigned char c);
+unsigned char Usart_isr(unsigned char c);
+int Usart_processLines(void);
+unsigned int Usart_getRxDropped(void);
+void Usart_txIsr(void);
+unsigned int Usart_write(const unsigned char *data, unsigned int length);
+void Usart_flush(void);
+unsigned int Usart_getTxDropped(void);
 void Usart_sendByte(unsigned char data);
 void Usart_sendString(char *data);
 void Usart_sendArray(unsigned char *data, unsigned int length);
@@ -0,0 +1,418 @@
+
+#include <string.h>
+#include <stdio.h>
+
+#include "command.h"
+#include "usart.h"
+#include "task.h"
+
+
+
+///////////////////////////////////////////////
+//static function prototype defs
+//see below for function definitions
+static void cmdHelp(int argc, char** argv);
+static void cmdTop(int argc, char** argv);
+
+
+
+////////////////////////////////////////////
+//CommandStruct commandTable
+//Flash only.  Keep it sorted by the command
+//string (strcmp order, '?' before letters),
+//the lookup is a binary search.
+//{command, menu, min args, max args, function}
+//usart/command/host/tablecheck.c checks the order.
+
+static const CommandStruct commandTable[] PROGMEM = 
+{
+    {"?",       "Print Help, ? <cmd> for one", 0, 1, cmdHelp},
+    {"top",     "Task stats, top reset to clear", 0, 1, cmdTop},
+};
+
+#define COMMAND_TABLE_SIZE      (int)(sizeof(commandTable) / sizeof(CommandStruct))
+
+
+
+void cmdHelp(int argc, char** argv)
+{
+    if (argc > 1)
+    {
+        if (Command_PrintCommandHelp(argv[1]) < 0)
+            Usart_sendString("No Such Command\r\n");
+
+        return;
+    }
+
+    Usart_sendString("Help Function\r\n");
+    Command_PrintHelp();
+}
+
+
+/////////////////////////////////////////////
+//top - one line per task, totals since the
+//last reset:
+//runs, average and max run time (us),
+//missed periods, most messages waiting / ring
+//size, share of the cpu (percent).
+//Needs TASK_STATS, see the Makefile
+void cmdTop(int argc, char** argv)
+{
+    TaskStats stats;
+    uint32_t ticks = Task_GetStatsTicks();
+    uint32_t permille;
+    uint8_t i;
+    int n;
+    char buffer[80];
+
+    if ((argc > 1) && (!strcmp(argv[1], "reset")))
+    {
+        Task_ResetStats();
+        Usart_sendString("Stats Reset\r\n");
+        return;
+    }
+
+    if (!TASK_STATS)
+    {
+        Usart_sendString("TASK_STATS Off\r\n");
+        return;
+    }
+
+    if (!ticks)
+        ticks = 1;
+
+    n = snprintf(buffer, 80, "%-8s %3s %8s %7s %7s %5s %7s %6s  %lums\r\n",
+            "name", "pri", "runs", "avg_us", "max_us", "miss", "msg", "cpu%", (unsigned long)ticks);
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    for (i = 0 ; i < TASK_MAX_TASK ; i++)
+    {
+        if (Task_GetStats(i, &stats) <= 0)
+            continue;
+
+        //us per ms tick = cpu share in 0.1%
+        permille = (stats.totalTime / ticks) * TASK_STATS_COUNT_US;
+        permille += ((stats.totalTime % ticks) * TASK_STATS_COUNT_US) / ticks;
+
+        n = snprintf(buffer, 80, "%-8.8s %3u %8lu %7lu %7lu %5u %3u/%-3u %4lu.%lu\r\n",
+                Task_GetName(i),
+                stats.priority,
+                (unsigned long)stats.runs,
+                (unsigned long)(stats.runs ? ((stats.totalTime / stats.runs) * TASK_STATS_COUNT_US) : 0),
+                (unsigned long)stats.maxTime * TASK_STATS_COUNT_US,
+                stats.missed,
+                stats.msgHighWater,
+                stats.msgDepth,
+                (unsigned long)(permille / 10),
+                (unsigned long)(permille % 10));
+
+        Usart_sendArray((unsigned char*)buffer, n);
+    }
+}
+
+
+/////////////////////////////////////////////
+//Command_Find
+//Binary search of the sorted table.
+//returns the index, -1 if no match
+static int Command_Find(char *name)
+{
+    int low = 0x00;
+    int high = COMMAND_TABLE_SIZE - 1;
+    int mid, cmp;
+
+    if (name == NULL)
+        return -1;
+
+    while (low <= high)
+    {
+        mid = (low + high) / 2;
+        cmp = strcmp_P(name, commandTable[mid].cmdString);
+
+        if (!cmp)
+            return mid;
+        else if (cmp < 0)
+            high = mid - 1;
+        else
+            low = mid + 1;
+    }
+
+    return -1;
+}
+
+
+/////////////////////////////////////////////
+//Command_ExeCommand
+//Takes parsed arguments, searches for the
+//matching command string, checks the number
+//of args, runs the cooresponding function.
+//returns index of the table element, -1 if
+//no match, -2 if wrong number of args
+int Command_ExeCommand(int argc, char** argv)
+{
+    void (*cmdPtr) (int argc, char** argv);
+    unsigned char args;
+    int i;
+
+    if (argc < 1)
+        return -1;
+
+    i = Command_Find(argv[0]);
+
+    if (i < 0)
+        return -1;
+
+    args = argc - 1;
+
+    if ((args < pgm_read_byte(&commandTable[i].minArgs)) ||
+        (args > pgm_read_byte(&commandTable[i].maxArgs)))
+    {
+        Command_PrintCommandHelp(argv[0]);
+        return -2;
+    }
+
+    //run the function
+    cmdPtr = (void (*) (int, char**))pgm_read_word(&commandTable[i].cmdPtr);
+    cmdPtr(argc, argv);
+
+    return i;
+}
+
+
+//////////////////////////////////
+//Prints a listing of all command
+//match string and description
+void Command_PrintHelp(void)
+{
+    int i = 0x00;
+    int n = 0x00;
+    char buffer[64];
+
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+    {
+        n = snprintf_P(buffer, 64, PSTR("%-16S  %-32S\r\n"), commandTable[i].cmdString, commandTable[i].menuString);
+        Usart_sendArray((unsigned char*)buffer, n);
+    }
+}
+
+
+//////////////////////////////////////
+//Prints one command, its description
+//and the number of args it takes.
+//returns the index, -1 if no match
+int Command_PrintCommandHelp(char *name)
+{
+    int i = Command_Find(name);
+    int n = 0x00;
+    char buffer[64];
+
+    if (i < 0)
+        return -1;
+
+    n = snprintf_P(buffer, 64, PSTR("%S - %S, args %u-%u\r\n"),
+            commandTable[i].cmdString,
+            commandTable[i].menuString,
+            pgm_read_byte(&commandTable[i].minArgs),
+            pgm_read_byte(&commandTable[i].maxArgs));
+
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    return i;
+}
+
+
+///////////////////////////////////////
+//hex char to 0-15, -1 if not hex
+static int Command_HexNibble(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+
+//////////////////////////////////////////////
+//Typed arg accessors.  Parse an argv[] string
+//without sscanf / strtol, no static state.
+//All return 0 and load value, or -1 if the
+//arg is missing, malformed or out of range.
+//
+//Command_GetInt - decimal with optional sign,
+//or hex with a 0x prefix
+int Command_GetInt(const char *arg, long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char negative = 0;
+
+    if ((arg == NULL) || (*arg == 0x00))
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+    {
+        if ((Command_GetHex(arg, &result) < 0) || (result > 0x7FFFFFFFul))
+            return -1;
+
+        *value = (long)result;
+        return 0;
+    }
+
+    if ((*arg == '-') || (*arg == '+'))
+        negative = (*arg++ == '-');
+
+    if (*arg == 0x00)
+        return -1;
+
+    while (*arg != 0x00)
+    {
+        if ((*arg < '0') || (*arg > '9'))
+            return -1;
+
+        if (result > ((0x80000000ul - (*arg - '0')) / 10))
+            return -1;
+
+        result = (result * 10) + (*arg++ - '0');
+    }
+
+    if (!negative && (result > 0x7FFFFFFFul))
+        return -1;
+
+    *value = negative ? (long)(0ul - result) : (long)result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetHex - hex, 0x prefix optional,
+//up to 8 digits
+int Command_GetHex(const char *arg, unsigned long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char digits = 0x00;
+    int nibble;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+        arg += 2;
+
+    while (*arg != 0x00)
+    {
+        nibble = Command_HexNibble(*arg++);
+
+        if ((nibble < 0) || (++digits > 8))
+            return -1;
+
+        result = (result << 4) | nibble;
+    }
+
+    if (!digits)
+        return -1;
+
+    *value = result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetFixed - decimal number with up to
+//places digits after the point, returned
+//scaled by 10^places.  "-1.25", 2 -> -125.
+//Extra fraction digits are truncated.
+int Command_GetFixed(const char *arg, unsigned char places, long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char negative = 0;
+    unsigned char digits = 0x00;
+    unsigned char point = 0;
+    unsigned char i;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((*arg == '-') || (*arg == '+'))
+        negative = (*arg++ == '-');
+
+    while (*arg != 0x00)
+    {
+        if ((*arg == '.') && !point)
+        {
+            point = 1;
+            arg++;
+            continue;
+        }
+
+        if ((*arg < '0') || (*arg > '9'))
+            return -1;
+
+        //drop fraction digits past places
+        if (!point || (point++ <= places))
+        {
+            if (result > ((0x7FFFFFFFul - (*arg - '0')) / 10))
+                return -1;
+
+            result = (result * 10) + (*arg - '0');
+        }
+
+        digits++;
+        arg++;
+    }
+
+    if (!digits)
+        return -1;
+
+    //pad the missing fraction digits
+    for (i = (point ? point - 1 : 0) ; i < places ; i++)
+    {
+        if (result > (0x7FFFFFFFul / 10))
+            return -1;
+
+        result *= 10;
+    }
+
+    *value = negative ? -(long)result : (long)result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetBytes - hex string to bytes, in
+//place.  "0a1B2c" -> 0x0A 0x1B 0x2C written
+//over the start of arg.  Returns the number
+//of bytes, -1 if malformed or odd length.
+int Command_GetBytes(char *arg, unsigned char **data)
+{
+    unsigned char *out = (unsigned char*)arg;
+    int count = 0x00;
+    int high, low;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+        arg += 2;
+
+    while (*arg != 0x00)
+    {
+        high = Command_HexNibble(arg[0]);
+        low = Command_HexNibble(arg[1]);
+
+        if ((high < 0) || (low < 0))
+            return -1;
+
+        out[count++] = (high << 4) | low;
+        arg += 2;
+    }
+
+    *data = (unsigned char*)out;
+    return count;
+}
+
+
+
+
@@ -0,0 +1,96 @@
+/*
+Led tasks
+Dana Olcott
+
+tx and rx from the tasker example, see led.h.
+Moved out of main.c as they were.
+
+*/
+
+#include <stdint.h>
+
+#include "register.h"
+#include "task.h"
+#include "led.h"
+
+
+
+//////////////////////////////////////////
+//Task Definitions - Tx Task
+//send toggle to the receiver task
+//
+void TaskFunction_Tx(void)
+{
+
+	TaskMessage msg = {TASK_SIG_TOGGLE, 0x00};
+
+	uint8_t index = Task_GetIndexFromName("rx");
+
+	Task_SendMessage(index, msg);
+
+}
+
+
+///////////////////////////////////////////
+//Task Definitions - Rx Task
+//
+//Coroutine task, see task.h.  Waits for a
+//message, the button blip sleeps instead of
+//blocking the other tasks with Delay.
+//msg is static, locals don't survive a wait.
+//
+void TaskFunction_Rx(void)
+{
+	static TaskMessage msg = {TASK_SIG_NONE, 0x00};
+
+	TASK_PT_BEGIN();
+
+	while (1)
+	{
+		TASK_PT_WAIT_MESSAGE(&msg);
+
+		//signal posted from button
+		//sleep to create a blip
+		if (msg.signal == TASK_SIG_BUTTON)
+		{
+			PORTB_DATA_R ^= LED_BIT;
+			TASK_PT_SLEEP(50);
+			PORTB_DATA_R ^= LED_BIT;
+			TASK_PT_SLEEP(50);
+		}
+		else
+			Rx_HandleSignal(msg.signal);
+	}
+
+	TASK_PT_END();
+}
+
+
+///////////////////////////////////////////
+//Led signals, no waiting
+//
+void Rx_HandleSignal(TaskSignal_t signal)
+{
+	switch(signal)
+	{
+		case TASK_SIG_ON:
+		{
+			PORTB_DATA_R |= LED_BIT;
+			break;
+		}
+		case TASK_SIG_OFF:
+		{
+			PORTB_DATA_R &=~ LED_BIT;
+			break;
+		}
+
+		case TASK_SIG_TOGGLE:
+		{
+			PORTB_DATA_R ^= LED_BIT;
+			break;
+		}
+
+		default:
+			break;
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef LED__H
+#define LED__H
+
+//////////////////////////////////////////
+//The led tasks from main.c.  tx sends a
+//toggle to rx on its period, rx drives the
+//led (Pin 13 - PB5) from its messages - the
+//toggles and the button blip.  rx has to be
+//added as "rx", TASK_TYPE_MESSAGE.
+//Own file so task/host/buttontest.c runs
+//the same code on the pc.
+
+#include "task.h"
+
+#define LED_BIT         (1u << 5)       //PB5
+
+void TaskFunction_Tx(void);
+void TaskFunction_Rx(void);
+void Rx_HandleSignal(TaskSignal_t signal);
+
+#endif
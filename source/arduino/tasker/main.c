@@ -9,6 +9,9 @@ Simple Tasker example.
 Make 2 tasks, sender and receiver.  Sender
 sends toggle signal to 
 
+Usart at 9600, "top" prints the task stats
+when built with TASK_STATS (see makefile).
+
 Defines (see makefile)  __AVR_ATmega328P__
 Inludes:  /usr/lib/avr/include
 */
@@ -16,7 +19,10 @@ Inludes:  /usr/lib/avr/include
 
 #include <avr/io.h>         //macros
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include "./task/task.h"
+#include "usart.h"
+#include "led.h"
 
 //////////////////////////////////////////
 //register defines
@@ -48,6 +54,7 @@ Inludes:  /usr/lib/avr/include
 void GPIO_init(void);
 void Interrupt_init(void);
 void Timer0_init(void);
+void Timer1_init(void);
 void Waste_CPU(unsigned int temp);
 void Dummy_Function(void);
 
@@ -59,16 +66,30 @@ void Dummy_Function(void);
 void Delay(volatile unsigned int val);
 static volatile unsigned long gTimeTick = 0x00;
 
+//////////////////////////////////////
+//tickless - Timer1 free runs at clk/64,
+//250 counts per 1ms task tick
+#define TICKLESS_COUNTS_PER_TICK    250
+#define TICKLESS_MAX_TICKS          250     //longest sleep, fits 16 bits
+
+#if TASK_TICKLESS
+static uint16_t gTicklessLast = 0x00;      //TCNT1 at the last counted tick
+#endif
+
 
 //////////////////////////////////////
 //task items
 //
 #define TASK_TX_NAME		((char*)"tx")
 #define TASK_RX_NAME		((char*)"rx")
+#define TASK_CLI_NAME		((char*)"cli")
+
+#define CLI_SIGNAL_LINE		0x01			//usart line complete
 
-//Task functions
-void TaskFunction_Tx(void);
-void TaskFunction_Rx(void);
+static uint8_t gCliTaskIndex = 0x00;
+
+//Task functions, tx and rx in led/
+void TaskFunction_Cli(void);
 
 
 
@@ -120,6 +141,87 @@ ISR(TIMER0_OVF_vect)
 }
 
 
+//////////////////////////////////////
+//usart rx interrupt
+//read the udr to clear the flag
+//stores the byte, a complete line
+//wakes the cli task
+//
+ISR(USART_RX_vect)
+{
+    unsigned char data = UDR0;
+
+    if (Usart_isr(data))
+        Task_SetSignals(gCliTaskIndex, CLI_SIGNAL_LINE);
+}
+
+
+//////////////////////////////////////
+//usart data register empty interrupt
+//sends the next byte from the tx ring
+//
+ISR(USART_UDRE_vect)
+{
+    Usart_txIsr();
+}
+
+
+#if TASK_STATS
+//////////////////////////////////////
+//Stats time base - Timer1 free running
+//at clk/64, TASK_STATS_COUNT_US = 4.
+//16 bit read is two bytes, keep isrs
+//from using the TEMP register in between
+uint16_t Task_StatsTimer(void)
+{
+    uint16_t count;
+    uint8_t sreg = SREG;
+
+    cli();
+    count = TCNT1;
+    SREG = sreg;
+
+    return count;
+}
+#endif
+
+
+#if TASK_TICKLESS
+///////////////////////////////////
+//Timer1 Compare A ISR
+//Next task deadline, or the longest
+//sleep ran out.
+ISR(TIMER1_COMPA_vect)
+{
+    Task_TicklessUpdate();
+}
+
+
+////////////////////////////////////////////
+//Tickless port hook - interrupts off.
+//Count the whole ticks since the last call,
+//then set the compare for the next deadline.
+void Task_TicklessUpdate(void)
+{
+    uint16_t elapsed = (uint16_t)(TCNT1 - gTicklessLast) / TICKLESS_COUNTS_PER_TICK;
+    uint32_t next;
+
+    gTicklessLast += elapsed * TICKLESS_COUNTS_PER_TICK;
+    Task_AdvanceTicks(elapsed);
+
+    next = Task_GetTicksToNextDeadline();
+
+    if (next < 1)
+        next = 1;
+    if (next > TICKLESS_MAX_TICKS)
+        next = TICKLESS_MAX_TICKS;
+
+    OCR1A = gTicklessLast + (uint16_t)next * TICKLESS_COUNTS_PER_TICK;
+    TIFR1 = 1u << OCF1A;
+}
+#endif
+
+
 
 
 ///////////////////////////////////////
@@ -127,15 +229,30 @@ int main()
 {
     GPIO_init();        //configure led and button
     Interrupt_init();   //falling edge trigger  
+#if TASK_TICKLESS || TASK_STATS
+    Timer1_init();      //Timer1 free running, tickless compare / stats time base
+#endif
+#if !TASK_TICKLESS
     Timer0_init();      //Timer0 Counter Overflow
+#endif
+    Usart_init(9600);   //"top" over the usart
  
 
     //Task
     Task_Init();
 
 	//add the tasks
-	Task_AddTask(TASK_TX_NAME, TaskFunction_Tx, 500, 0);
-	Task_AddTask(TASK_RX_NAME, TaskFunction_Rx, 100, 1);
+	Task_AddTask(TASK_TX_NAME, TaskFunction_Tx, 500, 0, 0);
+	Task_AddTask(TASK_RX_NAME, TaskFunction_Rx, 0, 1, 8);
+
+	//rx runs when a message arrives, not on a period
+	Task_SetTaskType(Task_GetIndexFromName(TASK_RX_NAME), TASK_TYPE_MESSAGE);
+
+	//cli runs the usart command lines, lowest priority
+	Task_AddTask(TASK_CLI_NAME, TaskFunction_Cli, 0, TASK_MAX_PRIORITY - 1, 0);
+	gCliTaskIndex = Task_GetIndexFromName(TASK_CLI_NAME);
+	Task_SetTaskType(gCliTaskIndex, TASK_TYPE_SIGNAL);
+	Task_WaitSignals(gCliTaskIndex, CLI_SIGNAL_LINE);
 
 	//start the scheduler
 	Task_StartScheduler();
@@ -231,6 +348,28 @@ void Timer0_init(void)
 }
 
 
+//////////////////////////////////////////
+//Configure Timer1 free running at clk/64,
+//4us per count.  Tickless - compare A is
+//moved by Task_TicklessUpdate.  Stats - the
+//count times the tasks.
+//
+void Timer1_init(void)
+{
+    TCCR1A = 0x00;                  //normal mode, no pins
+    TCCR1B = 0x03;                  //clk/64
+    TCNT1 = 0x00;
+
+#if TASK_TICKLESS
+    OCR1A = TICKLESS_COUNTS_PER_TICK;
+    TIFR1 = 1u << OCF1A;            //clear
+    TIMSK1 |= 1u << OCIE1A;         //compare A interrupt
+#endif
+
+    sei();
+}
+
+
 /////////////////////////////////////
 void Waste_CPU(unsigned int temp)
 {
@@ -251,90 +390,50 @@ void Dummy_Function(void)
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0, timer1, the
+//button or a usart byte wakes it.
 void Delay(volatile unsigned int val)
 {
+#if TASK_TICKLESS
+    //no periodic tick to wake on - poll the
+    //task tick, catching up from Timer1
+    uint32_t start = Task_GetTick();
+    while ((Task_GetTick() - start) < val)
+    {
+        cli();
+        Task_TicklessUpdate();
+        sei();
+    }
+#else
     gTimeTick = 0x00;           //upcounter
-    while (val > gTimeTick){};
-
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0 / timer1 and usart keep running
+    while (val > gTimeTick)
+    {
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
+#endif
 }
 
 
 
 
-//////////////////////////////////////////
-//Task Definitions - Tx Task
-//send toggle to the receiver task
-//
-void TaskFunction_Tx(void)
-{
-
-	TaskMessage msg = {TASK_SIG_TOGGLE, 0x00};
-
-	uint8_t index = Task_GetIndexFromName("rx");
-
-	Task_SendMessage(index, msg);
-
-}
-
-
 ///////////////////////////////////////////
-//Task Definitions - Rx Task
+//Task Definitions - Cli Task
 //
+//Signal task, the usart isr sets the line
+//signal.  Commands run here instead of in
+//the rx interrupt.
 //
-void TaskFunction_Rx(void)
+void TaskFunction_Cli(void)
 {
-	TaskMessage msg = {TASK_SIG_NONE, 0x00};
-	uint8_t index = Task_GetIndexFromName("rx");
-
-    //read all incoming messages into msg address
-    //
-	while (Task_GetNextMessage(index, &msg) > 0)
-	{
-		switch(msg.signal)
-		{
-			case TASK_SIG_ON:
-			{
-                PORTB_DATA_R |= 1u << 5;
-				break;
-			}
-			case TASK_SIG_OFF:
-			{
-                PORTB_DATA_R &=~ 1u << 5;
-				break;
-			}
-
-			case TASK_SIG_TOGGLE:
-			{
-                PORTB_DATA_R ^= 1u << 5;
-				break;
-			}
-
-            //signal posted from button
-            //delay to create a blip
-			case TASK_SIG_BUTTON:
-			{
-                PORTB_DATA_R ^= 1u << 5;
-                Delay(50);
-                PORTB_DATA_R ^= 1u << 5;
-                Delay(50);
-				break;
-			}
-
-			default:
-				break;
-		}
-	}
+	Task_TakeSignals(gCliTaskIndex);
+	Usart_processLines();
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
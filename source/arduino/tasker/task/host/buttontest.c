@@ -0,0 +1,350 @@
+/*
+Button to led test - runs on the pc
+Dana Olcott
+
+The button path from main.c on task.c, on a simulated
+1ms tick: the INT0 isr sends TASK_SIG_BUTTON to the
+rx task (message driven, priority 1), rx toggles the
+led and sleeps out the blip.  Around it the same
+tasks as main.c - tx sends a toggle every 500ms at
+priority 0, cli runs usart lines at priority 7.
+
+tx and rx are the ones main.c runs, from led/led.c,
+the led port is a variable (register.h here).  The
+scheduler runs them through wrappers that keep a copy
+of rx's message ring and give each its cpu time.
+
+Presses come at random times, also in the middle of
+tasks.  Usart lines come at random too, each cli run
+takes CLI_US.  The latency is from the message send
+(the end of the button isr, after its debounce wait)
+to the led write in rx.
+
+Without preemption rx waits at most for the task
+running when the press came, tx if it is ready too,
+and the tick isrs in between.  The test fails on any
+press over that bound, on a press that never reaches
+the led, on a led write that doesn't match the
+messages rx took, or on a dropped message.  Exit code
+is the failure count.
+
+The TASK_PT_ waits fall through into their case on
+purpose, -Wno-implicit-fallthrough keeps -Wextra quiet.
+
+Build:  gcc -std=c99 -O2 -Wall -Wextra -Wno-implicit-fallthrough -DTASK_HOST \
+            -I. -I.. -I../../led -o buttontest buttontest.c ../task.c ../../led/led.c
+Run:    ./buttontest [seconds] [seed]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <setjmp.h>
+
+#include "task.h"
+#include "led.h"
+
+#define TICK_US				1000
+#define ISR_US				8			//tick isr
+#define BUTTON_ISR_US		20			//the send, after the debounce
+#define TX_US				40
+#define RX_US				30
+#define CLI_US				2000		//one command line
+#define PRESS_GAP_MIN_MS	150			//the blip is 100ms
+#define PRESS_GAP_MS		500
+#define LINE_GAP_MS			300
+
+#define LATENCY_BOUND_US	(CLI_US + TX_US + BUTTON_ISR_US + (((CLI_US + TX_US) / TICK_US) + 1) * ISR_US)
+
+
+//simulated clock
+static uint64_t mNowUs;
+static uint64_t mEndUs;
+static uint64_t mNextTickUs;
+static uint64_t mNextPressUs;
+static uint64_t mNextLineUs;
+static jmp_buf mEndJump;
+
+//simulated port and task indexes
+volatile unsigned char mHostPortB = 0x00;
+static uint8_t mRxIndex;
+static uint8_t mCliIndex;
+
+#define CLI_SIGNAL_LINE		0x01
+
+//copy of rx's message ring, the signals
+//in the order sent
+#define SENT_SIZE			64
+static TaskSignal_t mSent[SENT_SIZE];
+static uint8_t mSentHead = 0;
+static uint8_t mSentTail = 0;
+
+//results
+static uint64_t mPressUs;
+static uint8_t mPressWaiting = 0;
+static unsigned long mPresses = 0;
+static unsigned long mLedHits = 0;
+static unsigned long mLost = 0;
+static unsigned long mOverBound = 0;
+static unsigned long mLedWrong = 0;
+static uint64_t mLatencyTotal = 0;
+static uint32_t mLatencyMin = 0xFFFFFFFFUL;
+static uint32_t mLatencyMax = 0;
+
+
+static uint64_t Sim_Gap(uint32_t minMs, uint32_t maxMs)
+{
+	//ms range, any us within
+	return ((uint64_t)minMs * 1000) + (uint64_t)(rand() % ((maxMs - minMs) * 1000));
+}
+
+
+//////////////////////////////////////////
+//main.c INT0_vect, after the debounce wait
+static void Sim_ButtonIsr(void)
+{
+	TaskMessage msg = {TASK_SIG_BUTTON, 0x00};
+
+	mNowUs += BUTTON_ISR_US;
+
+	if (mPressWaiting)
+		mLost++;							//last press never got to the led
+
+	if (Task_SendMessage(mRxIndex, msg) < 0)
+		mLost++;
+	else
+		mSent[mSentHead++ % SENT_SIZE] = TASK_SIG_BUTTON;
+
+	mPressUs = mNowUs;
+	mPressWaiting = 1;
+	mPresses++;
+
+	mNextPressUs += Sim_Gap(PRESS_GAP_MIN_MS, PRESS_GAP_MS);
+}
+
+
+//////////////////////////////////////////
+//main.c USART_RX_vect, a line completed
+static void Sim_UsartIsr(void)
+{
+	Task_SetSignals(mCliIndex, CLI_SIGNAL_LINE);
+	mNextLineUs += Sim_Gap(1, LINE_GAP_MS);
+}
+
+
+static void Sim_TickIsr(void)
+{
+	mNowUs += ISR_US;
+	mNextTickUs += TICK_US;
+	Task_TimerISRHandler();
+}
+
+
+static uint64_t Sim_NextInterrupt(void)
+{
+	uint64_t next = mNextTickUs;
+
+	if (mNextPressUs < next)
+		next = mNextPressUs;
+	if (mNextLineUs < next)
+		next = mNextLineUs;
+
+	return next;
+}
+
+
+//////////////////////////////////////////
+//Run the next interrupt, waiting for it
+//if it isn't due yet
+static void Sim_Interrupt(void)
+{
+	uint64_t next = Sim_NextInterrupt();
+
+	if (next > mNowUs)
+		mNowUs = next;
+
+	if (next == mNextTickUs)
+		Sim_TickIsr();
+	else if (next == mNextPressUs)
+		Sim_ButtonIsr();
+	else
+		Sim_UsartIsr();
+
+	if (mNowUs >= mEndUs)
+		longjmp(mEndJump, 1);
+}
+
+
+//////////////////////////////////////////
+//cpu busy for us, interrupts that fall due
+//in it are taken and push it out
+static void Sim_Cpu(uint32_t us)
+{
+	uint64_t end = mNowUs + us;
+	uint64_t next;
+
+	while ((next = Sim_NextInterrupt()) <= end)
+	{
+		uint64_t left = end - ((next > mNowUs) ? next : mNowUs);
+
+		Sim_Interrupt();
+		end = mNowUs + left;
+	}
+
+	mNowUs = end;
+}
+
+
+//////////////////////////////////////////
+//Nothing ready - sleep to the next interrupt
+void Task_IdleSleep(void)
+{
+	Sim_Interrupt();
+}
+
+
+//////////////////////////////////////////
+//rx took a button message, the led write
+//is the first thing it does with it
+static void Sim_ButtonTaken(void)
+{
+	uint32_t latency;
+
+	if (!mPressWaiting)
+		return;
+
+	latency = (uint32_t)(mNowUs - mPressUs);
+	mPressWaiting = 0;
+	mLedHits++;
+	mLatencyTotal += latency;
+
+	if (latency < mLatencyMin)
+		mLatencyMin = latency;
+	if (latency > mLatencyMax)
+		mLatencyMax = latency;
+
+	if (latency > LATENCY_BOUND_US)
+	{
+		if (mOverBound++ < 10)
+			printf("press at %.3fs: led after %luus, bound %luus\n",
+					mPressUs / 1000000.0, (unsigned long)latency,
+					(unsigned long)LATENCY_BOUND_US);
+	}
+}
+
+
+//////////////////////////////////////////
+//led.c tasks, their cpu time on Sim_Cpu.
+//tx - a message in rx's ring is a toggle
+static void Sim_Tx(void)
+{
+	int waiting = Task_GetNumMessageWaiting(mRxIndex);
+
+	TaskFunction_Tx();
+
+	if (Task_GetNumMessageWaiting(mRxIndex) > waiting)
+		mSent[mSentHead++ % SENT_SIZE] = TASK_SIG_TOGGLE;
+
+	Sim_Cpu(TX_US);
+}
+
+
+//////////////////////////////////////////
+//rx - every message it takes flips the led
+//once, a button then sleeps twice and the
+//end of the first sleep flips it back.  The
+//scheduler runs the wrapper as rx, so the
+//resume line is rx's.
+static void Sim_Rx(void)
+{
+	static uint8_t blip = 0;					//button sleep, 1 or 2
+	static uint16_t blipLine;
+	TaskStruct *pt = Task_GetCurrent();
+	int waiting = Task_GetNumMessageWaiting(mRxIndex);
+	uint8_t led = mHostPortB & LED_BIT;
+	uint8_t flips = 0;
+	uint8_t last = TASK_SIG_NONE;
+	int taken;
+
+	TaskFunction_Rx();
+
+	taken = waiting - Task_GetNumMessageWaiting(mRxIndex);
+
+	if (blip && (pt->ptLine != blipLine))
+	{
+		if (blip == 1)
+			flips++;							//blip end
+		blip = (blip == 1) ? 2 : 0;
+		blipLine = pt->ptLine;
+	}
+
+	while (taken-- > 0)
+	{
+		last = mSent[mSentTail++ % SENT_SIZE];
+		if (last == TASK_SIG_BUTTON)
+			Sim_ButtonTaken();
+		flips++;
+	}
+
+	if (last == TASK_SIG_BUTTON)
+	{
+		blip = 1;
+		blipLine = pt->ptLine;
+	}
+
+	if (((mHostPortB & LED_BIT) != led) != (flips & 1))
+		mLedWrong++;
+
+	Sim_Cpu(RX_US);
+}
+
+
+void TaskFunction_Cli(void)
+{
+	Task_TakeSignals(mCliIndex);
+	Sim_Cpu(CLI_US);
+}
+
+
+int main(int argc, char **argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 600.0;
+	unsigned int seed = (argc > 2) ? (unsigned int)atoi(argv[2]) : 1;
+	unsigned long failures;
+
+	srand(seed);
+
+	mNowUs = 0;
+	mEndUs = (uint64_t)(seconds * 1000000.0);
+	mNextTickUs = TICK_US;
+	mNextPressUs = Sim_Gap(PRESS_GAP_MIN_MS, PRESS_GAP_MS);
+	mNextLineUs = Sim_Gap(1, LINE_GAP_MS);
+
+	//as main.c
+	Task_Init();
+	Task_AddTask((char*)"tx", Sim_Tx, 500, 0, 0);
+	Task_AddTask((char*)"rx", Sim_Rx, 0, 1, 8);
+	mRxIndex = Task_GetIndexFromName((char*)"rx");
+	Task_SetTaskType(mRxIndex, TASK_TYPE_MESSAGE);
+
+	Task_AddTask((char*)"cli", TaskFunction_Cli, 0, TASK_MAX_PRIORITY - 1, 0);
+	mCliIndex = Task_GetIndexFromName((char*)"cli");
+	Task_SetTaskType(mCliIndex, TASK_TYPE_SIGNAL);
+	Task_WaitSignals(mCliIndex, CLI_SIGNAL_LINE);
+
+	if (!setjmp(mEndJump))
+		Task_StartScheduler();
+
+	//a press still on its way at the end isn't lost
+	failures = mLost + mOverBound + mLedWrong + Task_GetMessageOverflow(mRxIndex);
+
+	printf("%.0fs seed %u: %lu presses, %lu to the led, latency min/avg/max %lu/%lu/%luus, bound %luus\n",
+			seconds, seed, mPresses, mLedHits, (unsigned long)mLatencyMin,
+			(unsigned long)(mLedHits ? (mLatencyTotal / mLedHits) : 0),
+			(unsigned long)mLatencyMax, (unsigned long)LATENCY_BOUND_US);
+	printf("lost %lu, over the bound %lu, led wrong %lu, rx overflow %d\n", mLost, mOverBound,
+			mLedWrong, Task_GetMessageOverflow(mRxIndex));
+
+	return (failures > 255) ? 255 : (int)failures;
+}
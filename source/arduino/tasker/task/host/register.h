@@ -0,0 +1,17 @@
+/*
+register.h for the pc build - task/host
+Dana Olcott
+
+The port led/led.c writes, a variable in
+buttontest.c.
+
+*/
+
+#ifndef __REGISTER_H
+#define __REGISTER_H
+
+extern volatile unsigned char mHostPortB;
+
+#define PORTB_DATA_R    mHostPortB
+
+#endif
@@ -0,0 +1,306 @@
+/*
+Tasker simulator - runs on the pc
+Dana Olcott
+
+Runs task.c as it is on the target, with
+Task_StartScheduler, on a simulated 1ms tick, and
+reports the dispatch latency and how the cpu was
+shared out per task.
+
+Supplied here instead of the port:
+- the tick - Task_TimerISRHandler every TICK_US,
+  ISR_US long, taken as it falls due, also in the
+  middle of a task
+- Task_IdleSleep - the clock jumps to the next tick
+- Task_StatsTimer - the clock in us (TASK_STATS)
+
+Each task only spends its cost on the clock.  The
+dispatch latency is from the tick the task was last
+due to the start of its run.  Periods it missed
+entirely are in "missed" (task stats).
+
+Scenarios:
+- mixed - one task per priority, periods 1 to 50
+  ticks, the cpu about half loaded
+- overload - three equal priority tasks, each alone
+  nearly fills a tick.  They must share the cpu
+  evenly (round robin), the priority 0 task must get
+  in after at most one other task, the priority 7 task
+  is starved.
+
+Checks (exit code is the failure count):
+- equal priority tasks get the same share of runs,
+  fewest / most at least FAIR_MIN.  Not run for run:
+  tasks due on the same tick are readied in heap
+  order, so which of them goes to the back of the
+  list first isn't a strict rotation.
+- the highest priority task waits no longer than the
+  longest other task plus the tick isr
+
+Build:  gcc -std=c99 -O2 -Wall -Wextra -DTASK_HOST -DTASK_STATS=1 \
+            -DTASK_STATS_COUNT_US=1 -I.. -o tasksim tasksim.c ../task.c
+Run:    ./tasksim [seconds]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <setjmp.h>
+
+#include "task.h"
+
+#define TICK_US				1000
+#define ISR_US				8			//heap top check and a ready push, 16mhz
+#define MAX_SIM_TASKS		TASK_MAX_TASK
+#define FAIR_MIN			0.99		//fewest / most runs, equal priority
+
+
+typedef struct
+{
+	const char *name;
+	uint8_t priority;
+	uint16_t period;		//ticks
+	uint32_t cost;			//us per run
+}SimTask;
+
+
+typedef struct
+{
+	uint64_t latencyTotal;
+	uint32_t latencyMax;
+	uint32_t runs;
+}SimResult;
+
+
+typedef struct
+{
+	const char *name;
+	const SimTask *tasks;
+	int count;
+}Scenario;
+
+
+static const SimTask mMixed[] =
+{
+	{"radio",	0,	1,	120},
+	{"usart",	1,	2,	150},
+	{"sensor",	2,	5,	600},
+	{"led",		3,	10,	50},
+	{"log",		4,	20,	2500},
+	{"stats",	5,	50,	4000},
+};
+
+static const SimTask mOverload[] =
+{
+	{"urgent",	0,	10,	100},
+	{"rr_a",	2,	1,	900},
+	{"rr_b",	2,	1,	900},
+	{"rr_c",	2,	1,	900},
+	{"idle",	7,	1,	50},
+};
+
+static const Scenario mScenarios[] =
+{
+	{"mixed", mMixed, sizeof(mMixed) / sizeof(SimTask)},
+	{"overload", mOverload, sizeof(mOverload) / sizeof(SimTask)},
+};
+
+#define SCENARIO_COUNT		(int)(sizeof(mScenarios) / sizeof(Scenario))
+
+
+//simulated clock
+static uint64_t mNowUs;
+static uint64_t mNextTickUs;
+static uint64_t mEndUs;
+static jmp_buf mEndJump;
+
+static const Scenario *mScenario;
+static SimResult mResults[MAX_SIM_TASKS];
+static int mFailures = 0;
+
+
+static void Sim_Tick(void)
+{
+	mNowUs = mNextTickUs + ISR_US;
+	mNextTickUs += TICK_US;
+	Task_TimerISRHandler();
+
+	if (mNowUs >= mEndUs)
+		longjmp(mEndJump, 1);
+}
+
+
+//////////////////////////////////////////
+//cpu busy for us, ticks that fall due in
+//it are taken and push it out
+static void Sim_Cpu(uint32_t us)
+{
+	uint64_t left = us;
+
+	while ((mNowUs + left) >= mNextTickUs)
+	{
+		left -= mNextTickUs - mNowUs;
+		Sim_Tick();
+	}
+
+	mNowUs += left;
+}
+
+
+//////////////////////////////////////////
+//Nothing ready - sleep to the next tick
+void Task_IdleSleep(void)
+{
+	Sim_Tick();
+}
+
+
+uint16_t Task_StatsTimer(void)
+{
+	return (uint16_t)mNowUs;
+}
+
+
+//////////////////////////////////////////
+//Every task runs this, the table index is
+//the order they were added in
+static void Sim_TaskFunction(void)
+{
+	TaskStruct *task = Task_GetCurrent();
+	SimResult *result = &mResults[task->index];
+	uint64_t readyUs = (uint64_t)(task->due - task->timer) * TICK_US;
+	uint32_t latency = (uint32_t)(mNowUs - readyUs);
+
+	result->runs++;
+	result->latencyTotal += latency;
+
+	if (latency > result->latencyMax)
+		result->latencyMax = latency;
+
+	Sim_Cpu(mScenario->tasks[task->index].cost);
+}
+
+
+static void Sim_Report(double seconds)
+{
+	uint32_t ticks = Task_GetStatsTicks();
+	uint32_t longest = 0;
+	uint32_t bound;
+	double share;
+	int i, p;
+
+	printf("\n%s, %.0fs\n", mScenario->name, seconds);
+	printf("%-8s %4s %6s %6s %8s %8s %7s %9s %9s %6s\n", "task", "prio", "period",
+			"cost", "runs", "due", "missed", "lat avg", "lat max", "cpu");
+
+	for (i = 0 ; i < mScenario->count ; i++)
+	{
+		const SimTask *task = &mScenario->tasks[i];
+		SimResult *result = &mResults[i];
+		TaskStats stats;
+
+		Task_GetStats(i, &stats);
+
+		printf("%-8s %4u %6u %5luu %8lu %8lu %7u %8luu %8luu %5.1f%%\n",
+				task->name, task->priority, task->period, (unsigned long)task->cost,
+				(unsigned long)result->runs, (unsigned long)(ticks / task->period),
+				stats.missed,
+				(unsigned long)(result->runs ? (result->latencyTotal / result->runs) : 0),
+				(unsigned long)result->latencyMax,
+				(100.0 * stats.totalTime) / ((double)ticks * TICK_US));
+
+		if ((task->priority > mScenario->tasks[0].priority) && (task->cost > longest))
+			longest = task->cost;
+	}
+
+	//round robin - equal priority, equal share
+	for (p = 0 ; p < TASK_MAX_PRIORITY ; p++)
+	{
+		uint32_t fewest = 0xFFFFFFFFUL;
+		uint32_t most = 0;
+		int count = 0;
+
+		for (i = 0 ; i < mScenario->count ; i++)
+		{
+			if (mScenario->tasks[i].priority != p)
+				continue;
+
+			if (mResults[i].runs < fewest)
+				fewest = mResults[i].runs;
+			if (mResults[i].runs > most)
+				most = mResults[i].runs;
+
+			count++;
+		}
+
+		if ((count < 2) || !most)
+			continue;
+
+		share = (double)fewest / most;
+
+		printf("%s priority %d, %d tasks: runs %lu to %lu, fairness %.4f\n",
+				(share < FAIR_MIN) ? "FAIL" : "    ", p, count,
+				(unsigned long)fewest, (unsigned long)most, share);
+
+		if (share < FAIR_MIN)
+			mFailures++;
+	}
+
+	//no preemption - the top task waits at most one
+	//other task, plus the isr
+	bound = longest + ISR_US;
+
+	if (mResults[0].latencyMax > bound)
+	{
+		printf("FAIL %s latency max %luus, bound %luus\n", mScenario->tasks[0].name,
+				(unsigned long)mResults[0].latencyMax, (unsigned long)bound);
+		mFailures++;
+	}
+	else
+		printf("     %s latency max %luus, bound %luus\n", mScenario->tasks[0].name,
+				(unsigned long)mResults[0].latencyMax, (unsigned long)bound);
+}
+
+
+static void Sim_Run(const Scenario *scenario, double seconds)
+{
+	int i;
+
+	mScenario = scenario;
+	mNowUs = 0;
+	mNextTickUs = TICK_US;
+	mEndUs = (uint64_t)(seconds * 1000000.0);
+
+	for (i = 0 ; i < MAX_SIM_TASKS ; i++)
+	{
+		mResults[i].latencyTotal = 0;
+		mResults[i].latencyMax = 0;
+		mResults[i].runs = 0;
+	}
+
+	Task_Init();
+
+	for (i = 0 ; i < scenario->count ; i++)
+		Task_AddTask((char*)scenario->tasks[i].name, Sim_TaskFunction,
+				scenario->tasks[i].period, scenario->tasks[i].priority, 0);
+
+	if (!setjmp(mEndJump))
+		Task_StartScheduler();
+
+	Sim_Report(seconds);
+}
+
+
+int main(int argc, char **argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 60.0;
+	int i;
+
+	for (i = 0 ; i < SCENARIO_COUNT ; i++)
+		Sim_Run(&mScenarios[i], seconds);
+
+	printf("\n%d failures\n", mFailures);
+
+	return mFailures;
+}
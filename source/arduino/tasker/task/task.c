@@ -24,6 +24,21 @@ The idea is that signals are processed in the receiver task when
 it runs.  It's up to the user to eval all signals, or.. few
 of them, or however they want.
 
+Scheduling:
+When a task times out, the timer isr puts it at the end of the
+ready list for its priority and sets the priority bit in the
+ready mask.  The scheduler takes the first task from the highest
+priority list that has a bit set.  Finding the bit is a table
+lookup, so picking the next task takes the same time no matter
+how many tasks there are.  A task that times out again goes to
+the back of its list, so tasks with the same priority alternate.
+
+Timing:
+Timed tasks sit in a binary min-heap on the tick they are due.  A
+tick only looks at the top of the heap, so the isr cost doesn't grow
+with the number of tasks.  When the top is due, it goes on the ready
+list and is moved down the heap with its next due tick, O(log n).
+
 
  */
 //////////////////////////////////////////////////////
@@ -32,61 +47,133 @@ of them, or however they want.
 
 #include "task.h"
 
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
 static TaskStruct TaskTable[TASK_MAX_TASK];
 
+//ready lists - one fifo per priority, linked by readyNext
+static volatile uint8_t mReadyMask = 0x00;				//bit n = priority n has ready tasks
+static uint8_t mReadyHead[TASK_MAX_PRIORITY];
+static uint8_t mReadyTail[TASK_MAX_PRIORITY];
+
+//lowest set bit of a nibble, 0 not used
+static const uint8_t mLowestBit[16] = {0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+
+//deadline heap - task indexes, earliest due on top
+static uint8_t mHeap[TASK_MAX_TASK];
+static uint8_t mHeapSize = 0;
+static volatile uint32_t mTaskTick = 0x00;
+static uint8_t mCurrentTask = TASK_INDEX_NONE;		//task running now
+static uint32_t mStatsStartTick = 0x00;				//tick of the last stats reset
+
+//message pool - each task owns msgDepth entries
+//from msgBase, packed from the bottom
+static TaskMessage mMessagePool[TASK_MESSAGE_POOL_SIZE];
+static uint8_t mPoolUsed = 0;
+
+#define TASK_DUE_BEFORE(a, b)	((int32_t)(TaskTable[a].due - TaskTable[b].due) < 0)
+
+static void Task_ReadyPush(uint8_t index);
+static int Task_ReadyPop(void);
+static void Task_ReadyRemove(uint8_t index);
+static void Task_ClearEntry(uint8_t index);
+static void Task_Schedule(uint8_t index, uint32_t ticks);
+static void Task_ProcessDeadlines(void);
+static void Task_HeapSwap(uint8_t a, uint8_t b);
+static void Task_HeapUp(uint8_t pos);
+static void Task_HeapDown(uint8_t pos);
+static void Task_HeapRemove(uint8_t index);
+static void Task_PoolFree(uint8_t index);
+static void Task_Arm(uint8_t index);
+static uint8_t Task_EventPending(uint8_t index);
+
 ///////////////////////////////////////
 //Init task table with default values
 void Task_Init(void)
 {
 	uint8_t i;
 	for (i = 0 ; i < TASK_MAX_TASK ; i++)
+		Task_ClearEntry(i);
+
+	for (i = 0 ; i < TASK_MAX_PRIORITY ; i++)
 	{
-		memset(TaskTable[i].name, 0x00, TASK_NAME_LENGTH);
-		TaskTable[i].taskFunction = NULL_PTR;
-		TaskTable[i].timer = 0;
-		TaskTable[i].flagEnable = 0;
-		TaskTable[i].flagRun = 0;
-		TaskTable[i].index = i;
-		TaskTable[i].initialTimeTick = 0;
-		TaskTable[i].taskMessageWaiting = 0;
-		Task_ClearAllMessages(i);
+		mReadyHead[i] = TASK_INDEX_NONE;
+		mReadyTail[i] = TASK_INDEX_NONE;
 	}
+
+	mReadyMask = 0x00;
+	mHeapSize = 0;
+	mTaskTick = 0x00;
+	mPoolUsed = 0;
+	mCurrentTask = TASK_INDEX_NONE;
+	mStatsStartTick = 0x00;
 }
 
 /////////////////////////////////////////////
 //Task_AddTask
-//Add a task to the task table.  needs to fit
-//within the size, priority = index in the table
+//Add a task to the first free slot in the task
+//table.  priority 0 is the highest.  Tasks with the
+//same priority run round robin.
 //*task is the task to run
-int Task_AddTask(char* name, void (*taskFunction) (void), uint16_t time, uint8_t priority)
+//msgDepth - message ring size, power of 2, 0 for none.
+//Returns -1 if the table or the message pool is full.
+int Task_AddTask(char* name, void (*taskFunction) (void), uint16_t time, uint8_t priority, uint8_t msgDepth)
 {
-	//check priority and if the task function is set up
-	if (priority < TASK_MAX_TASK)
+	uint8_t i;
+
+	if (priority >= TASK_MAX_PRIORITY)
+		return -1;
+
+	if ((msgDepth > TASK_MESSAGE_MAX_DEPTH) || (msgDepth & (msgDepth - 1)))
+		return -1;
+
+	for (i = 0 ; i < TASK_MAX_TASK ; i++)
 	{
-		if (TaskTable[priority].taskFunction == NULL_PTR)
+		if (TaskTable[i].taskFunction == NULL_PTR)
 		{
-			memset(TaskTable[priority].name, 0x00, TASK_NAME_LENGTH);
-			strncpy(TaskTable[priority].name, name, TASK_NAME_LENGTH);
+			if ((mPoolUsed + msgDepth) > TASK_MESSAGE_POOL_SIZE)
+				return -1;
+
+			TASK_ENTER_CRITICAL();
+
+			memset(TaskTable[i].name, 0x00, TASK_NAME_LENGTH);
+			strncpy(TaskTable[i].name, name, TASK_NAME_LENGTH);
+
+			TaskTable[i].flagEnable = 1;					//task enable
+			TaskTable[i].flagRun = 0;						//set on timeout, polled in main
+			TaskTable[i].index = i;							//
+			TaskTable[i].priority = priority;
+			TaskTable[i].readyNext = TASK_INDEX_NONE;
+			TaskTable[i].type = TASK_TYPE_PERIODIC;			//see Task_SetTaskType
+			TaskTable[i].sigPending = 0x00;
+			TaskTable[i].sigWait = 0x00;
+			TaskTable[i].ptLine = 0;						//coroutine from the top
+			TaskTable[i].ptSleeping = 0;
+			TaskTable[i].ptWake = 0;
+			TaskTable[i].timer = time;						//timeout
+			TaskTable[i].taskFunction = taskFunction;		//function pointer
+			Task_Schedule(i, time);							//first run
+
+			TaskTable[i].msgBase = mPoolUsed;				//ring from the pool
+			TaskTable[i].msgDepth = msgDepth;
+			TaskTable[i].msgHead = 0;
+			TaskTable[i].msgTail = 0;
+			TaskTable[i].msgOverflow = 0;
+			mPoolUsed += msgDepth;
 
-			TaskTable[priority].flagEnable = 1;					//task enable
-			TaskTable[priority].flagRun = 0;					//set on timeout, polled in main
-			TaskTable[priority].index = priority;				//
-			TaskTable[priority].initialTimeTick = time;			//set the timeout
-			TaskTable[priority].taskFunction = taskFunction;	//function pointer
-			TaskTable[priority].timer = time;					//timeout
+#if TASK_STATS
+			memset(&TaskTable[i].stats, 0x00, sizeof(TaskStats));
+#endif
 
-			TaskTable[priority].taskMessageWaiting = 0;
-			Task_ClearAllMessages(priority);
+			TASK_EXIT_CRITICAL();
 
 			return 1;
 		}
-
-		//function pointer already assigned
-		else
-			return -1;
 	}
 
-	return -1;
+	return -1;		//table full
 }
 
 ///////////////////////////////////////
@@ -101,16 +188,14 @@ int Task_RemoveTask(void (*taskFunction) (void))
 	{
 		if (taskFunction == TaskTable[i].taskFunction)
 		{
-			memset(TaskTable[i].name, 0x00, TASK_NAME_LENGTH);
-			TaskTable[i].taskFunction = NULL_PTR;
-			TaskTable[i].timer = 0;
-			TaskTable[i].flagEnable = 0;
-			TaskTable[i].flagRun = 0;
-			TaskTable[i].index = i;
-			TaskTable[i].initialTimeTick = 0;
+			TASK_ENTER_CRITICAL();
 
-			TaskTable[i].taskMessageWaiting = 0;
-			Task_ClearAllMessages(i);
+			Task_ReadyRemove(i);
+			Task_HeapRemove(i);
+			Task_PoolFree(i);
+			Task_ClearEntry(i);
+
+			TASK_EXIT_CRITICAL();
 
 			return i;
 		}
@@ -126,9 +211,13 @@ void Task_EnableTask(uint8_t taskIndex)
 		//check null function
 		if (TaskTable[taskIndex].taskFunction != NULL_PTR)
 		{
+			TASK_ENTER_CRITICAL();
+
+			Task_ReadyRemove(taskIndex);
 			TaskTable[taskIndex].flagEnable = 1;
-			TaskTable[taskIndex].flagRun = 0;
-			TaskTable[taskIndex].initialTimeTick = TaskTable[taskIndex].timer;
+			Task_Arm(taskIndex);
+
+			TASK_EXIT_CRITICAL();
 		}
 	}
 }
@@ -140,9 +229,13 @@ void Task_DisableTask(uint8_t taskIndex)
 		//check null function
 		if (TaskTable[taskIndex].taskFunction != NULL_PTR)
 		{
+			TASK_ENTER_CRITICAL();
+
+			Task_ReadyRemove(taskIndex);
+			Task_HeapRemove(taskIndex);
 			TaskTable[taskIndex].flagEnable = 0;
-			TaskTable[taskIndex].flagRun = 0;
-			TaskTable[taskIndex].initialTimeTick = 0;
+
+			TASK_EXIT_CRITICAL();
 		}
 	}
 }
@@ -156,8 +249,14 @@ void Task_RescheduleTask(uint8_t taskIndex, uint16_t updatedTime)
 		//check null function
 		if (TaskTable[taskIndex].taskFunction != NULL_PTR)
 		{
+			TASK_ENTER_CRITICAL();
+
 			TaskTable[taskIndex].timer = updatedTime;
-			TaskTable[taskIndex].initialTimeTick = updatedTime;
+
+			if (TaskTable[taskIndex].flagEnable == 1)
+				Task_Arm(taskIndex);
+
+			TASK_EXIT_CRITICAL();
 		}
 	}
 }
@@ -186,84 +285,684 @@ int Task_GetIndexFromName(char* name)
 /////////////////////////////////////////
 //Main loop routine.  should never
 //stop.  called in main.
+//Runs the first task of the highest priority
+//ready list, one task per pass, so a higher
+//priority task that became ready meanwhile goes
+//next.  Idles when nothing is ready.
+//An event task that left messages / signals
+//waiting goes to the back of its list again.
 void Task_StartScheduler(void)
 {
-	uint8_t i = 0;
+	int i;
 
 	while (1)
 	{
-		//run the tasker
-		for (i = 0; i < TASK_MAX_TASK ; i++)
+		TASK_ENTER_CRITICAL();
+		i = Task_ReadyPop();
+		TASK_EXIT_CRITICAL();
+
+		if (i >= 0)
 		{
-			if (TaskTable[i].taskFunction != NULL_PTR)
-			{
-				if (TaskTable[i].flagEnable == 1)
-				{
-					if (TaskTable[i].flagRun == 1)
-					{
-						//task to run
-						TaskTable[i].flagRun = 0;
-
-						TaskTable[i].taskFunction();
-						break;
-					}
-				}
-			}
+#if TASK_STATS
+			uint16_t start = Task_StatsTimer();
+#endif
+
+			mCurrentTask = i;
+			TaskTable[i].taskFunction();
+			mCurrentTask = TASK_INDEX_NONE;
+
+#if TASK_STATS
+			uint16_t elapsed = Task_StatsTimer() - start;		//wraps after 65536 counts
+
+			TaskTable[i].stats.runs++;
+			TaskTable[i].stats.totalTime += elapsed;
+
+			if (elapsed > TaskTable[i].stats.maxTime)
+				TaskTable[i].stats.maxTime = elapsed;
+#endif
+
+			TASK_ENTER_CRITICAL();
+			if ((TaskTable[i].flagEnable == 1) && Task_EventPending(i))
+				Task_ReadyPush(i);
+			TASK_EXIT_CRITICAL();
 		}
+		else
+			TASK_IDLE();
 	}
 }
 
 
+///////////////////////////////////////////
+//Task running now, for the coroutine macros
+TaskStruct* Task_GetCurrent(void)
+{
+	return &TaskTable[mCurrentTask];
+}
+
+
+/////////////////////////////////////////////
+//Ready the running task again, behind the
+//other ready tasks of the same priority.
+void Task_Yield(void)
+{
+	if (mCurrentTask < TASK_MAX_TASK)
+	{
+		TASK_ENTER_CRITICAL();
+		Task_ReadyPush(mCurrentTask);
+		TASK_EXIT_CRITICAL();
+	}
+}
+
+
+/////////////////////////////////////////////////
+//Ready a task ticks from now.  Periodic tasks
+//carry on with their period from there, event
+//tasks with period 0 run once (one shot).
+void Task_Sleep(uint8_t index, uint16_t ticks)
+{
+	if ((index < TASK_MAX_TASK) && (TaskTable[index].flagEnable == 1))
+	{
+		TASK_ENTER_CRITICAL();
+		Task_Schedule(index, ticks);
+		TASK_EXIT_CRITICAL();
+	}
+}
+
+
+char* Task_GetName(uint8_t index)
+{
+	if (index < TASK_MAX_TASK)
+		return TaskTable[index].name;
+
+	return NULL_PTR;
+}
+
+
+////////////////////////////////////////////
+//Copy the stats for a task.  Returns 1, 0 if
+//the slot is empty or stats are compiled out,
+//-1 if invalid.
+int Task_GetStats(uint8_t index, TaskStats *stats)
+{
+	if (index >= TASK_MAX_TASK)
+		return -1;
+
+	if (TaskTable[index].taskFunction == NULL_PTR)
+		return 0;
+
+#if TASK_STATS
+	TASK_ENTER_CRITICAL();
+	*stats = TaskTable[index].stats;
+	TASK_EXIT_CRITICAL();
+
+	stats->priority = TaskTable[index].priority;
+	stats->msgDepth = TaskTable[index].msgDepth;
+
+	return 1;
+#else
+	(void)stats;
+	return 0;
+#endif
+}
+
+
+///////////////////////////////////////////
+//Clear the stats of all tasks
+void Task_ResetStats(void)
+{
+	TASK_ENTER_CRITICAL();
+
+#if TASK_STATS
+	uint8_t i;
+	for (i = 0 ; i < TASK_MAX_TASK ; i++)
+		memset(&TaskTable[i].stats, 0x00, sizeof(TaskStats));
+#endif
+
+	mStatsStartTick = mTaskTick;
+
+	TASK_EXIT_CRITICAL();
+}
+
+
+//////////////////////////////////////////
+//Ticks since the last stats reset, the
+//time the stats cover
+uint32_t Task_GetStatsTicks(void)
+{
+	return Task_GetTick() - mStatsStartTick;
+}
+
+
+///////////////////////////////////////////////
+//Set what readies a task.  Message and signal
+//tasks with period 0 only run on events, with a
+//period they also run on the period.
+//Returns 1, -1 if invalid.
+int Task_SetTaskType(uint8_t index, TaskType_t type)
+{
+	if ((index < TASK_MAX_TASK) && (TaskTable[index].taskFunction != NULL_PTR))
+	{
+		TASK_ENTER_CRITICAL();
+
+		TaskTable[index].type = type;
+
+		if (TaskTable[index].flagEnable == 1)
+			Task_Arm(index);
+
+		TASK_EXIT_CRITICAL();
+
+		return 1;
+	}
+
+	return -1;		//invalid index
+}
+
+
+//////////////////////////////////////////////
+//Set signal bits on a task, safe from isrs.
+//A signal task waiting on any of them is
+//readied right away.  Returns 1, -1 if invalid.
+int Task_SetSignals(uint8_t index, uint8_t mask)
+{
+	if (index < TASK_MAX_TASK)
+	{
+		TASK_ENTER_CRITICAL();
+
+		TaskTable[index].sigPending |= mask;
+
+		if ((TaskTable[index].flagEnable == 1) && Task_EventPending(index))
+			Task_ReadyPush(index);
+
+		TASK_EXIT_CRITICAL();
+
+		return 1;
+	}
+
+	return -1;		//invalid index
+}
+
+
+///////////////////////////////////////////////
+//Wait for any of the signal bits in mask.
+//Bits already set ready the task right away.
+int Task_WaitSignals(uint8_t index, uint8_t mask)
+{
+	if (index < TASK_MAX_TASK)
+	{
+		TASK_ENTER_CRITICAL();
+
+		TaskTable[index].sigWait = mask;
+
+		if ((TaskTable[index].flagEnable == 1) && Task_EventPending(index))
+			Task_ReadyPush(index);
+
+		TASK_EXIT_CRITICAL();
+
+		return 1;
+	}
+
+	return -1;		//invalid index
+}
+
+
+//////////////////////////////////////////////
+//Signal bits the task waits on that are set.
+//Clears them, bits not waited on stay set.
+uint8_t Task_TakeSignals(uint8_t index)
+{
+	uint8_t bits = 0x00;
+
+	if (index < TASK_MAX_TASK)
+	{
+		TASK_ENTER_CRITICAL();
+
+		bits = TaskTable[index].sigPending & TaskTable[index].sigWait;
+		TaskTable[index].sigPending &=~ bits;
+
+		TASK_EXIT_CRITICAL();
+	}
+
+	return bits;
+}
+
+
 //////////////////////////////////////
 //Call this function in the timer isr
 //Configure the timer to rollover
 //at same speed, 2x, 3x... as the rate
 //we want to run the tasker.
+//
+//Advances the tick and readies the tasks
+//that are due.  Only the top of the heap
+//is checked.
+void Task_TimerISRHandler(void)
+{
+	mTaskTick++;
+	Task_ProcessDeadlines();
+}
 
-//Loop over the task table, decrementing
-//the timeTick and set the run flag for
-//those timers that have rolled over
 
-void Task_TimerISRHandler(void)
+////////////////////////////////////////////
+//Tickless - add ticks that passed without a
+//tick interrupt.  Interrupts off, or from the
+//compare isr.
+void Task_AdvanceTicks(uint32_t ticks)
 {
-	uint8_t i;
-	for (i = 0 ; i < TASK_MAX_TASK ; i++)
+	if (!ticks)
+		return;
+
+	mTaskTick += ticks;
+	Task_ProcessDeadlines();
+}
+
+
+//////////////////////////////////////////////
+//Ticks until the next timed task is due, 0 if
+//one is already due, TASK_NO_DEADLINE if no
+//timed tasks.  Interrupts off.
+uint32_t Task_GetTicksToNextDeadline(void)
+{
+	int32_t ticks;
+
+	if (!mHeapSize)
+		return TASK_NO_DEADLINE;
+
+	ticks = (int32_t)(TaskTable[mHeap[0]].due - mTaskTick);
+
+	return (ticks > 0) ? (uint32_t)ticks : 0;
+}
+
+
+uint32_t Task_GetTick(void)
+{
+	uint32_t tick;
+
+	TASK_ENTER_CRITICAL();
+	tick = mTaskTick;
+	TASK_EXIT_CRITICAL();
+
+	return tick;
+}
+
+
+#if defined(__AVR__)
+////////////////////////////////////////
+//Nothing ready - sleep until the next
+//interrupt.  The check and the sleep
+//are atomic so a ready task isn't missed.
+void Task_IdleSleep(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
+	cli();
+
+#if TASK_TICKLESS
+	Task_TicklessUpdate();				//catch up, program the next wake up
+#endif
+
+	if (!mReadyMask)
 	{
-		//check task enabled, function != NULL
-		if ((TaskTable[i].flagEnable == 1) && (TaskTable[i].taskFunction != NULL_PTR))
-		{
-			if (!TaskTable[i].initialTimeTick)
-			{
-				//set the run flag polled in main,
-				//reset the timer tick value
-				TaskTable[i].flagRun = 1;
-				TaskTable[i].initialTimeTick = TaskTable[i].timer;
-			}
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+#endif
 
-			else
-				TaskTable[i].initialTimeTick--;
-		}
+
+/////////////////////////////////////////////
+//Put a task at the end of its ready list.
+//Interrupts off, or from the timer isr.
+static void Task_ReadyPush(uint8_t index)
+{
+	uint8_t p = TaskTable[index].priority;
+
+	if (TaskTable[index].flagRun == 1)
+		return;								//already waiting
+
+	TaskTable[index].flagRun = 1;
+	TaskTable[index].readyNext = TASK_INDEX_NONE;
+
+	if (mReadyTail[p] == TASK_INDEX_NONE)
+		mReadyHead[p] = index;
+	else
+		TaskTable[mReadyTail[p]].readyNext = index;
+
+	mReadyTail[p] = index;
+	mReadyMask |= (1u << p);
+}
+
+
+/////////////////////////////////////////////
+//Take the first task from the highest priority
+//ready list.  Returns the index, -1 if none.
+//Interrupts off.
+static int Task_ReadyPop(void)
+{
+	uint8_t mask = mReadyMask;
+	uint8_t p;
+	uint8_t index;
+
+	if (!mask)
+		return -1;
+
+	//lowest set bit = highest priority
+	if (mask & 0x0F)
+		p = mLowestBit[mask & 0x0F];
+	else
+		p = 4 + mLowestBit[mask >> 4];
+
+	index = mReadyHead[p];
+	mReadyHead[p] = TaskTable[index].readyNext;
+
+	if (mReadyHead[p] == TASK_INDEX_NONE)
+	{
+		mReadyTail[p] = TASK_INDEX_NONE;
+		mReadyMask &=~ (1u << p);
 	}
+
+	TaskTable[index].readyNext = TASK_INDEX_NONE;
+	TaskTable[index].flagRun = 0;
+
+	return index;
+}
+
+
+/////////////////////////////////////////////
+//Take a task off its ready list, if it is on
+//it.  Walks the list, only used on enable,
+//disable and remove.  Interrupts off.
+static void Task_ReadyRemove(uint8_t index)
+{
+	uint8_t p = TaskTable[index].priority;
+	uint8_t prev = TASK_INDEX_NONE;
+	uint8_t i = mReadyHead[p];
+
+	if (TaskTable[index].flagRun == 0)
+		return;
+
+	while ((i != TASK_INDEX_NONE) && (i != index))
+	{
+		prev = i;
+		i = TaskTable[i].readyNext;
+	}
+
+	if (i == TASK_INDEX_NONE)
+		return;
+
+	if (prev == TASK_INDEX_NONE)
+		mReadyHead[p] = TaskTable[index].readyNext;
+	else
+		TaskTable[prev].readyNext = TaskTable[index].readyNext;
+
+	if (mReadyTail[p] == index)
+		mReadyTail[p] = prev;
+
+	if (mReadyHead[p] == TASK_INDEX_NONE)
+		mReadyMask &=~ (1u << p);
+
+	TaskTable[index].readyNext = TASK_INDEX_NONE;
+	TaskTable[index].flagRun = 0;
+}
+
+
+//////////////////////////////////////////
+//Reset a task table entry to unused
+static void Task_ClearEntry(uint8_t index)
+{
+	memset(TaskTable[index].name, 0x00, TASK_NAME_LENGTH);
+	TaskTable[index].taskFunction = NULL_PTR;
+	TaskTable[index].timer = 0;
+	TaskTable[index].flagEnable = 0;
+	TaskTable[index].flagRun = 0;
+	TaskTable[index].index = index;
+	TaskTable[index].priority = TASK_MAX_PRIORITY - 1;
+	TaskTable[index].readyNext = TASK_INDEX_NONE;
+	TaskTable[index].due = 0;
+	TaskTable[index].heapIndex = TASK_INDEX_NONE;
+	TaskTable[index].type = TASK_TYPE_PERIODIC;
+	TaskTable[index].sigPending = 0x00;
+	TaskTable[index].sigWait = 0x00;
+	TaskTable[index].ptLine = 0;
+	TaskTable[index].ptSleeping = 0;
+	TaskTable[index].ptWake = 0;
+	TaskTable[index].msgBase = 0;
+	TaskTable[index].msgDepth = 0;
+	TaskTable[index].msgHead = 0;
+	TaskTable[index].msgTail = 0;
+	TaskTable[index].msgOverflow = 0;
+}
+
+
+///////////////////////////////////////////////
+//Start an enabled task from its type and period.
+//Event tasks with period 0 stay out of the heap.
+//Interrupts off.
+static void Task_Arm(uint8_t index)
+{
+	if ((TaskTable[index].type == TASK_TYPE_PERIODIC) || (TaskTable[index].timer > 0))
+		Task_Schedule(index, TaskTable[index].timer);
+	else
+		Task_HeapRemove(index);
+
+	if (Task_EventPending(index))
+		Task_ReadyPush(index);
 }
 
 
 ////////////////////////////////////////////
-//Clear all messages in the TaskTable array
-//for a given element
-int Task_ClearAllMessages(uint8_t element)
+//1 if an event task has something waiting
+//that should make it ready.  A sleeping
+//coroutine only wakes on time.  Interrupts off.
+static uint8_t Task_EventPending(uint8_t index)
+{
+	if (TaskTable[index].ptSleeping)
+		return 0;
+
+	switch(TaskTable[index].type)
+	{
+		case TASK_TYPE_MESSAGE:
+			return (TaskTable[index].msgHead != TaskTable[index].msgTail) ? 1 : 0;
+
+		case TASK_TYPE_SIGNAL:
+			return (TaskTable[index].sigPending & TaskTable[index].sigWait) ? 1 : 0;
+
+		default:
+			return 0;
+	}
+}
+
+
+////////////////////////////////////////////////
+//Give a task's ring back to the pool.  Rings
+//above it move down so the pool stays packed.
+//Interrupts off.
+static void Task_PoolFree(uint8_t index)
 {
+	uint8_t base = TaskTable[index].msgBase;
+	uint8_t depth = TaskTable[index].msgDepth;
 	uint8_t i;
 
-	if (element < TASK_MAX_TASK)
+	if (!depth)
+		return;
+
+	for (i = base ; (i + depth) < mPoolUsed ; i++)
+		mMessagePool[i] = mMessagePool[i + depth];
+
+	mPoolUsed -= depth;
+
+	for (i = 0 ; i < TASK_MAX_TASK ; i++)
+	{
+		if ((TaskTable[i].msgDepth > 0) && (TaskTable[i].msgBase > base))
+			TaskTable[i].msgBase -= depth;
+	}
+
+	TaskTable[index].msgDepth = 0;
+}
+
+
+///////////////////////////////////////////////
+//Set the next run ticks from now and put the
+//task in the heap, or move it if already there.
+//0 ticks runs on the next tick.  Interrupts off.
+static void Task_Schedule(uint8_t index, uint32_t ticks)
+{
+	if (!ticks)
+		ticks = 1;
+
+	TaskTable[index].due = mTaskTick + ticks;
+
+	if (TaskTable[index].heapIndex == TASK_INDEX_NONE)
+	{
+		TaskTable[index].heapIndex = mHeapSize;
+		mHeap[mHeapSize++] = index;
+		Task_HeapUp(TaskTable[index].heapIndex);
+	}
+	else
 	{
-		TaskTable[element].taskMessageWaiting = 0;
+		Task_HeapUp(TaskTable[index].heapIndex);
+		Task_HeapDown(TaskTable[index].heapIndex);
+	}
+}
+
 
-		for (i = 0 ; i < TASK_MESSAGE_SIZE ; i++)
+///////////////////////////////////////////////
+//Ready every task that is due.  Each one gets
+//its next due tick and sinks down the heap.
+//Periods that were missed completely (tickless
+//catch up) are skipped, the task runs once.
+//Event tasks with no period were sleeping, they
+//leave the heap.
+static void Task_ProcessDeadlines(void)
+{
+	uint32_t now = mTaskTick;
+
+	while (mHeapSize && ((int32_t)(TaskTable[mHeap[0]].due - now) <= 0))
+	{
+		uint8_t i = mHeap[0];
+		uint32_t period = TaskTable[i].timer ? TaskTable[i].timer : 1;
+
+#if TASK_STATS
+		if (TaskTable[i].flagRun == 1)
+			TaskTable[i].stats.missed++;			//last run hasn't happened yet
+#endif
+
+		Task_ReadyPush(i);
+
+		if ((TaskTable[i].type != TASK_TYPE_PERIODIC) && (TaskTable[i].timer == 0))
 		{
-			TaskTable[element].taskMessage[i].signal = TASK_SIG_NONE;
-			TaskTable[element].taskMessage[i].value = 0x00;
+			Task_HeapRemove(i);
+			continue;
 		}
 
+		TaskTable[i].due += period;
+
+		if ((int32_t)(TaskTable[i].due - now) <= 0)
+		{
+			uint32_t skip = ((now - TaskTable[i].due) / period) + 1;
+
+			TaskTable[i].due += skip * period;
+
+#if TASK_STATS
+			TaskTable[i].stats.missed += skip;
+#endif
+		}
+
+		Task_HeapDown(0);
+	}
+}
+
+
+static void Task_HeapSwap(uint8_t a, uint8_t b)
+{
+	uint8_t temp = mHeap[a];
+
+	mHeap[a] = mHeap[b];
+	mHeap[b] = temp;
+
+	TaskTable[mHeap[a]].heapIndex = a;
+	TaskTable[mHeap[b]].heapIndex = b;
+}
+
+
+///////////////////////////////////////
+//Move an entry up while it is due
+//before its parent
+static void Task_HeapUp(uint8_t pos)
+{
+	while (pos > 0)
+	{
+		uint8_t parent = (pos - 1) / 2;
+
+		if (!TASK_DUE_BEFORE(mHeap[pos], mHeap[parent]))
+			break;
+
+		Task_HeapSwap(pos, parent);
+		pos = parent;
+	}
+}
+
+
+///////////////////////////////////////
+//Move an entry down while a child is
+//due before it
+static void Task_HeapDown(uint8_t pos)
+{
+	while (1)
+	{
+		uint8_t left = (2 * pos) + 1;
+		uint8_t right = left + 1;
+		uint8_t first = pos;
+
+		if ((left < mHeapSize) && TASK_DUE_BEFORE(mHeap[left], mHeap[first]))
+			first = left;
+
+		if ((right < mHeapSize) && TASK_DUE_BEFORE(mHeap[right], mHeap[first]))
+			first = right;
+
+		if (first == pos)
+			break;
+
+		Task_HeapSwap(pos, first);
+		pos = first;
+	}
+}
+
+
+///////////////////////////////////////////////
+//Take a task out of the heap.  The last entry
+//fills the hole and moves up or down.
+//Interrupts off.
+static void Task_HeapRemove(uint8_t index)
+{
+	uint8_t pos = TaskTable[index].heapIndex;
+
+	if (pos == TASK_INDEX_NONE)
+		return;
+
+	mHeapSize--;
+	TaskTable[index].heapIndex = TASK_INDEX_NONE;
+
+	if (pos != mHeapSize)
+	{
+		mHeap[pos] = mHeap[mHeapSize];
+		TaskTable[mHeap[pos]].heapIndex = pos;
+		Task_HeapUp(pos);
+		Task_HeapDown(TaskTable[mHeap[pos]].heapIndex);
+	}
+}
+
+
+////////////////////////////////////////////
+//Drop all messages waiting for a task.
+//Call from the task that owns the ring.
+int Task_ClearAllMessages(uint8_t element)
+{
+	if (element < TASK_MAX_TASK)
+	{
+		TaskTable[element].msgTail = TaskTable[element].msgHead;
 		return 1;
 	}
 
@@ -273,28 +972,52 @@ int Task_ClearAllMessages(uint8_t element)
 
 /////////////////////////////////////////
 //Send message to a task.
-//puts a message into taskMessage array
-//at element taskNumMessage++
+//Adds the message to the back of the task's
+//ring.  Safe from isrs - the isr and tasks
+//may send to the same task, so the slot and
+//the head are claimed with interrupts off.
+//A message task is readied right away.
 //returns the number of messages in the queue
 //after posting the message.  returns -1 if error
+//or the ring is full (counted in msgOverflow)
 //
 int Task_SendMessage(uint8_t index, TaskMessage message)
 {
+	int count = -1;
+
 	if (index < TASK_MAX_TASK)
 	{
+		TaskStruct *task = &TaskTable[index];
+
+		TASK_ENTER_CRITICAL();
+
 		//in the range and task is enabled
-		if (TaskTable[index].taskMessageWaiting < (TASK_MESSAGE_SIZE - 1) &&
-				(TaskTable[index].flagEnable == 1))
+		if ((task->flagEnable == 1) && (task->msgDepth > 0))
 		{
-			TaskTable[index].taskMessage[TaskTable[index].taskMessageWaiting].signal = message.signal;
-			TaskTable[index].taskMessage[TaskTable[index].taskMessageWaiting].value = message.value;
-			TaskTable[index].taskMessageWaiting++;
+			uint8_t head = task->msgHead;
+
+			if ((uint8_t)(head - task->msgTail) < task->msgDepth)
+			{
+				mMessagePool[task->msgBase + (head & (task->msgDepth - 1))] = message;
+				task->msgHead = head + 1;
+				count = (uint8_t)(head + 1 - task->msgTail);
+
+				if (Task_EventPending(index))
+					Task_ReadyPush(index);
 
-			return TaskTable[index].taskMessageWaiting;
+#if TASK_STATS
+				if (count > task->stats.msgHighWater)
+					task->stats.msgHighWater = count;
+#endif
+			}
+			else
+				task->msgOverflow++;
 		}
+
+		TASK_EXIT_CRITICAL();
 	}
 
-	return -1;		//invalid index
+	return count;
 }
 
 
@@ -305,7 +1028,7 @@ int Task_GetNumMessageWaiting(uint8_t index)
 {
 	if (index < TASK_MAX_TASK)
 	{
-		return TaskTable[index].taskMessageWaiting;
+		return (uint8_t)(TaskTable[index].msgHead - TaskTable[index].msgTail);
 	}
 
 	return -1;		//invalid index
@@ -313,22 +1036,25 @@ int Task_GetNumMessageWaiting(uint8_t index)
 
 
 ////////////////////////////////////////////////////
-//Dequeue a message if taskmessagewaiting is > 0
-//Decrement taskMessageWaiting, load the msg ptr,
-//and return the status.  Returns the current num
-//messages waiting after dequeue, -1 if error (name not found)
+//Dequeue the oldest message.  Only the task that
+//owns the ring reads it, and only the reader moves
+//the tail, so no interrupt lock is needed.
+//Returns the num messages waiting before the dequeue
+//(0 if empty), -1 if error.  Use in a while loop.
 //
 int Task_GetNextMessage(uint8_t index, TaskMessage *msg)
 {
 	if (index < TASK_MAX_TASK)
 	{
-		if (TaskTable[index].taskMessageWaiting > 0)
-		{
-			msg->signal = TaskTable[index].taskMessage[TaskTable[index].taskMessageWaiting - 1].signal;
-			msg->value = TaskTable[index].taskMessage[TaskTable[index].taskMessageWaiting - 1].value;
+		TaskStruct *task = &TaskTable[index];
+		uint8_t tail = task->msgTail;
+		uint8_t count = task->msgHead - tail;
 
-			//post decrement if using a while loop on reader side
-			return TaskTable[index].taskMessageWaiting--;
+		if (count > 0)
+		{
+			*msg = mMessagePool[task->msgBase + (tail & (task->msgDepth - 1))];
+			task->msgTail = tail + 1;			//frees the slot
+			return count;
 		}
 
 		else
@@ -339,3 +1065,16 @@ int Task_GetNextMessage(uint8_t index, TaskMessage *msg)
 
 	return -1;		//invalid index
 }
+
+
+//////////////////////////////////////////
+//Number of messages dropped, ring full
+int Task_GetMessageOverflow(uint8_t index)
+{
+	if (index < TASK_MAX_TASK)
+	{
+		return TaskTable[index].msgOverflow;
+	}
+
+	return -1;		//invalid index
+}
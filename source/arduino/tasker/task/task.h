@@ -17,7 +17,58 @@ In the timer isr, call the following function: Task_TimerISRHandler()
 
 In the main program, start the Scheduler using the following: Task_StartScheduler()
 
-Initialize tasks using Task_AddTask() - requires name, function, period, priority
+Initialize tasks using Task_AddTask() - requires name, function, period, priority,
+message ring depth
+Priority 0 is the highest, up to TASK_MAX_PRIORITY - 1.  Tasks with the same
+priority take turns (round robin).  Each task runs to completion.
+
+Tickless:
+Set TASK_TICKLESS to 1 and don't call Task_TimerISRHandler().  The port
+provides Task_TicklessUpdate(), which adds the ticks elapsed since the
+last call with Task_AdvanceTicks() and programs the next compare match
+Task_GetTicksToNextDeadline() ticks out.  The scheduler calls it before
+going idle, and the compare isr calls it.  See main.c, Timer1.
+
+Messages:
+Each task has a FIFO ring of msgDepth messages (Task_AddTask, power of 2,
+0 for none), cut from a shared pool of TASK_MESSAGE_POOL_SIZE messages.
+Task_SendMessage() can be called from tasks and isrs.  Only the task
+itself reads its ring with Task_GetNextMessage().  Messages sent to a
+full ring are dropped and counted, see Task_GetMessageOverflow().
+
+Event driven tasks:
+Task_SetTaskType() makes a task message driven (ready as soon as a message
+is sent to it) or signal driven (ready as soon as one of the signal bits it
+waits on is set, Task_WaitSignals() / Task_SetSignals()).  It runs at its
+own priority, no waiting for the period.  Period 0 = events only, otherwise
+the task also runs on its period, as a timeout.  The task is readied again
+after it runs while it still has messages / signals waiting.
+
+Coroutine tasks (protothreads):
+A task function can be written as a coroutine with the TASK_PT_ macros
+below.  It returns to the scheduler at each wait and picks up at the same
+line on its next run.  The resume point is kept in the TaskStruct, there
+is no stack per task.  Rules: locals are lost at a wait (make them static),
+there can't be a switch statement around a TASK_PT_ macro, and only one
+TASK_PT_ macro per line (the line number is the resume point).
+
+void TaskFunction_X(void)
+{
+	TASK_PT_BEGIN();
+	while (1)
+	{
+		TASK_PT_WAIT_UNTIL(SD_Ready());
+		TASK_PT_SLEEP(10);
+	}
+	TASK_PT_END();
+}
+
+Stats:
+Set TASK_STATS to 1 (see the Makefile) to count runs, execution time,
+missed periods and the message high water mark per task.  The port
+provides Task_StatsTimer(), a free running 16 bit count, TASK_STATS_COUNT_US
+per count.  Task_GetStats() reads them, see the "top" command.
+
 If using signals, update the TaskSignal_t values in task.h.  it would be better to
 pass a pointer to a signal table to make it so tasks could have thier own signal list.
 
@@ -33,10 +84,56 @@ See example in main for how to implement.
 #include <stdint.h>			//uint32_t..etc
 
 #define TASK_MAX_TASK		8
+#define TASK_MAX_PRIORITY	8			//ready bitmap is one byte
+#define TASK_INDEX_NONE		0xFF		//end of a ready list
 #define NULL_PTR			((void *)0)
 #define TASK_NAME_LENGTH	8
 
-#define TASK_MESSAGE_SIZE	8
+#define TASK_MESSAGE_POOL_SIZE	32		//messages shared by all tasks
+#define TASK_MESSAGE_MAX_DEPTH	128		//one ring, fits the 8 bit indexes
+
+#ifndef TASK_TICKLESS
+#define TASK_TICKLESS		0			//1 - no periodic tick, see above
+#endif
+
+#ifndef TASK_STATS
+#define TASK_STATS			0			//1 - per task run time stats, see above
+#endif
+
+#ifndef TASK_STATS_COUNT_US
+#define TASK_STATS_COUNT_US	4			//Task_StatsTimer, Timer1 clk/64 at 16mhz
+#endif
+
+#define TASK_NO_DEADLINE	0xFFFFFFFFUL
+
+
+////////////////////////////////////////////
+//Critical section - the timer isr and the
+//scheduler share the ready lists
+#if defined(__AVR__)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define TASK_ENTER_CRITICAL()	uint8_t _taskSreg = SREG; cli()
+#define TASK_EXIT_CRITICAL()	SREG = _taskSreg
+#define TASK_IDLE()				Task_IdleSleep()
+
+#elif defined(TASK_HOST)
+
+//pc build, task/host - the simulator
+//provides Task_IdleSleep()
+#define TASK_ENTER_CRITICAL()
+#define TASK_EXIT_CRITICAL()
+#define TASK_IDLE()				Task_IdleSleep()
+
+#else
+
+#define TASK_ENTER_CRITICAL()
+#define TASK_EXIT_CRITICAL()
+#define TASK_IDLE()				do {} while (0)
+
+#endif
 
 
 typedef enum
@@ -58,20 +155,60 @@ typedef struct
 }TaskMessage;
 
 
+//what makes a task ready
+typedef enum
+{
+	TASK_TYPE_PERIODIC,		//period only
+	TASK_TYPE_MESSAGE,		//message sent to it
+	TASK_TYPE_SIGNAL,		//any of its wait signal bits set
+}TaskType_t;
+
+
+//per task run time stats, TASK_STATS
+typedef struct
+{
+	uint32_t runs;				//times run
+	uint32_t totalTime;			//execution time, timer counts
+	uint16_t maxTime;			//longest run, timer counts
+	uint16_t missed;			//periods missed - still waiting, or skipped
+	uint8_t msgHighWater;		//most messages waiting
+	uint8_t priority;			//filled in by Task_GetStats
+	uint8_t msgDepth;			//filled in by Task_GetStats
+}TaskStats;
+
+
 //task structure
 typedef struct
 {
 	char name[TASK_NAME_LENGTH];//task name, null terminated for ref
-	uint16_t initialTimeTick;	//countdown value
+	uint32_t due;				//tick of the next run
 	uint16_t timer;				//frequency to run task
-	uint8_t flagRun;			//running or not running
+	uint8_t heapIndex;			//position in the deadline heap, TASK_INDEX_NONE = not timed
+	uint8_t flagRun;			//in the ready list, waiting to run
 	uint8_t flagEnable;			//enable task
 	uint8_t index;				//index in the task table
+	uint8_t priority;			//0 = highest
+	uint8_t readyNext;			//next task in the ready list, TASK_INDEX_NONE = last
+	uint8_t type;				//TaskType_t
+	volatile uint8_t sigPending;	//signal bits set, not taken yet
+	uint8_t sigWait;			//signal bits that ready the task - any of
+	uint16_t ptLine;			//coroutine resume point, 0 = start
+	uint8_t ptSleeping;			//coroutine waits on time, events don't ready it
+	uint32_t ptWake;			//coroutine sleep end tick
 
 	//task functions, signals, etc
 	void (* taskFunction) (void);				//function pointer - function to run
-	uint8_t taskMessageWaiting;					//how many meessages waiting
-	TaskMessage taskMessage[TASK_MESSAGE_SIZE];	//task message queue - unwind when task runs
+
+	//message ring - slice of the shared pool
+	uint8_t msgBase;							//first pool entry
+	uint8_t msgDepth;							//ring size, power of 2, 0 = no messages
+	volatile uint8_t msgHead;					//free running, written by senders
+	volatile uint8_t msgTail;					//free running, written by the task
+	uint16_t msgOverflow;						//messages dropped, ring full
+
+#if TASK_STATS
+	TaskStats stats;
+#endif
 
 }TaskStruct;
 
@@ -79,7 +216,7 @@ typedef struct
 
 //function prototypes
 void Task_Init(void);
-int Task_AddTask(char* name, void (*taskFunction) (void), uint16_t time, uint8_t priority);
+int Task_AddTask(char* name, void (*taskFunction) (void), uint16_t time, uint8_t priority, uint8_t msgDepth);
 int Task_RemoveTask(void (*taskFunction) (void));
 void Task_EnableTask(uint8_t taskIndex);
 void Task_DisableTask(uint8_t taskIndex);
@@ -89,12 +226,77 @@ int Task_GetIndexFromName(char* name);
 
 void Task_StartScheduler(void);
 void Task_TimerISRHandler(void);
+void Task_IdleSleep(void);
+
+//time
+uint32_t Task_GetTick(void);
+void Task_AdvanceTicks(uint32_t ticks);
+uint32_t Task_GetTicksToNextDeadline(void);
+
+#if TASK_TICKLESS
+void Task_TicklessUpdate(void);					//provided by the port
+#endif
 
 //messages
 int Task_ClearAllMessages(uint8_t element);					//helper function on init/remove, etc
 int Task_SendMessage(uint8_t index, TaskMessage message);
 int Task_GetNumMessageWaiting(uint8_t index);
 int Task_GetNextMessage(uint8_t index, TaskMessage *msg);
+int Task_GetMessageOverflow(uint8_t index);
+
+//event driven tasks
+int Task_SetTaskType(uint8_t index, TaskType_t type);
+int Task_SetSignals(uint8_t index, uint8_t mask);
+int Task_WaitSignals(uint8_t index, uint8_t mask);
+uint8_t Task_TakeSignals(uint8_t index);
+
+//coroutine tasks
+TaskStruct* Task_GetCurrent(void);
+void Task_Yield(void);
+void Task_Sleep(uint8_t index, uint16_t ticks);
+
+//stats
+char* Task_GetName(uint8_t index);
+int Task_GetStats(uint8_t index, TaskStats *stats);
+void Task_ResetStats(void);
+uint32_t Task_GetStatsTicks(void);
+
+#if TASK_STATS
+uint16_t Task_StatsTimer(void);					//provided by the port
+#endif
+
+
+////////////////////////////////////////////////////
+//Coroutine macros - see the notes at the top.
+//_pt is the running task, the switch jumps back
+//to the line of the last wait.
+#define TASK_PT_BEGIN()			TaskStruct *_pt = Task_GetCurrent(); switch(_pt->ptLine) { case 0:
+
+#define TASK_PT_END()			} _pt->ptLine = 0; return
+
+//run again after the other ready tasks of the same priority
+#define TASK_PT_YIELD()			do { _pt->ptLine = __LINE__; Task_Yield(); return; case __LINE__:; } while (0)
+
+//polled once per tick, the cpu can idle in between
+#define TASK_PT_WAIT_UNTIL(cond)											\
+	do { _pt->ptLine = __LINE__; case __LINE__:								\
+		if (!(cond)) { _pt->ptSleeping = 1; Task_Sleep(_pt->index, 1); return; }	\
+		_pt->ptSleeping = 0; } while (0)
+
+//next message into *msg.  Use with TASK_TYPE_MESSAGE so a
+//message resumes the task, otherwise it checks on the period
+#define TASK_PT_WAIT_MESSAGE(msg)											\
+	do { _pt->ptLine = __LINE__; case __LINE__:								\
+		if (Task_GetNextMessage(_pt->index, (msg)) <= 0) return; } while (0)
+
+//resume after ticks.  Messages and signals wait, an
+//early run (the period) returns until the time is up.
+#define TASK_PT_SLEEP(ticks)												\
+	do { _pt->ptWake = Task_GetTick() + (ticks); _pt->ptSleeping = 1;		\
+		Task_Sleep(_pt->index, (ticks)); _pt->ptLine = __LINE__; return;	\
+		case __LINE__:														\
+		if ((int32_t)(Task_GetTick() - _pt->ptWake) < 0) return;			\
+		_pt->ptSleeping = 0; } while (0)
 
 
 
@@ -0,0 +1,466 @@
+
+#include <avr/interrupt.h>
+#include <avr/io.h>         //macros
+
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+
+
+#include "register.h"
+#include "usart.h"
+#include "command.h"
+
+
+
+
+//rx line queue - the isr fills line rxLineHead,
+//the main loop takes complete lines from rxLineTail
+static volatile unsigned char rxIndex = 0x00;
+static volatile unsigned char rxLineHead = 0x00;    //free running, written by the isr
+static volatile unsigned char rxLineTail = 0x00;    //free running, written by the main loop
+static volatile unsigned int rxLinesDropped = 0x00;
+static volatile unsigned char rxDiscard = 0;        //drop up to the next '\n'
+static unsigned char rxLines[RX_LINE_COUNT][RX_BUFFER_SIZE];
+static unsigned char rxLineLength[RX_LINE_COUNT];
+
+//compiler barrier - line data in memory before
+//the index that hands it over
+#define USART_BARRIER()     __asm__ __volatile__ ("" ::: "memory")
+
+//tx ring, UDRE interrupt sends
+static volatile unsigned char txHead = 0x00;        //written by senders
+static volatile unsigned char txTail = 0x00;        //written by Usart_txIsr
+static volatile unsigned char txStarted = 0;        //sent since the last flush
+static volatile unsigned int txDropped = 0x00;
+static unsigned char txBuffer[TX_BUFFER_SIZE];
+
+
+
+///////////////////////////////////////
+//Configure USART on Pins 0 and 1 as
+//rx and tx.  No need to set direction if
+//enabling the usart.  Baud rates supported
+//include 9600, 57600, 115200.  Baud config
+//values from Table 24-7.  Register defs 
+//around page 244+
+//defaults to 9600
+void Usart_init(unsigned long baud)
+{
+
+    rxIndex = 0x00;
+    rxLineHead = 0x00;
+    rxLineTail = 0x00;
+    rxLinesDropped = 0x00;
+    rxDiscard = 0;
+    txHead = 0x00;
+    txTail = 0x00;
+    txStarted = 0;
+    txDropped = 0x00;
+
+
+    //configure the baud rate
+    UBRR0H_R = 0x00;
+
+    switch(baud)
+    {
+        case 9600:
+        {
+            UBRR0L_R = 207;
+            UCSR0A_R |= 0x02;        //U2Xn = double speed
+            break;
+        }
+
+        //57600 works better single speed, despite table 24-7
+        case 57600:
+        {
+            UBRR0L_R = 16;
+            UCSR0A_R &=~ 0x02;        //U2Xn = single speed
+            break;
+        }
+
+        case 115200:
+        {
+            UBRR0L_R = 16;
+            UCSR0A_R |= 0x02;        //U2Xn = double speed
+            break;
+        }
+
+        default:        //9600:
+        {
+            UBRR0L_R = 207;
+            UCSR0A_R |= 0x02;        //U2Xn = double speed
+            break;
+        }
+    }
+
+    
+
+
+    //UCSR0B_R - 0xC1 - config interrupts and tx/rx enable
+    //bit 7 - RX complete interrupt enable - set high
+    //bit 6 - tx complete interrupt - 0
+    //bit 5 - data reg empty interrupt - 0, set while the tx ring has data
+    //bit 4 - rx enable - 1
+    //bit 3 - tx enable - 1
+    //bit 2 - 1 - dont care
+    //bit 0 - 9th bit on a 9 bit tx = 0
+    //ie, write 0x98
+
+    UCSR0B_R = 0x98;
+
+    //UCSR0C_R - 0xC2 - config usart params
+    //bit 7-6 = 00 - async
+    //bit 5-4 = 00 - no parity
+    //bit 3   = 0 - 1 stop bit
+    //bit 2-0 = 011 - 8 bit - note: this defaults to 110, ??
+    //since these are listed as reserved, leave bits 0-2 alone
+    UCSR0C_R = 0x06;
+
+    //enable global interrupts
+    __SEI;
+
+    //poll the rx...
+    while (RXC0_FLAG){};        //complete any incoming
+    while (TXC0_FLAG){};        //complete any outgoing 
+}
+
+
+
+///////////////////////////////////
+//Usart_isr
+//Call this function from ISR(), passing
+//the read data byte as function arg.
+//Only stores the byte.  A '\n' completes the
+//line and hands it to the main loop, see
+//Usart_processLines.  A line that arrives with
+//the queue full, or doesn't fit the buffer, is
+//discarded up to its '\n' and counted, so the
+//tail of it doesn't run as a command.
+//returns 1 when a line was completed
+//
+unsigned char Usart_isr(unsigned char c)
+{
+    unsigned char *line;
+
+    if (rxDiscard || ((unsigned char)(rxLineHead - rxLineTail) >= RX_LINE_COUNT))
+    {
+        rxIndex = 0x00;
+        rxDiscard = (c != '\n');
+
+        if (c == '\n')
+            rxLinesDropped++;
+
+        return 0;
+    }
+
+    line = rxLines[rxLineHead & RX_LINE_MASK];
+
+    if ((c != 0x00) && (c != '\n') && (rxIndex >= (RX_BUFFER_SIZE - 1)))
+    {
+        rxIndex = 0x00;                 //too long
+        rxDiscard = 1;
+        return 0;
+    }
+
+    if ((c != 0x00) && (rxIndex < (RX_BUFFER_SIZE - 1)))
+        line[rxIndex++] = c;
+
+    //test char c for \n - ends the line, a '\n'
+    //with no room left isn't stored
+    if (c == '\n')
+    {
+        line[rxIndex] = 0x00;
+        rxLineLength[rxLineHead & RX_LINE_MASK] = rxIndex;
+        rxIndex = 0x00;
+
+        USART_BARRIER();
+        rxLineHead++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+///////////////////////////////////////////
+//Usart_processLines
+//Call from the main loop.  Runs
+//Usart_processCommand on each complete line,
+//oldest first, outside the rx interrupt.
+//returns the number of lines processed.
+//A command that calls it again (from Delay)
+//returns 0, the line is still being run.
+int Usart_processLines(void)
+{
+    static unsigned char running = 0;
+    int count = 0x00;
+    unsigned char slot;
+
+    if (running)
+        return 0;
+
+    running = 1;
+
+    while (rxLineTail != rxLineHead)
+    {
+        USART_BARRIER();
+        slot = rxLineTail & RX_LINE_MASK;
+        Usart_processCommand(rxLines[slot], rxLineLength[slot]);
+
+        USART_BARRIER();
+        rxLineTail++;                   //frees the line for the isr
+        count++;
+    }
+
+    running = 0;
+
+    return count;
+}
+
+
+///////////////////////////////////////
+//Lines dropped, queue full or too long
+unsigned int Usart_getRxDropped(void)
+{
+    return rxLinesDropped;
+}
+
+
+/////////////////////////////////////////////
+//Transmit - bytes go into the tx ring and the
+//data register empty interrupt (UDRE) sends
+//them, see Usart_txIsr.  Senders only wait when
+//the ring is full and USART_TX_POLICY is block.
+//
+//Usart_txPut - one byte into the ring.  Senders
+//in isrs and the main loop share the head, so it
+//is claimed with interrupts off.  Full ring with
+//interrupts off (called from an isr) - the udre
+//interrupt can't run, send a byte by hand.
+//returns 1 if the byte went in, 0 if dropped
+static unsigned char Usart_txPut(unsigned char data, unsigned char block)
+{
+    unsigned char sreg;
+    unsigned char next;
+
+    while (1)
+    {
+        sreg = SREG_R;
+        cli();
+
+        next = (txHead + 1) & TX_BUFFER_MASK;
+        if (next != txTail)
+            break;
+
+        SREG_R = sreg;
+
+        if (!block)
+        {
+            txDropped++;
+            return 0;
+        }
+
+        if (!(sreg & 0x80) && (UCSR0A_R & (1u << 5)))
+            Usart_txIsr();
+    }
+
+    txBuffer[txHead] = data;
+    txHead = next;
+    UCSR0B_R |= 1u << 5;                //UDRIE - start sending
+
+    SREG_R = sreg;
+
+    return 1;
+}
+
+
+///////////////////////////////////////
+//Usart_txIsr
+//Call this function from ISR(USART_UDRE_vect)
+//Sends the next byte, turns the interrupt
+//off when the ring is empty.
+void Usart_txIsr(void)
+{
+    if (txTail != txHead)
+    {
+        UCSR0A_R = (UCSR0A_R & 0x03) | (1u << 6);  //clear TXC, keep U2X
+        UDR0_R = txBuffer[txTail];
+        txTail = (txTail + 1) & TX_BUFFER_MASK;
+        txStarted = 1;
+    }
+    else
+        UCSR0B_R &=~ (1u << 5);         //UDRIE off
+}
+
+
+/////////////////////////////////////////
+//Usart_write
+//Non blocking - copies what fits in the
+//tx ring, returns the number of bytes
+//accepted.
+unsigned int Usart_write(const unsigned char *data, unsigned int length)
+{
+    unsigned int i = 0x00;
+
+    while ((i < length) && Usart_txPut(data[i], 0))
+        i++;
+
+    return i;
+}
+
+
+/////////////////////////////////////////
+//Usart_flush
+//Wait until everything in the ring is
+//out of the shift register.
+void Usart_flush(void)
+{
+    while (txHead != txTail)
+    {
+        if (!(SREG_R & 0x80) && (UCSR0A_R & (1u << 5)))
+            Usart_txIsr();
+    }
+
+    if (txStarted)
+    {
+        while(!(UCSR0A_R & (1u << 6))){};   //wait for complete
+        txStarted = 0;
+    }
+}
+
+
+/////////////////////////////////////////
+//Bytes dropped - ring full, USART_TX_DROP
+//or Usart_write
+unsigned int Usart_getTxDropped(void)
+{
+    return txDropped;
+}
+
+
+void Usart_sendByte(unsigned char data)
+{
+    Usart_txPut(data, USART_TX_POLICY);
+}
+
+
+void Usart_sendString(char *data)
+{
+    char *p = data;
+    while (*p != 0x00)
+    {
+        Usart_sendByte((unsigned char)*p);
+        p++;
+    }
+}
+
+void Usart_sendArray(unsigned char *data, unsigned int length)
+{
+    unsigned int i = 0x00;
+    for (i = 0 ; i < length ; i++)
+        Usart_sendByte(data[i]);
+}
+
+
+
+//////////////////////////////////////////////
+//process command function for incoming
+//data over usart.  Parse args into argc
+//argv[*]
+//tokanize buffer and assign array of char*
+//and get num args.
+void Usart_processCommand(unsigned char *data, unsigned int length)
+{
+	//arg buffs, ptr and size
+	char* argv[ARG_BUFFER_SIZE];
+	int i, argc = 0;
+    int result = 0x00;
+    char outBuffer[64];
+
+	memset(argv, 0x00, sizeof(argv));
+
+    //clean up array by removing \r\n
+    for (i = 0 ; i < length ; i++)
+    {
+        if ((data[i] == '\r') || (data[i] == '\n'))
+            data[i] = 0x00;
+    }
+
+    //parse data* into argv argc
+    Usart_parseArgs((char*)data, &argc, argv);
+
+    //pass argv/arc into the cli table
+    result = Command_ExeCommand(argc, argv);
+
+    if (result >= 0)
+    {
+        i = sprintf(outBuffer, "Success: Elem: %d\r\n", result);
+        Usart_sendArray((unsigned char*)outBuffer, i);    
+    }
+    else
+    {
+        Usart_sendString("Error No Match\r\n");
+    }
+
+
+
+
+}
+
+
+/////////////////////////////////////////
+//parse input buffer into args in place.
+//Args are split on spaces, tabs and commas,
+//the separators are replaced with null chars
+//and argv points into the buffer, nothing
+//is copied.  "quoted args" keep their spaces,
+//the quotes are removed.  No static state,
+//so it can be called from any context.
+//
+void Usart_parseArgs(char *in, int *pargc, char** argv)
+{
+    int argc = 0;
+    char *src = in;
+    char *dst;
+    char quote;
+
+    while ((*src != 0x00) && (argc < ARG_BUFFER_SIZE))
+    {
+        //skip separators
+        if ((*src == ' ') || (*src == '\t') || (*src == ','))
+        {
+            src++;
+            continue;
+        }
+
+        //arg starts here, copy down over any quotes
+        argv[argc++] = src;
+        dst = src;
+        quote = 0;
+
+        while (*src != 0x00)
+        {
+            if (*src == '"')
+                quote = !quote;
+            else if (!quote && ((*src == ' ') || (*src == '\t') || (*src == ',')))
+                break;
+            else
+                *dst++ = *src;
+
+            src++;
+        }
+
+        if (*src != 0x00)
+            src++;
+
+        *dst = 0x00;
+    }
+
+    *pargc = argc;
+}
+
+
+
+
+
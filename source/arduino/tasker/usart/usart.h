@@ -0,0 +1,41 @@
+#ifndef __USART_H
+#define __USART_H
+
+
+
+//////////////////////////////
+//usart buffer items
+#define RX_BUFFER_SIZE              64
+#define ARG_BUFFER_SIZE             16
+#define RX_LINE_COUNT               2       //lines waiting, power of 2
+#define RX_LINE_MASK                (RX_LINE_COUNT - 1)
+#define TX_BUFFER_SIZE              64      //power of 2
+#define TX_BUFFER_MASK              (TX_BUFFER_SIZE - 1)
+
+//////////////////////////////
+//tx ring full - sendByte/String/Array
+//wait for room, or drop what doesn't fit
+#define USART_TX_DROP               0
+#define USART_TX_BLOCK              1
+
+#ifndef USART_TX_POLICY
+#define USART_TX_POLICY             USART_TX_BLOCK
+#endif
+
+
+void Usart_init(unsigned long baud);
+unsigned char Usart_isr(unsigned char c);
+int Usart_processLines(void);
+unsigned int Usart_getRxDropped(void);
+void Usart_txIsr(void);
+unsigned int Usart_write(const unsigned char *data, unsigned int length);
+void Usart_flush(void);
+unsigned int Usart_getTxDropped(void);
+void Usart_sendByte(unsigned char data);
+void Usart_sendString(char *data);
+void Usart_sendArray(unsigned char *data, unsigned int length);
+void Usart_processCommand(unsigned char *data, unsigned int length);
+void Usart_parseArgs(char *in, int *pargc, char** argv);
+
+#endif
+
@@ -0,0 +1,252 @@
+/*
+Sleep model - runs on the pc
+Dana Olcott
+
+Counts the cpu cycles spent awake in a main loop of
+work then Delay(n), with Delay spinning on the tick
+(the old way) and sleeping between ticks (main.c
+now), and checks the frame period didn't move.
+
+The two Delay loops below are copies of the ones in
+main.c (AVR) and Timer_Delay (SAME70, WFI), run on a
+cycle clock instead of the chip:
+
+- a tick interrupt every tickCycles, isrCycles long.
+  Other interrupts (adc end of conversion, the 11khz
+  audio timer) at extraRate per tick, extraCycles each
+- awake code advances the clock, interrupts due in
+  it run as they fall due and push it out
+- sleep jumps the clock to the next interrupt, waking
+  costs wakeCycles (interrupt response + the idle
+  wake up)
+- cycle counts are estimates from the listing, not
+  measured
+
+Current is typical datasheet figures, active and
+idle at the target clock, 5V (AVR).  The SAME70
+shows awake cycles only.
+
+Build:  gcc -std=c99 -O2 -Wall -o sleepmodel sleepmodel.c
+Run:    ./sleepmodel [frames]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+
+typedef struct
+{
+    const char *name;
+    uint32_t tickCycles;            //cpu clocks per 1ms tick
+    uint32_t isrCycles;             //tick isr, in and out
+    uint32_t wakeCycles;            //wake from idle / WFI
+    uint32_t spinCycles;            //one pass, while (val > gTimeTick)
+    uint32_t sleepCycles;           //one pass of the sleep loop, awake
+    uint32_t extraRate;             //other interrupts per tick
+    uint32_t extraCycles;
+    uint32_t work;                  //main loop work per frame
+    uint32_t delay;                 //Delay(n) per frame, ticks
+    double iActive;                 //mA, 0 - not modelled
+    double iIdle;
+}Target;
+
+
+static const Target mTargets[] =
+{
+    //16mhz, Timer0 overflow, clk/64
+    {"atmega328p  Delay(100)", 16000, 60, 8, 10, 22, 0, 0, 4000, 100, 9.0, 2.6},
+
+    //usart project - rx bytes at 115200 while a
+    //line comes in, ~11 per tick
+    {"atmega328p  usart rx", 16000, 60, 8, 10, 22, 11, 45, 4000, 100, 9.0, 2.6},
+
+    //1mhz, Timer0 compare
+    {"attiny85    Delay(500)", 1000, 40, 8, 10, 22, 0, 0, 200, 500, 1.0, 0.25},
+
+    //300mhz, TC3 tick, one adc conversion per tick,
+    //TC0 audio at 11khz, game frame ~6ms of drawing
+    {"same70      Timer_Delay(10)", 300000, 120, 20, 12, 30, 12, 150, 1800000, 10, 0.0, 0.0},
+};
+
+#define TARGET_COUNT    (int)(sizeof(mTargets) / sizeof(Target))
+
+
+//cycle clock
+static const Target *mTarget;
+static uint64_t mNow;
+static uint64_t mAwake;
+static uint64_t mNextTick;
+static uint64_t mNextExtra;
+static volatile uint32_t gTimeTick;
+
+
+static uint64_t nextIrq(void)
+{
+    return (mNextExtra < mNextTick) ? mNextExtra : mNextTick;
+}
+
+
+static void isr(void)
+{
+    if (mNextTick <= mNextExtra)
+    {
+        mNow += mTarget->isrCycles;
+        mAwake += mTarget->isrCycles;
+        mNextTick += mTarget->tickCycles;
+        gTimeTick++;
+    }
+    else
+    {
+        mNow += mTarget->extraCycles;
+        mAwake += mTarget->extraCycles;
+        mNextExtra += mTarget->tickCycles / mTarget->extraRate;
+    }
+}
+
+
+//////////////////////////////////////////
+//awake code, n cycles
+static void cpu(uint32_t n)
+{
+    uint64_t end = mNow + n;
+
+    while (nextIrq() <= end)
+    {
+        uint64_t t = nextIrq();
+
+        if (t > mNow)
+        {
+            mAwake += t - mNow;
+            mNow = t;
+        }
+
+        end -= mNow;                //cycles left
+        isr();
+        end += mNow;
+    }
+
+    mAwake += end - mNow;
+    mNow = end;
+}
+
+
+//////////////////////////////////////////
+//sleep_cpu / WFI - to the next interrupt
+static void sleep(void)
+{
+    uint64_t t = nextIrq();
+
+    if (t > mNow)
+        mNow = t;
+
+    mNow += mTarget->wakeCycles;
+    mAwake += mTarget->wakeCycles;
+    isr();
+}
+
+
+//////////////////////////////////////////
+//Delay, the old way
+static void delaySpin(uint32_t val)
+{
+    gTimeTick = 0x00;
+    while (val > gTimeTick)
+        cpu(mTarget->spinCycles);
+}
+
+
+//////////////////////////////////////////
+//Delay in main.c - the check and the sleep
+//with interrupts off, sei takes effect after
+//sleep_cpu
+static void delaySleep(uint32_t val)
+{
+    gTimeTick = 0x00;
+    while (val > gTimeTick)
+    {
+        cpu(mTarget->sleepCycles);
+
+        if (val > gTimeTick)
+            sleep();
+    }
+}
+
+
+typedef struct
+{
+    double awake;                   //fraction
+    double frameMs;                 //average
+    double frameMin, frameMax;
+}Result;
+
+
+static Result run(const Target *target, int frames, void (*delay)(uint32_t))
+{
+    Result result = {0, 0, 1e9, 0};
+    uint64_t start, frame;
+    double ms;
+    int i;
+
+    mTarget = target;
+    mNow = 0;
+    mAwake = 0;
+    mNextTick = target->tickCycles;
+    mNextExtra = target->extraRate ? (target->tickCycles / target->extraRate) / 2 : UINT64_MAX;
+
+    start = mNow;
+
+    for (i = 0 ; i < frames ; i++)
+    {
+        frame = mNow;
+
+        cpu(target->work);
+        delay(target->delay);
+
+        ms = (double)(mNow - frame) / target->tickCycles;
+
+        if (ms < result.frameMin)
+            result.frameMin = ms;
+        if (ms > result.frameMax)
+            result.frameMax = ms;
+    }
+
+    result.awake = (double)mAwake / (mNow - start);
+    result.frameMs = (double)(mNow - start) / target->tickCycles / frames;
+
+    return result;
+}
+
+
+int main(int argc, char **argv)
+{
+    int frames = (argc > 1) ? atoi(argv[1]) : 200;
+    Result spin, slept;
+    int i;
+
+    printf("%-28s %8s %8s %7s   %-20s  %-20s  %s\n", "target", "awake", "awake",
+            "", "frame ms", "frame ms", "mA");
+    printf("%-28s %8s %8s %7s   %-20s  %-20s  %s\n", "", "spin", "sleep",
+            "ratio", "spin avg/min/max", "sleep avg/min/max", "spin -> sleep");
+
+    for (i = 0 ; i < TARGET_COUNT ; i++)
+    {
+        spin = run(&mTargets[i], frames, delaySpin);
+        slept = run(&mTargets[i], frames, delaySleep);
+
+        printf("%-28s %7.2f%% %7.2f%% %6.1fx   %6.2f/%6.2f/%6.2f  %6.2f/%6.2f/%6.2f  ",
+                mTargets[i].name, spin.awake * 100, slept.awake * 100, spin.awake / slept.awake,
+                spin.frameMs, spin.frameMin, spin.frameMax,
+                slept.frameMs, slept.frameMin, slept.frameMax);
+
+        if (mTargets[i].iActive > 0)
+            printf("%5.2f -> %5.2f\n",
+                    mTargets[i].iActive,
+                    slept.awake * mTargets[i].iActive + (1 - slept.awake) * mTargets[i].iIdle);
+        else
+            printf("   -\n");
+    }
+
+    return 0;
+}
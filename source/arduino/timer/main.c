@@ -49,6 +49,11 @@ TIMSK2 - Interrupt mask register -
 TIFR2 - Timer/Counter2 - interrupt flag
         Bit 0 - set when overflow interrupt
         occurs, cleared by hardware when executing the interrupt.
+
+////////////////////////////////////////////
+update - Timer2 is no longer used.  The PB0 toggle
+runs in the Timer0 isr, same 1khz rate.  Timer0 is
+the only hardware timer, Timer2 is free.
  
 
 
@@ -68,6 +73,7 @@ TIFR2 - Timer/Counter2 - interrupt flag
 
 #include <avr/io.h>         //macros
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 
 //////////////////////////////////////////
@@ -109,7 +115,6 @@ TIFR2 - Timer/Counter2 - interrupt flag
 void GPIO_init(void);
 void Interrupt_init(void);
 void Timer0_init(void);
-void Timer2_init(void);
 void Waste_CPU(unsigned int temp);
 void Dummy_Function(void);
 
@@ -159,7 +164,7 @@ ISR(INT0_vect)
 ISR(TIMER0_OVF_vect)
 {
     gTimeTick++;        //used by Delay
-//    PINB_R |= 0x01;     //toggle PB0 (Pin 8)
+    PINB_R |= 0x01;     //toggle PB0 (Pin 8)
 
     //clear interrupt - datasheet shows
     //this bit has to be set to run timer
@@ -168,24 +173,12 @@ ISR(TIMER0_OVF_vect)
 
 
 
-////////////////////////////////////
-//Timer2 Overflow interrupt ISR
-//Configured to run at 1khz - should
-//be the same as Timer0 speed
-ISR(TIMER2_OVF_vect)
-{
-    PINB_R |= 0x01;     //toggle PB0 (Pin 8)
-    TIFR2 |= 0x01;      //clear the interrupt flag    
-}
-
-
 ///////////////////////////////////////
 int main()
 {
     GPIO_init();        //configure led and button
     Interrupt_init();   //falling edge trigger  
     Timer0_init();      //Timer0 Counter Overflow
-    Timer2_init();      //Timer2 Counter Overflow
  
     while(1)
     {
@@ -288,41 +281,6 @@ void Timer0_init(void)
 
 
 
-//////////////////////////////////////////
-//Configure Timer2 with Overflow Interrupt
-//The configuration should be similar to Timer0
-//in that both are 8 bit and will also be 
-//configured to overflow at 1khz
-//
-void Timer2_init(void)
-{
-    //Timer Control - 2 registers:
-    TCCR2A_R = 0x00;      //disable all pin outputs on compare
-    TCCR2B_R = 0x04;      //set the prescaler - bits 0-2
-
-    //NOTE: Prescale values for Timer2 are not the same
-    //as Timer0.  ie, to get clk / 64, need to write 0x04
-
-    //    000 - no clock - timer disabled
-    //    001 - no prescale
-    //    010 - clk/8
-    //    011 - clk/32
-    //    100 - clk/64
-    //    101 - clk/128
-    //    110 - clk/256
-    //    111 - clk/1024
-
-    TIMSK2_R |= 0x01;       //bit 0 - overflow interrupt
-    TIFR2_R |= 0x01;        //clear the overflow flag
-
-    sei();                  //enable interrupts
-}
-
-
-
-
-
-
 /////////////////////////////////////
 void Waste_CPU(unsigned int temp)
 {
@@ -382,10 +340,24 @@ void Flash3(void)
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0 / timer2 or
+//the INT0 button wakes it.
 void Delay(volatile unsigned int val)
 {
     gTimeTick = 0x00;           //upcounter
-    while (val > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0, timer2 and INT0 keep running
+    while (val > gTimeTick)
+    {
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 
 }
 
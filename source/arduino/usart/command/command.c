@@ -19,20 +19,33 @@ static void cmdFunction3(int argc, char** argv);
 
 ////////////////////////////////////////////
 //CommandStruct commandTable
-
-static const CommandStruct commandTable[5] = 
+//Flash only.  Keep it sorted by the command
+//string (strcmp order, '?' before letters),
+//the lookup is a binary search.
+//{command, menu, min args, max args, function}
+//host/tablecheck.c checks the order.
+static const CommandStruct commandTable[] PROGMEM = 
 {
-    {"?",       "Print Help",   cmdHelp},
-    {"string1", "menu string1", cmdFunction1},
-    {"string2", "menu string1", cmdFunction2},
-    {"string3", "menu string2", cmdFunction3},
-    {NULL, NULL, NULL},
+    {"?",       "Print Help, ? <cmd> for one", 0, 1, cmdHelp},
+    {"string1", "menu string1", 0, 0, cmdFunction1},
+    {"string2", "menu string1", 0, 0, cmdFunction2},
+    {"string3", "menu string2", 0, 0, cmdFunction3},
 };
 
+#define COMMAND_TABLE_SIZE      (int)(sizeof(commandTable) / sizeof(CommandStruct))
+
 
 
 void cmdHelp(int argc, char** argv)
 {
+    if (argc > 1)
+    {
+        if (Command_PrintCommandHelp(argv[1]) < 0)
+            Usart_sendString("No Such Command\r\n");
+
+        return;
+    }
+
     Usart_sendString("Help Function\r\n");
     Command_PrintHelp();
 }
@@ -55,31 +68,71 @@ void cmdFunction3(int argc, char** argv)
 }
 
 
+/////////////////////////////////////////////
+//Command_Find
+//Binary search of the sorted table.
+//returns the index, -1 if no match
+static int Command_Find(char *name)
+{
+    int low = 0x00;
+    int high = COMMAND_TABLE_SIZE - 1;
+    int mid, cmp;
+
+    if (name == NULL)
+        return -1;
+
+    while (low <= high)
+    {
+        mid = (low + high) / 2;
+        cmp = strcmp_P(name, commandTable[mid].cmdString);
+
+        if (!cmp)
+            return mid;
+        else if (cmp < 0)
+            high = mid - 1;
+        else
+            low = mid + 1;
+    }
+
+    return -1;
+}
+
+
 /////////////////////////////////////////////
 //Command_ExeCommand
 //Takes parsed arguments, searches for the
-//matching command string, runs the cooresponding
-//function.
+//matching command string, checks the number
+//of args, runs the cooresponding function.
 //returns index of the table element, -1 if
-//no match
+//no match, -2 if wrong number of args
 int Command_ExeCommand(int argc, char** argv)
 {
-    int i = 0x00;
-    
-    while (commandTable[i].cmdString != NULL)
-    {
-        if (!strcmp(argv[0], commandTable[i].cmdString))
-        {
-            //run the function
-            commandTable[i].cmdPtr(argc, argv);
-            return i;
-        }
+    void (*cmdPtr) (int argc, char** argv);
+    unsigned char args;
+    int i;
+
+    if (argc < 1)
+        return -1;
+
+    i = Command_Find(argv[0]);
+
+    if (i < 0)
+        return -1;
 
-        i++;
+    args = argc - 1;
+
+    if ((args < pgm_read_byte(&commandTable[i].minArgs)) ||
+        (args > pgm_read_byte(&commandTable[i].maxArgs)))
+    {
+        Command_PrintCommandHelp(argv[0]);
+        return -2;
     }
 
-    return -1;
+    //run the function
+    cmdPtr = (void (*) (int, char**))pgm_read_word(&commandTable[i].cmdPtr);
+    cmdPtr(argc, argv);
 
+    return i;
 }
 
 
@@ -92,14 +145,231 @@ void Command_PrintHelp(void)
     int n = 0x00;
     char buffer[64];
 
-    while (commandTable[i].cmdString != NULL)
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
     {
-        n = snprintf(buffer, 64, "%-16s  %-32s\r\n", commandTable[i].cmdString, commandTable[i].menuString);
+        n = snprintf_P(buffer, 64, PSTR("%-16S  %-32S\r\n"), commandTable[i].cmdString, commandTable[i].menuString);
         Usart_sendArray((unsigned char*)buffer, n);
-        i++;
+    }
+}
+
+
+//////////////////////////////////////
+//Prints one command, its description
+//and the number of args it takes.
+//returns the index, -1 if no match
+int Command_PrintCommandHelp(char *name)
+{
+    int i = Command_Find(name);
+    int n = 0x00;
+    char buffer[64];
+
+    if (i < 0)
+        return -1;
+
+    n = snprintf_P(buffer, 64, PSTR("%S - %S, args %u-%u\r\n"),
+            commandTable[i].cmdString,
+            commandTable[i].menuString,
+            pgm_read_byte(&commandTable[i].minArgs),
+            pgm_read_byte(&commandTable[i].maxArgs));
+
+    Usart_sendArray((unsigned char*)buffer, n);
+
+    return i;
+}
+
+
+///////////////////////////////////////
+//hex char to 0-15, -1 if not hex
+static int Command_HexNibble(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+
+//////////////////////////////////////////////
+//Typed arg accessors.  Parse an argv[] string
+//without sscanf / strtol, no static state.
+//All return 0 and load value, or -1 if the
+//arg is missing, malformed or out of range.
+//
+//Command_GetInt - decimal with optional sign,
+//or hex with a 0x prefix
+int Command_GetInt(const char *arg, long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char negative = 0;
+
+    if ((arg == NULL) || (*arg == 0x00))
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+    {
+        if ((Command_GetHex(arg, &result) < 0) || (result > 0x7FFFFFFFul))
+            return -1;
+
+        *value = (long)result;
+        return 0;
+    }
+
+    if ((*arg == '-') || (*arg == '+'))
+        negative = (*arg++ == '-');
+
+    if (*arg == 0x00)
+        return -1;
+
+    while (*arg != 0x00)
+    {
+        if ((*arg < '0') || (*arg > '9'))
+            return -1;
+
+        if (result > ((0x80000000ul - (*arg - '0')) / 10))
+            return -1;
+
+        result = (result * 10) + (*arg++ - '0');
+    }
+
+    if (!negative && (result > 0x7FFFFFFFul))
+        return -1;
+
+    *value = negative ? (long)(0ul - result) : (long)result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetHex - hex, 0x prefix optional,
+//up to 8 digits
+int Command_GetHex(const char *arg, unsigned long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char digits = 0x00;
+    int nibble;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+        arg += 2;
+
+    while (*arg != 0x00)
+    {
+        nibble = Command_HexNibble(*arg++);
+
+        if ((nibble < 0) || (++digits > 8))
+            return -1;
+
+        result = (result << 4) | nibble;
     }
 
+    if (!digits)
+        return -1;
+
+    *value = result;
+    return 0;
 }
 
 
+//////////////////////////////////////////////
+//Command_GetFixed - decimal number with up to
+//places digits after the point, returned
+//scaled by 10^places.  "-1.25", 2 -> -125.
+//Extra fraction digits are truncated.
+int Command_GetFixed(const char *arg, unsigned char places, long *value)
+{
+    unsigned long result = 0x00;
+    unsigned char negative = 0;
+    unsigned char digits = 0x00;
+    unsigned char point = 0;
+    unsigned char i;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((*arg == '-') || (*arg == '+'))
+        negative = (*arg++ == '-');
+
+    while (*arg != 0x00)
+    {
+        if ((*arg == '.') && !point)
+        {
+            point = 1;
+            arg++;
+            continue;
+        }
+
+        if ((*arg < '0') || (*arg > '9'))
+            return -1;
+
+        //drop fraction digits past places
+        if (!point || (point++ <= places))
+        {
+            if (result > ((0x7FFFFFFFul - (*arg - '0')) / 10))
+                return -1;
+
+            result = (result * 10) + (*arg - '0');
+        }
+
+        digits++;
+        arg++;
+    }
+
+    if (!digits)
+        return -1;
+
+    //pad the missing fraction digits
+    for (i = (point ? point - 1 : 0) ; i < places ; i++)
+    {
+        if (result > (0x7FFFFFFFul / 10))
+            return -1;
+
+        result *= 10;
+    }
+
+    *value = negative ? -(long)result : (long)result;
+    return 0;
+}
+
+
+//////////////////////////////////////////////
+//Command_GetBytes - hex string to bytes, in
+//place.  "0a1B2c" -> 0x0A 0x1B 0x2C written
+//over the start of arg.  Returns the number
+//of bytes, -1 if malformed or odd length.
+int Command_GetBytes(char *arg, unsigned char **data)
+{
+    unsigned char *out = (unsigned char*)arg;
+    int count = 0x00;
+    int high, low;
+
+    if (arg == NULL)
+        return -1;
+
+    if ((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X')))
+        arg += 2;
+
+    while (*arg != 0x00)
+    {
+        high = Command_HexNibble(arg[0]);
+        low = Command_HexNibble(arg[1]);
+
+        if ((high < 0) || (low < 0))
+            return -1;
+
+        out[count++] = (high << 4) | low;
+        arg += 2;
+    }
+
+    *data = (unsigned char*)out;
+    return count;
+}
+
+
+
 
@@ -0,0 +1,233 @@
+/*
+Typed arg test - runs on the pc
+Dana Olcott
+
+Edge cases for the argv accessors in command.c -
+Command_GetInt, GetHex, GetFixed and GetBytes: signs,
+the 32 bit limits and one past them, missing and
+empty args, stray characters, fraction digits past
+places.  A failed parse must return -1 and leave the
+value alone.  long is 64 bits on the pc, the limits
+in command.c are explicit so the results are the
+same as on the avr.
+
+Exit code is the failure count.
+
+Build:  gcc -std=c99 -O2 -Wall -I. -I.. -I../../usart \
+            -o argtest argtest.c
+Run:    ./argtest
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../command.c"
+
+#define UNTOUCHED           0x5A5A5A5AL
+
+
+typedef struct
+{
+    const char *arg;
+    int result;
+    long value;
+}IntCase;
+
+
+typedef struct
+{
+    const char *arg;
+    unsigned char places;
+    int result;
+    long value;
+}FixedCase;
+
+
+static const IntCase mIntCases[] =
+{
+    {"0",               0,  0},
+    {"42",              0,  42},
+    {"-42",             0,  -42},
+    {"+7",              0,  7},
+    {"007",             0,  7},
+    {"2147483647",      0,  2147483647L},
+    {"2147483648",      -1, 0},
+    {"-2147483648",     0,  -2147483647L - 1},
+    {"-2147483649",     -1, 0},
+    {"99999999999",     -1, 0},
+    {"0x10",            0,  16},
+    {"0X7fffffff",      0,  2147483647L},
+    {"0x80000000",      -1, 0},
+    {"0x",              -1, 0},
+    {"-0x10",           -1, 0},
+    {"",                -1, 0},
+    {NULL,              -1, 0},
+    {"-",               -1, 0},
+    {"+",               -1, 0},
+    {"--1",             -1, 0},
+    {"12a",             -1, 0},
+    {" 1",              -1, 0},
+    {"1.5",             -1, 0},
+};
+
+
+static const FixedCase mFixedCases[] =
+{
+    {"1.25",            2,  0,  125},
+    {"-1.25",           2,  0,  -125},
+    {"+1.5",            2,  0,  150},
+    {"1",               2,  0,  100},
+    {"1.",              2,  0,  100},
+    {".5",              2,  0,  50},
+    {"-.5",             1,  0,  -5},
+    {"1.239",           2,  0,  123},
+    {"0.001",           2,  0,  0},
+    {"-0.001",          2,  0,  0},
+    {"3.9",             0,  0,  3},
+    {"21474836.47",     2,  0,  2147483647L},
+    {"21474836.48",     2,  -1, 0},
+    {"-21474836.47",    2,  0,  -2147483647L},
+    {"21474837",        2,  -1, 0},
+    {"99999999999",     0,  -1, 0},
+    {"",                2,  -1, 0},
+    {NULL,              2,  -1, 0},
+    {"-",               2,  -1, 0},
+    {".",               2,  -1, 0},
+    {"-.",              2,  -1, 0},
+    {"1..2",            2,  -1, 0},
+    {"1.2.3",           2,  -1, 0},
+    {"1e3",             2,  -1, 0},
+    {"1,5",             2,  -1, 0},
+};
+
+
+static int mFailures = 0;
+
+
+//////////////////////////////////////////
+//usart - the help output isn't looked at
+void Usart_sendArray(unsigned char *data, unsigned int length)
+{
+    (void)data;
+    (void)length;
+}
+
+void Usart_sendString(char *data)
+{
+    (void)data;
+}
+
+
+static void Test_Result(const char *what, const char *arg, int result, long value,
+        int expectResult, long expectValue)
+{
+    if (expectResult < 0)
+        expectValue = UNTOUCHED;
+
+    if ((result != expectResult) || (value != expectValue))
+    {
+        printf("FAIL %s(\"%s\"): %d, %ld - expected %d, %ld\n", what, arg ? arg : "NULL",
+                result, value, expectResult, expectValue);
+        mFailures++;
+    }
+}
+
+
+static void Test_Int(void)
+{
+    unsigned int i;
+    long value;
+    int result;
+
+    for (i = 0 ; i < sizeof(mIntCases) / sizeof(IntCase) ; i++)
+    {
+        value = UNTOUCHED;
+        result = Command_GetInt(mIntCases[i].arg, &value);
+        Test_Result("GetInt", mIntCases[i].arg, result, value, mIntCases[i].result, mIntCases[i].value);
+    }
+}
+
+
+static void Test_Fixed(void)
+{
+    unsigned int i;
+    long value;
+    int result;
+
+    for (i = 0 ; i < sizeof(mFixedCases) / sizeof(FixedCase) ; i++)
+    {
+        value = UNTOUCHED;
+        result = Command_GetFixed(mFixedCases[i].arg, mFixedCases[i].places, &value);
+        Test_Result("GetFixed", mFixedCases[i].arg, result, value, mFixedCases[i].result, mFixedCases[i].value);
+    }
+}
+
+
+static void Test_Hex(void)
+{
+    static const char *bad[] = {"", "0x", "g", "12345678 ", "123456789", NULL};
+    unsigned long value;
+    unsigned int i;
+    int result;
+
+    result = Command_GetHex("ff", &value);
+    Test_Result("GetHex", "ff", result, (long)value, 0, 0xFF);
+
+    result = Command_GetHex("0xFFFFFFFF", &value);
+    Test_Result("GetHex", "0xFFFFFFFF", result, (long)value, 0, 0xFFFFFFFFL);
+
+    for (i = 0 ; i < sizeof(bad) / sizeof(char*) ; i++)
+    {
+        value = UNTOUCHED;
+        result = Command_GetHex(bad[i], &value);
+        Test_Result("GetHex", bad[i], result, (long)value, -1, 0);
+    }
+}
+
+
+static void Test_Bytes(void)
+{
+    static const unsigned char expect[] = {0x0A, 0x1B, 0x2C};
+    unsigned char *data = NULL;
+    char arg[16];
+    int count;
+
+    strcpy(arg, "0a1B2c");
+    count = Command_GetBytes(arg, &data);
+
+    if ((count != 3) || (data != (unsigned char*)arg) || memcmp(data, expect, 3))
+    {
+        printf("FAIL GetBytes(\"0a1B2c\"): %d\n", count);
+        mFailures++;
+    }
+
+    strcpy(arg, "0x0a");
+    Test_Result("GetBytes", "0x0a", Command_GetBytes(arg, &data), UNTOUCHED, 1, UNTOUCHED);
+
+    strcpy(arg, "");
+    Test_Result("GetBytes", "", Command_GetBytes(arg, &data), UNTOUCHED, 0, UNTOUCHED);
+
+    strcpy(arg, "abc");
+    Test_Result("GetBytes", "abc", Command_GetBytes(arg, &data), UNTOUCHED, -1, 0);
+
+    strcpy(arg, "zz");
+    Test_Result("GetBytes", "zz", Command_GetBytes(arg, &data), UNTOUCHED, -1, 0);
+
+    Test_Result("GetBytes", NULL, Command_GetBytes(NULL, &data), UNTOUCHED, -1, 0);
+}
+
+
+int main(void)
+{
+    Test_Int();
+    Test_Fixed();
+    Test_Hex();
+    Test_Bytes();
+
+    printf("%u int, %u fixed cases, %d failures\n",
+            (unsigned int)(sizeof(mIntCases) / sizeof(IntCase)),
+            (unsigned int)(sizeof(mFixedCases) / sizeof(FixedCase)), mFailures);
+
+    return mFailures;
+}
@@ -0,0 +1,73 @@
+/*
+avr/pgmspace.h for the pc build - command/host
+Dana Olcott
+
+Flash is plain memory here.  The pgm_read_ calls
+read through the pointer, so they load whatever
+type the entry is (the function pointer is 8 bytes
+on the pc, not a word).  strcmp_P counts the calls,
+the lookup benchmark reports them.  snprintf_P turns
+the flash string %S into %s, %S is a wide string on
+the pc.
+
+*/
+
+#ifndef HOST_PGMSPACE_H
+#define HOST_PGMSPACE_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(p)        (*(p))
+#define pgm_read_word(p)        (*(p))
+
+static unsigned long mHostCompares = 0;
+
+static inline int strcmp_P(const char *a, const char *b)
+{
+    mHostCompares++;
+    return strcmp(a, b);
+}
+
+static inline int snprintf_P(char *buffer, size_t size, const char *format, ...)
+{
+    char pcFormat[128];
+    const char *f = format;
+    unsigned int i = 0;
+    va_list args;
+    int n;
+
+    //%S -> %s, flags and width left alone
+    while ((*f != 0x00) && (i < (sizeof(pcFormat) - 1)))
+    {
+        char c = *f++;
+
+        pcFormat[i++] = c;
+
+        if (c != '%')
+            continue;
+
+        while ((*f != 0x00) && (i < (sizeof(pcFormat) - 1)) &&
+                (strchr("-+ #0123456789.", *f) != NULL))
+            pcFormat[i++] = *f++;
+
+        if ((*f != 0x00) && (i < (sizeof(pcFormat) - 1)))
+        {
+            pcFormat[i++] = (*f == 'S') ? 's' : *f;
+            f++;
+        }
+    }
+
+    pcFormat[i] = 0x00;
+
+    va_start(args, format);
+    n = vsnprintf(buffer, size, pcFormat, args);
+    va_end(args);
+
+    return n;
+}
+
+#endif
@@ -0,0 +1,128 @@
+/*
+Command lookup benchmark - runs on the pc
+Dana Olcott
+
+The binary search in command.c (Command_Find) against
+the linear strcmp scan it replaced, on a 50 command
+table.  The build makes command50.c, command.c with
+its table cut out for table50.h, so command.c itself
+has no host hooks.  Looks up every command and a
+miss next to each one, and reports string compares
+per lookup - the cost that carries over to the avr,
+each compare is a strcmp_P on flash - and pc time.
+
+cmdtest.c runs its checks on the same table first.
+
+Build:  sed '/^static const CommandStruct commandTable/,/^};/c #include "table50.h"' \
+            ../command.c > command50.c
+        gcc -std=c99 -O2 -Wall -I. -I.. -I../../usart -o cmdbench cmdbench.c
+Run:    ./cmdbench [rounds]
+
+*/
+
+#define _POSIX_C_SOURCE     199309L     //clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define COMMAND_SOURCE      "command50.c"
+
+#define main Test_Main
+#include "cmdtest.c"
+#undef main
+
+#define BENCH_NAMES         (2 * COMMAND_TABLE_SIZE)
+
+
+static char mNames[BENCH_NAMES][COMMAND_NAME_SIZE + 2];
+
+
+//////////////////////////////////////////
+//The lookup before the binary search, in
+//table order until a match
+static int Bench_LinearFind(char *name)
+{
+    int i;
+
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+    {
+        if (!strcmp_P(name, commandTable[i].cmdString))
+            return i;
+    }
+
+    return -1;
+}
+
+
+static double Bench_Seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+
+static void Bench_Run(const char *what, int (*find)(char*), long rounds, int first, int count)
+{
+    volatile int sink = 0;
+    unsigned long compares;
+    double start, seconds;
+    long r;
+    int i;
+
+    mHostCompares = 0;
+    start = Bench_Seconds();
+
+    for (r = 0 ; r < rounds ; r++)
+    {
+        for (i = first ; i < (first + count) ; i++)
+            sink += find(mNames[i]);
+    }
+
+    seconds = Bench_Seconds() - start;
+    compares = mHostCompares;
+
+    printf("%-8s %-6s %8.2f %8.1f\n", what, (first ? "miss" : "hit"),
+            (double)compares / ((double)rounds * count),
+            (seconds * 1e9) / ((double)rounds * count));
+}
+
+
+int main(int argc, char **argv)
+{
+    long rounds = (argc > 1) ? atol(argv[1]) : 200000;
+    int failures;
+    int i;
+
+    failures = Test_Main();
+
+    //hits, then a miss after each command
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+    {
+        strcpy(mNames[i], commandTable[i].cmdString);
+        snprintf(mNames[COMMAND_TABLE_SIZE + i], sizeof(mNames[0]), "%.7sz", commandTable[i].cmdString);
+    }
+
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+    {
+        if ((Command_Find(mNames[i]) != i) || (Bench_LinearFind(mNames[i]) != i) ||
+            (Command_Find(mNames[COMMAND_TABLE_SIZE + i]) != -1))
+        {
+            printf("FAIL lookup %s\n", mNames[i]);
+            failures++;
+        }
+    }
+
+    printf("\n%d commands, %ld rounds\n", COMMAND_TABLE_SIZE, rounds);
+    printf("%-8s %-6s %8s %8s\n", "lookup", "", "compares", "ns");
+
+    Bench_Run("binary", Command_Find, rounds, 0, COMMAND_TABLE_SIZE);
+    Bench_Run("linear", Bench_LinearFind, rounds, 0, COMMAND_TABLE_SIZE);
+    Bench_Run("binary", Command_Find, rounds, COMMAND_TABLE_SIZE, COMMAND_TABLE_SIZE);
+    Bench_Run("linear", Bench_LinearFind, rounds, COMMAND_TABLE_SIZE, COMMAND_TABLE_SIZE);
+
+    return failures;
+}
@@ -0,0 +1,223 @@
+/*
+Command table test - runs on the pc
+Dana Olcott
+
+Builds command.c as it is on the target, with the
+flash reads stubbed (avr/pgmspace.h in this folder),
+and checks the lookup and dispatch on whatever table
+is compiled in:
+
+- the table is sorted, strcmp order, no duplicates
+- every command is found at its own index and runs
+  with min and max args
+- one arg too many / too few returns -2 and prints
+  the command's help line
+- near misses (prefix, one more char, upper case),
+  "", and no args at all return -1
+- "?" lists every command, "? <cmd>" one of them
+
+Exit code is the failure count.
+
+Build:  gcc -std=c99 -O2 -Wall -I. -I.. -I../../usart \
+            -o cmdtest cmdtest.c
+Run:    ./cmdtest
+
+cmdbench.c builds it with the 50 command table,
+COMMAND_SOURCE is the command.c to test.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef COMMAND_SOURCE
+#define COMMAND_SOURCE      "../command.c"
+#endif
+
+#include COMMAND_SOURCE
+
+
+static char mOutput[4096];
+static unsigned int mOutputLength = 0;
+static int mFailures = 0;
+
+
+//////////////////////////////////////////
+//usart - output goes to mOutput
+void Usart_sendArray(unsigned char *data, unsigned int length)
+{
+    if ((mOutputLength + length) >= sizeof(mOutput))
+        length = sizeof(mOutput) - 1 - mOutputLength;
+
+    memcpy(&mOutput[mOutputLength], data, length);
+    mOutputLength += length;
+    mOutput[mOutputLength] = 0x00;
+}
+
+void Usart_sendString(char *data)
+{
+    Usart_sendArray((unsigned char*)data, strlen(data));
+}
+
+
+static void Test_ClearOutput(void)
+{
+    mOutputLength = 0;
+    mOutput[0] = 0x00;
+}
+
+
+static void Test_Check(int ok, const char *what, const char *name)
+{
+    if (!ok)
+    {
+        printf("FAIL %s: %s\n", name, what);
+        mFailures++;
+    }
+}
+
+
+//////////////////////////////////////////
+//Run name with args dummy args
+static int Test_Run(const char *name, int args)
+{
+    char *argv[ARG_BUFFER_SIZE];
+    int i;
+
+    argv[0] = (char*)name;
+
+    for (i = 1 ; i <= args ; i++)
+        argv[i] = (char*)"1";
+
+    Test_ClearOutput();
+
+    return Command_ExeCommand(args + 1, argv);
+}
+
+
+static void Test_Table(void)
+{
+    int i;
+
+    for (i = 1 ; i < COMMAND_TABLE_SIZE ; i++)
+        Test_Check(strcmp(commandTable[i - 1].cmdString, commandTable[i].cmdString) < 0,
+                "table not sorted", commandTable[i].cmdString);
+}
+
+
+static void Test_Commands(void)
+{
+    char expect[64];
+    int i;
+
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+    {
+        const CommandStruct *cmd = &commandTable[i];
+
+        snprintf(expect, sizeof(expect), "%.7s - %.31s, args %u-%u\r\n", cmd->cmdString,
+                cmd->menuString, cmd->minArgs, cmd->maxArgs);
+
+        Test_Check(Command_Find((char*)cmd->cmdString) == i, "not found at its index", cmd->cmdString);
+
+        Test_Check(Test_Run(cmd->cmdString, cmd->minArgs) == i, "min args didn't run", cmd->cmdString);
+        Test_Check(mOutputLength > 0, "min args, no output", cmd->cmdString);
+
+        Test_Check(Test_Run(cmd->cmdString, cmd->maxArgs) == i, "max args didn't run", cmd->cmdString);
+
+        Test_Check(Test_Run(cmd->cmdString, cmd->maxArgs + 1) == -2, "too many args ran", cmd->cmdString);
+        Test_Check(!strcmp(mOutput, expect), "too many args, wrong help line", cmd->cmdString);
+
+        if (cmd->minArgs > 0)
+        {
+            Test_Check(Test_Run(cmd->cmdString, cmd->minArgs - 1) == -2, "too few args ran", cmd->cmdString);
+            Test_Check(!strcmp(mOutput, expect), "too few args, wrong help line", cmd->cmdString);
+        }
+    }
+}
+
+
+static void Test_Misses(void)
+{
+    char name[COMMAND_NAME_SIZE + 2];
+    unsigned int length;
+    unsigned int j;
+    int i;
+
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+    {
+        length = strlen(commandTable[i].cmdString);
+
+        //prefix
+        memcpy(name, commandTable[i].cmdString, length - 1);
+        name[length - 1] = 0x00;
+
+        if ((length > 1) && (Command_Find(name) < 0))
+            Test_Check(Test_Run(name, 0) == -1, "prefix ran", name);
+
+        //one more char
+        memcpy(name, commandTable[i].cmdString, length);
+        name[length] = 'z';
+        name[length + 1] = 0x00;
+        Test_Check(Test_Run(name, 0) == -1, "longer name ran", name);
+
+        //upper case
+        for (j = 0 ; j < length ; j++)
+            name[j] = ((name[j] >= 'a') && (name[j] <= 'z')) ? (name[j] - 'a' + 'A') : name[j];
+        name[length] = 0x00;
+
+        if (strcmp(name, commandTable[i].cmdString))
+            Test_Check(Test_Run(name, 0) == -1, "upper case ran", name);
+    }
+
+    Test_Check(Test_Run("", 0) == -1, "empty name ran", "\"\"");
+    Test_Check(Command_Find(NULL) == -1, "NULL found", "NULL");
+
+    Test_ClearOutput();
+    Test_Check(Command_ExeCommand(0, NULL) == -1, "argc 0 ran", "argc 0");
+    Test_Check(mOutputLength == 0, "argc 0 printed", "argc 0");
+}
+
+
+static void Test_Help(void)
+{
+    char *argv[2] = {(char*)"?", NULL};
+    char *line;
+    int lines = 0;
+    int i;
+
+    Test_ClearOutput();
+    Command_ExeCommand(1, argv);
+
+    for (line = strstr(mOutput, "\r\n") ; line != NULL ; line = strstr(line + 2, "\r\n"))
+        lines++;
+
+    Test_Check(lines == COMMAND_TABLE_SIZE + 1, "\"?\" doesn't list every command", "?");
+
+    for (i = 0 ; i < COMMAND_TABLE_SIZE ; i++)
+        Test_Check(strstr(mOutput, commandTable[i].menuString) != NULL, "missing from \"?\"",
+                commandTable[i].cmdString);
+
+    argv[1] = (char*)commandTable[COMMAND_TABLE_SIZE - 1].cmdString;
+    Test_ClearOutput();
+    Command_ExeCommand(2, argv);
+    Test_Check(strstr(mOutput, commandTable[COMMAND_TABLE_SIZE - 1].menuString) != NULL,
+            "\"? <cmd>\" wrong", argv[1]);
+
+    argv[1] = (char*)"nope";
+    Test_ClearOutput();
+    Command_ExeCommand(2, argv);
+    Test_Check(!strcmp(mOutput, "No Such Command\r\n"), "\"? nope\" wrong", argv[1]);
+}
+
+
+int main(void)
+{
+    Test_Table();
+    Test_Commands();
+    Test_Misses();
+    Test_Help();
+
+    printf("%d commands, %d failures\n", COMMAND_TABLE_SIZE, mFailures);
+
+    return mFailures;
+}
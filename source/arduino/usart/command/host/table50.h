@@ -0,0 +1,59 @@
+//////////////////////////////////////////
+//50 command table for host/cmdbench.c, in
+//place of command.c's table in command50.c.  Sorted
+//by the command string like the real tables.
+//Some take args so the arg count checks are run.
+
+static const CommandStruct commandTable[] PROGMEM =
+{
+    {"?",       "Print Help, ? <cmd> for one", 0, 1, cmdHelp},
+    {"adc",     "adc menu", 0, 0, cmdFunction1},
+    {"baud",    "baud menu", 1, 2, cmdFunction2},
+    {"beacon",  "beacon menu", 2, 2, cmdFunction3},
+    {"blink",   "blink menu", 0, 1, cmdFunction1},
+    {"burst",   "burst menu", 1, 1, cmdFunction2},
+    {"chan",    "chan menu", 2, 3, cmdFunction3},
+    {"clear",   "clear menu", 0, 0, cmdFunction1},
+    {"config",  "config menu", 1, 2, cmdFunction2},
+    {"crc",     "crc menu", 2, 2, cmdFunction3},
+    {"date",    "date menu", 0, 1, cmdFunction1},
+    {"debug",   "debug menu", 1, 1, cmdFunction2},
+    {"dump",    "dump menu", 2, 3, cmdFunction3},
+    {"echo",    "echo menu", 0, 0, cmdFunction1},
+    {"eeprom",  "eeprom menu", 1, 2, cmdFunction2},
+    {"erase",   "erase menu", 2, 2, cmdFunction3},
+    {"flush",   "flush menu", 0, 1, cmdFunction1},
+    {"freq",    "freq menu", 1, 1, cmdFunction2},
+    {"id",      "id menu", 2, 3, cmdFunction3},
+    {"info",    "info menu", 0, 0, cmdFunction1},
+    {"led",     "led menu", 1, 2, cmdFunction2},
+    {"list",    "list menu", 2, 2, cmdFunction3},
+    {"load",    "load menu", 0, 1, cmdFunction1},
+    {"log",     "log menu", 1, 1, cmdFunction2},
+    {"mesh",    "mesh menu", 2, 3, cmdFunction3},
+    {"mode",    "mode menu", 0, 0, cmdFunction1},
+    {"peek",    "peek menu", 1, 2, cmdFunction2},
+    {"ping",    "ping menu", 2, 2, cmdFunction3},
+    {"poke",    "poke menu", 0, 1, cmdFunction1},
+    {"power",   "power menu", 1, 1, cmdFunction2},
+    {"read",    "read menu", 2, 3, cmdFunction3},
+    {"reboot",  "reboot menu", 0, 0, cmdFunction1},
+    {"relay",   "relay menu", 1, 2, cmdFunction2},
+    {"reset",   "reset menu", 2, 2, cmdFunction3},
+    {"rssi",    "rssi menu", 0, 1, cmdFunction1},
+    {"save",    "save menu", 1, 1, cmdFunction2},
+    {"scan",    "scan menu", 2, 3, cmdFunction3},
+    {"send",    "send menu", 0, 0, cmdFunction1},
+    {"sleep",   "sleep menu", 1, 2, cmdFunction2},
+    {"stats",   "stats menu", 2, 2, cmdFunction3},
+    {"status",  "status menu", 0, 1, cmdFunction1},
+    {"temp",    "temp menu", 1, 1, cmdFunction2},
+    {"time",    "time menu", 2, 3, cmdFunction3},
+    {"top",     "top menu", 0, 0, cmdFunction1},
+    {"tx",      "tx menu", 1, 2, cmdFunction2},
+    {"version", "version menu", 2, 2, cmdFunction3},
+    {"volt",    "volt menu", 0, 1, cmdFunction1},
+    {"wake",    "wake menu", 1, 1, cmdFunction2},
+    {"watch",   "watch menu", 2, 3, cmdFunction3},
+    {"write",   "write menu", 0, 0, cmdFunction1},
+};
@@ -0,0 +1,140 @@
+/*
+Command table order check - runs on the pc
+Dana Olcott
+
+Command_Find is a binary search, a table out of
+order loses commands without an error.  cmdtest.c
+checks the table it builds, the projects that copied
+command.c (nrf24l01, repeater, tasker) pull in their
+drivers and don't build on the pc.  This reads the
+commandTable rows out of each command.c given and
+checks them the same way:
+
+- at least one row
+- sorted, strcmp order, no duplicates
+- every name fits COMMAND_NAME_SIZE, with the null
+
+Exit code is the failure count.
+
+Build:  gcc -std=c99 -O2 -Wall -Wextra -I. -I.. -o tablecheck tablecheck.c
+Run:    ./tablecheck ../command.c ../../../nrf24l01/command/command.c \
+            ../../../repeater/command/command.c ../../../tasker/command/command.c
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "command.h"
+
+#define CHECK_LINE_SIZE     256
+#define CHECK_MAX_ROWS      128
+
+
+static char mNames[CHECK_MAX_ROWS][CHECK_LINE_SIZE];
+
+
+//////////////////////////////////////////
+//Table rows from the file, the first
+//string of each {"name", ...} line between
+//the commandTable definition and its "};"
+//returns the row count, -1 no file, -2 no
+//table, -3 too many rows
+static int Check_ReadTable(const char *path)
+{
+    char line[CHECK_LINE_SIZE];
+    char *start, *end;
+    int inTable = 0;
+    int rows = 0;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (!inTable)
+        {
+            if (strstr(line, "commandTable[]") != NULL)
+                inTable = 1;
+
+            continue;
+        }
+
+        if (!strncmp(line, "};", 2))
+            break;
+
+        start = strstr(line, "{\"");
+        if (start == NULL)
+            continue;
+
+        start += 2;
+        end = strchr(start, '"');
+        if (end == NULL)
+            continue;
+
+        if (rows >= CHECK_MAX_ROWS)
+        {
+            fclose(file);
+            return -3;
+        }
+
+        *end = 0x00;
+        strcpy(mNames[rows++], start);
+    }
+
+    fclose(file);
+
+    return inTable ? rows : -2;
+}
+
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+    int rows, i, fileFailures;
+
+    if (argc < 2)
+    {
+        printf("tablecheck <command.c> ...\n");
+        return 1;
+    }
+
+    while (--argc)
+    {
+        argv++;
+        fileFailures = 0;
+        rows = Check_ReadTable(argv[0]);
+
+        if (rows < 1)
+        {
+            printf("FAIL %s: %s\n", argv[0], (rows == -1) ? "can't open" :
+                    (rows == -3) ? "too many rows" : "no commandTable rows");
+            failures++;
+            continue;
+        }
+
+        for (i = 0 ; i < rows ; i++)
+        {
+            if (strlen(mNames[i]) >= COMMAND_NAME_SIZE)
+            {
+                printf("FAIL %s: \"%s\" longer than %d\n", argv[0], mNames[i],
+                        COMMAND_NAME_SIZE - 1);
+                fileFailures++;
+            }
+
+            if (i && (strcmp(mNames[i - 1], mNames[i]) >= 0))
+            {
+                printf("FAIL %s: \"%s\" before \"%s\"\n", argv[0], mNames[i - 1],
+                        mNames[i]);
+                fileFailures++;
+            }
+        }
+
+        printf("%s: %d commands, %s\n", argv[0], rows,
+                fileFailures ? "out of order" : "sorted");
+        failures += fileFailures;
+    }
+
+    return (failures > 255) ? 255 : failures;
+}
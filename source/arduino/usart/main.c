@@ -26,6 +26,7 @@ system("stty -F /dev/ttyUSB0 115200");
 ///////////////////////////////////////////////
 
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <avr/io.h>         //macros
 #include <stdio.h>
 #include <string.h>
@@ -110,6 +111,16 @@ ISR(USART_RX_vect)
 }
 
 
+//////////////////////////////////////
+//usart data register empty interrupt
+//sends the next byte from the tx ring
+//
+ISR(USART_UDRE_vect)
+{
+    Usart_txIsr();
+}
+
+
 
 
 ///////////////////////////////////////
@@ -240,10 +251,27 @@ void Dummy_Function(void)
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0, the button or
+//a usart byte wakes it.
+//Usart command lines run here, the rx isr
+//only queues them.
 void Delay(volatile unsigned int val)
 {
     gTimeTick = 0x00;           //upcounter
-    while (val > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0 and usart keep running
+    while (val > gTimeTick)
+    {
+        Usart_processLines();           //command lines, outside the rx isr
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
@@ -0,0 +1,201 @@
+/*
+Arg tokenizer test and benchmark - runs on the pc
+Dana Olcott
+
+Usart_parseArgs from usart.c against the strtok
+parser it replaced (copied below as it was).  Checks
+the tokenizer first - separators, quotes, negative
+and decimal args, the ARG_BUFFER_SIZE limit, empty
+lines - then times both on a few command lines.
+Both parse in place, so each pass copies the line
+into the buffer first, the copy is in both times.
+
+avr/ in this folder and command/host/avr stand in
+for the avr headers.  The fixed register addresses
+look out of bounds to the pc compiler, hence
+-Wno-array-bounds.  Exit code is the failure count.
+
+Build:  gcc -std=c99 -O2 -Wall -Wno-array-bounds -I. -I.. -I../.. \
+            -I../../command -I../../command/host -o argbench argbench.c ../usart.c
+Run:    ./argbench [rounds]
+
+*/
+
+#define _POSIX_C_SOURCE     199309L     //clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "usart.h"
+
+
+typedef struct
+{
+    const char *line;
+    int argc;
+    const char *argv[ARG_BUFFER_SIZE];
+}ArgCase;
+
+
+static const ArgCase mCases[] =
+{
+    {"led on",                      2,  {"led", "on"}},
+    {"  set  1,2\t3 ",              4,  {"set", "1", "2", "3"}},
+    {"temp -1.25",                  2,  {"temp", "-1.25"}},
+    {"say \"hello world\" x",       3,  {"say", "hello world", "x"}},
+    {"say \"a, b\",c",              3,  {"say", "a, b", "c"}},
+    {"x \"open quote",              2,  {"x", "open quote"}},
+    {"a\"\"b",                      1,  {"ab"}},
+    {"\"\"",                        1,  {""}},
+    {"",                            0,  {NULL}},
+    {" ,\t, ",                      0,  {NULL}},
+    {"0 1 2 3 4 5 6 7 8 9 a b c d e f g h", ARG_BUFFER_SIZE,
+        {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "a", "b", "c", "d", "e", "f"}},
+};
+
+#define CASE_COUNT          (int)(sizeof(mCases) / sizeof(ArgCase))
+
+
+static const char *mBenchLines[] =
+{
+    "led on",
+    "radio burst 10 32",
+    "set 1,2,3,4,5,6",
+    "log \"a quoted arg\" -12.5",
+    "0 1 2 3 4 5 6 7 8 9 a b c d e f",
+};
+
+#define BENCH_LINE_COUNT    (int)(sizeof(mBenchLines) / sizeof(char*))
+
+
+//////////////////////////////////////////
+//usart.c runs lines through the command
+//table, not used here
+int Command_ExeCommand(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    return -1;
+}
+
+
+//////////////////////////////////////////
+//Usart_parseArgs before, strtok on " ,.-"
+static void Bench_StrtokParseArgs(char *in, int *pargc, char** argv)
+{
+
+	int argc = 0;
+	char* ptr;
+
+	//get the first arg - pass input buffer
+	ptr = strtok(in, " ,.-");
+	argv[argc++] = ptr;
+
+	//subsequent args, pass NULL
+	while ((ptr != NULL) && (argc < ARG_BUFFER_SIZE))
+	{
+		ptr = strtok(NULL, " ,.-");
+		if(ptr != NULL)
+			argv[argc++] = ptr;
+	}
+
+	*pargc = argc;
+}
+
+
+static int Test_Tokenizer(void)
+{
+    char buffer[RX_BUFFER_SIZE];
+    char *argv[ARG_BUFFER_SIZE];
+    int failures = 0;
+    int argc, i, j;
+
+    for (i = 0 ; i < CASE_COUNT ; i++)
+    {
+        strcpy(buffer, mCases[i].line);
+        memset(argv, 0x00, sizeof(argv));
+        Usart_parseArgs(buffer, &argc, argv);
+
+        if (argc != mCases[i].argc)
+        {
+            printf("FAIL \"%s\": argc %d, expected %d\n", mCases[i].line, argc, mCases[i].argc);
+            failures++;
+            continue;
+        }
+
+        for (j = 0 ; j < argc ; j++)
+        {
+            if (strcmp(argv[j], mCases[i].argv[j]))
+            {
+                printf("FAIL \"%s\": argv[%d] \"%s\", expected \"%s\"\n", mCases[i].line,
+                        j, argv[j], mCases[i].argv[j]);
+                failures++;
+            }
+        }
+    }
+
+    //old parser, for the record
+    strcpy(buffer, "temp -1.25");
+    Bench_StrtokParseArgs(buffer, &argc, argv);
+    printf("strtok \"temp -1.25\": %d args, \"%s\" \"%s\"\n", argc, argv[0],
+            (argc > 1) ? argv[1] : "");
+
+    printf("tokenizer, %d cases, %d failures\n", CASE_COUNT, failures);
+
+    return failures;
+}
+
+
+static double Bench_Seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+
+static double Bench_Run(void (*parse)(char*, int*, char**), const char *line, long rounds)
+{
+    char buffer[RX_BUFFER_SIZE];
+    char *argv[ARG_BUFFER_SIZE];
+    volatile int sink = 0;
+    double start;
+    int argc;
+    long r;
+
+    start = Bench_Seconds();
+
+    for (r = 0 ; r < rounds ; r++)
+    {
+        strcpy(buffer, line);
+        parse(buffer, &argc, argv);
+        sink += argc;
+    }
+
+    return ((Bench_Seconds() - start) * 1e9) / rounds;
+}
+
+
+int main(int argc, char **argv)
+{
+    long rounds = (argc > 1) ? atol(argv[1]) : 2000000;
+    int failures;
+    int i;
+
+    failures = Test_Tokenizer();
+
+    printf("\n%ld rounds, ns per line\n", rounds);
+    printf("%-34s %8s %8s\n", "line", "parse", "strtok");
+
+    for (i = 0 ; i < BENCH_LINE_COUNT ; i++)
+    {
+        printf("%-34s %8.1f %8.1f\n", mBenchLines[i],
+                Bench_Run(Usart_parseArgs, mBenchLines[i], rounds),
+                Bench_Run(Bench_StrtokParseArgs, mBenchLines[i], rounds));
+    }
+
+    return failures;
+}
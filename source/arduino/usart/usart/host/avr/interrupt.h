@@ -0,0 +1,13 @@
+/*
+avr/interrupt.h for the pc build - usart/host
+Dana Olcott
+
+*/
+
+#ifndef HOST_INTERRUPT_H
+#define HOST_INTERRUPT_H
+
+#define cli()
+#define sei()
+
+#endif
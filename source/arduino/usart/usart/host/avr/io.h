@@ -0,0 +1,10 @@
+/*
+avr/io.h for the pc build - usart/host
+Dana Olcott
+
+usart.c uses its own register defines (register.h),
+nothing is needed from here.  The register functions
+build but can't run on the pc, only the line and arg
+handling is called.
+
+*/
@@ -34,6 +34,7 @@ Inludes:  /usr/lib/avr/include
 //
 #include <avr/io.h>         //macros
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 
 #define BIT0            (1u << 0)
@@ -138,10 +139,24 @@ int main()
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, the timer0 compare
+//interrupt wakes it.
 void Delay(volatile unsigned int val)
 {
     gTimeTick = 0x00;           //upcounter
-    while (val > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0 keeps running
+    while (val > gTimeTick)
+    {
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
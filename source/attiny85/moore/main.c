@@ -40,6 +40,7 @@ State_t fsm[num states]
 //
 #include <avr/io.h>         //macros
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 
 #define BIT0            (1u << 0)
@@ -240,10 +241,24 @@ int main()
 
 ////////////////////////////////////
 //timeTick is increased in timer isr
+//Idle between ticks, timer0 or a button
+//PCINT wakes it.  State functions run here.
 void Delay(volatile unsigned int val)
 {
     gTimeTick = 0x00;           //upcounter
-    while (val > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0 and pin change keep running
+    while (val > gTimeTick)
+    {
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
@@ -65,6 +65,7 @@ User Buttons:
 //
 #include <avr/io.h>         //macros
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 
 #define BIT0            (1u << 0)
@@ -310,7 +311,19 @@ int main()
 void Delay(volatile unsigned int val)
 {
     gTimeTick = 0x00;
-    while (val > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer0, adc and pin change keep running
+    while (val > gTimeTick)
+    {
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
@@ -94,6 +94,7 @@ Serial Output
 //
 #include <avr/io.h>         //macros
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -388,7 +389,19 @@ int main()
 void Delay(volatile unsigned int val)
 {
     gTimeTick = 0x00;
-    while (val > gTimeTick){};
+    set_sleep_mode(SLEEP_MODE_IDLE);    //timer1 tick, timer0 bit clock keep running
+    while (val > gTimeTick)
+    {
+        cli();
+        if (val > gTimeTick)
+        {
+            sleep_enable();
+            sei();                      //sei takes effect after sleep_cpu,
+            sleep_cpu();                //so the tick can't slip in between
+            sleep_disable();
+        }
+        sei();
+    }
 }
 
 
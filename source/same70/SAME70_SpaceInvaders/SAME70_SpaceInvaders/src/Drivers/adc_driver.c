@@ -58,6 +58,7 @@ Pin AD3 - PA19, AFE0_AD8
 #include "afec.h"			//timer
 #include "adc_driver.h"
 #include "pindefs.h"		//conversion from D# to chip pin#
+#include "input.h"			//joystick input events
 
 
 
@@ -96,10 +97,13 @@ static void afec_temp_sensor_end_conversion(void)
 
 /////////////////////////////////////////////////////
 //Callback function for ADC6
+//AD6 is the joystick, so the sample is also
+//passed to the input sampler.
 static void ADC_Channel6_Callback(void)
 {
 	g_adc_channel6_rawData = afec_channel_get_value(AFEC1, AFEC_CHANNEL_6);		//read the data
 	is_ADC_CH6_Done = true;														//set the flag
+	Input_JoystickSampleISR(g_adc_channel6_rawData);							//joystick events
 }
 
 
@@ -199,8 +203,10 @@ void ADC_Config()
 //
 //Callback: ADC_Channel6_Callback()
 //
-//The following example results in continuous conversion
-//of ADC Channel 6.
+//Channel 6 uses the software trigger.  One conversion
+//is started per system tick from TC3_Handler, see
+//ADC_StartAD6().  Free run mode interrupts every few uS
+//and keeps the core from sleeping.
 //
 ///////////////////////////////////////////////////////////
 //Notes on Analog Offset
@@ -236,7 +242,7 @@ void ADC_ConfigAD6(void)
 	afec_enable(AFEC1);												//enable AFEC1
 	afec_get_config_defaults(&afec_cfg);							//populate the afec structure
 	afec_init(AFEC1, &afec_cfg);									//init the AFEC1 peripheral
-	afec_set_trigger(AFEC1, AFEC_TRIG_FREERUN);						//2-6 uS conversion time
+	afec_set_trigger(AFEC1, AFEC_TRIG_SW);							//started from the system tick
 	afec_ch_get_config_defaults(&afec_ch_cfg);						//populate the channel struct with default values
 	afec_ch_cfg.gain = AFEC_GAINVALUE_0;							//set the gain - check the linearity
 	afec_ch_set_config(AFEC1, AFEC_CHANNEL_6, &afec_ch_cfg);		//configure channel 6
@@ -249,6 +255,15 @@ void ADC_ConfigAD6(void)
 }
 
 
+//////////////////////////////////////////
+//Start one conversion on ADC Channel6.
+//Called from the 1ms system tick.
+void ADC_StartAD6(void)
+{
+	afec_start_software_conversion(AFEC1);
+}
+
+
 
 
 
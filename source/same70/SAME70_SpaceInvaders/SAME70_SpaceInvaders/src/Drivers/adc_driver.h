@@ -22,6 +22,7 @@ void ADC_Config(void);
 uint32_t ADC_readTemp(void);
 
 void ADC_ConfigAD6(void);
+void ADC_StartAD6(void);
 uint32_t ADC_readChannel6(void);
 
 void ADC_ConfigAD0(void);
@@ -17,8 +17,7 @@
 #include "conf_clock.h"
 #include "gpio_driver.h"
 
-#include "sprite.h"
-#include "lcd_12864_dfrobot.h"
+#include "input.h"
 
 
 ////////////////////////////////////////////////////
@@ -92,31 +91,21 @@ void Button_Config()
 //Button handler for user button on shield on PA5
 //
 //id = GPIO Port, ie, PIOA, index = pin, ie, PIO_PA11
-//Set button flag = polled in main loop
+//Post a press event to the input queue, drained
+//by the game loop.  No game state is touched here.
 void Button_Handler(const uint32_t id, const uint32_t index)
 {
 	//PA11 - button
 	if ((id == ID_PIOA) && (index == PIO_PA11))
 	{
-		//game over flag or missle 
-		if (Sprite_GetGameOverFlag() == 1)
-			Sprite_ClearGameOverFlag();
-		else
-			Sprite_SetPlayerMissileLaunchFlag();
-
+		Input_ButtonISR(INPUT_ID_BUTTON_SW0);
 		pio_get(PIOA, PIO_TYPE_PIO_INPUT, PIO_PA11);	//clear interrupt
 	}
 
 	//PA5 - button
 	if ((id == ID_PIOA) && (index == PIO_PA5))
 	{
-		//game over flag or missle 
-		if (Sprite_GetGameOverFlag() == 1)
-			Sprite_ClearGameOverFlag();
-		else
-			Sprite_SetPlayerMissileLaunchFlag();
-
+		Input_ButtonISR(INPUT_ID_BUTTON_SHIELD);
 		pio_get(PIOA, PIO_TYPE_PIO_INPUT, PIO_PA5);	//clear interrupt
 	}
 }
-
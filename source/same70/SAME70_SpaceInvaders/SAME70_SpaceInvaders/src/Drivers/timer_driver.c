@@ -24,151 +24,112 @@
 #include "timer_driver.h"	//timer function prototypes
 #include "pindefs.h"		//conversion from D# to chip pin#
 #include "Sound.h"			//sound files
+#include "adc_driver.h"		//joystick sample trigger
+#include "sleepmgr.h"		//sleep between ticks
  
 static volatile uint32_t gTimerTick = 0x00;
 
 //////////////////////////////////////////////
 //Delay that uses Timer3
+//gTimerTick is free running, so the delay is
+//measured from the current tick instead of
+//resetting it.  This keeps timestamps valid.
+//
+//Between ticks the core sleeps in WFI.  Any
+//interrupt wakes it - the system tick, the sound
+//timer, the adc or the buttons.
 void Timer_Delay(uint32_t delay)
 {
-	gTimerTick = 0x00;
+	uint32_t start = gTimerTick;
+
+	while ((gTimerTick - start) < delay)
+	{
+#if TIMER_SLEEP_ENABLE
+		sleepmgr_enter_sleep();
+#endif
+	}
+}
+
+
+//////////////////////////////////////////////
+//Sleep manager setup.  Only WFI is allowed,
+//the deeper modes stop the clocks the timers
+//and the sound output run from.
+void Timer_SleepConfig(void)
+{
+	sleepmgr_init();
+	sleepmgr_lock_mode(SLEEPMGR_SLEEP_WFI);
+}
 
-	volatile uint32_t temp = delay;
-	while (gTimerTick < temp);
 
+//////////////////////////////////////////////
+//System tick, 1ms, free running - Timer3
+uint32_t Timer_GetTick(void)
+{
+	return gTimerTick;
 }
 
 ///////////////////////////////////////////////
-//Timer 0 Config
-//Timer0 ID = Timer0, Channel 0
-//Compare Capture - Interrupt Enabled
-//Configure to Trigger at 11khz
+//Configure one TC channel for an RC compare
+//interrupt at frequency.  Each TC block has three
+//channels, each channel has its own peripheral ID
+//and handler.  ie, Timer3 = TC1, channel 0, ID_TC3
 //
-void Timer0_Config(void)
+//NOTE: rc uses the cpu clock and MCK = cpu / 2,
+//hence the 2 * frequency.
+//
+//divFrequency picks the prescaler, normally the
+//same as frequency.
+//
+static void Timer_ConfigChannel(Tc *tc, uint32_t channel, uint32_t id, uint32_t frequency, uint32_t divFrequency)
 {
 	uint32_t ul_div;
 	uint32_t ul_tcclks;
-	uint32_t ul_sysclk;
-	uint32_t Timer0_Frequency = 11000;
+	uint32_t ul_sysclk = sysclk_get_cpu_hz();
 
-	ul_sysclk = sysclk_get_cpu_hz();
-	pmc_enable_periph_clk(ID_TC0);			//peripheral clock for Timer0
+	pmc_enable_periph_clk(id);							//peripheral clock
 
-	//compute the clock divider	 
-	tc_find_mck_divisor(1000, ul_sysclk, &ul_div, &ul_tcclks, ul_sysclk);
+	//clock divider for frequency
+	tc_find_mck_divisor(divFrequency, ul_sysclk, &ul_div, &ul_tcclks, ul_sysclk);
 
-	/////////////////////////////////////////////////////////////
-	//Configure the compare/capture value
-	tc_write_rc(TC0, 0, (ul_sysclk / ul_div) / (2*Timer0_Frequency));
-	tc_init(TC0, 0, ul_tcclks | TC_CMR_CPCTRG);
+	//compare/capture
+	tc_write_rc(tc, channel, (ul_sysclk / ul_div) / (2*frequency));
+	tc_init(tc, channel, ul_tcclks | TC_CMR_CPCTRG);
 
-	////////////////////////////////////////////////////////////
-	//Configure and enable interrupt on RC compare
-	NVIC_EnableIRQ((IRQn_Type) ID_TC0);				//ID0
-	tc_enable_interrupt(TC0, 0, TC_IER_CPCS);		//Timer 0, Channel 0	 
-	tc_start(TC0, 0);								//enable the timer
+	//interrupt on RC compare
+	NVIC_EnableIRQ((IRQn_Type) id);
+	tc_enable_interrupt(tc, channel, TC_IER_CPCS);
+	tc_start(tc, channel);
 }
 
 
-
-
 ///////////////////////////////////////////////
-//Timer 3 Config
-//Timer3 ID = Timer1, Channel 0
+//Timer 0 Config
+//Timer0 ID = Timer0, Channel 0
 //Compare Capture - Interrupt Enabled
-//Configure to Trigger at 1khz
+//Configure to Trigger at 11khz
 //
-void Timer3_Config()
+//The prescaler is searched for 1khz, as in the
+//original setup, so the rc rounding and the exact
+//sound rate don't change.
+//
+void Timer0_Config(void)
 {
-	uint32_t ul_div;
-	uint32_t ul_tcclks;
-	uint32_t ul_sysclk;
-	uint32_t Timer3_Frequency = 1000;
-
-	ul_sysclk = sysclk_get_cpu_hz();
-	pmc_enable_periph_clk(ID_TC3);		//Enable Clock Timer 3
-	 
-	//Clock divider for Timer3_Frequency
-	tc_find_mck_divisor(Timer3_Frequency, ul_sysclk, &ul_div, &ul_tcclks, ul_sysclk);
-
-	//Configure compare/capture
-	//Timer3 ID = Timer1, Ch0
-	tc_write_rc(TC1, 0, (ul_sysclk / ul_div) / (2*Timer3_Frequency));
-	tc_init(TC1, 0, ul_tcclks | TC_CMR_CPCTRG);
-
-	//////////////////////////////////////////////////
-	//Configure and enable interrupt on RC compare
-	NVIC_EnableIRQ((IRQn_Type) ID_TC3);				//ID3
-	tc_enable_interrupt(TC1, 0, TC_IER_CPCS);		//Timer 1, Channel 0
-	tc_start(TC1, 0);								//start the timer
+	Timer_ConfigChannel(TC0, 0, ID_TC0, 11000, 1000);
 }
 
 
-
-
 ///////////////////////////////////////////////
-//Timer 4 Config
-//Timer4 ID = Timer1, Channel 1
+//Timer 3 Config
+//Timer3 ID = Timer1, Channel 0
 //Compare Capture - Interrupt Enabled
-//Configure to Trigger at 500hz
+//Configure to Trigger at 1khz
 //
-void Timer4_Config()
-{
-	uint32_t ul_div;
-	uint32_t ul_tcclks;
-	uint32_t ul_sysclk;
-	uint32_t Timer4_Frequency = 500;
-
-	ul_sysclk = sysclk_get_cpu_hz();
-	pmc_enable_periph_clk(ID_TC4);		//Enable Clock Timer 4
-	
-	//Clock divider for Timer4_Frequency
-	tc_find_mck_divisor(Timer4_Frequency, ul_sysclk, &ul_div, &ul_tcclks, ul_sysclk);
-
-	//Configure compare/capture
-	//Timer4 ID = Timer1, Ch1
-	tc_write_rc(TC1, 1, (ul_sysclk / ul_div) / (2*Timer4_Frequency));
-	tc_init(TC1, 1, ul_tcclks | TC_CMR_CPCTRG);
-
-	//////////////////////////////////////////////////
-	//Configure and enable interrupt on RC compare
-	NVIC_EnableIRQ((IRQn_Type) ID_TC4);				//ID4
-	tc_enable_interrupt(TC1, 1, TC_IER_CPCS);		//Timer 1, Channel 1
-	tc_start(TC1, 1);								//start the timer
-}
-
-
-
-
-///////////////////////////////////////////////////
-//Timer 5 Config
-//Timer5 ID = Timer1, Channel 2
-//Compare Capture - Interrupt Enabled
-//Configure to Trigger at 100hz
+//System tick.
 //
-void Timer5_Config()
+void Timer3_Config()
 {
-	uint32_t ul_div;
-	uint32_t ul_tcclks;
-	uint32_t ul_sysclk;
-	uint32_t Timer5_Frequency = 100;
-
-	ul_sysclk = sysclk_get_cpu_hz();
-	pmc_enable_periph_clk(ID_TC5);		//Enable Clock Timer 5
-	
-	//Clock divider for Timer5_Frequency
-	tc_find_mck_divisor(Timer5_Frequency, ul_sysclk, &ul_div, &ul_tcclks, ul_sysclk);
-
-	//Configure compare/capture
-	//Timer5 ID = Timer1, Ch2
-	tc_write_rc(TC1, 2, (ul_sysclk / ul_div) / (2*Timer5_Frequency));
-	tc_init(TC1, 2, ul_tcclks | TC_CMR_CPCTRG);
-
-	//////////////////////////////////////////////////
-	//Configure and enable interrupt on RC compare
-	NVIC_EnableIRQ((IRQn_Type) ID_TC5);				//ID5
-	tc_enable_interrupt(TC1, 2, TC_IER_CPCS);		//Timer 1, Channel 2
-	tc_start(TC1, 2);								//start the timer
+	Timer_ConfigChannel(TC1, 0, ID_TC3, 1000, 1000);
 }
 
 
@@ -194,62 +155,21 @@ void TC0_Handler()
 
 /////////////////////////////////////////////////
 //ISR for Timer 3
-//
+//System tick.  Also starts one joystick
+//conversion per tick.
 void TC3_Handler()
 {
 	//do something
 	ioport_toggle_pin_level(GPIO_D6);	//D6 - PC19
 
 	gTimerTick++;
+	ADC_StartAD6();
 	
 	uint32_t dummy = tc_get_status(TC1, 0);
 	UNUSED(dummy);
 }
 
 
-/////////////////////////////////////////////////
-//ISR for Timer 4
-//
-void TC4_Handler()
-{
-	//do something
-	ioport_toggle_pin_level(GPIO_D5);
-	
-	uint32_t dummy = tc_get_status(TC1, 1);
-	UNUSED(dummy);
-}
-
-
-/////////////////////////////////////////////////
-//ISR for Timer 5
-//100hz timer.  Use to toggle gpio pin D4
-//and toggle the high speed timer 11khz 
-//on and off.  simulates starting and stopping
-//sound output.
-void TC5_Handler()
-{
-	static uint8_t sound = 0;
-
-	//do something
-	ioport_toggle_pin_level(GPIO_D4);
-
-	if (!sound)
-	{
-		sound = 1;
-		tc_start(TC0, 0);		//start the HS timer
-	}
-	else
-	{
-		sound = 0;
-		tc_stop(TC0, 0);		//stop the HS timer
-	}
-
-	uint32_t dummy = tc_get_status(TC1, 2);
-	UNUSED(dummy);
-}
-
-
-
 ///////////////////////////////////////
 //Timer0 - TC0
 void Timer0_Start(void)
@@ -15,13 +15,18 @@
 #include "conf_board.h"
 #include "conf_clock.h"
 
+///////////////////////////////////////////
+//Sleep between ticks in Timer_Delay.
+//Set to 0 to spin instead (debugger friendly)
+#define TIMER_SLEEP_ENABLE		1
+
+void Timer_SleepConfig(void);
 void Timer_Delay(uint32_t delay);
+uint32_t Timer_GetTick(void);
 
 //timers
 void Timer0_Config(void);
 void Timer3_Config(void);
-void Timer4_Config(void);
-void Timer5_Config(void);
 
 void Timer0_Start(void);
 void Timer0_Stop(void);
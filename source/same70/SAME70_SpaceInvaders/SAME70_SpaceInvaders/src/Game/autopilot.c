@@ -0,0 +1,286 @@
+/*
+ * autopilot.c
+ *
+ *  Author: danao
+
+ Attract mode / soak test autopilot.
+
+ Call order in the game loop:
+ Autopilot_Update() - top of the frame, before Sprite_ProcessInput()
+ Autopilot_FrameDone() - end of the frame, before the frame delay
+
+ Autopilot_Update() is also called on the game over
+ screens so it can restart the game.
+
+ Joystick moves are posted as press / release pairs
+ like the ADC sampler does, so Sprite_Player_Move sees a
+ held direction.  Shots are button presses.
+
+ */
+
+#include <stdio.h>
+
+#include "autopilot.h"
+#include "input.h"
+#include "sprite.h"
+#include "timer_driver.h"
+
+
+static uint8_t mAutopilotEnabled = 0;
+static InputId_t mAutopilotHeld = INPUT_ID_LAST;		//joystick direction held, LAST = none
+static uint32_t mAutopilotLastX = 0x00;					//player x last frame
+static uint32_t mAutopilotFireTick = 0x00;
+static uint32_t mAutopilotGameOverTick = 0x00;
+static uint8_t mAutopilotPlaying = 0;					//game in progress
+
+#if AUTOPILOT_SOAK_ENABLE
+static uint32_t mSoakBins[AUTOPILOT_SOAK_NUM_BINS];		//frame time histogram
+static uint32_t mSoakFrames = 0x00;
+static uint32_t mSoakMax = 0x00;
+static uint32_t mSoakFrameStart = 0x00;
+static uint32_t mSoakStartTick = 0x00;
+static uint32_t mSoakReportTick = 0x00;
+static uint16_t mSoakLevel = 0x00;						//level reached, current game
+static uint16_t mSoakLastLevel = 0x00;					//level reached, last game
+static uint16_t mSoakMaxLevel = 0x00;					//level reached, all games
+static uint32_t mSoakGames = 0x00;
+
+static uint32_t Autopilot_SoakPercentile(uint32_t percent);
+static void Autopilot_SoakReport(uint32_t tick);
+#endif
+
+static void Autopilot_Hold(InputId_t id);
+static void Autopilot_GameOver(void);
+
+
+///////////////////////////////////////////
+//Reset the autopilot and the soak stats.
+//Call after Input_Init and Timer3_Config.
+void Autopilot_Init(void)
+{
+	uint32_t tick = Timer_GetTick();
+
+	mAutopilotEnabled = (AUTOPILOT_ENABLE || AUTOPILOT_SOAK_ENABLE) ? 1 : 0;
+	mAutopilotHeld = INPUT_ID_LAST;
+	mAutopilotLastX = 0x00;
+	mAutopilotFireTick = tick;
+	mAutopilotGameOverTick = tick;
+	mAutopilotPlaying = 0;
+
+#if AUTOPILOT_SOAK_ENABLE
+	for (int i = 0 ; i < AUTOPILOT_SOAK_NUM_BINS ; i++)
+		mSoakBins[i] = 0x00;
+
+	mSoakFrames = 0x00;
+	mSoakMax = 0x00;
+	mSoakFrameStart = tick;
+	mSoakStartTick = tick;
+	mSoakReportTick = tick;
+	mSoakLevel = 0x00;
+	mSoakLastLevel = 0x00;
+	mSoakMaxLevel = 0x00;
+	mSoakGames = 0x00;
+#endif
+}
+
+
+/////////////////////////////////////////
+//Turn the autopilot on / off.  Turning
+//it off releases the joystick.
+void Autopilot_Enable(uint8_t enable)
+{
+	if (!enable)
+		Autopilot_Hold(INPUT_ID_LAST);
+
+	mAutopilotEnabled = enable ? 1 : 0;
+}
+
+uint8_t Autopilot_IsEnabled(void)
+{
+	return mAutopilotEnabled;
+}
+
+
+//////////////////////////////////////////////////
+//Play one frame.  Post input events for this
+//frame, Sprite_ProcessInput() picks them up.
+//
+//Priority:
+//1. incoming missile - step away from it
+//2. line up under the nearest enemy
+//3. fire when lined up and the cooldown is done
+//
+void Autopilot_Update(void)
+{
+	uint32_t tick = Timer_GetTick();
+
+#if AUTOPILOT_SOAK_ENABLE
+	mSoakFrameStart = tick;
+#endif
+
+	if (!mAutopilotEnabled)
+		return;
+
+	//game over screen - wait, then press the button
+	if (Sprite_GetGameOverFlag() == 1)
+	{
+		if (mAutopilotPlaying == 1)
+			Autopilot_GameOver();
+
+		if ((tick - mAutopilotGameOverTick) >= AUTOPILOT_RESTART_MS)
+		{
+			Input_AutopilotPost(INPUT_EVENT_PRESS, INPUT_ID_BUTTON_SW0);
+			mAutopilotGameOverTick = tick;
+		}
+
+		return;
+	}
+
+	mAutopilotPlaying = 1;
+
+#if AUTOPILOT_SOAK_ENABLE
+	if (Sprite_GetGameLevel() > mSoakLevel)
+		mSoakLevel = Sprite_GetGameLevel();
+#endif
+
+	uint32_t px = Sprite_GetPlayerCenterX();
+	int threat = Sprite_GetIncomingMissileX(px, AUTOPILOT_DODGE_HALF_WIDTH, AUTOPILOT_DODGE_RANGE_Y);
+	int target = Sprite_GetNearestEnemyX(px);
+	InputId_t dir = INPUT_ID_LAST;
+
+	if (threat >= 0)
+	{
+		dir = ((uint32_t)threat >= px) ? INPUT_ID_JOYSTICK_LEFT : INPUT_ID_JOYSTICK_RIGHT;
+
+		//against the wall - go the other way
+		if ((dir == mAutopilotHeld) && (px == mAutopilotLastX))
+			dir = (dir == INPUT_ID_JOYSTICK_LEFT) ? INPUT_ID_JOYSTICK_RIGHT : INPUT_ID_JOYSTICK_LEFT;
+	}
+	else if (target >= 0)
+	{
+		int32_t diff = target - (int32_t)px;
+
+		if (diff > AUTOPILOT_AIM_TOLERANCE)
+			dir = INPUT_ID_JOYSTICK_RIGHT;
+		else if (diff < -AUTOPILOT_AIM_TOLERANCE)
+			dir = INPUT_ID_JOYSTICK_LEFT;
+		else if ((tick - mAutopilotFireTick) >= AUTOPILOT_FIRE_COOLDOWN_MS)
+		{
+			Input_AutopilotPost(INPUT_EVENT_PRESS, INPUT_ID_BUTTON_SW0);
+			mAutopilotFireTick = tick;
+		}
+	}
+
+	Autopilot_Hold(dir);
+	mAutopilotLastX = px;
+}
+
+
+//////////////////////////////////////////////
+//End of a game frame.  Records the frame time
+//(top of the frame to here, without the frame
+//delay) and prints the soak report when due.
+void Autopilot_FrameDone(void)
+{
+#if AUTOPILOT_SOAK_ENABLE
+	uint32_t tick = Timer_GetTick();
+	uint32_t frame = tick - mSoakFrameStart;
+	uint32_t bin = frame / AUTOPILOT_SOAK_BIN_MS;
+
+	if (bin >= AUTOPILOT_SOAK_NUM_BINS)
+		bin = AUTOPILOT_SOAK_NUM_BINS - 1;
+
+	mSoakBins[bin]++;
+	mSoakFrames++;
+
+	if (frame > mSoakMax)
+		mSoakMax = frame;
+
+	if ((tick - mSoakReportTick) >= AUTOPILOT_SOAK_REPORT_MS)
+	{
+		Autopilot_SoakReport(tick);
+		mSoakReportTick = tick;
+	}
+#endif
+}
+
+
+/////////////////////////////////////////////
+//Change the held joystick direction.  Post
+//the release of the old direction and the
+//press of the new one.  LAST = centered
+static void Autopilot_Hold(InputId_t id)
+{
+	if (id == mAutopilotHeld)
+		return;
+
+	if (mAutopilotHeld != INPUT_ID_LAST)
+		Input_AutopilotPost(INPUT_EVENT_RELEASE, mAutopilotHeld);
+
+	if (id != INPUT_ID_LAST)
+		Input_AutopilotPost(INPUT_EVENT_PRESS, id);
+
+	mAutopilotHeld = id;
+}
+
+
+/////////////////////////////////////////
+//First frame on the game over screen
+static void Autopilot_GameOver(void)
+{
+	mAutopilotPlaying = 0;
+	mAutopilotGameOverTick = Timer_GetTick();
+	Autopilot_Hold(INPUT_ID_LAST);
+
+#if AUTOPILOT_SOAK_ENABLE
+	mSoakGames++;
+	mSoakLastLevel = mSoakLevel;
+
+	if (mSoakLevel > mSoakMaxLevel)
+		mSoakMaxLevel = mSoakLevel;
+
+	mSoakLevel = 0x00;
+#endif
+}
+
+
+#if AUTOPILOT_SOAK_ENABLE
+
+///////////////////////////////////////////////
+//Frame time at percent, in ms, from the
+//histogram.  Returns the bottom of the bin,
+//exact with 1ms bins.
+static uint32_t Autopilot_SoakPercentile(uint32_t percent)
+{
+	uint32_t target = ((mSoakFrames * percent) + 99) / 100;
+	uint32_t count = 0x00;
+
+	for (int i = 0 ; i < AUTOPILOT_SOAK_NUM_BINS ; i++)
+	{
+		count += mSoakBins[i];
+
+		if ((count > 0) && (count >= target))
+			return i * AUTOPILOT_SOAK_BIN_MS;
+	}
+
+	return (AUTOPILOT_SOAK_NUM_BINS - 1) * AUTOPILOT_SOAK_BIN_MS;
+}
+
+
+///////////////////////////////////////////
+//One line per report, totals since boot
+static void Autopilot_SoakReport(uint32_t tick)
+{
+	printf("soak %lus frames:%lu p50:%lu p90:%lu p99:%lu max:%lu ms level:%u last:%u max:%u games:%lu drop:%lu\r\n",
+		(unsigned long)((tick - mSoakStartTick) / 1000),
+		(unsigned long)mSoakFrames,
+		(unsigned long)Autopilot_SoakPercentile(50),
+		(unsigned long)Autopilot_SoakPercentile(90),
+		(unsigned long)Autopilot_SoakPercentile(99),
+		(unsigned long)mSoakMax,
+		mSoakLevel, mSoakLastLevel, mSoakMaxLevel,
+		(unsigned long)mSoakGames,
+		(unsigned long)Input_GetDroppedCount());
+}
+
+#endif
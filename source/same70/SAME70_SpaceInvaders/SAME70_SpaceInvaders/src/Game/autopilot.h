@@ -0,0 +1,64 @@
+/*
+ * autopilot.h
+ *
+ *  Author: danao
+
+ Attract mode / soak test autopilot.
+ Plays the game through the input event queue, the same
+ path as the buttons and joystick:  tracks the nearest
+ enemy column, steps away from incoming missiles, fires
+ on a cooldown and restarts the game on game over.
+
+ Soak mode records the time of every frame and prints
+ a report on the console every AUTOPILOT_SOAK_REPORT_MS:
+ frame time percentiles, max, levels reached and the
+ number of input events dropped.
+
+ Only uses the sprite getters, the input queue and
+ Timer_GetTick(), no hardware access.
+
+ host/soak.c builds the game, the lcd driver and this
+ on the pc and runs the soak on a simulated clock.
+
+ */
+
+
+#ifndef AUTOPILOT_H_
+#define AUTOPILOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//////////////////////////////////////////
+//Build options
+#ifndef AUTOPILOT_ENABLE
+#define AUTOPILOT_ENABLE				0		//1 - start in attract mode
+#endif
+#ifndef AUTOPILOT_SOAK_ENABLE
+#define AUTOPILOT_SOAK_ENABLE			0		//1 - frame stats on the console, host/soak.c
+#endif
+
+//////////////////////////////////////////
+//Play, in system ticks (1ms) and pixels
+#define AUTOPILOT_FIRE_COOLDOWN_MS		400		//time between shots
+#define AUTOPILOT_RESTART_MS			3000	//game over screen time
+#define AUTOPILOT_AIM_TOLERANCE			3		//close enough to fire
+#define AUTOPILOT_DODGE_HALF_WIDTH		8		//missile this close in x is a threat
+#define AUTOPILOT_DODGE_RANGE_Y			20		//and this close above the player
+
+//////////////////////////////////////////
+//Soak stats
+#define AUTOPILOT_SOAK_REPORT_MS		60000	//console report period
+#define AUTOPILOT_SOAK_BIN_MS			1		//histogram bin width
+#define AUTOPILOT_SOAK_NUM_BINS			256		//last bin holds everything longer
+
+
+void Autopilot_Init(void);
+void Autopilot_Enable(uint8_t enable);
+uint8_t Autopilot_IsEnabled(void);
+
+void Autopilot_Update(void);
+void Autopilot_FrameDone(void);
+
+
+#endif /* AUTOPILOT_H_ */
@@ -0,0 +1,32 @@
+/*
+ * asf.h - host build stub
+ *
+ * Just what the game, input and lcd files use from
+ * the ASF, for host/soak.c.  Pins do nothing.
+ */
+
+#ifndef ASF_H_HOST_
+#define ASF_H_HOST_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define ID_PIOA								10
+#define ID_PIOC								12
+#define ID_PIOD								16
+
+#define PIO_PA2_IDX							2
+#define PIO_PA17_IDX						17
+#define PIO_PC9_IDX							(64 + 9)
+
+#define IOPORT_DIR_OUTPUT					1
+
+#define pmc_enable_periph_clk(id)			((void)(id))
+#define ioport_set_pin_dir(pin, dir)		((void)(pin), (void)(dir))
+#define ioport_set_pin_level(pin, level)	((void)(pin), (void)(level))
+#define ioport_toggle_pin_level(pin)		((void)(pin))
+
+#define __DMB()								__sync_synchronize()
+
+#endif
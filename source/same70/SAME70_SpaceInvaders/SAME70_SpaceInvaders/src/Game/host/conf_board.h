@@ -0,0 +1,3 @@
+/*
+ * conf_board.h - host build stub, see asf.h
+ */
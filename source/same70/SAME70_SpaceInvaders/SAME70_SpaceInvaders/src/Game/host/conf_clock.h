@@ -0,0 +1,3 @@
+/*
+ * conf_clock.h - host build stub, see asf.h
+ */
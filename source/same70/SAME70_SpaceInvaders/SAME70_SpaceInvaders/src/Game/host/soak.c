@@ -0,0 +1,203 @@
+/*
+ * soak.c
+ *
+ *  Author: danao
+
+ Soak test on the pc.  Builds the game (sprite.c),
+ the input queue, the autopilot and the lcd driver
+ as they are on the target, with AUTOPILOT_SOAK_ENABLE,
+ and runs the main loop from main.c on a simulated
+ 1ms tick.  The autopilot prints its soak report every
+ simulated minute, same line as on the console.
+
+ Supplied here instead of the drivers:
+ - Timer_GetTick / Timer_Delay - the simulated clock,
+   Timer_Delay moves it on at once
+ - SPI - each byte the lcd driver writes takes 8 bits
+   at SPI_CLOCK_HZ (spi_driver.c), the only time a
+   frame costs.  The game code itself is taken as
+   free, at 300MHz it is small next to the lcd.
+ - Sound, pins - nothing
+ - the high score (EEPROM) - not kept, the game over
+   screen is the one without a new high score
+
+ asf.h, conf_board.h, conf_clock.h and stdio_serial.h
+ in this folder stand in for the ASF ones.
+
+ Build (from src/Game/host):
+ gcc -std=gnu99 -O2 -Wall -DAUTOPILOT_SOAK_ENABLE=1 -I. -I.. \
+     -I../../Display -I../../Bitmap -I../../Drivers -I../../Sound \
+     -o soak soak.c ../autopilot.c ../input.c ../sprite.c \
+     ../../Display/lcd_12864_dfrobot.c ../../Display/font_table.c \
+     ../../Display/offset.c ../../Bitmap/[a-z]*.c
+ Add -fsanitize=address,undefined -g to check for
+ overruns over a long run.
+
+ Run:    ./soak [hours] [seed]
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "autopilot.h"
+#include "input.h"
+#include "sprite.h"
+#include "lcd_12864_dfrobot.h"
+#include "spi_driver.h"
+#include "timer_driver.h"
+#include "Sound.h"
+
+#define SPI_CLOCK_HZ			500000		//spi_driver.c
+#define FRAME_DELAY_MS			200			//main loop, Timer_Delay
+
+
+static uint64_t mClockUs = 0x00;			//simulated time
+static uint64_t mSpiBytes = 0x00;
+static uint32_t mFrames = 0x00;
+
+
+/////////////////////////////////////////
+//Timer - the simulated clock
+uint32_t Timer_GetTick(void)
+{
+	return (uint32_t)(mClockUs / 1000);
+}
+
+void Timer_Delay(uint32_t delay)
+{
+	mClockUs += (uint64_t)delay * 1000;
+}
+
+void Timer_SleepConfig(void) {}
+void Timer0_Config(void) {}
+void Timer3_Config(void) {}
+void Timer0_Start(void) {}
+void Timer0_Stop(void) {}
+
+
+/////////////////////////////////////////
+//SPI - the lcd's time on the wire
+static void Spi_Clock(uint32_t bytes)
+{
+	mSpiBytes += bytes;
+	mClockUs += ((uint64_t)bytes * 8 * 1000000) / SPI_CLOCK_HZ;
+}
+
+void SPI_Config(void) {}
+void SPI_Select(void) {}
+void SPI_Deselect(void) {}
+void SPI_tx(uint8_t data) { (void)data; Spi_Clock(1); }
+uint8_t SPI_rx(void) { Spi_Clock(1); return 0x00; }
+void SPI_writeByte(uint8_t data) { (void)data; Spi_Clock(1); }
+void SPI_writeArray(uint8_t* data, uint16_t length) { (void)data; Spi_Clock(length); }
+
+
+/////////////////////////////////////////
+//Sound - silent
+void Sound_Init(void) {}
+void Sound_InterruptHandler(void) {}
+void Sound_Play_PlayerFire(void) {}
+void Sound_Play_EnemyFire(void) {}
+void Sound_Play_PlayerExplode(void) {}
+void Sound_Play_EnemyExplode(void) {}
+void Sound_Play_GameOver(void) {}
+void Sound_Play_LevelUp(void) {}
+
+
+/////////////////////////////////////////
+//Joystick - the adc sampler isn't run, the
+//autopilot posts its own events
+JoystickPosition_t Joystick_GetPositionFromRaw(uint16_t value)
+{
+	(void)value;
+	return JOYSTICK_NONE;
+}
+
+
+/////////////////////////////////////////
+//main.c main loop, one pass
+static void Soak_Frame(uint32_t counter)
+{
+	if (Sprite_GetGameOverFlag() == 1)
+	{
+		Sound_Play_GameOver();
+		Timer_Delay(2000);
+	}
+
+	while (Sprite_GetGameOverFlag() == 1)
+	{
+		LCD_DrawStringKern(5, 3, " Press Button");
+		Timer_Delay(1000);
+		LCD_Clear(0x00);
+		Timer_Delay(1000);
+
+		Autopilot_Update();
+		Sprite_ProcessInput();			//button press clears the game over flag
+		Sprite_Init();					//reset and clear all flags
+	}
+
+	Autopilot_Update();
+	Sprite_ProcessInput();
+
+	if (Sprite_GetPlayerMissileLaunchFlag() == 1)
+	{
+		Sprite_ClearPlayerMissileLaunchFlag();
+		Sprite_Player_Missle_Launch();
+	}
+
+	int16_t interval = 30 - (2 * Sprite_GetGameLevel());
+	if (interval < 0)
+		interval = interval * (-1);
+
+	if (interval < 5)
+		interval = 5;
+
+	if (!(counter % interval))
+		Sprite_Enemy_Missle_Launch();
+
+	if (Sprite_GetGameLevel() < 10)
+	{
+		if (!(counter % 20))
+			Sprite_Drone_Launch();
+	}
+	else
+	{
+		if (!(counter % 15))
+			Sprite_Drone_Launch();
+	}
+
+	Sprite_Player_Move();
+	Sprite_Enemy_Move();
+	Sprite_Missle_Move();
+	Sprite_Drone_Move();
+	Sprite_UpdateDisplay();
+
+	Autopilot_FrameDone();
+	Timer_Delay(FRAME_DELAY_MS);
+}
+
+
+int main(int argc, char **argv)
+{
+	double hours = (argc > 1) ? atof(argv[1]) : 1.0;
+	unsigned int seed = (argc > 2) ? (unsigned int)atoi(argv[2]) : 1;
+	uint64_t endUs = (uint64_t)(hours * 3600.0 * 1000000.0);
+
+	srand(seed);
+
+	Input_Init();
+	Sprite_Init();
+	Autopilot_Init();
+	Sprite_SetGameOverFlag();
+
+	while (mClockUs < endUs)
+		Soak_Frame(mFrames++);
+
+	printf("done %.2fh seed %u, %lu passes, lcd %llu bytes, %llus on the spi\r\n",
+		hours, seed, (unsigned long)mFrames, (unsigned long long)mSpiBytes,
+		(unsigned long long)((mSpiBytes * 8) / SPI_CLOCK_HZ));
+
+	return 0;
+}
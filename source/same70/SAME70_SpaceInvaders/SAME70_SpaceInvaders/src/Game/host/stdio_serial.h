@@ -0,0 +1,3 @@
+/*
+ * stdio_serial.h - host build stub, see asf.h
+ */
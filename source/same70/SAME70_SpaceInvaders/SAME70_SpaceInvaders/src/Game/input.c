@@ -0,0 +1,242 @@
+/*
+ * input.c
+ *
+ *  Author: danao
+
+ Input event queue for the user buttons and joystick.
+
+ Producers:
+ Button_Handler (PIO interrupt) - Input_ButtonISR()
+ ADC Channel 6 callback - Input_JoystickSampleISR()
+ Autopilot, main loop - Input_AutopilotPost()
+
+ Consumer:
+ Game loop, once per frame - Input_GetEvent()
+
+ Each producer writes only the head of its own ring and
+ the consumer writes only the tail, so the rings are
+ lock free.  The data memory barrier makes sure the event
+ is in memory before the index that publishes it.
+
+ */
+
+#include "asf.h"
+#include "conf_board.h"
+#include "conf_clock.h"
+
+#include "input.h"
+#include "joystick.h"
+#include "timer_driver.h"
+
+
+typedef struct
+{
+	volatile uint8_t head;					//written by producer
+	volatile uint8_t tail;					//written by consumer
+	InputEvent events[INPUT_QUEUE_SIZE];
+}InputQueue;
+
+
+static InputQueue mInputQueue[INPUT_SOURCE_LAST];
+static volatile uint32_t mInputDropped = 0x00;
+
+//button debounce - last accepted edge
+static uint32_t mButtonLastTick[INPUT_ID_JOYSTICK_UP];
+static uint8_t mButtonValid[INPUT_ID_JOYSTICK_UP];
+
+//joystick sampler state
+static uint32_t mJoystickLastSample = 0x00;
+static JoystickPosition_t mJoystickCandidate = JOYSTICK_NONE;
+static uint32_t mJoystickCandidateTick = 0x00;
+static JoystickPosition_t mJoystickStable = JOYSTICK_NONE;
+static uint32_t mJoystickRepeatTick = 0x00;
+
+static int Input_Post(InputSource_t source, InputEventType_t type, InputId_t id, uint32_t tick);
+static InputId_t Input_JoystickToId(JoystickPosition_t pos);
+
+
+////////////////////////////////////////////
+//Reset the queues and debounce state.
+//Call before enabling the button and ADC
+//interrupts.
+void Input_Init(void)
+{
+	for (int i = 0 ; i < INPUT_SOURCE_LAST ; i++)
+	{
+		mInputQueue[i].head = 0x00;
+		mInputQueue[i].tail = 0x00;
+	}
+
+	for (int i = 0 ; i < INPUT_ID_JOYSTICK_UP ; i++)
+	{
+		mButtonLastTick[i] = 0x00;
+		mButtonValid[i] = 0;
+	}
+
+	mInputDropped = 0x00;
+	mJoystickLastSample = Timer_GetTick();
+	mJoystickCandidate = JOYSTICK_NONE;
+	mJoystickCandidateTick = mJoystickLastSample;
+	mJoystickStable = JOYSTICK_NONE;
+	mJoystickRepeatTick = mJoystickLastSample;
+}
+
+
+//////////////////////////////////////////////
+//Button edge from the PIO interrupt.  Edges
+//inside the debounce window of the last accepted
+//edge are contact bounce and are dropped, so one
+//press posts exactly one event.
+void Input_ButtonISR(InputId_t id)
+{
+	uint32_t tick = Timer_GetTick();
+
+	if (id >= INPUT_ID_JOYSTICK_UP)
+		return;
+
+	if ((mButtonValid[id] == 1) && ((tick - mButtonLastTick[id]) < INPUT_BUTTON_DEBOUNCE_MS))
+		return;
+
+	mButtonValid[id] = 1;
+	mButtonLastTick[id] = tick;
+	Input_Post(INPUT_SOURCE_BUTTON, INPUT_EVENT_PRESS, id, tick);
+}
+
+
+///////////////////////////////////////////////////
+//Joystick sample from the ADC conversion callback.
+//One conversion is started per system tick, extra
+//samples inside the same tick are ignored.  A new position has to
+//hold for INPUT_JOYSTICK_DEBOUNCE_MS before it is
+//accepted.  Accepted changes post release/press
+//edges, holding a direction posts repeats.
+void Input_JoystickSampleISR(uint32_t rawData)
+{
+	uint32_t tick = Timer_GetTick();
+	JoystickPosition_t pos;
+
+	if (tick == mJoystickLastSample)
+		return;
+
+	mJoystickLastSample = tick;
+	pos = Joystick_GetPositionFromRaw((uint16_t)rawData);
+
+	//new candidate - restart the debounce window
+	if (pos != mJoystickCandidate)
+	{
+		mJoystickCandidate = pos;
+		mJoystickCandidateTick = tick;
+		return;
+	}
+
+	if ((tick - mJoystickCandidateTick) < INPUT_JOYSTICK_DEBOUNCE_MS)
+		return;
+
+	//candidate is stable - edge?
+	if (pos != mJoystickStable)
+	{
+		if (mJoystickStable != JOYSTICK_NONE)
+			Input_Post(INPUT_SOURCE_JOYSTICK, INPUT_EVENT_RELEASE, Input_JoystickToId(mJoystickStable), tick);
+
+		if (pos != JOYSTICK_NONE)
+			Input_Post(INPUT_SOURCE_JOYSTICK, INPUT_EVENT_PRESS, Input_JoystickToId(pos), tick);
+
+		mJoystickStable = pos;
+		mJoystickRepeatTick = tick + INPUT_REPEAT_DELAY_MS;
+	}
+
+	//held - repeat
+	else if ((pos != JOYSTICK_NONE) && ((int32_t)(tick - mJoystickRepeatTick) >= 0))
+	{
+		Input_Post(INPUT_SOURCE_JOYSTICK, INPUT_EVENT_REPEAT, Input_JoystickToId(pos), tick);
+		mJoystickRepeatTick = tick + INPUT_REPEAT_RATE_MS;
+	}
+}
+
+
+///////////////////////////////////////////////////
+//Event from the autopilot.  Posted from the main
+//loop, already debounced, so it goes straight into
+//its own ring.  Returns 0 on success, -1 if full.
+int Input_AutopilotPost(InputEventType_t type, InputId_t id)
+{
+	return Input_Post(INPUT_SOURCE_AUTOPILOT, type, id, Timer_GetTick());
+}
+
+
+///////////////////////////////////////////////////
+//Remove the oldest event across all producer
+//rings.  Returns 1 if an event was loaded, 0 if
+//all rings are empty.
+int Input_GetEvent(InputEvent *event)
+{
+	int source = -1;
+
+	for (int i = 0 ; i < INPUT_SOURCE_LAST ; i++)
+	{
+		InputQueue *q = &mInputQueue[i];
+
+		if (q->tail != q->head)
+		{
+			if ((source < 0) ||
+				((int32_t)(q->events[q->tail].tick - mInputQueue[source].events[mInputQueue[source].tail].tick) < 0))
+				source = i;
+		}
+	}
+
+	if (source < 0)
+		return 0;
+
+	InputQueue *q = &mInputQueue[source];
+	*event = q->events[q->tail];
+	__DMB();											//read the event before freeing the slot
+	q->tail = (q->tail + 1) & INPUT_QUEUE_MASK;
+
+	return 1;
+}
+
+
+//////////////////////////////////////////
+//Number of events lost to a full ring
+uint32_t Input_GetDroppedCount(void)
+{
+	return mInputDropped;
+}
+
+
+/////////////////////////////////////////////
+//Producer side push.  Only called from the
+//context that owns the ring.
+static int Input_Post(InputSource_t source, InputEventType_t type, InputId_t id, uint32_t tick)
+{
+	InputQueue *q = &mInputQueue[source];
+	uint8_t head = q->head;
+	uint8_t next = (head + 1) & INPUT_QUEUE_MASK;
+
+	if (next == q->tail)
+	{
+		mInputDropped++;
+		return -1;
+	}
+
+	q->events[head].type = type;
+	q->events[head].id = id;
+	q->events[head].tick = tick;
+	__DMB();											//publish the event before the index
+	q->head = next;
+
+	return 0;
+}
+
+
+static InputId_t Input_JoystickToId(JoystickPosition_t pos)
+{
+	switch(pos)
+	{
+		case JOYSTICK_UP:		return INPUT_ID_JOYSTICK_UP;
+		case JOYSTICK_DOWN:		return INPUT_ID_JOYSTICK_DOWN;
+		case JOYSTICK_LEFT:		return INPUT_ID_JOYSTICK_LEFT;
+		case JOYSTICK_RIGHT:	return INPUT_ID_JOYSTICK_RIGHT;
+		default:				return INPUT_ID_JOYSTICK_PRESS;
+	}
+}
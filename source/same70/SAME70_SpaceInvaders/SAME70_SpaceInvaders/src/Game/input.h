@@ -0,0 +1,96 @@
+/*
+ * input.h
+ *
+ *  Author: danao
+
+ Input event queue for the user buttons and joystick.
+ Button presses are posted from the PIO interrupt and
+ joystick changes are posted from the ADC sampler.  The
+ game drains the queue once per frame, so none of the
+ game state is touched from interrupt context.
+
+ The autopilot (attract / soak mode) posts the same
+ events from the main loop, so the game can't tell it
+ from a player.
+
+ Each producer gets its own single
+ producer / single consumer ring, so no locking is needed.
+ Input_GetEvent() merges the rings in timestamp order.
+
+ */
+
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "joystick.h"
+
+//////////////////////////////////////////
+//Queue size - per producer, power of 2
+#define INPUT_QUEUE_SIZE				16
+#define INPUT_QUEUE_MASK				(INPUT_QUEUE_SIZE - 1)
+
+//////////////////////////////////////////
+//Timing, in system ticks (1ms)
+#define INPUT_BUTTON_DEBOUNCE_MS		50		//ignore edges inside this window
+#define INPUT_JOYSTICK_DEBOUNCE_MS		20		//position must be stable this long
+#define INPUT_REPEAT_DELAY_MS			300		//hold time before first repeat
+#define INPUT_REPEAT_RATE_MS			100		//time between repeats
+
+
+typedef enum
+{
+	INPUT_SOURCE_BUTTON,		//PIO interrupt
+	INPUT_SOURCE_JOYSTICK,		//ADC sampler
+	INPUT_SOURCE_AUTOPILOT,		//attract mode, main loop
+	INPUT_SOURCE_LAST,
+}InputSource_t;
+
+
+typedef enum
+{
+	INPUT_ID_BUTTON_SW0,		//onboard button PA11
+	INPUT_ID_BUTTON_SHIELD,		//shield button PA5
+	INPUT_ID_JOYSTICK_UP,
+	INPUT_ID_JOYSTICK_DOWN,
+	INPUT_ID_JOYSTICK_LEFT,
+	INPUT_ID_JOYSTICK_RIGHT,
+	INPUT_ID_JOYSTICK_PRESS,
+	INPUT_ID_LAST,
+}InputId_t;
+
+
+typedef enum
+{
+	INPUT_EVENT_PRESS,			//edge - pressed
+	INPUT_EVENT_RELEASE,		//edge - released
+	INPUT_EVENT_REPEAT,			//still held
+}InputEventType_t;
+
+
+typedef struct
+{
+	InputEventType_t type;
+	InputId_t id;
+	uint32_t tick;				//Timer_GetTick() when posted
+}InputEvent;
+
+
+void Input_Init(void);
+
+//producers - interrupt context
+void Input_ButtonISR(InputId_t id);
+void Input_JoystickSampleISR(uint32_t rawData);
+
+//producer - main loop
+int Input_AutopilotPost(InputEventType_t type, InputId_t id);
+
+//consumer - main loop
+int Input_GetEvent(InputEvent *event);
+uint32_t Input_GetDroppedCount(void);
+
+
+#endif /* INPUT_H_ */
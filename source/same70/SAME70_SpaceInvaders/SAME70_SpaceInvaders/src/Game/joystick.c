@@ -22,7 +22,16 @@
 JoystickPosition_t Joystick_GetPosition(void)
 {
 	uint16_t value = ADC_readChannel6();
+	return Joystick_GetPositionFromRaw(value);
+}
+
 
+///////////////////////////////////////////////
+//Convert a raw 12 bit reading from AD6 into a
+//joystick position.  Safe to call from the ADC
+//callback, it does not touch the ADC.
+JoystickPosition_t Joystick_GetPositionFromRaw(uint16_t value)
+{
 	if (value < JOYSTICK_LIMIT_0)
 		return JOYSTICK_LEFT;
 	else if ((value >= JOYSTICK_LIMIT_0) && (value < JOYSTICK_LIMIT_1))
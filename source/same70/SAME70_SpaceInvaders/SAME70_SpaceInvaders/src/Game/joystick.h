@@ -46,6 +46,7 @@ typedef enum
 #include "conf_clock.h"
 
 JoystickPosition_t Joystick_GetPosition(void);
+JoystickPosition_t Joystick_GetPositionFromRaw(uint16_t value);
 uint16_t Joystick_GetRawData(void);
 
 
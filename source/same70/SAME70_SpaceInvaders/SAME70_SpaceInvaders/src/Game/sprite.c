@@ -23,9 +23,11 @@ drone image 24x10
 #include "sprite.h"
 #include "lcd_12864_dfrobot.h"
 #include "joystick.h"
+#include "input.h"
 #include "bitmap.h"
 
 #include "Sound.h"
+#include "timer_driver.h"
 
 //player, enemy, missile, drone
 volatile PlayerStruct mPlayer;
@@ -35,11 +37,15 @@ static MissileStruct mPlayerMissile[NUM_MISSILE];
 static DroneStruct mDrone;
 
 //flags
-static uint8_t mPlayerMissileLaunchFlag;		//set in button isr
+static uint8_t mPlayerMissileLaunchFlag;		//set from button input event
 static uint16_t mGameScore;						//score
 static uint16_t mGameLevel;						//level
 static uint8_t mGameOverFlag = 0;				//set when last player killed
 
+//joystick direction - updated from input events
+static JoystickPosition_t mPlayerDirection = JOYSTICK_NONE;		//held direction
+static JoystickPosition_t mPlayerTap = JOYSTICK_NONE;			//press since last move
+
 ///////////////////////////////////////////
 //Dummy delay for showing sequence of image
 //events.  ie, player explode, etc
@@ -160,17 +166,69 @@ void Sprite_Drone_Init(void)
 
 
 
+///////////////////////////////////////////////////////
+//Drain the input event queue.  Call once per frame
+//from the game loop.  Button presses clear the game
+//over flag or launch a missile, joystick edges set
+//the player direction used by Sprite_Player_Move.
+void Sprite_ProcessInput(void)
+{
+	InputEvent event;
+
+	while (Input_GetEvent(&event))
+	{
+		switch(event.id)
+		{
+			case INPUT_ID_BUTTON_SW0:
+			case INPUT_ID_BUTTON_SHIELD:
+			{
+				//game over flag or missle
+				if (mGameOverFlag == 1)
+					mGameOverFlag = 0;
+				else
+					mPlayerMissileLaunchFlag = 1;
+				break;
+			}
+
+			case INPUT_ID_JOYSTICK_LEFT:
+			case INPUT_ID_JOYSTICK_RIGHT:
+			{
+				JoystickPosition_t pos = (event.id == INPUT_ID_JOYSTICK_LEFT) ? JOYSTICK_LEFT : JOYSTICK_RIGHT;
+
+				if (event.type == INPUT_EVENT_PRESS)
+				{
+					mPlayerDirection = pos;
+					mPlayerTap = pos;
+				}
+				else if ((event.type == INPUT_EVENT_RELEASE) && (mPlayerDirection == pos))
+					mPlayerDirection = JOYSTICK_NONE;
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+}
+
+
 //////////////////////////////////////////////////////
 //Set the player position x-direction
-//Uses the joystick on the LCD shield to get left 
-//and right presses.  If pressed left or right, move
-//player by 2 pixels.
+//Uses the joystick direction from the input events
+//(see Sprite_ProcessInput).  If held left or right, or
+//tapped since the last frame, move the player.
 //Player is left aligned, so max right position
 //is LCD_WIDTH - player.sizeX - 1
 //
 void Sprite_Player_Move(void)
 {
-	JoystickPosition_t pos = Joystick_GetPosition();
+	JoystickPosition_t pos = mPlayerDirection;
+
+	if (pos == JOYSTICK_NONE)
+		pos = mPlayerTap;
+
+	mPlayerTap = JOYSTICK_NONE;
+
 	//move left
 	if (pos == JOYSTICK_LEFT)
 	{
@@ -549,6 +607,9 @@ void Sprite_Player_Missle_Launch(void)
 {
     int nextMissile = Sprite_Player_GetNextMissile();
 
+    if (nextMissile < 0)
+        return;                 //all missiles in flight
+
     //set the missile in the array as live
     mPlayerMissile[nextMissile].life = 1;
     mPlayerMissile[nextMissile].x = mPlayer.x + (mPlayer.sizeX / 2) - (mPlayerMissile[nextMissile].sizeX / 2);
@@ -569,7 +630,7 @@ void Sprite_Enemy_Missle_Launch(void)
     int nextMissile = Sprite_Enemy_GetNextMissile();    //next missile
     int index = Sprite_GetRandomEnemy();                //index of random enemy
 
-    if (index >= 0)
+    if ((index >= 0) && (nextMissile >= 0))
     {        
         //set the missile in the array as live
         mEnemyMissile[nextMissile].life = 1;
@@ -591,6 +652,9 @@ void Sprite_Drone_Missle_Launch(void)
 {
 	int nextMissile = Sprite_Enemy_GetNextMissile();    //next missile
 
+	if (nextMissile < 0)
+		return;
+
 	//set the missile in the array as live
 	mEnemyMissile[nextMissile].life = 1;
 	mEnemyMissile[nextMissile].x = mDrone.x + (mDrone.sizeX / 2) - (mEnemyMissile[nextMissile].sizeX / 2);
@@ -774,6 +838,72 @@ int Sprite_GetNumEnemy(void)
 }
 
 
+//////////////////////////////////////
+//center x of the player
+uint32_t Sprite_GetPlayerCenterX(void)
+{
+    return mPlayer.x + (mPlayer.sizeX / 2);
+}
+
+
+//////////////////////////////////////////////
+//returns the center x of the live enemy closest
+//to x, horizontally.  returns -1 if none left.
+int Sprite_GetNearestEnemyX(uint32_t x)
+{
+    int nearest = -1;
+    uint32_t best = 0xFFFFFFFF;
+
+    for (int i = 0 ; i < NUM_ENEMY ; i++)
+    {
+        if (mEnemy[i].life == 1)
+        {
+            uint32_t cx = mEnemy[i].x + (mEnemy[i].sizeX / 2);
+            uint32_t dist = (cx > x) ? (cx - x) : (x - cx);
+
+            if (dist < best)
+            {
+                best = dist;
+                nearest = (int)cx;
+            }
+        }
+    }
+
+    return nearest;
+}
+
+
+//////////////////////////////////////////////////
+//returns the center x of the lowest enemy missile
+//within +/- halfWidth of x and at most rangeY
+//above the player.  returns -1 if nothing incoming
+int Sprite_GetIncomingMissileX(uint32_t x, uint32_t halfWidth, uint32_t rangeY)
+{
+    int incoming = -1;
+    uint32_t lowest = 0;
+
+    for (int i = 0 ; i < NUM_MISSILE ; i++)
+    {
+        if (mEnemyMissile[i].life == 1)
+        {
+            uint32_t cx = mEnemyMissile[i].x + (mEnemyMissile[i].sizeX / 2);
+            uint32_t bottom = mEnemyMissile[i].y + mEnemyMissile[i].sizeY;
+            uint32_t dist = (cx > x) ? (cx - x) : (x - cx);
+
+            //above the player bottom and inside the range
+            if ((dist <= halfWidth) && (bottom + rangeY >= mPlayer.y) &&
+                (mEnemyMissile[i].y <= mPlayer.y + mPlayer.sizeY) && (bottom >= lowest))
+            {
+                lowest = bottom;
+                incoming = (int)cx;
+            }
+        }
+    }
+
+    return incoming;
+}
+
+
 ////////////////////////////////////
 //returns the index of a live random
 //enemy for use in shooting missile
@@ -892,20 +1022,20 @@ void Sprite_Player_Explode(uint16_t x, uint16_t y)
 {
     LCD_DrawIcon(mPlayer.x, mPlayer.y, &bmimgPlayerExp1Bmp, 1);
 	LCD_BacklightOff();
-    Sprite_DummyDelay(1200000);
+    Timer_Delay(PLAYER_EXPLODE_DELAY);
     LCD_DrawIcon(mPlayer.x, mPlayer.y, &bmimgPlayerExp2Bmp, 1);
 	LCD_BacklightOn();
-    Sprite_DummyDelay(1200000);
+    Timer_Delay(PLAYER_EXPLODE_DELAY);
     LCD_DrawIcon(mPlayer.x, mPlayer.y, &bmimgPlayerExp3Bmp, 1);
 	LCD_BacklightOff();
-    Sprite_DummyDelay(1200000);
+    Timer_Delay(PLAYER_EXPLODE_DELAY);
     LCD_DrawIcon(mPlayer.x, mPlayer.y, &bmimgPlayerExp4Bmp, 1);
 	LCD_BacklightOn();
-    Sprite_DummyDelay(1200000);
+    Timer_Delay(PLAYER_EXPLODE_DELAY);
 	LCD_BacklightOff();
-	Sprite_DummyDelay(1200000);
+	Timer_Delay(PLAYER_EXPLODE_DELAY);
 	LCD_BacklightOn();
-	Sprite_DummyDelay(1200000);
+	Timer_Delay(PLAYER_EXPLODE_DELAY);
 }
 
 
@@ -916,13 +1046,13 @@ void Sprite_Player_Explode(uint16_t x, uint16_t y)
 void Sprite_Drone_Explode(uint16_t x, uint16_t y)
 {
 	LCD_DrawIcon(x, y, &bmimgDroneExp1Bmp, 1);
-	Sprite_DummyDelay(600000);
+	Timer_Delay(DRONE_EXPLODE_DELAY);
 	LCD_DrawIcon(x, y, &bmimgDroneExp2Bmp, 1);
-	Sprite_DummyDelay(600000);
+	Timer_Delay(DRONE_EXPLODE_DELAY);
 	LCD_DrawIcon(x, y, &bmimgDroneExp3Bmp, 1);
-	Sprite_DummyDelay(600000);
+	Timer_Delay(DRONE_EXPLODE_DELAY);
 	LCD_DrawIcon(x, y, &bmimgDroneExp4Bmp, 1);
-	Sprite_DummyDelay(600000);
+	Timer_Delay(DRONE_EXPLODE_DELAY);
 }
 
 
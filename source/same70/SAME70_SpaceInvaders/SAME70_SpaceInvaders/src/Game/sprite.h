@@ -45,6 +45,10 @@ drone image 24x10
 
 #define NUM_MISSILE    8
 
+//explosion sequence, ms per image
+#define PLAYER_EXPLODE_DELAY    20
+#define DRONE_EXPLODE_DELAY     10
+
 #define SPRITE_MAX_X        120
 #define SPRITE_MIN_X        10
 #define SPRITE_MAX_Y        48
@@ -130,6 +134,8 @@ void Sprite_Missile_Init(void);
 void Sprite_Drone_Init(void);
 
 
+void Sprite_ProcessInput(void);
+
 void Sprite_Player_Move(void);
 void Sprite_Enemy_Move(void);
 void Sprite_Missle_Move(void);
@@ -154,6 +160,10 @@ uint8_t Sprite_GetNumPlayers(void);
 int Sprite_GetNumEnemy(void);
 int Sprite_GetRandomEnemy(void);
 
+uint32_t Sprite_GetPlayerCenterX(void);
+int Sprite_GetNearestEnemyX(uint32_t x);
+int Sprite_GetIncomingMissileX(uint32_t x, uint32_t halfWidth, uint32_t rangeY);
+
 int Sprite_Player_GetNextMissile(void);
 int Sprite_Enemy_GetNextMissile(void);
 
@@ -75,6 +75,7 @@
 #include "stdio_serial.h"
 #include "conf_board.h"
 #include "conf_clock.h"
+#include "conf_uart_serial.h"
 
 #include "timer_driver.h"			//timebase and 11khz timer
 #include "spi_driver.h"				//spi - lcd control
@@ -85,6 +86,8 @@
 #include "lcd_12864_dfrobot.h"		//lcd driver
 #include "bitmap.h"					//images
 #include "joystick.h"				//joystick left/right
+#include "input.h"					//button / joystick event queue
+#include "autopilot.h"				//attract mode, soak test
 #include "sprite.h"					//game engine
 #include "Sound.h"					//sound engine
 #include "score.h"					//high score, level, etc, EEPROM
@@ -120,6 +123,10 @@
 //Globals
 uint32_t gCounter = 0x00;			//game loop counter
 
+#if AUTOPILOT_SOAK_ENABLE
+static void Console_Config(void);
+#endif
+
 
 int main(void)
 {
@@ -128,16 +135,23 @@ int main(void)
 	board_init();
 
 	GPIO_Config();			//LED
+	Input_Init();			//input event queue - before button / adc interrupts
 	Button_Config();		//user button
 	SPI_Config();			//LCD SPI control
+	ADC_ConfigAD6();		//channel 6 - AD1 pin, before TC3 starts sampling it
 	Timer0_Config();		//11khz timer
 	Timer3_Config();		//1000hz - required
+	Timer_SleepConfig();	//sleep (WFI) in Timer_Delay
 	DAC_Config();			//configure DAC output on DAC0, PB13
-	ADC_ConfigAD6();		//setup channel 6 - AD1 pin
 	I2C_Config();			//configure I2C for EEPROM - pins on Arduino headers
 	LCD_Config();			//setup lcd shield
 	Sprite_Init();			//initialize the game engine
 	Sound_Init();			//init the sound engine
+	Autopilot_Init();		//attract mode - see autopilot.h
+
+#if AUTOPILOT_SOAK_ENABLE
+	Console_Config();		//soak report on the EDBG com port
+#endif
 
 	//comment this out of score and player are set
 	//Score_Init();			//init high score, level, name
@@ -164,6 +178,8 @@ int main(void)
 					Timer_Delay(1000);
 					LCD_Clear(0x00);
 					Timer_Delay(1000);
+					Autopilot_Update();
+					Sprite_ProcessInput();		//button press clears the game over flag
 				}
 
 				//update the high score and level here
@@ -221,9 +237,15 @@ int main(void)
 //	        LCD_DrawStringKern(2, 3, "                ");
 	        Timer_Delay(1000);
 
+			Autopilot_Update();
+			Sprite_ProcessInput();			//button press clears the game over flag
 	        Sprite_Init();                  //reset and clear all flags
         }
 
+		//input events posted since the last frame
+		Autopilot_Update();
+		Sprite_ProcessInput();
+
         //launch any new missiles from player?
         if (Sprite_GetPlayerMissileLaunchFlag() == 1)
         {
@@ -273,10 +295,30 @@ int main(void)
         
         gCounter++;
 
+		Autopilot_FrameDone();		//frame time stats
         Timer_Delay(200);
 	}
 
 }
 
 
+#if AUTOPILOT_SOAK_ENABLE
+/////////////////////////////////////////////
+//Console on USART1 - EDBG virtual com port
+//printf goes here.
+static void Console_Config(void)
+{
+	const usart_serial_options_t uart_serial_options = {
+		.baudrate = CONF_UART_BAUDRATE,
+		.charlength = CONF_UART_CHAR_LENGTH,
+		.paritytype = CONF_UART_PARITY,
+		.stopbits = CONF_UART_STOP_BITS,
+	};
+
+	sysclk_enable_peripheral_clock(CONSOLE_UART_ID);
+	stdio_serial_init(CONF_UART, &uart_serial_options);
+}
+#endif
+
+
 